@@ -17,6 +17,7 @@
 #define BASE_H
 
 #include <stdint.h>
+#include <string.h>
 
 /* Basic macros for a variety of uses.  Quite self explanatory. */
 #define ARR_SIZE(xs) (sizeof(xs) / sizeof(xs[0]))
@@ -118,10 +119,19 @@ typedef enum
 #define DHWORD(HWORD) ((data_t){.as_hword = (HWORD)})
 #define DWORD(WORD)   ((data_t){.as_word = (WORD)})
 
-// Macro to determine if the current machine is little endian
-#ifndef LITTLE_ENDIAN
-static const hword_t __i = 0xFFFF0000;
-#define LITTLE_ENDIAN ((*((byte_t *)&__i)) == 0)
+/* Whether the host is little endian, i.e. in the same byte order as
+   the virtual machine.  Decided by the preprocessor where the compiler
+   says, otherwise a constant expression the compiler can still fold,
+   so the convert_* routines never test anything at runtime. */
+#if defined(__BYTE_ORDER__) && defined(__ORDER_LITTLE_ENDIAN__)
+#define HOST_LITTLE_ENDIAN (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#else
+#define HOST_LITTLE_ENDIAN \
+  (((union {           \
+     hword_t h;        \
+     byte_t b;         \
+   }){.h = 1})         \
+       .b == 1)
 #endif
 
 /**
@@ -153,13 +163,77 @@ static const hword_t __i = 0xFFFF0000;
 */
 #define WORD_NTH_HWORD(WORD, N) (((WORD) >> ((N) * 32)) & 0xFFFFFFFF)
 
+/* The routines below are inline so that conversions cost a load or a
+   store (plus a byte swap on big endian hosts) wherever they're used.
+   lib/base.c has their external definitions. */
+
+/**
+   @brief Swap the ordering of bytes within an short
+
+   @details The ordering of the bytes in the short are reversed (2 bytes in a
+   short).
+
+   @param s: short to swap
+ */
+inline short_t short_byteswap(const short_t s)
+{
+#if defined(__GNUC__)
+  return __builtin_bswap16(s);
+#else
+  return WORD_NTH_BYTE(s, 1) | (WORD_NTH_BYTE(s, 0) << 8);
+#endif
+}
+
+/**
+   @brief Swap the ordering of bytes within an half word
+
+   @details The ordering of the bytes in the half word are reversed (4 bytes in
+   a half word).
+
+   @param h: Half word to swap
+ */
+inline hword_t hword_byteswap(const hword_t h)
+{
+#if defined(__GNUC__)
+  return __builtin_bswap32(h);
+#else
+  return WORD_NTH_BYTE(h, 3) | (WORD_NTH_BYTE(h, 2) << 8) |
+         WORD_NTH_BYTE(h, 1) << 16 | WORD_NTH_BYTE(h, 0) << 24;
+#endif
+}
+
+/**
+   @brief Swap the ordering of bytes within an word
+
+   @details The ordering of the bytes in the word are reversed (8 bytes in a
+   word).
+
+   @param w: Word to swap
+ */
+inline word_t word_byteswap(const word_t w)
+{
+#if defined(__GNUC__)
+  return __builtin_bswap64(w);
+#else
+  return WORD_NTH_BYTE(w, 7) | WORD_NTH_BYTE(w, 6) << 8 |
+         WORD_NTH_BYTE(w, 5) << 16 | WORD_NTH_BYTE(w, 4) << 24 |
+         WORD_NTH_BYTE(w, 3) << 32 | WORD_NTH_BYTE(w, 2) << 40 |
+         WORD_NTH_BYTE(w, 1) << 48 | WORD_NTH_BYTE(w, 0) << 56;
+#endif
+}
+
 /**
    @brief Convert a buffer of bytes to a short
 
    @details It is assumed that the buffer of bytes are in virtual machine byte
    code format (little endian) and that they are at least SHORT_SIZE in size.
  */
-short_t convert_bytes_to_short(const byte_t *buffer);
+inline short_t convert_bytes_to_short(const byte_t *buffer)
+{
+  short_t s;
+  memcpy(&s, buffer, SHORT_SIZE);
+  return HOST_LITTLE_ENDIAN ? s : short_byteswap(s);
+}
 
 /**
    @brief Convert a half word into a VM byte code format bytes (big
@@ -170,7 +244,11 @@ short_t convert_bytes_to_short(const byte_t *buffer);
    @param buffer: Buffer to store into.  It is assumed that the buffer has at
    least SHORT_SIZE space.
 */
-void convert_short_to_bytes(const short_t s, byte_t *buffer);
+inline void convert_short_to_bytes(const short_t s, byte_t *buffer)
+{
+  const short_t le = HOST_LITTLE_ENDIAN ? s : short_byteswap(s);
+  memcpy(buffer, &le, SHORT_SIZE);
+}
 
 /**
    @brief Convert a buffer of bytes to a half word.
@@ -178,7 +256,12 @@ void convert_short_to_bytes(const short_t s, byte_t *buffer);
    @details It is assumed that the buffer of bytes are in virtual machine byte
    code format (little endian) and that they are at least HWORD_SIZE in size.
 */
-hword_t convert_bytes_to_hword(const byte_t *buffer);
+inline hword_t convert_bytes_to_hword(const byte_t *buffer)
+{
+  hword_t h;
+  memcpy(&h, buffer, HWORD_SIZE);
+  return HOST_LITTLE_ENDIAN ? h : hword_byteswap(h);
+}
 
 /**
    @brief Convert a half word into a VM byte code format bytes (big
@@ -189,7 +272,11 @@ hword_t convert_bytes_to_hword(const byte_t *buffer);
    @param buffer: Buffer to store into.  It is assumed that the buffer has at
    least HWORD_SIZE space.
 */
-void convert_hword_to_bytes(const hword_t h, byte_t *buffer);
+inline void convert_hword_to_bytes(const hword_t h, byte_t *buffer)
+{
+  const hword_t le = HOST_LITTLE_ENDIAN ? h : hword_byteswap(h);
+  memcpy(buffer, &le, HWORD_SIZE);
+}
 
 /**
    @brief Convert a buffer of bytes to a word.
@@ -197,7 +284,12 @@ void convert_hword_to_bytes(const hword_t h, byte_t *buffer);
    @details It is assumed that the buffer of bytes are in virtual machine byte
    code format (little endian) and that they are at least WORD_SIZE in size.
 */
-word_t convert_bytes_to_word(const byte_t *);
+inline word_t convert_bytes_to_word(const byte_t *buffer)
+{
+  word_t w;
+  memcpy(&w, buffer, WORD_SIZE);
+  return HOST_LITTLE_ENDIAN ? w : word_byteswap(w);
+}
 
 /**
    @brief Convert a word into a VM byte code format bytes (little endian)
@@ -207,36 +299,10 @@ word_t convert_bytes_to_word(const byte_t *);
    @param buffer: Buffer to store into.  It is assumed that the buffer has at
    least WORD_SIZE space.
 */
-void convert_word_to_bytes(const word_t w, byte_t *buffer);
-
-/**
-   @brief Swap the ordering of bytes within an short
-
-   @details The ordering of the bytes in the short are reversed (2 bytes in a
-   short).
-
-   @param s: short to swap
- */
-short_t short_byteswap(const short_t s);
-
-/**
-   @brief Swap the ordering of bytes within an half word
-
-   @details The ordering of the bytes in the half word are reversed (4 bytes in
-   a half word).
-
-   @param h: Half word to swap
- */
-hword_t hword_byteswap(const hword_t h);
-
-/**
-   @brief Swap the ordering of bytes within an word
-
-   @details The ordering of the bytes in the word are reversed (8 bytes in a
-   word).
-
-   @param w: Word to swap
- */
-word_t word_byteswap(const word_t w);
+inline void convert_word_to_bytes(const word_t w, byte_t *buffer)
+{
+  const word_t le = HOST_LITTLE_ENDIAN ? w : word_byteswap(w);
+  memcpy(buffer, &le, WORD_SIZE);
+}
 
 #endif
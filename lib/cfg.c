@@ -0,0 +1,377 @@
+/* Copyright (C) 2026 Aryadev Chavali
+
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License Version 2 for
+ * more details.
+
+ * You should have received a copy of the GNU General Public License Version 2
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+ * Created: 2026-10-16
+ * Author: Aryadev Chavali
+ * Description: Control flow graphs of programs
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <lib/cfg.h>
+
+/* Building a graph
+
+   Leaders (the first instruction of a block) are the start address,
+   the targets of jumps and calls and any instruction after one which
+   ends a block.  Blocks are made from the leaders in order of address,
+   then their successors from the last instruction of each.
+
+   Predecessors of every block share one allocation, in order of
+   block, which blocks[0].predecessors points to the start of.
+
+   Dominators are found by the iterative algorithm of Cooper, Harvey
+   and Kennedy over the reverse postorder: each block's immediate
+   dominator is the nearest common dominator of its processed
+   predecessors, repeated until nothing changes.  Programs have few
+   blocks and fewer back edges, so this settles in a couple of rounds.
+*/
+
+static bool cfg_ends_block(opcode_t opcode)
+{
+  return opcode == OP_JUMP_ABS || opcode == OP_CALL || opcode == OP_RET ||
+         opcode == OP_HALT || UNSIGNED_OPCODE_IS_TYPE(opcode, OP_JUMP_IF);
+}
+
+static bool cfg_has_target(opcode_t opcode)
+{
+  return opcode == OP_JUMP_ABS || opcode == OP_CALL ||
+         UNSIGNED_OPCODE_IS_TYPE(opcode, OP_JUMP_IF);
+}
+
+static bool cfg_has_fallthrough(opcode_t opcode)
+{
+  return opcode != OP_JUMP_ABS && opcode != OP_RET && opcode != OP_HALT;
+}
+
+/* Mark the leaders of program, returning how many there are. */
+static size_t cfg_leaders(prog_t program, bool *leaders)
+{
+  leaders[0] = true;
+  if (program.start_address < program.count)
+    leaders[program.start_address] = true;
+  for (word_t i = 0; i < program.count; ++i)
+  {
+    const inst_t inst = program.instructions[i];
+    if (cfg_has_target(inst.opcode) && inst.operand.as_word < program.count)
+      leaders[inst.operand.as_word] = true;
+    if (cfg_ends_block(inst.opcode) && i + 1 < program.count)
+      leaders[i + 1] = true;
+  }
+  size_t count = 0;
+  for (word_t i = 0; i < program.count; ++i)
+    count += leaders[i];
+  return count;
+}
+
+/* Blocks reachable from the entry in reverse postorder, through an
+   explicit stack of blocks with the next successor to visit. */
+static bool cfg_order(cfg_t *cfg)
+{
+  cfg->reachable = 0;
+  if (cfg->entry == CFG_NONE)
+    return true;
+  bool *visited = calloc(cfg->count, sizeof(*visited));
+  size_t *stack = malloc(cfg->count * sizeof(*stack));
+  size_t *edge  = malloc(cfg->count * sizeof(*edge));
+  if (!visited || !stack || !edge)
+  {
+    free(visited);
+    free(stack);
+    free(edge);
+    return false;
+  }
+
+  size_t depth = 1, post = cfg->count;
+  stack[0]              = cfg->entry;
+  edge[0]               = 0;
+  visited[cfg->entry]   = true;
+  while (depth > 0)
+  {
+    const size_t block = stack[depth - 1];
+    if (edge[depth - 1] < 2)
+    {
+      const size_t next = cfg->blocks[block].successors[edge[depth - 1]++];
+      if (next != CFG_NONE && !visited[next])
+      {
+        visited[next] = true;
+        stack[depth]  = next;
+        edge[depth]   = 0;
+        ++depth;
+      }
+    }
+    else
+    {
+      // Filled in from the back, then moved down to the start
+      cfg->order[--post] = block;
+      --depth;
+    }
+  }
+  cfg->reachable = cfg->count - post;
+  memmove(cfg->order, cfg->order + post,
+          cfg->reachable * sizeof(*cfg->order));
+
+  free(visited);
+  free(stack);
+  free(edge);
+  return true;
+}
+
+static bool cfg_dominators(cfg_t *cfg)
+{
+  if (cfg->reachable == 0)
+    return true;
+  // Position of each block in order, or CFG_NONE if it's unreachable
+  size_t *position = malloc(cfg->count * sizeof(*position));
+  if (!position)
+    return false;
+  for (size_t i = 0; i < cfg->count; ++i)
+    position[i] = CFG_NONE;
+  for (size_t i = 0; i < cfg->reachable; ++i)
+    position[cfg->order[i]] = i;
+
+  // The entry dominates itself until the end, so walks up stop there
+  cfg->blocks[cfg->entry].dominator = cfg->entry;
+  for (bool changed = true; changed;)
+  {
+    changed = false;
+    for (size_t i = 1; i < cfg->reachable; ++i)
+    {
+      cfg_block_t *block = cfg->blocks + cfg->order[i];
+      size_t dominator   = CFG_NONE;
+      for (size_t j = 0; j < block->predecessor_count; ++j)
+      {
+        size_t other = block->predecessors[j];
+        if (cfg->blocks[other].dominator == CFG_NONE)
+          continue;
+        else if (dominator == CFG_NONE)
+        {
+          dominator = other;
+          continue;
+        }
+        while (other != dominator)
+        {
+          while (position[other] > position[dominator])
+            other = cfg->blocks[other].dominator;
+          while (position[dominator] > position[other])
+            dominator = cfg->blocks[dominator].dominator;
+        }
+      }
+      if (block->dominator != dominator)
+      {
+        block->dominator = dominator;
+        changed          = true;
+      }
+    }
+  }
+  cfg->blocks[cfg->entry].dominator = CFG_NONE;
+
+  free(position);
+  return true;
+}
+
+bool cfg_build(prog_t program, cfg_t *cfg)
+{
+  memset(cfg, 0, sizeof(*cfg));
+  cfg->entry = CFG_NONE;
+  if (program.count == 0)
+    return true;
+
+  bool *leaders = calloc(program.count, sizeof(*leaders));
+  if (!leaders)
+    return false;
+  cfg->count    = cfg_leaders(program, leaders);
+  cfg->blocks   = calloc(cfg->count, sizeof(*cfg->blocks));
+  cfg->block_of = malloc(program.count * sizeof(*cfg->block_of));
+  cfg->order    = malloc(cfg->count * sizeof(*cfg->order));
+  if (!cfg->blocks || !cfg->block_of || !cfg->order)
+  {
+    free(leaders);
+    cfg_free(cfg);
+    return false;
+  }
+
+  size_t block = CFG_NONE;
+  for (word_t i = 0; i < program.count; ++i)
+  {
+    if (leaders[i])
+    {
+      ++block;
+      cfg->blocks[block].start = i;
+    }
+    cfg->blocks[block].end = i + 1;
+    cfg->block_of[i]       = block;
+  }
+  free(leaders);
+  if (program.start_address < program.count)
+    cfg->entry = cfg->block_of[program.start_address];
+
+  size_t edges = 0;
+  for (size_t i = 0; i < cfg->count; ++i)
+  {
+    cfg_block_t *b    = cfg->blocks + i;
+    const inst_t last = program.instructions[b->end - 1];
+    b->successors[CFG_FALLTHROUGH] = CFG_NONE;
+    b->successors[CFG_TARGET]      = CFG_NONE;
+    b->dominator                   = CFG_NONE;
+    if (cfg_has_fallthrough(last.opcode) && b->end < program.count)
+      b->successors[CFG_FALLTHROUGH] = cfg->block_of[b->end];
+    if (cfg_has_target(last.opcode) && last.operand.as_word < program.count)
+      b->successors[CFG_TARGET] = cfg->block_of[last.operand.as_word];
+    // A JUMP_IF to the next instruction is one edge, not two
+    if (b->successors[CFG_TARGET] == b->successors[CFG_FALLTHROUGH])
+      b->successors[CFG_TARGET] = CFG_NONE;
+    for (size_t j = 0; j < 2; ++j)
+      if (b->successors[j] != CFG_NONE)
+      {
+        ++cfg->blocks[b->successors[j]].predecessor_count;
+        ++edges;
+      }
+  }
+
+  size_t *predecessors = malloc(MAX(edges, 1) * sizeof(*predecessors));
+  if (!predecessors)
+  {
+    cfg_free(cfg);
+    return false;
+  }
+  for (size_t i = 0, offset = 0; i < cfg->count; ++i)
+  {
+    cfg->blocks[i].predecessors = predecessors + offset;
+    offset += cfg->blocks[i].predecessor_count;
+    cfg->blocks[i].predecessor_count = 0;
+  }
+  for (size_t i = 0; i < cfg->count; ++i)
+    for (size_t j = 0; j < 2; ++j)
+    {
+      const size_t next = cfg->blocks[i].successors[j];
+      if (next != CFG_NONE)
+        cfg->blocks[next].predecessors[cfg->blocks[next].predecessor_count++] =
+            i;
+    }
+
+  if (!cfg_order(cfg) || !cfg_dominators(cfg))
+  {
+    cfg_free(cfg);
+    return false;
+  }
+  return true;
+}
+
+void cfg_free(cfg_t *cfg)
+{
+  if (cfg->blocks && cfg->count > 0)
+    free(cfg->blocks[0].predecessors);
+  free(cfg->blocks);
+  free(cfg->block_of);
+  free(cfg->order);
+  memset(cfg, 0, sizeof(*cfg));
+  cfg->entry = CFG_NONE;
+}
+
+bool cfg_dominates(const cfg_t *cfg, size_t dominator, size_t block)
+{
+  for (; block != CFG_NONE; block = cfg->blocks[block].dominator)
+    if (block == dominator)
+      return true;
+  return false;
+}
+
+static void cfg_print_block(size_t block, FILE *fp)
+{
+  if (block == CFG_NONE)
+    fprintf(fp, "-");
+  else
+    fprintf(fp, "%lu", block);
+}
+
+void cfg_print(const cfg_t *cfg, FILE *fp)
+{
+  fprintf(fp, "Blocks(%lu, entry=", cfg->count);
+  cfg_print_block(cfg->entry, fp);
+  fprintf(fp, "):\n");
+  for (size_t i = 0; i < cfg->count; ++i)
+  {
+    const cfg_block_t *block = cfg->blocks + i;
+    fprintf(fp, "\t%lu: [%lu, %lu) -> ", i, block->start, block->end);
+    cfg_print_block(block->successors[CFG_FALLTHROUGH], fp);
+    fprintf(fp, ", ");
+    cfg_print_block(block->successors[CFG_TARGET], fp);
+    fprintf(fp, "; idom ");
+    cfg_print_block(block->dominator, fp);
+    fprintf(fp, "; from {");
+    for (size_t j = 0; j < block->predecessor_count; ++j)
+      fprintf(fp, "%s%lu", j == 0 ? "" : ", ", block->predecessors[j]);
+    fprintf(fp, "}\n");
+  }
+}
+
+void cfg_print_profile(const cfg_t *cfg, const word_t *counts, size_t n,
+                       FILE *fp)
+{
+  word_t total = 0;
+  for (size_t i = 0; i < cfg->count; ++i)
+    total += counts[i] * (cfg->blocks[i].end - cfg->blocks[i].start);
+
+  fprintf(fp, "Block profile(%lu instructions):\n", total);
+  size_t *blocks = malloc(cfg->count * sizeof(*blocks));
+  if (!blocks)
+    return;
+  for (size_t i = 0; i < cfg->count; ++i)
+    blocks[i] = i;
+  // Selection sort, only as far as the blocks printed
+  for (size_t i = 0; i < MIN(n, cfg->count); ++i)
+  {
+    size_t hottest = i;
+    for (size_t j = i + 1; j < cfg->count; ++j)
+      if (counts[blocks[j]] > counts[blocks[hottest]])
+        hottest = j;
+    const size_t block = blocks[hottest];
+    if (counts[block] == 0)
+      break;
+    blocks[hottest] = blocks[i];
+    blocks[i]       = block;
+
+    const cfg_block_t *b = cfg->blocks + block;
+    const word_t executed = counts[block] * (b->end - b->start);
+    fprintf(fp, "\t%lu: [%lu, %lu): %lu entries, %lu instructions (%.1f%%)\n",
+            block, b->start, b->end, counts[block], executed,
+            100.0 * executed / total);
+  }
+  free(blocks);
+}
+
+void cfg_write_profile(const cfg_t *cfg, const word_t *counts, FILE *fp)
+{
+  for (size_t i = 0; i < cfg->count; ++i)
+    if (counts[i] > 0)
+      fprintf(fp, "%lu %lu %lu\n", cfg->blocks[i].start, cfg->blocks[i].end,
+              counts[i]);
+}
+
+bool cfg_read_profile(const cfg_t *cfg, word_t *counts, FILE *fp)
+{
+  // Blocks cover the whole program, so the last ends where it does
+  const word_t size = cfg->count ? cfg->blocks[cfg->count - 1].end : 0;
+  word_t start, end, entries;
+  int read;
+  while ((read = fscanf(fp, "%lu %lu %lu", &start, &end, &entries)) == 3)
+  {
+    // Blocks are looked up by start, the end making sure it's the same
+    if (start >= size)
+      return false;
+    const size_t block = cfg->block_of[start];
+    if (cfg->blocks[block].start != start || cfg->blocks[block].end != end)
+      return false;
+    counts[block] += entries;
+  }
+  return read == EOF;
+}
@@ -0,0 +1,132 @@
+/* Copyright (C) 2026 Aryadev Chavali
+
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License Version 2 for
+ * more details.
+
+ * You should have received a copy of the GNU General Public License Version 2
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+ * Created: 2026-10-16
+ * Author: Aryadev Chavali
+ * Description: Control flow graphs of programs
+ */
+
+#ifndef CFG_H
+#define CFG_H
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include <lib/inst.h>
+
+#define CFG_NONE ((size_t)-1)
+
+/* Indices into cfg_block_t.successors */
+typedef enum
+{
+  // Next instruction, or the return site of a CALL
+  CFG_FALLTHROUGH = 0,
+  // Target of a JUMP_ABS, JUMP_IF or CALL
+  CFG_TARGET,
+} cfg_edge_t;
+
+/**
+   @brief A basic block: instructions only ever entered at the first
+   and left at the last.
+
+   @details A block ends at a JUMP_ABS, JUMP_IF, CALL, RET or HALT, or
+   just before the target of a jump or call.  Successors which don't
+   exist, such as the target of a RET or the fallthrough of a
+   JUMP_ABS, are CFG_NONE.  A CALL's fallthrough is its return site,
+   as that's where execution carries on once the subroutine returns,
+   so RETs have no successors of their own.
+
+   @prop[start] Address of the first instruction
+   @prop[end] Address after the last instruction
+   @prop[successors] Blocks control may pass to, by cfg_edge_t
+   @prop[predecessors] Blocks with this one as a successor
+   @prop[predecessor_count] Size of predecessors
+   @prop[dominator] Immediate dominator, or CFG_NONE for the entry
+   block and blocks unreachable from it
+ */
+typedef struct
+{
+  word_t start, end;
+  size_t successors[2];
+  size_t *predecessors;
+  size_t predecessor_count;
+  size_t dominator;
+} cfg_block_t;
+
+/**
+   @brief Control flow graph of a program.
+
+   @prop[blocks] Blocks in order of address
+   @prop[count] Number of blocks
+   @prop[entry] Block of the start address, or CFG_NONE if the
+   program is empty
+   @prop[block_of] Block of each instruction, by address
+   @prop[order] Blocks reachable from entry in reverse postorder
+   @prop[reachable] Size of order
+ */
+typedef struct
+{
+  cfg_block_t *blocks;
+  size_t count, entry;
+  size_t *block_of;
+  size_t *order, reachable;
+} cfg_t;
+
+/**
+   @brief Build the control flow graph of a program.
+
+   @details Jumps and calls to addresses outside the program, which
+   fail when executed, have no target.
+
+   @param[program] Program to analyse
+   @param[cfg] Graph to build, freed with cfg_free
+   @return False if memory for the graph couldn't be allocated
+ */
+bool cfg_build(prog_t program, cfg_t *cfg);
+
+void cfg_free(cfg_t *cfg);
+
+/* Whether every path from the entry block to block goes through
+   dominator.  Blocks dominate themselves. */
+bool cfg_dominates(const cfg_t *cfg, size_t dominator, size_t block);
+
+void cfg_print(const cfg_t *cfg, FILE *fp);
+
+/**
+   @brief Print the most entered blocks of a profile.
+
+   @details Each block is printed with its address range, the number
+   of times it was entered and the instructions that accounts for.
+
+   @param[cfg] Graph the profile was made with
+   @param[counts] Entries into each block, by index
+   @param[n] Maximum number of blocks to print
+   @param[fp] Stream to print to
+ */
+void cfg_print_profile(const cfg_t *cfg, const word_t *counts, size_t n,
+                       FILE *fp);
+
+/* Write the blocks entered in a profile to fp as text, a line of
+   start, end and entries for each, to be read back by
+   cfg_read_profile. */
+void cfg_write_profile(const cfg_t *cfg, const word_t *counts, FILE *fp);
+
+/**
+   @brief Read a profile written by cfg_write_profile.
+
+   @param[cfg] Graph of the program the profile was made with
+   @param[counts] Entries into each block, added to from the profile
+   @param[fp] Stream to read from
+   @return False if fp isn't a profile of blocks in cfg, in which case
+   counts may have been partly added to
+ */
+bool cfg_read_profile(const cfg_t *cfg, word_t *counts, FILE *fp);
+
+#endif
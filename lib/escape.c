@@ -0,0 +1,458 @@
+/* Copyright (C) 2026 Aryadev Chavali
+
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License Version 2 for
+ * more details.
+
+ * You should have received a copy of the GNU General Public License Version 2
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+ * Created: 2026-10-16
+ * Author: Aryadev Chavali
+ * Description: Escape analysis of heap pages
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <lib/cfg.h>
+#include <lib/escape.h>
+
+/* Analysis
+
+   Every datum on the stack or in a register is labelled with the
+   MALLOC its page came from, or ESCAPE_UNKNOWN if it isn't a page or
+   could be one from several.  Labels are propagated over the blocks
+   of the control flow graph from the start address and the target of
+   every CALL, each of which starts with nothing tracked: the stack
+   below what's tracked, and every register, only holds unknowns.
+
+   A label is live until its page is deleted, when every copy of it
+   becomes dead.  Anything which could let a live page outlive its
+   subroutine, or reach an MDELETE through a datum not labelled with
+   it, makes its MALLOC escape.  Escaping never undoes any labels, so
+   a label always names the only MALLOC its datum could come from:
+   after one pass an MDELETE deletes pages of a MALLOC which doesn't
+   escape exactly when it pops that MALLOC's live label.
+*/
+
+#define ESCAPE_UNKNOWN 0
+
+// Labels of a MALLOC at address, live or dead
+#define ESCAPE_LIVE(ADDRESS) (((ADDRESS) + 1) << 1)
+#define ESCAPE_DEAD(ADDRESS) (ESCAPE_LIVE(ADDRESS) | 1)
+#define ESCAPE_SITE(LABEL)   (((LABEL) >> 1) - 1)
+#define ESCAPE_IS_LIVE(LABEL) \
+  ((LABEL) != ESCAPE_UNKNOWN && ((LABEL) & 1) == 0)
+
+static const word_t sizes[] = {BYTE_SIZE, SHORT_SIZE, HWORD_SIZE, WORD_SIZE};
+
+struct EscapeEntry
+{
+  word_t size, label;
+};
+
+/* State before an instruction.  stack[depth - 1] is the top of the
+   stack. */
+struct EscapeState
+{
+  bool reached;
+  size_t depth;
+  struct EscapeEntry stack[ESCAPE_DEPTH];
+  word_t registers[ESCAPE_REGISTERS];
+};
+
+struct Escape
+{
+  prog_t program;
+  bool *escaped;
+  // If not NULL, where MALLOCs and MDELETEs which don't escape are set
+  bool *scoped;
+};
+
+static void escape_label(struct Escape *e, word_t label)
+{
+  if (ESCAPE_IS_LIVE(label))
+    e->escaped[ESCAPE_SITE(label)] = true;
+}
+
+/* Every live page in state escapes. */
+static void escape_all(struct Escape *e, const struct EscapeState *state)
+{
+  for (size_t i = 0; i < state->depth; ++i)
+    escape_label(e, state->stack[i].label);
+  for (size_t i = 0; i < ESCAPE_REGISTERS; ++i)
+    escape_label(e, state->registers[i]);
+}
+
+static void escape_push(struct Escape *e, struct EscapeState *state,
+                        word_t size, word_t label)
+{
+  if (state->depth == ESCAPE_DEPTH)
+  {
+    escape_label(e, state->stack[0].label);
+    memmove(state->stack, state->stack + 1,
+            (ESCAPE_DEPTH - 1) * sizeof(*state->stack));
+    --state->depth;
+  }
+  state->stack[state->depth++] = (struct EscapeEntry){size, label};
+}
+
+/* Pop a datum of size bytes, returning its label.  Popping part of an
+   entry, or more than one, is never a whole page so they escape. */
+static word_t escape_pop(struct Escape *e, struct EscapeState *state,
+                         word_t size)
+{
+  if (state->depth == 0)
+    return ESCAPE_UNKNOWN;
+  struct EscapeEntry *top = state->stack + state->depth - 1;
+  if (top->size == size)
+  {
+    --state->depth;
+    return top->label;
+  }
+  while (size > 0 && state->depth > 0)
+  {
+    top = state->stack + state->depth - 1;
+    escape_label(e, top->label);
+    if (top->size > size)
+    {
+      *top = (struct EscapeEntry){top->size - size, ESCAPE_UNKNOWN};
+      break;
+    }
+    size -= top->size;
+    --state->depth;
+  }
+  return ESCAPE_UNKNOWN;
+}
+
+/* Pop a datum used as anything but a page. */
+static void escape_use(struct Escape *e, struct EscapeState *state,
+                       word_t size)
+{
+  escape_label(e, escape_pop(e, state, size));
+}
+
+/* The datum of size bytes whose top is offset bytes below the top of
+   the stack, as DUP copies. */
+static word_t escape_dup(struct Escape *e, const struct EscapeState *state,
+                         word_t size, word_t offset)
+{
+  word_t top = 0;
+  for (size_t i = state->depth; i > 0; --i)
+  {
+    const struct EscapeEntry entry = state->stack[i - 1];
+    const word_t bottom            = top + entry.size;
+    if (top == offset && entry.size == size)
+      return entry.label;
+    else if (bottom > offset && top < offset + size)
+      escape_label(e, entry.label);
+    top = bottom;
+  }
+  return ESCAPE_UNKNOWN;
+}
+
+static void escape_mov(struct Escape *e, struct EscapeState *state,
+                       word_t size, word_t reg)
+{
+  const word_t label = escape_pop(e, state, size);
+  // Byte offset of the register, bounded so it can't overflow
+  const word_t word = reg < WORD_SIZE * ESCAPE_REGISTERS
+                          ? (reg * size) / WORD_SIZE
+                          : ESCAPE_REGISTERS;
+  if (word >= ESCAPE_REGISTERS)
+    escape_label(e, label);
+  else if (size == WORD_SIZE)
+    state->registers[word] = label;
+  else
+    state->registers[word] = ESCAPE_UNKNOWN;
+}
+
+static void escape_push_register(struct Escape *e, struct EscapeState *state,
+                                 word_t size, word_t reg)
+{
+  const word_t word = reg < WORD_SIZE * ESCAPE_REGISTERS
+                          ? (reg * size) / WORD_SIZE
+                          : ESCAPE_REGISTERS;
+  word_t label = ESCAPE_UNKNOWN;
+  if (word < ESCAPE_REGISTERS && size == WORD_SIZE)
+    label = state->registers[word];
+  else if (word < ESCAPE_REGISTERS)
+    escape_label(e, state->registers[word]);
+  escape_push(e, state, size, label);
+}
+
+static bool escape_holds(const struct EscapeState *state, word_t label)
+{
+  for (size_t i = 0; i < state->depth; ++i)
+    if (state->stack[i].label == label)
+      return true;
+  for (size_t i = 0; i < ESCAPE_REGISTERS; ++i)
+    if (state->registers[i] == label)
+      return true;
+  return false;
+}
+
+static void escape_delete(struct Escape *e, struct EscapeState *state,
+                          word_t address)
+{
+  const word_t label = escape_pop(e, state, WORD_SIZE);
+  if (label == ESCAPE_UNKNOWN)
+    return;
+  const word_t site = ESCAPE_SITE(label);
+  if (!ESCAPE_IS_LIVE(label))
+  {
+    e->escaped[site] = true;
+    return;
+  }
+  if (e->scoped && !e->escaped[site])
+    e->scoped[address] = true;
+  for (size_t i = 0; i < state->depth; ++i)
+    if (state->stack[i].label == label)
+      state->stack[i].label = ESCAPE_DEAD(site);
+  for (size_t i = 0; i < ESCAPE_REGISTERS; ++i)
+    if (state->registers[i] == label)
+      state->registers[i] = ESCAPE_DEAD(site);
+}
+
+static void escape_step(struct Escape *e, struct EscapeState *state,
+                        word_t address)
+{
+  static_assert(NUMBER_OF_OPCODES == 115, "escape_step: Out of date");
+  const inst_t inst     = e->program.instructions[address];
+  const opcode_t opcode = inst.opcode;
+  const word_t operand  = inst.operand.as_word;
+  if (UNSIGNED_OPCODE_IS_TYPE(opcode, OP_PUSH))
+    escape_push(e, state, sizes[OPCODE_DATA_TYPE(opcode, OP_PUSH)],
+                ESCAPE_UNKNOWN);
+  else if (UNSIGNED_OPCODE_IS_TYPE(opcode, OP_POP))
+    escape_mov(e, state, sizes[OPCODE_DATA_TYPE(opcode, OP_POP)], 0);
+  else if (UNSIGNED_OPCODE_IS_TYPE(opcode, OP_MOV))
+    escape_mov(e, state, sizes[OPCODE_DATA_TYPE(opcode, OP_MOV)], operand);
+  else if (UNSIGNED_OPCODE_IS_TYPE(opcode, OP_PUSH_REGISTER))
+    escape_push_register(
+        e, state, sizes[OPCODE_DATA_TYPE(opcode, OP_PUSH_REGISTER)], operand);
+  else if (UNSIGNED_OPCODE_IS_TYPE(opcode, OP_DUP))
+  {
+    const word_t size = sizes[OPCODE_DATA_TYPE(opcode, OP_DUP)];
+    const word_t offset =
+        operand < WORD_SIZE * ESCAPE_DEPTH ? operand * size : WORD_MAX / 2;
+    escape_push(e, state, size, escape_dup(e, state, size, offset));
+  }
+  else if (UNSIGNED_OPCODE_IS_TYPE(opcode, OP_MALLOC))
+  {
+    escape_use(e, state, WORD_SIZE);
+    word_t label = ESCAPE_LIVE(address);
+    // Another page from here while this one's live would share labels
+    if (escape_holds(state, label))
+      e->escaped[address] = true;
+    if (e->escaped[address])
+      label = ESCAPE_UNKNOWN;
+    else if (e->scoped)
+      e->scoped[address] = true;
+    escape_push(e, state, WORD_SIZE, label);
+  }
+  else if (UNSIGNED_OPCODE_IS_TYPE(opcode, OP_MSET))
+  {
+    escape_use(e, state, WORD_SIZE);
+    escape_use(e, state, sizes[OPCODE_DATA_TYPE(opcode, OP_MSET)]);
+    escape_pop(e, state, WORD_SIZE);
+  }
+  else if (UNSIGNED_OPCODE_IS_TYPE(opcode, OP_MGET))
+  {
+    escape_use(e, state, WORD_SIZE);
+    escape_pop(e, state, WORD_SIZE);
+    escape_push(e, state, sizes[OPCODE_DATA_TYPE(opcode, OP_MGET)],
+                ESCAPE_UNKNOWN);
+  }
+  else if (opcode == OP_MSIZE)
+  {
+    escape_pop(e, state, WORD_SIZE);
+    escape_push(e, state, WORD_SIZE, ESCAPE_UNKNOWN);
+  }
+  else if (opcode == OP_MDELETE)
+    escape_delete(e, state, address);
+  else if (UNSIGNED_OPCODE_IS_TYPE(opcode, OP_NOT))
+  {
+    const word_t size = sizes[OPCODE_DATA_TYPE(opcode, OP_NOT)];
+    escape_use(e, state, size);
+    escape_push(e, state, size, ESCAPE_UNKNOWN);
+  }
+  else if (UNSIGNED_OPCODE_IS_TYPE(opcode, OP_EQ) ||
+           (opcode >= OP_LT_BYTE && opcode <= OP_GTE_SWORD))
+  {
+    const word_t size = UNSIGNED_OPCODE_IS_TYPE(opcode, OP_EQ)
+                            ? sizes[OPCODE_DATA_TYPE(opcode, OP_EQ)]
+                            : sizes[((opcode - OP_LT_BYTE) % 8) / 2];
+    escape_use(e, state, size);
+    escape_use(e, state, size);
+    escape_push(e, state, BYTE_SIZE, ESCAPE_UNKNOWN);
+  }
+  else if (opcode >= OP_OR_BYTE && opcode <= OP_MULT_WORD)
+  {
+    const word_t size = sizes[(opcode - OP_OR_BYTE) % 4];
+    escape_use(e, state, size);
+    escape_use(e, state, size);
+    escape_push(e, state, size, ESCAPE_UNKNOWN);
+  }
+  else if (SIGNED_OPCODE_IS_TYPE(opcode, OP_PRINT))
+    escape_use(e, state, sizes[OPCODE_DATA_TYPE(opcode, OP_PRINT) / 2]);
+  else if (UNSIGNED_OPCODE_IS_TYPE(opcode, OP_JUMP_IF))
+    escape_use(e, state, sizes[OPCODE_DATA_TYPE(opcode, OP_JUMP_IF)]);
+  else if (opcode == OP_CALL)
+  {
+    // The callee may do anything with the stack and registers
+    escape_all(e, state);
+    *state = (struct EscapeState){.reached = true};
+  }
+  else if (opcode == OP_RET || opcode == OP_HALT)
+    escape_all(e, state);
+}
+
+/* Join state into the state at the start of a block, returning
+   whether it changed.  Entries are matched from the top of the stack,
+   and any which don't match are forgotten. */
+static bool escape_join(struct Escape *e, struct EscapeState *into,
+                        const struct EscapeState *state)
+{
+  if (!into->reached)
+  {
+    *into = *state;
+    return true;
+  }
+  bool changed = false;
+  size_t kept  = 0;
+  for (; kept < MIN(into->depth, state->depth); ++kept)
+  {
+    struct EscapeEntry *a       = into->stack + into->depth - 1 - kept;
+    const struct EscapeEntry *b = state->stack + state->depth - 1 - kept;
+    if (a->size != b->size)
+      break;
+    else if (a->label != b->label)
+    {
+      escape_label(e, a->label);
+      escape_label(e, b->label);
+      a->label = ESCAPE_UNKNOWN;
+      changed  = true;
+    }
+  }
+  for (size_t i = 0; i + kept < into->depth; ++i)
+    escape_label(e, into->stack[i].label);
+  for (size_t i = 0; i + kept < state->depth; ++i)
+    escape_label(e, state->stack[i].label);
+  if (kept < into->depth)
+  {
+    memmove(into->stack, into->stack + into->depth - kept,
+            kept * sizeof(*into->stack));
+    into->depth = kept;
+    changed     = true;
+  }
+
+  for (size_t i = 0; i < ESCAPE_REGISTERS; ++i)
+    if (into->registers[i] != state->registers[i])
+    {
+      escape_label(e, into->registers[i]);
+      escape_label(e, state->registers[i]);
+      changed = changed || into->registers[i] != ESCAPE_UNKNOWN;
+      into->registers[i] = ESCAPE_UNKNOWN;
+    }
+  return changed;
+}
+
+/* Run the block at index through state, joining it into its
+   successors and adding those which changed to work. */
+static void escape_block(struct Escape *e, const cfg_t *cfg, size_t index,
+                         struct EscapeState *states, size_t *work,
+                         size_t *work_size, bool *queued)
+{
+  const cfg_block_t *block = cfg->blocks + index;
+  struct EscapeState state = states[index];
+  for (word_t i = block->start; i < block->end; ++i)
+    escape_step(e, &state, i);
+
+  const opcode_t last = e->program.instructions[block->end - 1].opcode;
+  // Running off the end of the program halts it
+  if (block->successors[CFG_FALLTHROUGH] == CFG_NONE &&
+      last != OP_JUMP_ABS && last != OP_RET && last != OP_HALT)
+    escape_all(e, &state);
+  for (size_t i = 0; i < ARR_SIZE(block->successors); ++i)
+  {
+    const size_t next = block->successors[i];
+    // Callees are analysed from their own entry
+    if (next == CFG_NONE || (last == OP_CALL && i == CFG_TARGET))
+      continue;
+    if (escape_join(e, states + next, &state) && !queued[next])
+    {
+      queued[next]          = true;
+      work[(*work_size)++] = next;
+    }
+  }
+}
+
+bool escape_analyse(prog_t program, bool *scoped)
+{
+  cfg_t cfg = {0};
+  if (!cfg_build(program, &cfg))
+    return false;
+  struct EscapeState *states = calloc(MAX(cfg.count, 1), sizeof(*states));
+  size_t *work               = malloc(MAX(cfg.count, 1) * sizeof(*work));
+  bool *queued               = calloc(MAX(cfg.count, 1), sizeof(*queued));
+  bool *escaped = calloc(MAX(program.count, 1), sizeof(*escaped));
+  if (!states || !work || !queued || !escaped)
+  {
+    cfg_free(&cfg);
+    free(states);
+    free(work);
+    free(queued);
+    free(escaped);
+    return false;
+  }
+
+  struct Escape e  = {program, escaped, NULL};
+  size_t work_size = 0;
+  for (size_t i = 0; i < cfg.count; ++i)
+  {
+    const inst_t last = program.instructions[cfg.blocks[i].end - 1];
+    const size_t entry =
+        i == 0 ? cfg.entry
+        : last.opcode == OP_CALL ? cfg.blocks[i].successors[CFG_TARGET]
+                                 : CFG_NONE;
+    if (entry != CFG_NONE && !states[entry].reached)
+    {
+      states[entry].reached = true;
+      queued[entry]         = true;
+      work[work_size++]     = entry;
+    }
+  }
+  while (work_size > 0)
+  {
+    const size_t index = work[--work_size];
+    queued[index]      = false;
+    escape_block(&e, &cfg, index, states, work, &work_size, queued);
+  }
+
+  // One more run through every block, now that what escapes is known
+  memset(scoped, 0, program.count * sizeof(*scoped));
+  e.scoped = scoped;
+  for (size_t i = 0; i < cfg.count; ++i)
+    if (states[i].reached)
+    {
+      struct EscapeState state = states[i];
+      for (word_t j = cfg.blocks[i].start; j < cfg.blocks[i].end; ++j)
+        escape_step(&e, &state, j);
+    }
+  // Escapes found in that run only take away from what was set
+  for (word_t i = 0; i < program.count; ++i)
+    if (scoped[i] && UNSIGNED_OPCODE_IS_TYPE(program.instructions[i].opcode,
+                                             OP_MALLOC))
+      scoped[i] = !escaped[i];
+
+  cfg_free(&cfg);
+  free(states);
+  free(work);
+  free(queued);
+  free(escaped);
+  return true;
+}
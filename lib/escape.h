@@ -0,0 +1,54 @@
+/* Copyright (C) 2026 Aryadev Chavali
+
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License Version 2 for
+ * more details.
+
+ * You should have received a copy of the GNU General Public License Version 2
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+ * Created: 2026-10-16
+ * Author: Aryadev Chavali
+ * Description: Escape analysis of heap pages
+ */
+
+#ifndef ESCAPE_H
+#define ESCAPE_H
+
+#include <stdbool.h>
+
+#include <lib/inst.h>
+
+/* Entries at the top of the stack, and word registers from the first,
+   tracked by escape_analyse.  A page pushed any deeper or moved into
+   any other register escapes. */
+#define ESCAPE_DEPTH     16
+#define ESCAPE_REGISTERS 8
+
+/**
+   @brief Find the MALLOCs whose pages never escape the subroutine
+   allocating them, and the MDELETEs which delete them.
+
+   @details A page escapes if it's stored to the heap, used as
+   anything but the page of MSET, MGET, MSIZE or MDELETE, live at a
+   CALL, RET or HALT, or deleted twice, or if its MALLOC is reached
+   again while it's live.  One copy of a page may be in different
+   places on different paths (or a place may hold different pages),
+   in which case it escapes too.  So a page which doesn't escape is
+   deleted, by an MDELETE only ever deleting pages from its MALLOC,
+   before its subroutine calls another or returns, unless its last
+   copy is dropped first.
+
+   Such pages may come from somewhere cheaper than the heap, like
+   heap_scratch_allocate, as long as their MDELETEs free them back
+   there.
+
+   @param[program] Program to analyse
+   @param[scoped] Set for each MALLOC and MDELETE as above, by address
+   @return False if memory for the analysis couldn't be allocated, in
+   which case nothing is set
+ */
+bool escape_analyse(prog_t program, bool *scoped);
+
+#endif
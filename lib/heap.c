@@ -18,6 +18,7 @@
 #include <lib/darr.h>
 
 #include <malloc.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 
@@ -25,8 +26,12 @@ page_t *page_create(size_t max)
 {
   if (max == 0)
     max = PAGE_DEFAULT_SIZE;
+  else if (max > SIZE_MAX - sizeof(page_t))
+    return NULL;
 
-  page_t *page    = calloc(1, sizeof(*page) + max);
+  page_t *page = calloc(1, sizeof(*page) + max);
+  if (!page)
+    return NULL;
   page->available = max;
   return page;
 }
@@ -44,7 +49,9 @@ void heap_create(heap_t *heap)
 page_t *heap_allocate(heap_t *heap, size_t requested)
 {
   page_t *cur = page_create(requested);
-  darr_append_bytes(&heap->page_vec, (byte_t *)cur, sizeof(cur));
+  if (!cur)
+    return NULL;
+  darr_append_bytes(&heap->page_vec, (byte_t *)&cur, sizeof(cur));
   return cur;
 }
 
@@ -68,6 +75,66 @@ bool heap_free(heap_t *heap, page_t *page)
   return false;
 }
 
+/* Capacity of a scratch page of size bytes, so a free page fits any
+   size it'd be given to as is. */
+static size_t scratch_capacity(size_t size)
+{
+  size_t capacity = PAGE_DEFAULT_SIZE;
+  while (capacity < size)
+    capacity *= 2;
+  return capacity;
+}
+
+page_t *heap_scratch_allocate(heap_t *heap, size_t size)
+{
+  if (size == 0)
+    size = PAGE_DEFAULT_SIZE;
+  // No power of two capacity is that large
+  else if (size > SIZE_MAX / 2)
+    return NULL;
+  const size_t capacity = scratch_capacity(size);
+  page_t *page          = NULL;
+  if (heap->scratch_free > 0)
+  {
+    // The last free page becomes the first in use without moving
+    const size_t i = heap->scratch_free - 1;
+    page           = DARR_AT(page_t *, heap->scratch.data, i);
+    if (scratch_capacity(page->available) != capacity)
+    {
+      page_t *resized = realloc(page, sizeof(*page) + capacity);
+      if (!resized)
+        return NULL;
+      page                                   = resized;
+      DARR_AT(page_t *, heap->scratch.data, i) = page;
+    }
+    --heap->scratch_free;
+    memset(page->data, 0, size);
+  }
+  else
+  {
+    page = calloc(1, sizeof(*page) + capacity);
+    if (!page)
+      return NULL;
+    darr_append_bytes(&heap->scratch, (byte_t *)&page, sizeof(page));
+  }
+  page->available = size;
+  return page;
+}
+
+bool heap_scratch_free(heap_t *heap, page_t *page)
+{
+  page_t **pages = (page_t **)heap->scratch.data;
+  for (size_t i = heap->scratch.used / sizeof(page); i > heap->scratch_free;
+       --i)
+    if (pages[i - 1] == page)
+    {
+      pages[i - 1]                 = pages[heap->scratch_free];
+      pages[heap->scratch_free++] = page;
+      return true;
+    }
+  return false;
+}
+
 void heap_stop(heap_t *heap)
 {
   for (size_t i = 0; i < (heap->page_vec.used / sizeof(page_t *)); i++)
@@ -78,4 +145,9 @@ void heap_stop(heap_t *heap)
   }
   free(heap->page_vec.data);
   heap->page_vec = (darr_t){0};
+  for (size_t i = 0; i < (heap->scratch.used / sizeof(page_t *)); i++)
+    page_delete(DARR_AT(page_t *, heap->scratch.data, i));
+  free(heap->scratch.data);
+  heap->scratch      = (darr_t){0};
+  heap->scratch_free = 0;
 }
@@ -46,6 +46,8 @@ typedef struct Page
    next page.  NOTE: all memory is 0 initialised by default.
 
    @param[max] Maximum available memory in page
+
+   @return The page, or NULL if it couldn't be allocated
  */
 page_t *page_create(size_t max);
 
@@ -67,10 +69,14 @@ void page_delete(page_t *page);
    pages.
 
    @prop[page_vec] Vector of pages
+   @prop[scratch] Vector of scratch pages, free ones first
+   @prop[scratch_free] Number of free pages at the start of scratch
  */
 typedef struct
 {
   darr_t page_vec;
+  darr_t scratch;
+  size_t scratch_free;
 } heap_t;
 
 #define HEAP_SIZE(HEAP) ((HEAP).page_vec.used / sizeof(page_t *))
@@ -94,7 +100,7 @@ void heap_create(heap_t *heap);
    @param[heap] Heap to create a new page on
    @param[size] Size of page to allocate
 
-   @return The newly allocated page
+   @return The newly allocated page, or NULL if it couldn't be allocated
  */
 page_t *heap_allocate(heap_t *heap, size_t size);
 
@@ -112,6 +118,37 @@ page_t *heap_allocate(heap_t *heap, size_t size);
  */
 bool heap_free(heap_t *heap, page_t *page);
 
+/**
+   @brief Allocate a scratch page on the heap
+
+   @details Scratch pages are for allocations known to be freed soon,
+   through heap_scratch_free.  Freed pages are kept by the heap and
+   handed out again, so in the steady state this is just zeroing size
+   bytes.  Pages are allocated in powers of two from PAGE_DEFAULT_SIZE,
+   and one of another size is reallocated when reused.
+
+   @param[heap] Heap to allocate the page on
+   @param[size] Size of page to allocate, PAGE_DEFAULT_SIZE if 0
+
+   @return The page, or NULL if it couldn't be allocated or size is
+   more than SIZE_MAX / 2
+ */
+page_t *heap_scratch_allocate(heap_t *heap, size_t size);
+
+/**
+   @brief Free a scratch page from the heap
+
+   @details The page is kept for reuse by heap_scratch_allocate.  Pages
+   in use are searched from the most recently allocated, which is
+   usually the one freed.
+
+   @param[heap] Heap to free page from
+   @param[page] Scratch page in use to free
+
+   @return Whether page was a scratch page in use
+ */
+bool heap_scratch_free(heap_t *heap, page_t *page);
+
 /**
    @brief Stop the heap, freeing all associated memory
 
@@ -20,244 +20,119 @@
 #include <stdbool.h>
 #include <stdio.h>
 
+/* Indexed by opcode, so sizing, encoding, decoding and printing an
+   instruction each take one lookup.  Operands are 1 << type bytes.
+   POP and PUSH are macros given the size of the opcode's datum, so
+   each family is written once. */
+#define OPCODE_OPERAND_SIZE(TYPE) ((TYPE) == DATA_TYPE_NIL ? 0 : 1 << (TYPE))
+#define OPCODE_INFO(NAME, OPERAND, TYPE, POP, PUSH)                  \
+  [OP_##NAME] = {#NAME, OPERAND, TYPE, 1 + OPCODE_OPERAND_SIZE(TYPE), \
+                 POP, PUSH}
+#define OPCODE_INFO_UNSIGNED(NAME, OPERAND, TYPE, POP, PUSH)          \
+  OPCODE_INFO(NAME##_BYTE, OPERAND, TYPE, POP(BYTE_SIZE),            \
+              PUSH(BYTE_SIZE)),                                      \
+      OPCODE_INFO(NAME##_SHORT, OPERAND, TYPE, POP(SHORT_SIZE),      \
+                  PUSH(SHORT_SIZE)),                                 \
+      OPCODE_INFO(NAME##_HWORD, OPERAND, TYPE, POP(HWORD_SIZE),      \
+                  PUSH(HWORD_SIZE)),                                 \
+      OPCODE_INFO(NAME##_WORD, OPERAND, TYPE, POP(WORD_SIZE),        \
+                  PUSH(WORD_SIZE))
+#define OPCODE_INFO_SIGNED(NAME, POP, PUSH)                           \
+  OPCODE_INFO(NAME##_BYTE, OPERAND_NONE, DATA_TYPE_NIL,              \
+              POP(BYTE_SIZE), PUSH(BYTE_SIZE)),                      \
+      OPCODE_INFO(NAME##_SBYTE, OPERAND_NONE, DATA_TYPE_NIL,         \
+                  POP(BYTE_SIZE), PUSH(BYTE_SIZE)),                  \
+      OPCODE_INFO(NAME##_SHORT, OPERAND_NONE, DATA_TYPE_NIL,         \
+                  POP(SHORT_SIZE), PUSH(SHORT_SIZE)),                \
+      OPCODE_INFO(NAME##_SSHORT, OPERAND_NONE, DATA_TYPE_NIL,        \
+                  POP(SHORT_SIZE), PUSH(SHORT_SIZE)),                \
+      OPCODE_INFO(NAME##_HWORD, OPERAND_NONE, DATA_TYPE_NIL,         \
+                  POP(HWORD_SIZE), PUSH(HWORD_SIZE)),                \
+      OPCODE_INFO(NAME##_SHWORD, OPERAND_NONE, DATA_TYPE_NIL,        \
+                  POP(HWORD_SIZE), PUSH(HWORD_SIZE)),                \
+      OPCODE_INFO(NAME##_WORD, OPERAND_NONE, DATA_TYPE_NIL,          \
+                  POP(WORD_SIZE), PUSH(WORD_SIZE)),                  \
+      OPCODE_INFO(NAME##_SWORD, OPERAND_NONE, DATA_TYPE_NIL,         \
+                  POP(WORD_SIZE), PUSH(WORD_SIZE))
+
+/* Stack effects, given the size of an opcode's datum. */
+#define EFFECT_NONE(SIZE)  0
+#define EFFECT_ONE(SIZE)   (SIZE)
+#define EFFECT_TWO(SIZE)   (2 * (SIZE))
+#define EFFECT_BOOL(SIZE)  BYTE_SIZE
+#define EFFECT_WORD(SIZE)  WORD_SIZE
+#define EFFECT_WORDS(SIZE) (2 * WORD_SIZE)
+#define EFFECT_MSET(SIZE)  (2 * WORD_SIZE + (SIZE))
+
+static_assert(NUMBER_OF_OPCODES == 115, "opcode_info: Out of date");
+const opcode_info_t opcode_info[NUMBER_OF_OPCODES] = {
+    OPCODE_INFO(NOOP, OPERAND_NONE, DATA_TYPE_NIL, 0, 0),
+    OPCODE_INFO(HALT, OPERAND_NONE, DATA_TYPE_NIL, 0, 0),
+    OPCODE_INFO(PUSH_BYTE, OPERAND_DATUM, DATA_TYPE_BYTE, 0, BYTE_SIZE),
+    OPCODE_INFO(PUSH_SHORT, OPERAND_DATUM, DATA_TYPE_SHORT, 0, SHORT_SIZE),
+    OPCODE_INFO(PUSH_HWORD, OPERAND_DATUM, DATA_TYPE_HWORD, 0, HWORD_SIZE),
+    OPCODE_INFO(PUSH_WORD, OPERAND_DATUM, DATA_TYPE_WORD, 0, WORD_SIZE),
+    OPCODE_INFO_UNSIGNED(POP, OPERAND_NONE, DATA_TYPE_NIL,
+                         EFFECT_ONE, EFFECT_NONE),
+    OPCODE_INFO_UNSIGNED(PUSH_REGISTER, OPERAND_REGISTER, DATA_TYPE_WORD,
+                         EFFECT_NONE, EFFECT_ONE),
+    OPCODE_INFO_UNSIGNED(MOV, OPERAND_REGISTER, DATA_TYPE_WORD,
+                         EFFECT_ONE, EFFECT_NONE),
+    OPCODE_INFO_UNSIGNED(DUP, OPERAND_COUNT, DATA_TYPE_WORD,
+                         EFFECT_NONE, EFFECT_ONE),
+    OPCODE_INFO_UNSIGNED(MALLOC, OPERAND_NONE, DATA_TYPE_NIL,
+                         EFFECT_WORD, EFFECT_WORD),
+    OPCODE_INFO_UNSIGNED(MSET, OPERAND_NONE, DATA_TYPE_NIL,
+                         EFFECT_MSET, EFFECT_NONE),
+    OPCODE_INFO_UNSIGNED(MGET, OPERAND_NONE, DATA_TYPE_NIL,
+                         EFFECT_WORDS, EFFECT_ONE),
+    OPCODE_INFO(MDELETE, OPERAND_NONE, DATA_TYPE_NIL, WORD_SIZE, 0),
+    OPCODE_INFO(MSIZE, OPERAND_NONE, DATA_TYPE_NIL, WORD_SIZE, WORD_SIZE),
+    OPCODE_INFO_UNSIGNED(NOT, OPERAND_NONE, DATA_TYPE_NIL,
+                         EFFECT_ONE, EFFECT_ONE),
+    OPCODE_INFO_UNSIGNED(OR, OPERAND_NONE, DATA_TYPE_NIL,
+                         EFFECT_TWO, EFFECT_ONE),
+    OPCODE_INFO_UNSIGNED(AND, OPERAND_NONE, DATA_TYPE_NIL,
+                         EFFECT_TWO, EFFECT_ONE),
+    OPCODE_INFO_UNSIGNED(XOR, OPERAND_NONE, DATA_TYPE_NIL,
+                         EFFECT_TWO, EFFECT_ONE),
+    OPCODE_INFO_UNSIGNED(EQ, OPERAND_NONE, DATA_TYPE_NIL,
+                         EFFECT_TWO, EFFECT_BOOL),
+    OPCODE_INFO_UNSIGNED(PLUS, OPERAND_NONE, DATA_TYPE_NIL,
+                         EFFECT_TWO, EFFECT_ONE),
+    OPCODE_INFO_UNSIGNED(SUB, OPERAND_NONE, DATA_TYPE_NIL,
+                         EFFECT_TWO, EFFECT_ONE),
+    OPCODE_INFO_UNSIGNED(MULT, OPERAND_NONE, DATA_TYPE_NIL,
+                         EFFECT_TWO, EFFECT_ONE),
+    OPCODE_INFO_SIGNED(LT, EFFECT_TWO, EFFECT_BOOL),
+    OPCODE_INFO_SIGNED(LTE, EFFECT_TWO, EFFECT_BOOL),
+    OPCODE_INFO_SIGNED(GT, EFFECT_TWO, EFFECT_BOOL),
+    OPCODE_INFO_SIGNED(GTE, EFFECT_TWO, EFFECT_BOOL),
+    OPCODE_INFO_SIGNED(PRINT, EFFECT_ONE, EFFECT_NONE),
+    OPCODE_INFO(JUMP_ABS, OPERAND_ADDRESS, DATA_TYPE_WORD, 0, 0),
+    OPCODE_INFO_UNSIGNED(JUMP_IF, OPERAND_ADDRESS, DATA_TYPE_WORD,
+                         EFFECT_ONE, EFFECT_NONE),
+    OPCODE_INFO(CALL, OPERAND_ADDRESS, DATA_TYPE_WORD, 0, 0),
+    OPCODE_INFO(RET, OPERAND_NONE, DATA_TYPE_NIL, 0, 0),
+};
+
+#undef EFFECT_MSET
+#undef EFFECT_WORDS
+#undef EFFECT_WORD
+#undef EFFECT_BOOL
+#undef EFFECT_TWO
+#undef EFFECT_ONE
+#undef EFFECT_NONE
+#undef OPCODE_INFO_SIGNED
+#undef OPCODE_INFO_UNSIGNED
+#undef OPCODE_INFO
+#undef OPCODE_OPERAND_SIZE
+
 const char *opcode_as_cstr(opcode_t code)
 {
-  switch (code)
-  {
-  case OP_NOOP:
-    return "NOOP";
-  case OP_HALT:
-    return "HALT";
-  case OP_PUSH_BYTE:
-    return "PUSH_BYTE";
-  case OP_PUSH_SHORT:
-    return "PUSH_SHORT";
-  case OP_PUSH_HWORD:
-    return "PUSH_HWORD";
-  case OP_PUSH_WORD:
-    return "PUSH_WORD";
-  case OP_POP_BYTE:
-    return "POP_BYTE";
-  case OP_POP_SHORT:
-    return "POP_SHORT";
-  case OP_POP_HWORD:
-    return "POP_HWORD";
-  case OP_POP_WORD:
-    return "POP_WORD";
-  case OP_PUSH_REGISTER_BYTE:
-    return "PUSH_REGISTER_BYTE";
-  case OP_PUSH_REGISTER_SHORT:
-    return "PUSH_REGISTER_SHORT";
-  case OP_PUSH_REGISTER_HWORD:
-    return "PUSH_REGISTER_HWORD";
-  case OP_PUSH_REGISTER_WORD:
-    return "PUSH_REGISTER_WORD";
-  case OP_MOV_BYTE:
-    return "MOV_BYTE";
-  case OP_MOV_SHORT:
-    return "MOV_SHORT";
-  case OP_MOV_HWORD:
-    return "MOV_HWORD";
-  case OP_MOV_WORD:
-    return "MOV_WORD";
-  case OP_DUP_BYTE:
-    return "DUP_BYTE";
-  case OP_DUP_SHORT:
-    return "DUP_SHORT";
-  case OP_DUP_HWORD:
-    return "DUP_HWORD";
-  case OP_DUP_WORD:
-    return "DUP_WORD";
-  case OP_MALLOC_BYTE:
-    return "MALLOC_BYTE";
-  case OP_MALLOC_SHORT:
-    return "MALLOC_SHORT";
-  case OP_MALLOC_HWORD:
-    return "MALLOC_HWORD";
-  case OP_MALLOC_WORD:
-    return "MALLOC_WORD";
-  case OP_MSET_BYTE:
-    return "MSET_BYTE";
-  case OP_MSET_SHORT:
-    return "MSET_SHORT";
-  case OP_MSET_HWORD:
-    return "MSET_HWORD";
-  case OP_MSET_WORD:
-    return "MSET_WORD";
-  case OP_MGET_BYTE:
-    return "MGET_BYTE";
-  case OP_MGET_SHORT:
-    return "MGET_SHORT";
-  case OP_MGET_HWORD:
-    return "MGET_HWORD";
-  case OP_MGET_WORD:
-    return "MGET_WORD";
-  case OP_MDELETE:
-    return "MDELETE";
-  case OP_MSIZE:
-    return "MSIZE";
-  case OP_NOT_BYTE:
-    return "NOT_BYTE";
-  case OP_NOT_SHORT:
-    return "NOT_SHORT";
-  case OP_NOT_HWORD:
-    return "NOT_HWORD";
-  case OP_NOT_WORD:
-    return "NOT_WORD";
-  case OP_OR_BYTE:
-    return "OR_BYTE";
-  case OP_OR_SHORT:
-    return "OR_SHORT";
-  case OP_OR_HWORD:
-    return "OR_HWORD";
-  case OP_OR_WORD:
-    return "OR_WORD";
-  case OP_AND_BYTE:
-    return "AND_BYTE";
-  case OP_AND_SHORT:
-    return "AND_SHORT";
-  case OP_AND_HWORD:
-    return "AND_HWORD";
-  case OP_AND_WORD:
-    return "AND_WORD";
-  case OP_XOR_BYTE:
-    return "XOR_BYTE";
-  case OP_XOR_SHORT:
-    return "XOR_SHORT";
-  case OP_XOR_HWORD:
-    return "XOR_HWORD";
-  case OP_XOR_WORD:
-    return "XOR_WORD";
-  case OP_EQ_BYTE:
-    return "EQ_BYTE";
-  case OP_EQ_SHORT:
-    return "EQ_SHORT";
-  case OP_EQ_HWORD:
-    return "EQ_HWORD";
-  case OP_EQ_WORD:
-    return "EQ_WORD";
-  case OP_PLUS_BYTE:
-    return "PLUS_BYTE";
-  case OP_PLUS_SHORT:
-    return "PLUS_SHORT";
-  case OP_PLUS_HWORD:
-    return "PLUS_HWORD";
-  case OP_PLUS_WORD:
-    return "PLUS_WORD";
-  case OP_SUB_BYTE:
-    return "SUB_BYTE";
-  case OP_SUB_SHORT:
-    return "SUB_SHORT";
-  case OP_SUB_HWORD:
-    return "SUB_HWORD";
-  case OP_SUB_WORD:
-    return "SUB_WORD";
-  case OP_MULT_BYTE:
-    return "MULT_BYTE";
-  case OP_MULT_SHORT:
-    return "MULT_SHORT";
-  case OP_MULT_HWORD:
-    return "MULT_HWORD";
-  case OP_MULT_WORD:
-    return "MULT_WORD";
-  case OP_LT_BYTE:
-    return "LT_BYTE";
-  case OP_LT_SBYTE:
-    return "LT_SBYTE";
-  case OP_LT_SHORT:
-    return "LT_SHORT";
-  case OP_LT_SSHORT:
-    return "LT_SSHORT";
-  case OP_LT_HWORD:
-    return "LT_HWORD";
-  case OP_LT_SHWORD:
-    return "LT_SHWORD";
-  case OP_LT_WORD:
-    return "LT_WORD";
-  case OP_LT_SWORD:
-    return "LT_SWORD";
-  case OP_LTE_BYTE:
-    return "LTE_BYTE";
-  case OP_LTE_SBYTE:
-    return "LTE_SBYTE";
-  case OP_LTE_SHORT:
-    return "LTE_SHORT";
-  case OP_LTE_SSHORT:
-    return "LTE_SSHORT";
-  case OP_LTE_HWORD:
-    return "LTE_HWORD";
-  case OP_LTE_SHWORD:
-    return "LTE_SHWORD";
-  case OP_LTE_WORD:
-    return "LTE_WORD";
-  case OP_LTE_SWORD:
-    return "LTE_SWORD";
-  case OP_GT_BYTE:
-    return "GT_BYTE";
-  case OP_GT_SBYTE:
-    return "GT_SBYTE";
-  case OP_GT_SHORT:
-    return "GT_SHORT";
-  case OP_GT_SSHORT:
-    return "GT_SSHORT";
-  case OP_GT_HWORD:
-    return "GT_HWORD";
-  case OP_GT_SHWORD:
-    return "GT_SHWORD";
-  case OP_GT_WORD:
-    return "GT_WORD";
-  case OP_GT_SWORD:
-    return "GT_SWORD";
-  case OP_GTE_BYTE:
-    return "GTE_BYTE";
-  case OP_GTE_SBYTE:
-    return "GTE_SBYTE";
-  case OP_GTE_SHORT:
-    return "GTE_SHORT";
-  case OP_GTE_SSHORT:
-    return "GTE_SSHORT";
-  case OP_GTE_HWORD:
-    return "GTE_HWORD";
-  case OP_GTE_SHWORD:
-    return "GTE_SHWORD";
-  case OP_GTE_WORD:
-    return "GTE_WORD";
-  case OP_GTE_SWORD:
-    return "GTE_SWORD";
-  case OP_PRINT_BYTE:
-    return "PRINT_BYTE";
-  case OP_PRINT_SBYTE:
-    return "PRINT_SBYTE";
-  case OP_PRINT_SHORT:
-    return "PRINT_SHORT";
-  case OP_PRINT_SSHORT:
-    return "PRINT_SSHORT";
-  case OP_PRINT_HWORD:
-    return "PRINT_HWORD";
-  case OP_PRINT_SHWORD:
-    return "PRINT_SHWORD";
-  case OP_PRINT_WORD:
-    return "PRINT_WORD";
-  case OP_PRINT_SWORD:
-    return "PRINT_SWORD";
-  case OP_JUMP_ABS:
-    return "JUMP_ABS";
-  case OP_JUMP_IF_BYTE:
-    return "JUMP_IF_BYTE";
-  case OP_JUMP_IF_SHORT:
-    return "JUMP_IF_SHORT";
-  case OP_JUMP_IF_HWORD:
-    return "JUMP_IF_HWORD";
-  case OP_JUMP_IF_WORD:
-    return "JUMP_IF_WORD";
-  case OP_CALL:
-    return "CALL";
-  case OP_RET:
-    return "RET";
-  case NUMBER_OF_OPCODES:
+  if ((word_t)code >= NUMBER_OF_OPCODES)
     return "";
-  }
-  return "";
+  return opcode_info[code].name;
 }
 
 void data_print(data_t datum, data_type_t type, FILE *fp)
@@ -283,188 +158,153 @@ void data_print(data_t datum, data_type_t type, FILE *fp)
 
 void inst_print(inst_t instruction, FILE *fp)
 {
-  static_assert(NUMBER_OF_OPCODES == 115, "inst_print: Out of date");
   fprintf(fp, "%s(", opcode_as_cstr(instruction.opcode));
-  if (UNSIGNED_OPCODE_IS_TYPE(instruction.opcode, OP_PUSH))
+  const operand_t operand = (word_t)instruction.opcode < NUMBER_OF_OPCODES
+                                ? opcode_info[instruction.opcode].operand
+                                : OPERAND_NONE;
+  switch (operand)
   {
-    data_type_t type = (data_type_t)instruction.opcode;
+  case OPERAND_NONE:
+    break;
+  case OPERAND_DATUM:
     fprintf(fp, "datum=0x");
-    data_print(instruction.operand, type, fp);
-  }
-  else if (UNSIGNED_OPCODE_IS_TYPE(instruction.opcode, OP_PUSH_REGISTER) ||
-           UNSIGNED_OPCODE_IS_TYPE(instruction.opcode, OP_MOV))
-  {
+    data_print(instruction.operand, opcode_info[instruction.opcode].type, fp);
+    break;
+  case OPERAND_REGISTER:
     fprintf(fp, "reg=0x");
     data_print(instruction.operand, DATA_TYPE_BYTE, fp);
-  }
-  else if (UNSIGNED_OPCODE_IS_TYPE(instruction.opcode, OP_DUP))
-  {
+    break;
+  case OPERAND_COUNT:
     fprintf(fp, "n=0x%lX", instruction.operand.as_word);
-  }
-  else if (instruction.opcode == OP_JUMP_ABS ||
-           UNSIGNED_OPCODE_IS_TYPE(instruction.opcode, OP_JUMP_IF) ||
-           instruction.opcode == OP_CALL)
-  {
+    break;
+  case OPERAND_ADDRESS:
     fprintf(fp, "address=0x");
     data_print(instruction.operand, DATA_TYPE_WORD, fp);
+    break;
   }
   fprintf(fp, ")");
 }
 
 size_t opcode_bytecode_size(opcode_t opcode)
 {
-  static_assert(NUMBER_OF_OPCODES == 115, "inst_bytecode_size: Out of date");
-  size_t size = 1; // for opcode
-  if (UNSIGNED_OPCODE_IS_TYPE(opcode, OP_PUSH))
-  {
-    if (opcode == OP_PUSH_BYTE)
-      ++size;
-    else if (opcode == OP_PUSH_HWORD)
-      size += HWORD_SIZE;
-    else if (opcode == OP_PUSH_WORD)
-      size += WORD_SIZE;
-  }
-  else if (UNSIGNED_OPCODE_IS_TYPE(opcode, OP_PUSH_REGISTER) ||
-           UNSIGNED_OPCODE_IS_TYPE(opcode, OP_MOV) ||
-           UNSIGNED_OPCODE_IS_TYPE(opcode, OP_DUP) ||
-           UNSIGNED_OPCODE_IS_TYPE(opcode, OP_MALLOC) ||
-           UNSIGNED_OPCODE_IS_TYPE(opcode, OP_MSET) ||
-           UNSIGNED_OPCODE_IS_TYPE(opcode, OP_MGET) ||
-           UNSIGNED_OPCODE_IS_TYPE(opcode, OP_JUMP_IF) ||
-           opcode == OP_JUMP_ABS || opcode == OP_CALL)
-    size += WORD_SIZE;
-  return size;
+  if ((word_t)opcode >= NUMBER_OF_OPCODES)
+    return 1;
+  return opcode_info[opcode].size;
 }
 
 size_t inst_write_bytecode(inst_t inst, byte_t *bytes)
 {
-  static_assert(NUMBER_OF_OPCODES == 115, "inst_write_bytecode: Out of date");
-
-  bytes[0]       = inst.opcode;
-  size_t written = 1;
-  // Then append 0 or more operands
-  data_type_t to_append = DATA_TYPE_NIL;
-  if (UNSIGNED_OPCODE_IS_TYPE(inst.opcode, OP_PUSH))
-    to_append = OPCODE_DATA_TYPE(inst.opcode, OP_PUSH);
-  else if (UNSIGNED_OPCODE_IS_TYPE(inst.opcode, OP_PUSH_REGISTER) ||
-           UNSIGNED_OPCODE_IS_TYPE(inst.opcode, OP_DUP) ||
-           UNSIGNED_OPCODE_IS_TYPE(inst.opcode, OP_MOV) ||
-           UNSIGNED_OPCODE_IS_TYPE(inst.opcode, OP_DUP) ||
-           UNSIGNED_OPCODE_IS_TYPE(inst.opcode, OP_JUMP_IF) ||
-           inst.opcode == OP_JUMP_ABS || inst.opcode == OP_CALL)
-    to_append = DATA_TYPE_WORD;
+  if ((word_t)inst.opcode >= NUMBER_OF_OPCODES)
+  {
+    bytes[0] = inst.opcode;
+    return 1;
+  }
 
-  switch (to_append)
+  const opcode_info_t info = opcode_info[inst.opcode];
+  bytes[0]                 = inst.opcode;
+  switch (info.type)
   {
   case DATA_TYPE_NIL:
     break;
-  case DATA_TYPE_BYTE: {
+  case DATA_TYPE_BYTE:
     bytes[1] = inst.operand.as_byte;
-    written += 1;
     break;
-  }
-  case DATA_TYPE_SHORT: {
+  case DATA_TYPE_SHORT:
     convert_short_to_bytes(inst.operand.as_short, bytes + 1);
-    written += SHORT_SIZE;
     break;
-  }
-  case DATA_TYPE_HWORD: {
+  case DATA_TYPE_HWORD:
     convert_hword_to_bytes(inst.operand.as_hword, bytes + 1);
-    written += HWORD_SIZE;
     break;
-  }
-  case DATA_TYPE_WORD: {
+  case DATA_TYPE_WORD:
     convert_word_to_bytes(inst.operand.as_word, bytes + 1);
-    written += WORD_SIZE;
     break;
   }
-  }
-  return written;
+  return info.size;
 }
 
-bool read_type_from_darr(byte_t *bytes, size_t size, data_type_t type,
-                         data_t *data)
+/* Decode the instruction at bytes, which has size_bytes left in it.
+   If checked is false the caller has made sure at least
+   INST_MAX_BYTECODE_SIZE bytes are left, so only the opcode is
+   checked. */
+static inline int inst_decode(inst_t *inst, const byte_t *bytes,
+                              size_t size_bytes, bool checked)
 {
-  data_t datum = {0};
-  switch (type)
+  const byte_t opcode = bytes[0];
+  if (opcode >= NUMBER_OF_OPCODES)
+    return READ_ERR_INVALID_OPCODE;
+  const opcode_info_t info = opcode_info[opcode];
+  if (checked && size_bytes < info.size)
+    return READ_ERR_OPERAND_NO_FIT;
+
+  data_t operand = {0};
+  switch (info.type)
   {
   case DATA_TYPE_NIL:
     break;
   case DATA_TYPE_BYTE:
-    if (size == 0)
-      return false;
-    datum = DBYTE(bytes[0]);
+    operand = DBYTE(bytes[1]);
     break;
   case DATA_TYPE_SHORT:
-    if (size < SHORT_SIZE)
-      return false;
-    short s = convert_bytes_to_short(bytes);
-    datum   = DSHORT(s);
+    operand = DSHORT(convert_bytes_to_short(bytes + 1));
     break;
   case DATA_TYPE_HWORD:
-    if (size < HWORD_SIZE)
-      return false;
-    hword_t u = convert_bytes_to_hword(bytes);
-    datum     = DHWORD(u);
+    operand = DHWORD(convert_bytes_to_hword(bytes + 1));
     break;
   case DATA_TYPE_WORD:
-    if (size < WORD_SIZE)
-      return false;
-    word_t w = convert_bytes_to_word(bytes);
-    datum    = DWORD(w);
+    operand = DWORD(convert_bytes_to_word(bytes + 1));
     break;
-  default:
-    return false;
   }
-  *data = datum;
-  return true;
+  *inst = (inst_t){opcode, operand};
+  return info.size;
 }
 
 int inst_read_bytecode(inst_t *ptr, byte_t *bytes, size_t size_bytes)
 {
-  static_assert(NUMBER_OF_OPCODES == 115, "inst_read_bytecode: Out of date");
-
-  opcode_t opcode = *(bytes++);
-  if (opcode >= NUMBER_OF_OPCODES || opcode < OP_NOOP)
-    return READ_ERR_INVALID_OPCODE;
-
-  inst_t inst = {opcode, {0}};
-  --size_bytes;
-
-  bool success = true;
+  if (size_bytes == 0)
+    return READ_ERR_EXPECTED_MORE;
+  return inst_decode(ptr, bytes, size_bytes, true);
+}
 
-  // Read operands
-  if (UNSIGNED_OPCODE_IS_TYPE(opcode, OP_PUSH))
-    success = read_type_from_darr(bytes, size_bytes, (data_type_t)opcode,
-                                  &inst.operand);
-  // Read operand as a word
-  else if (UNSIGNED_OPCODE_IS_TYPE(opcode, OP_PUSH_REGISTER) ||
-           UNSIGNED_OPCODE_IS_TYPE(opcode, OP_MOV) ||
-           UNSIGNED_OPCODE_IS_TYPE(opcode, OP_DUP) ||
-           UNSIGNED_OPCODE_IS_TYPE(opcode, OP_JUMP_IF) ||
-           opcode == OP_JUMP_ABS || opcode == OP_CALL)
-    success =
-        read_type_from_darr(bytes, size_bytes, DATA_TYPE_WORD, &inst.operand);
-  else
+read_err_prog_t inst_read_bytecode_n(inst_t *insts, size_t count,
+                                     size_t *size_bytes_read, byte_t *bytes,
+                                     size_t size_bytes)
+{
+  size_t inst_iter = 0, byte_iter = 0;
+  // Any instruction fits in what's left, so only the opcode is checked
+  for (; inst_iter < count && size_bytes - byte_iter >= INST_MAX_BYTECODE_SIZE;
+       ++inst_iter)
   {
-    // Instruction doesn't take operands
+    const int bytes_read =
+        inst_decode(insts + inst_iter, bytes + byte_iter, 0, false);
+    if (bytes_read < 0)
+      return (read_err_prog_t){bytes_read, byte_iter};
+    byte_iter += bytes_read;
   }
-
-  if (success)
+  // The last few instructions may not
+  for (; inst_iter < count && byte_iter < size_bytes; ++inst_iter)
   {
-    *ptr = inst;
-    return (int)(size_bytes);
+    const int bytes_read = inst_decode(insts + inst_iter, bytes + byte_iter,
+                                       size_bytes - byte_iter, true);
+    if (bytes_read < 0)
+      return (read_err_prog_t){bytes_read, byte_iter};
+    byte_iter += bytes_read;
   }
-  else
-    return READ_ERR_OPERAND_NO_FIT;
+
+  if (inst_iter < count)
+    return (read_err_prog_t){READ_ERR_EXPECTED_MORE, 0};
+  *size_bytes_read = byte_iter;
+  return (read_err_prog_t){0};
 }
 
-static_assert(sizeof(prog_t) == (WORD_SIZE * 2) + sizeof(inst_t *),
+static_assert(sizeof(prog_t) == (WORD_SIZE * 2) + sizeof(inst_t *) +
+                                    sizeof(prog_resources_t),
               "prog_{write|read}_* is out of date");
 
 size_t prog_bytecode_size(prog_t program)
 {
-  size_t size = WORD_SIZE * 2;
+  size_t size = PROG_HEADER_SIZE;
+  if (program.resources.present)
+    size += PROG_RESOURCES_SIZE;
   for (size_t i = 0; i < program.count; ++i)
     size += opcode_bytecode_size(program.instructions[i].opcode);
   return size;
@@ -472,15 +312,29 @@ size_t prog_bytecode_size(prog_t program)
 
 size_t prog_write_bytecode(prog_t program, byte_t *bytes, size_t size_bytes)
 {
-  if (size_bytes < PROG_HEADER_SIZE || prog_bytecode_size(program) < size_bytes)
+  // A count clashing with the flag for the section can't be written
+  if (program.count & PROG_RESOURCES || size_bytes < PROG_HEADER_SIZE ||
+      size_bytes < prog_bytecode_size(program))
     return 0;
-  size_t b_iter = 0;
+  size_t b_iter                      = 0;
+  const prog_resources_t *resources = &program.resources;
   // Write program header i.e. the start and count
   convert_word_to_bytes(program.start_address, bytes);
   b_iter += WORD_SIZE;
-  convert_word_to_bytes(program.count, bytes + b_iter);
+  convert_word_to_bytes(
+      program.count | (resources->present ? PROG_RESOURCES : 0),
+      bytes + b_iter);
   b_iter += WORD_SIZE;
 
+  // Write the resource section, if there is one
+  if (resources->present)
+  {
+    const word_t section[] = {resources->stack, resources->calls,
+                              resources->registers, resources->heap};
+    for (size_t i = 0; i < ARR_SIZE(section); ++i, b_iter += WORD_SIZE)
+      convert_word_to_bytes(section[i], bytes + b_iter);
+  }
+
   // Write instructions
   size_t p_iter = 0;
   for (; p_iter < program.count && b_iter < size_bytes; ++p_iter)
@@ -501,10 +355,27 @@ size_t prog_read_header(prog_t *prog, byte_t *bytes, size_t size_bytes)
     return 0;
   prog->start_address = convert_bytes_to_word(bytes);
   prog->count         = convert_bytes_to_word(bytes + WORD_SIZE);
+  prog->resources     = (prog_resources_t){0};
+
+  if (prog->count & PROG_RESOURCES)
+  {
+    prog->count &= ~PROG_RESOURCES;
+    if (size_bytes < PROG_HEADER_SIZE + PROG_RESOURCES_SIZE)
+      return 0;
+    bytes += PROG_HEADER_SIZE;
+    prog->resources = (prog_resources_t){
+        .present   = true,
+        .stack     = convert_bytes_to_word(bytes),
+        .calls     = convert_bytes_to_word(bytes + WORD_SIZE),
+        .registers = convert_bytes_to_word(bytes + WORD_SIZE * 2),
+        .heap      = convert_bytes_to_word(bytes + WORD_SIZE * 3),
+    };
+  }
 
   if (prog->start_address >= prog->count)
     return 0;
-  return PROG_HEADER_SIZE;
+  return PROG_HEADER_SIZE +
+         (prog->resources.present ? PROG_RESOURCES_SIZE : 0);
 }
 
 read_err_prog_t prog_read_instructions(prog_t *program, size_t *size_bytes_read,
@@ -513,21 +384,6 @@ read_err_prog_t prog_read_instructions(prog_t *program, size_t *size_bytes_read,
   // If no count then must be empty
   if (program->count == 0)
     return (read_err_prog_t){0};
-
-  size_t program_iter = 0, byte_iter = 0;
-  for (; program_iter < program->count && byte_iter < size_bytes;
-       ++program_iter)
-  {
-    inst_t inst = {0};
-    int bytes_read =
-        inst_read_bytecode(&inst, bytes + byte_iter, size_bytes - byte_iter);
-    if (bytes_read < 0)
-      return (read_err_prog_t){bytes_read, byte_iter};
-    byte_iter += bytes_read;
-  }
-
-  if (program_iter < program->count)
-    return (read_err_prog_t){READ_ERR_EXPECTED_MORE, 0};
-  *size_bytes_read = byte_iter;
-  return (read_err_prog_t){0};
+  return inst_read_bytecode_n(program->instructions, program->count,
+                              size_bytes_read, bytes, size_bytes);
 }
@@ -17,6 +17,7 @@
 #define INST_H
 
 #include <lib/base.h>
+#include <stdbool.h>
 #include <stdio.h>
 
 #define UNSIGNED_OPCODE_IS_TYPE(OPCODE, OP_TYPE) \
@@ -181,6 +182,53 @@ typedef enum
   NUMBER_OF_OPCODES,
 } opcode_t;
 
+/**
+   @brief What the operand of an instruction is used as.
+
+   @prop[OPERAND_NONE] No operand
+   @prop[OPERAND_DATUM] A datum pushed, of the opcode's type
+   @prop[OPERAND_REGISTER] Index of a register
+   @prop[OPERAND_COUNT] Number of data down the stack
+   @prop[OPERAND_ADDRESS] Address of an instruction
+ */
+typedef enum
+{
+  OPERAND_NONE = 0,
+  OPERAND_DATUM,
+  OPERAND_REGISTER,
+  OPERAND_COUNT,
+  OPERAND_ADDRESS,
+} operand_t;
+
+/**
+   @brief Properties of an opcode, looked up rather than worked out
+   from its range.
+
+   @prop[name] Name, as printed
+   @prop[operand] What its operand is used as
+   @prop[type] Type of its operand in bytecode, DATA_TYPE_NIL if it has
+   none
+   @prop[size] Bytes of its bytecode, opcode and operand
+   @prop[pop] Bytes it takes off the stack when it succeeds
+   @prop[push] Bytes it then puts on the stack
+
+   DUP reads below the top of the stack, and CALL and RET move along
+   the call stack: those aren't counted in pop and push.
+ */
+typedef struct
+{
+  const char *name;
+  operand_t operand;
+  data_type_t type;
+  byte_t size;
+  byte_t pop, push;
+} opcode_info_t;
+
+/* Largest bytecode of any instruction: an opcode and a word. */
+#define INST_MAX_BYTECODE_SIZE (1 + WORD_SIZE)
+
+extern const opcode_info_t opcode_info[NUMBER_OF_OPCODES];
+
 size_t opcode_bytecode_size(opcode_t);
 const char *opcode_as_cstr(opcode_t);
 
@@ -234,15 +282,41 @@ int inst_read_bytecode(inst_t *inst, byte_t *bytes, size_t size_bytes);
 
 void inst_print(inst_t, FILE *);
 
+/**
+   @brief Resources a program needs, from resource_analyse.
+
+   @details Written to bytecode as an optional section after the
+   header, so a loader can size the parts of a vm for the program.
+
+   @prop[present] Whether the section is there; the rest are only
+   meaningful if so
+   @prop[stack] Most bytes on the stack at once, from an empty stack
+   @prop[calls] Most entries on the call stack at once
+   @prop[registers] Bytes of the registers used, from the first
+   @prop[heap] Estimate of the most bytes allocated on the heap at
+   once, not a bound
+ */
+typedef struct
+{
+  bool present;
+  word_t stack, calls, registers, heap;
+} prog_resources_t;
+
 typedef struct
 {
   word_t start_address;
   word_t count;
   inst_t *instructions;
+  prog_resources_t resources;
 } prog_t;
 
 #define PROG_HEADER_SIZE (WORD_SIZE * 2)
 
+/* Set in the count of the header if a resource section of
+   PROG_RESOURCES_SIZE bytes follows it. */
+#define PROG_RESOURCES      (1UL << 63)
+#define PROG_RESOURCES_SIZE (WORD_SIZE * 4)
+
 size_t prog_bytecode_size(prog_t);
 
 size_t prog_write_bytecode(prog_t program, byte_t *bytes, size_t size_bytes);
@@ -255,6 +329,27 @@ typedef struct
   size_t index;
 } read_err_prog_t;
 
+/**
+   @brief Deserialise a run of instructions from a bytecode buffer
+
+   @details Decodes count instructions into insts in one loop.  While
+   the largest instruction still fits in what's left of bytes only the
+   opcode is checked, so most instructions take one comparison against
+   the end of the buffer rather than one per operand.
+
+   @param[insts] Buffer of at least count instructions to store results
+   @param[count] Number of instructions to read
+   @param[size_bytes_read] Set to the bytes read if successful
+   @param[bytes] Bytecode buffer to deserialise
+   @param[size_bytes] Number of bytes in buffer
+
+   @return[read_err_prog_t] Zeroed if successful, otherwise the error
+   and the offset in bytes of the instruction which caused it
+ */
+read_err_prog_t inst_read_bytecode_n(inst_t *insts, size_t count,
+                                     size_t *size_bytes_read, byte_t *bytes,
+                                     size_t size_bytes);
+
 read_err_prog_t prog_read_instructions(prog_t *program, size_t *size_bytes_read,
                                        byte_t *bytes, size_t size_bytes);
 
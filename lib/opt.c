@@ -0,0 +1,787 @@
+/* Copyright (C) 2026 Aryadev Chavali
+
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License Version 2 for
+ * more details.
+
+ * You should have received a copy of the GNU General Public License Version 2
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+ * Created: 2026-10-16
+ * Author: Aryadev Chavali
+ * Description: Optimisation passes over programs
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <lib/inst-macro.h>
+#include <lib/opt.h>
+
+/* Passes
+
+   Passes work on the program in place and never move instructions:
+   whatever they remove becomes a NOOP, which doesn't change what any
+   execution does.  Only OPT_STRIP and OPT_INLINE move instructions,
+   relocating every address as they go.
+
+   Inlining copies the body of a small leaf subroutine over each CALL
+   to it, with RETs becoming jumps to the instruction after the CALL.
+   A leaf makes no calls, so inlining never recurses, but callers
+   become leaves once their own calls are inlined and may be inlined
+   in the next round.  The original body is left for unreachable code
+   elimination to remove once nothing calls it.
+
+   Sequences are only rewritten if no instruction after the first of
+   them is a leader: the target of a jump or call, the instruction
+   after a call (where it returns to) or the start address.  Then
+   every execution reaching the sequence starts at its first
+   instruction and runs through all of it.  NOOPs between the
+   instructions of a sequence are skipped, as long as they aren't
+   leaders either.
+*/
+
+#define OPT_NONE ((word_t)-1)
+
+/* Largest subroutine, in instructions, inlined at its call sites. */
+#define OPT_INLINE_MAX 16
+
+static const word_t sizes[] = {BYTE_SIZE, SHORT_SIZE, HWORD_SIZE, WORD_SIZE};
+
+static word_t opt_datum(data_t datum, data_type_t type)
+{
+  switch (type)
+  {
+  case DATA_TYPE_BYTE:
+    return datum.as_byte;
+  case DATA_TYPE_SHORT:
+    return datum.as_short;
+  case DATA_TYPE_HWORD:
+    return datum.as_hword;
+  case DATA_TYPE_WORD:
+  case DATA_TYPE_NIL:
+  default:
+    return datum.as_word;
+  }
+}
+
+static data_t opt_data(word_t datum, data_type_t type)
+{
+  switch (type)
+  {
+  case DATA_TYPE_BYTE:
+    return DBYTE(datum);
+  case DATA_TYPE_SHORT:
+    return DSHORT(datum);
+  case DATA_TYPE_HWORD:
+    return DHWORD(datum);
+  case DATA_TYPE_WORD:
+  case DATA_TYPE_NIL:
+  default:
+    return DWORD(datum);
+  }
+}
+
+static sword_t opt_signed(word_t datum, data_type_t type)
+{
+  const word_t shift = (WORD_SIZE - sizes[type]) * 8;
+  return ((sword_t)(datum << shift)) >> shift;
+}
+
+static bool opt_is_jump(opcode_t opcode)
+{
+  return opcode == OP_JUMP_ABS || opcode == OP_CALL ||
+         UNSIGNED_OPCODE_IS_TYPE(opcode, OP_JUMP_IF);
+}
+
+/* Mark the leaders of a program, with an entry for the address after
+   its last instruction. */
+static void opt_leaders(prog_t program, bool *leaders)
+{
+  memset(leaders, 0, (program.count + 1) * sizeof(*leaders));
+  if (program.start_address < program.count)
+    leaders[program.start_address] = true;
+  for (word_t i = 0; i < program.count; ++i)
+  {
+    const inst_t inst = program.instructions[i];
+    if (opt_is_jump(inst.opcode) && inst.operand.as_word < program.count)
+      leaders[inst.operand.as_word] = true;
+    if (inst.opcode == OP_CALL)
+      leaders[i + 1] = true;
+  }
+}
+
+/* Instruction before the one at i in the same sequence, skipping NOOPs,
+   or OPT_NONE if there's a leader in the way. */
+static word_t opt_previous(prog_t program, const bool *leaders, word_t i)
+{
+  for (; i > 0; --i)
+  {
+    if (leaders[i])
+      return OPT_NONE;
+    else if (program.instructions[i - 1].opcode != OP_NOOP)
+      return i - 1;
+  }
+  return OPT_NONE;
+}
+
+static bool opt_is_push(prog_t program, word_t i, data_type_t type)
+{
+  return i != OPT_NONE &&
+         program.instructions[i].opcode == (opcode_t)(OP_PUSH_BYTE + type);
+}
+
+/* Type of the PUSHes an operation needs to be folded, or DATA_TYPE_NIL
+   if it can't be. */
+static data_type_t opt_operand_type(opcode_t opcode)
+{
+  if (opcode >= OP_NOT_BYTE && opcode <= OP_EQ_WORD)
+    return (opcode - OP_NOT_BYTE) % 4;
+  else if (opcode >= OP_PLUS_BYTE && opcode <= OP_MULT_WORD)
+    return (opcode - OP_PLUS_BYTE) % 4;
+  else if (opcode >= OP_LT_BYTE && opcode <= OP_GTE_SWORD)
+    return ((opcode - OP_LT_BYTE) % 8) / 2;
+  else if (UNSIGNED_OPCODE_IS_TYPE(opcode, OP_JUMP_IF))
+    return OPCODE_DATA_TYPE(opcode, OP_JUMP_IF);
+  return DATA_TYPE_NIL;
+}
+
+/* Fold an operation on the constants a and b, where a was pushed last
+   so is popped first, into the PUSH of its result. */
+static inst_t opt_evaluate(opcode_t opcode, word_t a, word_t b)
+{
+  static_assert(NUMBER_OF_OPCODES == 115, "opt_evaluate: Out of date");
+  const data_type_t type = opt_operand_type(opcode);
+  const bool is_signed   = opcode >= OP_LT_BYTE && (opcode - OP_LT_BYTE) % 2;
+  const sword_t sa = opt_signed(a, type), sb = opt_signed(b, type);
+  word_t value     = 0;
+  bool holds       = false;
+  if (UNSIGNED_OPCODE_IS_TYPE(opcode, OP_NOT))
+    value = !a;
+  else if (UNSIGNED_OPCODE_IS_TYPE(opcode, OP_OR))
+    value = a | b;
+  else if (UNSIGNED_OPCODE_IS_TYPE(opcode, OP_AND))
+    value = a & b;
+  else if (UNSIGNED_OPCODE_IS_TYPE(opcode, OP_XOR))
+    value = a ^ b;
+  else if (UNSIGNED_OPCODE_IS_TYPE(opcode, OP_PLUS))
+    value = a + b;
+  else if (UNSIGNED_OPCODE_IS_TYPE(opcode, OP_SUB))
+    value = a - b;
+  else if (UNSIGNED_OPCODE_IS_TYPE(opcode, OP_MULT))
+    value = a * b;
+  // Comparisons push a byte, b COMP a
+  else if (UNSIGNED_OPCODE_IS_TYPE(opcode, OP_EQ))
+    holds = b == a;
+  else if (SIGNED_OPCODE_IS_TYPE(opcode, OP_LT))
+    holds = is_signed ? sb < sa : b < a;
+  else if (SIGNED_OPCODE_IS_TYPE(opcode, OP_LTE))
+    holds = is_signed ? sb <= sa : b <= a;
+  else if (SIGNED_OPCODE_IS_TYPE(opcode, OP_GT))
+    holds = is_signed ? sb > sa : b > a;
+  else if (SIGNED_OPCODE_IS_TYPE(opcode, OP_GTE))
+    holds = is_signed ? sb >= sa : b >= a;
+  if (UNSIGNED_OPCODE_IS_TYPE(opcode, OP_EQ) ||
+      (opcode >= OP_LT_BYTE && opcode <= OP_GTE_SWORD))
+    return (inst_t){OP_PUSH_BYTE, DBYTE(holds)};
+  return (inst_t){OP_PUSH_BYTE + type, opt_data(value, type)};
+}
+
+static size_t opt_fold(prog_t program, const bool *leaders)
+{
+  size_t folded = 0;
+  for (word_t i = 0; i < program.count; ++i)
+  {
+    inst_t *inst           = program.instructions + i;
+    const data_type_t type = opt_operand_type(inst->opcode);
+    const word_t j         = opt_previous(program, leaders, i);
+    if (type == DATA_TYPE_NIL || !opt_is_push(program, j, type))
+      continue;
+    const word_t a = opt_datum(program.instructions[j].operand, type);
+    if (UNSIGNED_OPCODE_IS_TYPE(inst->opcode, OP_JUMP_IF))
+    {
+      // Always or never taken
+      if (a)
+        inst->opcode = OP_JUMP_ABS;
+      else
+        *inst = INST_NOOP;
+    }
+    else if (UNSIGNED_OPCODE_IS_TYPE(inst->opcode, OP_NOT))
+      *inst = opt_evaluate(inst->opcode, a, 0);
+    else
+    {
+      const word_t k = opt_previous(program, leaders, j);
+      if (!opt_is_push(program, k, type))
+        continue;
+      const word_t b = opt_datum(program.instructions[k].operand, type);
+      *inst          = opt_evaluate(inst->opcode, a, b);
+      program.instructions[k] = INST_NOOP;
+    }
+    program.instructions[j] = INST_NOOP;
+    ++folded;
+  }
+  return folded;
+}
+
+/* Where execution from address goes once it's through any NOOPs and
+   JUMP_ABSs, or address itself if that never ends.  A NOOP at the end
+   of the program isn't skipped, as jumping past the end fails where
+   running off it doesn't. */
+static word_t opt_destination(prog_t program, word_t address)
+{
+  word_t destination = address;
+  for (word_t steps = 0; steps <= program.count; ++steps)
+  {
+    if (destination >= program.count)
+      return destination;
+    const inst_t inst = program.instructions[destination];
+    if (inst.opcode == OP_NOOP && destination + 1 < program.count)
+      ++destination;
+    else if (inst.opcode == OP_JUMP_ABS &&
+             inst.operand.as_word < program.count)
+      destination = inst.operand.as_word;
+    else
+      return destination;
+  }
+  return address;
+}
+
+static size_t opt_thread(prog_t program)
+{
+  size_t threaded = 0;
+  for (word_t i = 0; i < program.count; ++i)
+  {
+    inst_t *inst = program.instructions + i;
+    if (!opt_is_jump(inst->opcode) || inst->operand.as_word >= program.count)
+      continue;
+    const word_t target = opt_destination(program, inst->operand.as_word);
+    word_t next         = i + 1;
+    for (; next < target && program.instructions[next].opcode == OP_NOOP;
+         ++next)
+      continue;
+    if (inst->opcode == OP_JUMP_ABS && next == target)
+    {
+      // Only NOOPs between here and target
+      *inst = INST_NOOP;
+      ++threaded;
+    }
+    else if (target != inst->operand.as_word)
+    {
+      inst->operand = DWORD(target);
+      ++threaded;
+    }
+  }
+  return threaded;
+}
+
+static size_t opt_registers(prog_t program, const bool *leaders)
+{
+  size_t removed = 0;
+  for (word_t i = 0; i < program.count; ++i)
+  {
+    const inst_t inst = program.instructions[i];
+    data_type_t type  = DATA_TYPE_NIL;
+    word_t reg        = 0;
+    if (UNSIGNED_OPCODE_IS_TYPE(inst.opcode, OP_MOV))
+    {
+      type = OPCODE_DATA_TYPE(inst.opcode, OP_MOV);
+      reg  = inst.operand.as_word;
+    }
+    // POP is a MOV to the first register
+    else if (UNSIGNED_OPCODE_IS_TYPE(inst.opcode, OP_POP))
+      type = OPCODE_DATA_TYPE(inst.opcode, OP_POP);
+    else
+      continue;
+    const word_t j = opt_previous(program, leaders, i);
+    if (j == OPT_NONE ||
+        program.instructions[j].opcode !=
+            (opcode_t)(OP_PUSH_REGISTER_BYTE + type) ||
+        program.instructions[j].operand.as_word != reg)
+      continue;
+    program.instructions[i] = INST_NOOP;
+    program.instructions[j] = INST_NOOP;
+    ++removed;
+  }
+  return removed;
+}
+
+/* CALL x then RET is JUMP_ABS x, as x returns to wherever the RET
+   would have. */
+static size_t opt_tail(prog_t program)
+{
+  size_t tails = 0;
+  for (word_t i = 0; i < program.count; ++i)
+  {
+    if (program.instructions[i].opcode != OP_CALL)
+      continue;
+    word_t next = i + 1;
+    for (; next < program.count &&
+           program.instructions[next].opcode == OP_NOOP;
+         ++next)
+      continue;
+    if (next < program.count && program.instructions[next].opcode == OP_RET)
+    {
+      program.instructions[i].opcode = OP_JUMP_ABS;
+      ++tails;
+    }
+  }
+  return tails;
+}
+
+/* End of the leaf subroutine at address: the least end such that
+   [address, end) holds every instruction reachable from address
+   without following a RET or HALT, or OPT_NONE if that range has a
+   CALL, is left any other way or is larger than OPT_INLINE_MAX. */
+static word_t opt_subroutine(prog_t program, word_t address, bool *reached,
+                             word_t *pending)
+{
+  const word_t limit = MIN(program.count, address + OPT_INLINE_MAX);
+  size_t count = 0, head = 0;
+  word_t end   = address + 1;
+  if (address >= program.count)
+    return OPT_NONE;
+  reached[address]  = true;
+  pending[count++] = address;
+  for (; head < count && end != OPT_NONE; ++head)
+  {
+    const word_t i    = pending[head];
+    const inst_t inst = program.instructions[i];
+    word_t next[2]    = {OPT_NONE, OPT_NONE};
+    end               = MAX(end, i + 1);
+    if (inst.opcode >= NUMBER_OF_OPCODES)
+      end = OPT_NONE;
+    else if (opt_is_jump(inst.opcode))
+      next[0] = inst.operand.as_word;
+    if (inst.opcode != OP_JUMP_ABS && inst.opcode != OP_HALT &&
+        inst.opcode != OP_RET)
+      next[1] = i + 1;
+    for (size_t j = 0; j < ARR_SIZE(next) && end != OPT_NONE; ++j)
+    {
+      if (next[j] == OPT_NONE || (next[j] < limit && reached[next[j]]))
+        continue;
+      else if (next[j] < address || next[j] >= limit)
+        end = OPT_NONE;
+      else
+      {
+        reached[next[j]] = true;
+        pending[count++] = next[j];
+      }
+    }
+  }
+  for (size_t i = 0; i < count; ++i)
+    reached[pending[i]] = false;
+  // Not even unreachable calls, or their copies could be inlined again
+  for (word_t i = address; end != OPT_NONE && i < end; ++i)
+    if (program.instructions[i].opcode == OP_CALL)
+      end = OPT_NONE;
+  return end;
+}
+
+static word_t opt_relocate(word_t address, const word_t *relocated,
+                           word_t count, word_t new_count)
+{
+  return address < count ? relocated[address] : new_count;
+}
+
+/* Copy the program into instructions, inlining every call with an
+   end in ends. */
+static void opt_copy_inlined(prog_t program, const word_t *ends,
+                             const word_t *relocated, inst_t *instructions,
+                             word_t new_count)
+{
+  for (word_t i = 0; i < program.count; ++i)
+  {
+    inst_t inst = program.instructions[i];
+    if (inst.opcode != OP_CALL || inst.operand.as_word >= program.count ||
+        ends[inst.operand.as_word] == OPT_NONE)
+    {
+      if (opt_is_jump(inst.opcode))
+        inst.operand = DWORD(opt_relocate(inst.operand.as_word, relocated,
+                                          program.count, new_count));
+      instructions[relocated[i]] = inst;
+      continue;
+    }
+    const word_t x = inst.operand.as_word, end = ends[x];
+    for (word_t j = x; j < end; ++j)
+    {
+      inst_t copy = program.instructions[j];
+      if (copy.opcode == OP_RET)
+        copy = (inst_t){OP_JUMP_ABS,
+                        DWORD(opt_relocate(i + 1, relocated, program.count,
+                                           new_count))};
+      else if (opt_is_jump(copy.opcode))
+      {
+        const word_t target = copy.operand.as_word;
+        copy.operand =
+            DWORD(target >= x && target < end
+                      ? relocated[i] + (target - x)
+                      : opt_relocate(target, relocated, program.count,
+                                     new_count));
+      }
+      instructions[relocated[i] + (j - x)] = copy;
+    }
+  }
+}
+
+/* Inline calls to leaf subroutines, adding the number inlined to
+   inlined.  Returns false if memory couldn't be allocated. */
+static bool opt_inline(prog_t *program, bool *reached, word_t *pending,
+                       size_t *inlined)
+{
+  // ends[x] is 0 until the subroutine at x has been looked at
+  word_t *ends      = calloc(program->count, sizeof(*ends));
+  word_t *relocated = calloc(program->count + 1, sizeof(*relocated));
+  if (!ends || !relocated)
+  {
+    free(ends);
+    free(relocated);
+    return false;
+  }
+  memset(reached, 0, program->count * sizeof(*reached));
+
+  word_t new_count = 0;
+  size_t calls     = 0;
+  for (word_t i = 0; i < program->count; ++i)
+  {
+    const inst_t inst = program->instructions[i];
+    relocated[i]      = new_count++;
+    if (inst.opcode != OP_CALL || inst.operand.as_word >= program->count)
+      continue;
+    const word_t x = inst.operand.as_word;
+    if (ends[x] == 0)
+      ends[x] = opt_subroutine(*program, x, reached, pending);
+    if (ends[x] != OPT_NONE)
+    {
+      new_count += ends[x] - x - 1;
+      ++calls;
+    }
+  }
+  relocated[program->count] = new_count;
+
+  inst_t *instructions =
+      calls > 0 ? calloc(new_count, sizeof(*instructions)) : NULL;
+  if (instructions)
+  {
+    opt_copy_inlined(*program, ends, relocated, instructions, new_count);
+    program->start_address = opt_relocate(program->start_address, relocated,
+                                          program->count, new_count);
+    free(program->instructions);
+    program->instructions = instructions;
+    program->count        = new_count;
+    *inlined += calls;
+  }
+  free(ends);
+  free(relocated);
+  return calls == 0 || instructions;
+}
+
+static size_t opt_unreachable(prog_t program, bool *reached, word_t *pending)
+{
+  memset(reached, 0, program.count * sizeof(*reached));
+  size_t pending_count = 0;
+  if (program.start_address < program.count)
+  {
+    reached[program.start_address] = true;
+    pending[pending_count++]       = program.start_address;
+  }
+  while (pending_count > 0)
+  {
+    const word_t i    = pending[--pending_count];
+    const inst_t inst = program.instructions[i];
+    word_t next[2]    = {OPT_NONE, OPT_NONE};
+    if (opt_is_jump(inst.opcode))
+      next[0] = inst.operand.as_word;
+    if (inst.opcode != OP_JUMP_ABS && inst.opcode != OP_HALT &&
+        inst.opcode != OP_RET && inst.opcode < NUMBER_OF_OPCODES)
+      next[1] = i + 1;
+    for (size_t j = 0; j < ARR_SIZE(next); ++j)
+      if (next[j] < program.count && !reached[next[j]])
+      {
+        reached[next[j]]         = true;
+        pending[pending_count++] = next[j];
+      }
+  }
+
+  size_t removed = 0;
+  for (word_t i = 0; i < program.count; ++i)
+    if (!reached[i] && program.instructions[i].opcode != OP_NOOP)
+    {
+      program.instructions[i] = INST_NOOP;
+      ++removed;
+    }
+  return removed;
+}
+
+/* Remove every NOOP, relocating addresses to the instruction that
+   followed them.  An address relocated past the last instruction,
+   which jumping or returning to would fail, gets a HALT to land on
+   instead. */
+static size_t opt_strip(prog_t *program, word_t *relocated)
+{
+  word_t kept = 0;
+  for (word_t i = 0; i < program->count; ++i)
+  {
+    relocated[i] = kept;
+    if (program->instructions[i].opcode != OP_NOOP)
+      ++kept;
+  }
+  relocated[program->count] = kept;
+  if (kept == program->count)
+    return 0;
+
+  bool halt = program->start_address < program->count &&
+              relocated[program->start_address] == kept;
+  for (word_t i = 0; i < program->count; ++i)
+  {
+    const inst_t inst = program->instructions[i];
+    if (inst.opcode != OP_NOOP && opt_is_jump(inst.opcode) &&
+        inst.operand.as_word < program->count &&
+        relocated[inst.operand.as_word] == kept)
+      halt = true;
+    // Returning past the end fails too
+    else if (inst.opcode == OP_CALL && i + 1 < program->count &&
+             relocated[i + 1] == kept)
+      halt = true;
+  }
+  const word_t count = kept + halt;
+
+  for (word_t i = 0; i < program->count; ++i)
+  {
+    inst_t inst = program->instructions[i];
+    if (inst.opcode == OP_NOOP)
+      continue;
+    else if (opt_is_jump(inst.opcode))
+      inst.operand = DWORD(inst.operand.as_word < program->count
+                               ? relocated[inst.operand.as_word]
+                               : count);
+    program->instructions[relocated[i]] = inst;
+  }
+  if (halt)
+    program->instructions[kept] = INST_HALT;
+
+  program->start_address = program->start_address < program->count
+                               ? relocated[program->start_address]
+                               : count;
+  const size_t stripped = program->count - kept;
+  program->count        = count;
+  return stripped;
+}
+
+static size_t opt_changes(const opt_stats_t *stats)
+{
+  return stats->folded + stats->threaded + stats->registers +
+         stats->tails + stats->inlined + stats->unreachable +
+         stats->stripped;
+}
+
+bool opt_program(prog_t *program, unsigned passes, opt_stats_t *stats)
+{
+  opt_stats_t local = {0};
+  if (!stats)
+    stats = &local;
+  bool *marks     = NULL;
+  word_t *words   = NULL;
+  word_t capacity = 0;
+  bool changed = true, ok = true;
+  while (changed && ok)
+  {
+    // Only inlining grows the program, so this is usually done once
+    if (capacity < program->count + 1)
+    {
+      capacity  = program->count + 1;
+      bool *m   = realloc(marks, capacity * sizeof(*marks));
+      word_t *w = realloc(words, capacity * sizeof(*words));
+      marks     = m ? m : marks;
+      words     = w ? w : words;
+      ok        = m && w;
+      if (!ok)
+        break;
+    }
+
+    const size_t before = opt_changes(stats);
+    opt_leaders(*program, marks);
+    if (passes & OPT_FOLD)
+      stats->folded += opt_fold(*program, marks);
+    if (passes & OPT_REGISTERS)
+      stats->registers += opt_registers(*program, marks);
+    if (passes & OPT_THREAD)
+      stats->threaded += opt_thread(*program);
+    if (passes & OPT_TAIL)
+      stats->tails += opt_tail(*program);
+    if (passes & OPT_UNREACHABLE)
+      stats->unreachable += opt_unreachable(*program, marks, words);
+    if (passes & OPT_STRIP)
+      stats->stripped += opt_strip(program, words);
+    // Only inline once the other passes are done with the program
+    if (opt_changes(stats) == before && (passes & OPT_INLINE))
+      ok = opt_inline(program, marks, words, &stats->inlined);
+    ++stats->rounds;
+    changed = opt_changes(stats) != before;
+  }
+  free(marks);
+  free(words);
+  return ok;
+}
+
+/* Block layout
+
+   Chains are grown from seeds: the entry block first, then the other
+   blocks from hottest to coldest, ties (and so all the cold blocks)
+   in order of address.  A chain carries on to the hotter of the
+   unplaced successors of its last block, preferring the fallthrough
+   as the original layout did, but not from a hot block into a cold
+   one, which keeps cold code out of hot chains.  A CALL always
+   carries on to its return site: the callee is shared between every
+   caller, while the return site is only reached from here. */
+
+struct OptSeed
+{
+  word_t count;
+  size_t block;
+};
+
+static int opt_seed_compare(const void *a, const void *b)
+{
+  const struct OptSeed *x = a, *y = b;
+  if (x->count != y->count)
+    return x->count > y->count ? -1 : 1;
+  return (x->block > y->block) - (x->block < y->block);
+}
+
+static size_t opt_layout_next(prog_t program, const cfg_t *cfg,
+                              const word_t *counts, const bool *placed,
+                              size_t block)
+{
+  const cfg_block_t *b = cfg->blocks + block;
+  size_t next          = CFG_NONE;
+  for (size_t i = 0; i < ARR_SIZE(b->successors); ++i)
+  {
+    const size_t successor = b->successors[i];
+    if (successor != CFG_NONE && !placed[successor] &&
+        (next == CFG_NONE || counts[successor] > counts[next]))
+      next = successor;
+    if (program.instructions[b->end - 1].opcode == OP_CALL)
+      break;
+  }
+  if (next != CFG_NONE && counts[block] > 0 && counts[next] == 0)
+    return CFG_NONE;
+  return next;
+}
+
+/* Change to the size of a block laid out before next: -1 if it ends in
+   a JUMP_ABS to next, which is removed, and 1 if it falls through to
+   anything else, which needs a JUMP_ABS (or a HALT if it ran off the
+   end of the program). */
+static int opt_layout_end(prog_t program, const cfg_block_t *block,
+                          size_t next)
+{
+  const opcode_t last = program.instructions[block->end - 1].opcode;
+  if (last == OP_JUMP_ABS)
+    return next != CFG_NONE && block->successors[CFG_TARGET] == next ? -1 : 0;
+  else if (last == OP_RET || last == OP_HALT)
+    return 0;
+  return block->successors[CFG_FALLTHROUGH] != next;
+}
+
+/* Blocks of cfg in the order they should be laid out. */
+static bool opt_layout_order(prog_t program, const cfg_t *cfg,
+                             const word_t *counts, size_t *order)
+{
+  struct OptSeed *seeds = malloc(cfg->count * sizeof(*seeds));
+  bool *placed          = calloc(cfg->count, sizeof(*placed));
+  if (!seeds || !placed)
+  {
+    free(seeds);
+    free(placed);
+    return false;
+  }
+  for (size_t i = 0; i < cfg->count; ++i)
+    seeds[i] = (struct OptSeed){counts[i], i};
+  qsort(seeds, cfg->count, sizeof(*seeds), opt_seed_compare);
+
+  size_t placed_count = 0;
+  for (size_t i = 0; i <= cfg->count; ++i)
+  {
+    // The entry is the first seed, before any from seeds
+    size_t block = i == 0 ? cfg->entry : seeds[i - 1].block;
+    while (block != CFG_NONE && !placed[block])
+    {
+      placed[block]           = true;
+      order[placed_count++]   = block;
+      block = opt_layout_next(program, cfg, counts, placed, block);
+    }
+  }
+  free(seeds);
+  free(placed);
+  return true;
+}
+
+bool opt_layout(prog_t *program, const cfg_t *cfg, const word_t *counts)
+{
+  if (cfg->count == 0)
+    return true;
+  size_t *order     = malloc(cfg->count * sizeof(*order));
+  word_t *relocated = malloc(cfg->count * sizeof(*relocated));
+  if (!order || !relocated ||
+      !opt_layout_order(*program, cfg, counts, order))
+  {
+    free(order);
+    free(relocated);
+    return false;
+  }
+
+  // relocated is by block, as every jump and call targets a leader
+  word_t new_count = 0;
+  for (size_t i = 0; i < cfg->count; ++i)
+  {
+    const cfg_block_t *b = cfg->blocks + order[i];
+    const size_t next    = i + 1 < cfg->count ? order[i + 1] : CFG_NONE;
+    relocated[order[i]]  = new_count;
+    new_count += b->end - b->start + opt_layout_end(*program, b, next);
+  }
+
+  inst_t *instructions = calloc(MAX(new_count, 1), sizeof(*instructions));
+  if (!instructions)
+  {
+    free(order);
+    free(relocated);
+    return false;
+  }
+  for (size_t i = 0; i < cfg->count; ++i)
+  {
+    const cfg_block_t *b = cfg->blocks + order[i];
+    const size_t next    = i + 1 < cfg->count ? order[i + 1] : CFG_NONE;
+    word_t j             = relocated[order[i]];
+    for (word_t k = b->start; k < b->end; ++k)
+    {
+      inst_t inst = program->instructions[k];
+      if (opt_is_jump(inst.opcode))
+        inst.operand = DWORD(
+            inst.operand.as_word < program->count
+                ? relocated[cfg->block_of[inst.operand.as_word]]
+                : new_count);
+      instructions[j++] = inst;
+    }
+    const int end = opt_layout_end(*program, b, next);
+    if (end < 0)
+      --j;
+    else if (end > 0)
+      instructions[j] =
+          b->successors[CFG_FALLTHROUGH] == CFG_NONE
+              ? INST_HALT
+              : (inst_t){OP_JUMP_ABS,
+                         DWORD(relocated[b->successors[CFG_FALLTHROUGH]])};
+  }
+
+  program->start_address = program->start_address < program->count
+                               ? relocated[cfg->entry]
+                               : new_count;
+  free(program->instructions);
+  program->instructions = instructions;
+  program->count        = new_count;
+  free(order);
+  free(relocated);
+  return true;
+}
@@ -0,0 +1,111 @@
+/* Copyright (C) 2026 Aryadev Chavali
+
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License Version 2 for
+ * more details.
+
+ * You should have received a copy of the GNU General Public License Version 2
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+ * Created: 2026-10-16
+ * Author: Aryadev Chavali
+ * Description: Optimisation passes over programs
+ */
+
+#ifndef OPT_H
+#define OPT_H
+
+#include <stdbool.h>
+
+#include <lib/cfg.h>
+#include <lib/inst.h>
+
+typedef enum
+{
+  // PUSHes followed by an operation on them, and constant JUMP_IFs
+  OPT_FOLD = 1 << 0,
+  // Jumps and calls to jumps, and jumps to the next instruction
+  OPT_THREAD = 1 << 1,
+  // PUSH_REGISTER followed by a MOV back into the same register
+  OPT_REGISTERS = 1 << 2,
+  // Instructions no path from the start address reaches
+  OPT_UNREACHABLE = 1 << 3,
+  // NOOPs, including those left by other passes
+  OPT_STRIP = 1 << 4,
+  // CALL followed by RET, which becomes a JUMP_ABS
+  OPT_TAIL = 1 << 5,
+  // Calls to small subroutines which make no calls themselves
+  OPT_INLINE = 1 << 6,
+
+  OPT_ALL = (1 << 7) - 1,
+} opt_pass_t;
+
+/**
+   @brief Number of changes made by each pass.
+
+   @prop[folded] Sequences folded into one PUSH or jump
+   @prop[threaded] Jumps and calls retargeted or removed
+   @prop[registers] PUSH_REGISTER, MOV pairs removed
+   @prop[tails] Tail calls made jumps
+   @prop[inlined] Calls inlined
+   @prop[unreachable] Unreachable instructions removed
+   @prop[stripped] Instructions removed from the program by OPT_STRIP
+   @prop[rounds] Number of times the passes were run
+ */
+typedef struct
+{
+  size_t folded, threaded, registers, tails, inlined, unreachable, stripped;
+  size_t rounds;
+} opt_stats_t;
+
+/**
+   @brief Optimise a program in place.
+
+   @details The passes are run until they make no more changes.  Every
+   pass but OPT_STRIP and OPT_INLINE replaces the instructions it
+   removes with NOOPs, so addresses only change when those run, at
+   which point the operands of jumps and calls and the start address
+   are relocated.  OPT_INLINE may grow the program, replacing its
+   instructions with a new allocation, so they must have been
+   allocated with malloc when it's run.
+
+   Executions of the optimised program which don't fail do the same
+   as those of the original, except for program addresses and the
+   call stack.  Executions which fail may fail at another instruction
+   or, for stack overflow, call stack overflow and invalid registers,
+   not at all.
+
+   @param[program] Program to optimise
+   @param[passes] Passes to run, as a set of opt_pass_t
+   @param[stats] If not NULL, incremented with the changes made
+   @return False if memory for the passes couldn't be allocated, in
+   which case the program may only be partly optimised
+ */
+bool opt_program(prog_t *program, unsigned passes, opt_stats_t *stats);
+
+/**
+   @brief Reorder the blocks of a program by a profile of its
+   execution.
+
+   @details Hot blocks are laid out in chains following their hottest
+   successor, so the paths most taken fall through from one block to
+   the next, and blocks never entered are moved to the end in their
+   original order.  A block whose fallthrough no longer follows it
+   gets a JUMP_ABS to it (for a CALL, where the RET lands), and a
+   JUMP_ABS to the block following it is removed.  Every operand of a
+   jump or call and the start address are relocated.
+
+   Run it before opt_program, whose OPT_THREAD then cleans up after
+   it.  The instructions are replaced with a new allocation, so they
+   must have been allocated with malloc.
+
+   @param[program] Program to lay out
+   @param[cfg] Graph of program, from cfg_build
+   @param[counts] Entries into each block of cfg, from a profile
+   @return False if memory for the layout couldn't be allocated, in
+   which case the program is unchanged
+ */
+bool opt_layout(prog_t *program, const cfg_t *cfg, const word_t *counts);
+
+#endif
@@ -0,0 +1,275 @@
+/* Copyright (C) 2026 Aryadev Chavali
+
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License Version 2 for
+ * more details.
+
+ * You should have received a copy of the GNU General Public License Version 2
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+ * Created: 2026-10-16
+ * Author: Aryadev Chavali
+ * Description: Purity analysis of subroutines
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <lib/pure.h>
+
+/* Analysis
+
+   Each CALL target is walked from its entry, giving every instruction
+   reached the depth of the stack before it relative to the depth at
+   the call, and the bytes of the registers written to on every path
+   there.  Nothing below the least depth read is touched, so that's
+   the arguments, and the depth at RET less it is the results.  Bytes
+   of registers read before they've been written to on every path are
+   what the subroutine reads of them.
+
+   A CALL is only walked past once its target has been found to
+   return, taking on the target's summary.  Summaries only ever go from
+   not returning to returning, read or write more, always write less
+   or become impure, so the walks are repeated until none of them
+   change.
+*/
+
+static_assert(PURE_MAX_REGISTERS == WORD_SIZE * 8,
+              "pure: A byte of registers for each bit of a word");
+
+/* What's known of a subroutine so far.  low is the least depth read,
+   and depth the depth it returns at.  reads and writes are the bytes
+   of registers it may read or write, and written those it always
+   writes. */
+struct PureSummary
+{
+  bool impure, returns;
+  sword_t low, depth;
+  word_t reads, writes, written;
+};
+
+/* State before an instruction, see Analysis. */
+struct PureState
+{
+  bool reached, queued;
+  sword_t depth;
+  word_t written;
+};
+
+struct Pure
+{
+  prog_t program;
+  struct PureSummary *summaries;
+  struct PureState *states;
+  word_t *work;
+};
+
+static bool pure_same(const struct PureSummary *a, const struct PureSummary *b)
+{
+  return a->impure == b->impure && a->returns == b->returns &&
+         a->low == b->low && a->depth == b->depth && a->reads == b->reads &&
+         a->writes == b->writes && a->written == b->written;
+}
+
+/* Bits of the size bytes of register reg, or 0 if they're past
+   PURE_MAX_REGISTERS. */
+static word_t pure_register(word_t reg, word_t size)
+{
+  if (reg >= PURE_MAX_REGISTERS || (reg + 1) * size > PURE_MAX_REGISTERS)
+    return 0;
+  return ((1UL << size) - 1) << (reg * size);
+}
+
+/* Walk the subroutine at entry, setting its RETs in pure if it isn't
+   NULL. */
+static struct PureSummary pure_walk(struct Pure *p, word_t entry,
+                                    pure_t *pure)
+{
+  static_assert(NUMBER_OF_OPCODES == 115, "pure_walk: Out of date");
+  const prog_t program   = p->program;
+  struct PureState *states = p->states;
+  struct PureSummary s   = {0};
+  memset(states, 0, program.count * sizeof(*states));
+  size_t work_size     = 0;
+  states[entry]        = (struct PureState){true, true, 0, 0};
+  p->work[work_size++] = entry;
+  while (work_size > 0 && !s.impure)
+  {
+    const word_t address  = p->work[--work_size];
+    const inst_t inst     = program.instructions[address];
+    const opcode_t opcode = inst.opcode;
+    const word_t operand  = inst.operand.as_word;
+    states[address].queued = false;
+    const sword_t before   = states[address].depth;
+    word_t written         = states[address].written;
+    // Where the instruction may go next, WORD_MAX if nowhere
+    word_t next = address + 1, target = WORD_MAX;
+    if ((word_t)opcode >= NUMBER_OF_OPCODES)
+    {
+      s.impure = true;
+      break;
+    }
+    // Operands come off the stack and the result goes on, which is all
+    // most instructions do
+    sword_t low   = before - (sword_t)opcode_info[opcode].pop;
+    sword_t depth = low + (sword_t)opcode_info[opcode].push;
+
+    if (UNSIGNED_OPCODE_IS_TYPE(opcode, OP_PUSH_REGISTER))
+    {
+      const word_t bits = pure_register(operand, opcode_info[opcode].push);
+      if (!bits)
+        s.impure = true;
+      s.reads |= bits & ~written;
+    }
+    else if (UNSIGNED_OPCODE_IS_TYPE(opcode, OP_POP) ||
+             UNSIGNED_OPCODE_IS_TYPE(opcode, OP_MOV))
+    {
+      // POP is a MOV into register 0, as in vm_execute
+      const bool pop    = UNSIGNED_OPCODE_IS_TYPE(opcode, OP_POP);
+      const word_t bits = pure_register(pop ? 0 : operand,
+                                        opcode_info[opcode].pop);
+      if (!bits)
+        s.impure = true;
+      s.writes |= bits;
+      written  |= bits;
+    }
+    else if (UNSIGNED_OPCODE_IS_TYPE(opcode, OP_DUP))
+    {
+      const word_t size = opcode_info[opcode].push;
+      if (operand >= PURE_MAX_ARGS)
+        s.impure = true;
+      else
+        low = before - (sword_t)(size * (operand + 1));
+    }
+    else if (UNSIGNED_OPCODE_IS_TYPE(opcode, OP_JUMP_IF))
+      target = operand;
+    else if (opcode == OP_JUMP_ABS)
+    {
+      next   = WORD_MAX;
+      target = operand;
+    }
+    else if (opcode == OP_CALL)
+    {
+      const struct PureSummary callee =
+          operand < program.count ? p->summaries[operand]
+                                  : (struct PureSummary){.impure = true};
+      if (callee.impure)
+        s.impure = true;
+      // Nothing after the call is reached until the callee returns
+      else if (!callee.returns)
+        next = WORD_MAX;
+      else
+      {
+        low       = depth + callee.low;
+        depth    += callee.depth;
+        s.reads  |= callee.reads & ~written;
+        s.writes |= callee.writes;
+        written  |= callee.written;
+      }
+    }
+    else if (opcode == OP_RET)
+    {
+      next = WORD_MAX;
+      if (s.returns && s.depth != depth)
+        s.impure = true;
+      s.written = s.returns ? s.written & written : written;
+      s.returns = true;
+      s.depth   = depth;
+      if (pure)
+        pure[address].pure = true;
+    }
+    else if (opcode == OP_HALT || opcode == OP_MDELETE || opcode == OP_MSIZE ||
+             UNSIGNED_OPCODE_IS_TYPE(opcode, OP_MALLOC) ||
+             UNSIGNED_OPCODE_IS_TYPE(opcode, OP_MSET) ||
+             UNSIGNED_OPCODE_IS_TYPE(opcode, OP_MGET) ||
+             SIGNED_OPCODE_IS_TYPE(opcode, OP_PRINT))
+      // The heap, printing or halting
+      s.impure = true;
+
+    s.low = MIN(s.low, low);
+    if (s.low < -PURE_MAX_ARGS)
+      s.impure = true;
+
+    const word_t successors[] = {next, target};
+    for (size_t i = 0; i < ARR_SIZE(successors) && !s.impure; ++i)
+    {
+      const word_t successor = successors[i];
+      if (successor == WORD_MAX)
+        continue;
+      // Running off the end of the program halts it
+      else if (successor >= program.count ||
+               (states[successor].reached && states[successor].depth != depth))
+      {
+        s.impure = true;
+        continue;
+      }
+      struct PureState *state = states + successor;
+      const word_t joined     = state->reached ? state->written & written
+                                               : written;
+      if (state->reached && state->written == joined)
+        continue;
+      if (!state->queued)
+        p->work[work_size++] = successor;
+      *state = (struct PureState){true, true, depth, joined};
+    }
+  }
+  if (s.returns && s.depth - s.low > PURE_MAX_RESULTS)
+    s.impure = true;
+  return s;
+}
+
+bool pure_analyse(prog_t program, pure_t *pure)
+{
+  const size_t count = MAX(program.count, 1);
+  struct Pure p      = {program, calloc(count, sizeof(*p.summaries)),
+                        malloc(count * sizeof(*p.states)),
+                        malloc(count * sizeof(*p.work))};
+  bool *targets      = calloc(count, sizeof(*targets));
+  if (!p.summaries || !p.states || !p.work || !targets)
+  {
+    free(p.summaries);
+    free(p.states);
+    free(p.work);
+    free(targets);
+    return false;
+  }
+
+  for (word_t i = 0; i < program.count; ++i)
+    if (program.instructions[i].opcode == OP_CALL &&
+        program.instructions[i].operand.as_word < program.count)
+      targets[program.instructions[i].operand.as_word] = true;
+
+  for (bool changed = true; changed;)
+  {
+    changed = false;
+    for (word_t i = 0; i < program.count; ++i)
+    {
+      if (!targets[i] || p.summaries[i].impure)
+        continue;
+      const struct PureSummary s = pure_walk(&p, i, NULL);
+      changed                    = changed || !pure_same(&s, p.summaries + i);
+      p.summaries[i]             = s;
+    }
+  }
+
+  memset(pure, 0, program.count * sizeof(*pure));
+  for (word_t i = 0; i < program.count; ++i)
+  {
+    const struct PureSummary s = p.summaries[i];
+    if (!targets[i] || s.impure || !s.returns)
+      continue;
+    // Once more to set the RETs, now that every summary is known
+    pure_walk(&p, i, pure);
+    // Bytes which may be left as they were are part of the result
+    pure[i] = (pure_t){true, (word_t)-s.low, (word_t)(s.depth - s.low),
+                       s.reads | (s.writes & ~s.written), s.writes};
+  }
+
+  free(p.summaries);
+  free(p.states);
+  free(p.work);
+  free(targets);
+  return true;
+}
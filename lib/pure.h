@@ -0,0 +1,80 @@
+/* Copyright (C) 2026 Aryadev Chavali
+
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License Version 2 for
+ * more details.
+
+ * You should have received a copy of the GNU General Public License Version 2
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+ * Created: 2026-10-16
+ * Author: Aryadev Chavali
+ * Description: Purity analysis of subroutines
+ */
+
+#ifndef PURE_H
+#define PURE_H
+
+#include <stdbool.h>
+
+#include <lib/inst.h>
+
+/* Most bytes a pure subroutine may read from below the stack it's
+   called with and leave in place of its arguments.  Anything using
+   more isn't pure. */
+#define PURE_MAX_ARGS    64
+#define PURE_MAX_RESULTS 64
+
+/* Registers a pure subroutine may use are within this many bytes of
+   the start, one bit of a word_t for each. */
+#define PURE_MAX_REGISTERS 64
+
+/**
+   @brief Summary of a subroutine found pure by pure_analyse.
+
+   @details A call to it reads args bytes from the top of the stack
+   and the bytes of registers set in registers, then replaces those
+   args bytes on the stack with results bytes and writes to the bytes
+   of registers set in writes.  Nothing else about the vm changes, so
+   two calls reading the same bytes leave the same results.
+
+   Bit n of registers or writes is byte n of the registers.  Bytes a
+   call may leave as they were, rather than always writing to, are
+   counted as read.
+
+   @prop[pure] Set for the entry of a pure subroutine, and for every
+   RET returning from one
+   @prop[args] Bytes read from the stack
+   @prop[results] Bytes left in place of the arguments
+   @prop[registers] Bytes read from the registers
+   @prop[writes] Bytes written to the registers
+ */
+typedef struct
+{
+  bool pure;
+  word_t args, results;
+  word_t registers, writes;
+} pure_t;
+
+/**
+   @brief Find the subroutines whose calls only depend on the stack and
+   registers they read.
+
+   @details Every CALL target is run through with the depth of the
+   stack relative to the call, and is pure if every instruction
+   reachable from it is one of PUSH, POP, PUSH_REGISTER, MOV, DUP,
+   NOT, the arithmetic and comparisons, JUMP_ABS, JUMP_IF, NOOP, RET or
+   a CALL of a pure subroutine, each reached at one depth, and it
+   returns at one depth.  Targets are assumed pure, and those they call
+   to return only once they've been shown to, so recursive subroutines
+   may be pure too.
+
+   @param[program] Program to analyse
+   @param[pure] Set for each entry and RET as above, by address
+   @return False if memory for the analysis couldn't be allocated, in
+   which case nothing is set
+ */
+bool pure_analyse(prog_t program, pure_t *pure);
+
+#endif
@@ -0,0 +1,645 @@
+/* Copyright (C) 2026 Aryadev Chavali
+
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License Version 2 for
+ * more details.
+
+ * You should have received a copy of the GNU General Public License Version 2
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+ * Created: 2026-10-16
+ * Author: Aryadev Chavali
+ * Description: Range analysis of indices into heap pages
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <lib/cfg.h>
+#include <lib/range.h>
+
+/* Analysis
+
+   Ranges are propagated over the blocks of the control flow graph
+   from the start address and the target of every CALL, each of which
+   starts with nothing known: the stack below what's tracked, and
+   every register, could hold anything.  After a CALL nothing is known
+   either, as the callee may do anything to the stack and registers.
+
+   Facts relating a datum to a register (that it was pushed from it,
+   or is the size of or below the size of its page) only hold until
+   the register is written to, when they're forgotten.
+*/
+
+#define RANGE_NONE ((size_t)-1)
+
+static const word_t sizes[] = {BYTE_SIZE, SHORT_SIZE, HWORD_SIZE, WORD_SIZE};
+
+/* Largest datum of size bytes */
+static word_t range_max(word_t size)
+{
+  return size >= WORD_SIZE ? WORD_MAX : ((word_t)1 << (size * 8)) - 1;
+}
+
+/* An operand of a comparison, with the registers of its datum */
+struct RangeOperand
+{
+  word_t lo, hi;
+  size_t reg, size_of;
+};
+
+struct RangeValue
+{
+  word_t lo, hi;
+  // Least size in bytes of the page this points to, 0 if unknown
+  word_t page;
+  // Registers this was pushed from, whose page this is the size of,
+  // and whose page this is below the size of
+  size_t origin, size_of, below;
+  // Comparison of two words this is the result of, OP_NOOP if none.
+  // Always one of OP_EQ_WORD, OP_LT_WORD, OP_LTE_WORD, OP_GT_WORD or
+  // OP_GTE_WORD.
+  opcode_t compare;
+  struct RangeOperand left, right;
+};
+
+struct RangeEntry
+{
+  word_t size;
+  struct RangeValue value;
+};
+
+/* State before an instruction.  stack[depth - 1] is the top of the
+   stack. */
+struct RangeState
+{
+  bool reached;
+  size_t depth, changes;
+  struct RangeEntry stack[RANGE_DEPTH];
+  struct RangeValue registers[RANGE_REGISTERS];
+};
+
+struct Range
+{
+  prog_t program;
+  // If not NULL, where MGETs and MSETs in bounds are set
+  bool *in_bounds;
+};
+
+static struct RangeValue range_of(word_t lo, word_t hi)
+{
+  const struct RangeOperand none = {.reg = RANGE_NONE, .size_of = RANGE_NONE};
+  return (struct RangeValue){.lo      = lo,
+                             .hi      = hi,
+                             .origin  = RANGE_NONE,
+                             .size_of = RANGE_NONE,
+                             .below   = RANGE_NONE,
+                             .compare = OP_NOOP,
+                             .left    = none,
+                             .right   = none};
+}
+
+static struct RangeValue range_any(word_t size)
+{
+  return range_of(0, range_max(size));
+}
+
+static struct RangeState range_start(void)
+{
+  struct RangeState state = {.reached = true};
+  for (size_t i = 0; i < RANGE_REGISTERS; ++i)
+    state.registers[i] = range_any(WORD_SIZE);
+  return state;
+}
+
+static void range_push(struct RangeState *state, word_t size,
+                       struct RangeValue value)
+{
+  if (state->depth == RANGE_DEPTH)
+  {
+    memmove(state->stack, state->stack + 1,
+            (RANGE_DEPTH - 1) * sizeof(*state->stack));
+    --state->depth;
+  }
+  state->stack[state->depth++] = (struct RangeEntry){size, value};
+}
+
+/* Pop a datum of size bytes.  Popping part of an entry, or more than
+   one, gives any datum. */
+static struct RangeValue range_pop(struct RangeState *state, word_t size)
+{
+  const word_t requested = size;
+  if (state->depth == 0)
+    return range_any(requested);
+  struct RangeEntry *top = state->stack + state->depth - 1;
+  if (top->size == size)
+  {
+    --state->depth;
+    return top->value;
+  }
+  while (size > 0 && state->depth > 0)
+  {
+    top = state->stack + state->depth - 1;
+    if (top->size > size)
+    {
+      *top = (struct RangeEntry){top->size - size,
+                                 range_any(top->size - size)};
+      break;
+    }
+    size -= top->size;
+    --state->depth;
+  }
+  return range_any(requested);
+}
+
+/* Forget every fact about reg in value. */
+static void range_forget_value(struct RangeValue *value, size_t reg)
+{
+  if (value->origin == reg)
+    value->origin = RANGE_NONE;
+  if (value->size_of == reg)
+    value->size_of = RANGE_NONE;
+  if (value->below == reg)
+    value->below = RANGE_NONE;
+  if (value->left.reg == reg || value->left.size_of == reg ||
+      value->right.reg == reg || value->right.size_of == reg)
+    value->compare = OP_NOOP;
+}
+
+static void range_set_register(struct RangeState *state, size_t reg,
+                               struct RangeValue value)
+{
+  state->registers[reg] = value;
+  for (size_t i = 0; i < state->depth; ++i)
+    range_forget_value(&state->stack[i].value, reg);
+  for (size_t i = 0; i < RANGE_REGISTERS; ++i)
+    range_forget_value(state->registers + i, reg);
+}
+
+/* Word register holding the bytes of reg for data of size bytes, or
+   RANGE_REGISTERS if it isn't tracked. */
+static size_t range_register(word_t size, word_t reg)
+{
+  if (reg >= WORD_SIZE * RANGE_REGISTERS)
+    return RANGE_REGISTERS;
+  return MIN((reg * size) / WORD_SIZE, RANGE_REGISTERS);
+}
+
+static void range_mov(struct RangeState *state, word_t size, word_t reg)
+{
+  struct RangeValue value = range_pop(state, size);
+  const size_t word       = range_register(size, reg);
+  if (word == RANGE_REGISTERS)
+    return;
+  else if (size != WORD_SIZE)
+    value = range_any(WORD_SIZE);
+  value.origin  = RANGE_NONE;
+  value.compare = OP_NOOP;
+  range_set_register(state, word, value);
+}
+
+static void range_push_register(struct RangeState *state, word_t size,
+                                word_t reg)
+{
+  const size_t word = range_register(size, reg);
+  if (word == RANGE_REGISTERS || size != WORD_SIZE)
+    range_push(state, size, range_any(size));
+  else
+  {
+    struct RangeValue value = state->registers[word];
+    value.origin            = word;
+    range_push(state, size, value);
+  }
+}
+
+/* The datum of size bytes whose top is offset bytes below the top of
+   the stack, as DUP copies. */
+static struct RangeValue range_dup(const struct RangeState *state,
+                                   word_t size, word_t offset)
+{
+  word_t top = 0;
+  for (size_t i = state->depth; i > 0 && top <= offset; --i)
+  {
+    const struct RangeEntry entry = state->stack[i - 1];
+    if (top == offset && entry.size == size)
+      return entry.value;
+    top += entry.size;
+  }
+  return range_any(size);
+}
+
+static struct RangeOperand range_operand(struct RangeValue value)
+{
+  return (struct RangeOperand){value.lo, value.hi, value.origin,
+                               value.size_of};
+}
+
+/* Comparison of b (the second from the top) against a (the top) */
+static struct RangeValue range_compare(opcode_t opcode, struct RangeValue a,
+                                       struct RangeValue b)
+{
+  struct RangeValue result = range_of(0, 1);
+  // Signed words compare as unsigned ones when neither is negative
+  const bool unsigned_words = a.hi <= LONG_MAX && b.hi <= LONG_MAX;
+  if (opcode == OP_EQ_WORD || opcode == OP_LT_WORD || opcode == OP_LTE_WORD ||
+      opcode == OP_GT_WORD || opcode == OP_GTE_WORD)
+    result.compare = opcode;
+  else if (opcode == OP_LT_SWORD && unsigned_words)
+    result.compare = OP_LT_WORD;
+  else if (opcode == OP_LTE_SWORD && unsigned_words)
+    result.compare = OP_LTE_WORD;
+  else if (opcode == OP_GT_SWORD && unsigned_words)
+    result.compare = OP_GT_WORD;
+  else if (opcode == OP_GTE_SWORD && unsigned_words)
+    result.compare = OP_GTE_WORD;
+  result.left  = range_operand(b);
+  result.right = range_operand(a);
+  return result;
+}
+
+/* a OP b for OR to MULT, where a is the top of the stack */
+static struct RangeValue range_arithmetic(opcode_t opcode, word_t size,
+                                          struct RangeValue a,
+                                          struct RangeValue b)
+{
+  const word_t max = range_max(size);
+  const word_t op  = (opcode - OP_OR_BYTE) / 4;
+  if (op == (OP_AND_BYTE - OP_OR_BYTE) / 4)
+    return range_of(0, MIN(a.hi, b.hi));
+  else if (op == (OP_PLUS_BYTE - OP_OR_BYTE) / 4 && a.hi <= max - b.hi)
+    return range_of(a.lo + b.lo, a.hi + b.hi);
+  else if (op == (OP_SUB_BYTE - OP_OR_BYTE) / 4 && a.lo >= b.hi)
+    return range_of(a.lo - b.hi, a.hi - b.lo);
+  else if (op == (OP_MULT_BYTE - OP_OR_BYTE) / 4 &&
+           (a.hi == 0 || b.hi <= max / a.hi))
+    return range_of(a.lo * b.lo, a.hi * b.hi);
+  return range_any(size);
+}
+
+static void range_access(struct Range *r, word_t address, word_t size,
+                         struct RangeValue page, struct RangeValue index)
+{
+  if (!r->in_bounds)
+    return;
+  r->in_bounds[address] = (page.page >= size && index.hi < page.page / size) ||
+                          (size == BYTE_SIZE && index.below != RANGE_NONE &&
+                           index.below == page.origin);
+}
+
+static void range_step(struct Range *r, struct RangeState *state,
+                       word_t address)
+{
+  static_assert(NUMBER_OF_OPCODES == 115, "range_step: Out of date");
+  const inst_t inst     = r->program.instructions[address];
+  const opcode_t opcode = inst.opcode;
+  const word_t operand  = inst.operand.as_word;
+  if (UNSIGNED_OPCODE_IS_TYPE(opcode, OP_PUSH))
+  {
+    const word_t size = sizes[OPCODE_DATA_TYPE(opcode, OP_PUSH)];
+    const word_t datum = operand & range_max(size);
+    range_push(state, size, range_of(datum, datum));
+  }
+  else if (UNSIGNED_OPCODE_IS_TYPE(opcode, OP_POP))
+    range_mov(state, sizes[OPCODE_DATA_TYPE(opcode, OP_POP)], 0);
+  else if (UNSIGNED_OPCODE_IS_TYPE(opcode, OP_MOV))
+    range_mov(state, sizes[OPCODE_DATA_TYPE(opcode, OP_MOV)], operand);
+  else if (UNSIGNED_OPCODE_IS_TYPE(opcode, OP_PUSH_REGISTER))
+    range_push_register(
+        state, sizes[OPCODE_DATA_TYPE(opcode, OP_PUSH_REGISTER)], operand);
+  else if (UNSIGNED_OPCODE_IS_TYPE(opcode, OP_DUP))
+  {
+    const word_t size = sizes[OPCODE_DATA_TYPE(opcode, OP_DUP)];
+    const word_t offset =
+        operand < WORD_SIZE * RANGE_DEPTH ? operand * size : WORD_MAX;
+    range_push(state, size, range_dup(state, size, offset));
+  }
+  else if (UNSIGNED_OPCODE_IS_TYPE(opcode, OP_MALLOC))
+  {
+    const word_t size             = sizes[OPCODE_DATA_TYPE(opcode, OP_MALLOC)];
+    const struct RangeValue count = range_pop(state, WORD_SIZE);
+    struct RangeValue page        = range_any(WORD_SIZE);
+    // A count of 0 gets a page of PAGE_DEFAULT_SIZE, and one too large
+    // wraps around
+    if (count.lo > 0 && count.hi <= WORD_MAX / size)
+      page.page = count.lo * size;
+    range_push(state, WORD_SIZE, page);
+  }
+  else if (UNSIGNED_OPCODE_IS_TYPE(opcode, OP_MSET))
+  {
+    const word_t size             = sizes[OPCODE_DATA_TYPE(opcode, OP_MSET)];
+    const struct RangeValue index = range_pop(state, WORD_SIZE);
+    range_pop(state, size);
+    range_access(r, address, size, range_pop(state, WORD_SIZE), index);
+  }
+  else if (UNSIGNED_OPCODE_IS_TYPE(opcode, OP_MGET))
+  {
+    const word_t size             = sizes[OPCODE_DATA_TYPE(opcode, OP_MGET)];
+    const struct RangeValue index = range_pop(state, WORD_SIZE);
+    range_access(r, address, size, range_pop(state, WORD_SIZE), index);
+    range_push(state, size, range_any(size));
+  }
+  else if (opcode == OP_MSIZE)
+  {
+    const struct RangeValue page = range_pop(state, WORD_SIZE);
+    struct RangeValue value      = range_of(page.page, WORD_MAX);
+    value.size_of                = page.origin;
+    range_push(state, WORD_SIZE, value);
+  }
+  else if (opcode == OP_MDELETE)
+    range_pop(state, WORD_SIZE);
+  else if (UNSIGNED_OPCODE_IS_TYPE(opcode, OP_NOT))
+  {
+    const word_t size = sizes[OPCODE_DATA_TYPE(opcode, OP_NOT)];
+    range_pop(state, size);
+    range_push(state, size, range_any(size));
+  }
+  else if (UNSIGNED_OPCODE_IS_TYPE(opcode, OP_EQ) ||
+           (opcode >= OP_LT_BYTE && opcode <= OP_GTE_SWORD))
+  {
+    const word_t size = UNSIGNED_OPCODE_IS_TYPE(opcode, OP_EQ)
+                            ? sizes[OPCODE_DATA_TYPE(opcode, OP_EQ)]
+                            : sizes[((opcode - OP_LT_BYTE) % 8) / 2];
+    const struct RangeValue a = range_pop(state, size);
+    const struct RangeValue b = range_pop(state, size);
+    range_push(state, BYTE_SIZE, range_compare(opcode, a, b));
+  }
+  else if (opcode >= OP_OR_BYTE && opcode <= OP_MULT_WORD)
+  {
+    const word_t size         = sizes[(opcode - OP_OR_BYTE) % 4];
+    const struct RangeValue a = range_pop(state, size);
+    const struct RangeValue b = range_pop(state, size);
+    range_push(state, size, range_arithmetic(opcode, size, a, b));
+  }
+  else if (SIGNED_OPCODE_IS_TYPE(opcode, OP_PRINT))
+    range_pop(state, sizes[OPCODE_DATA_TYPE(opcode, OP_PRINT) / 2]);
+  else if (UNSIGNED_OPCODE_IS_TYPE(opcode, OP_JUMP_IF))
+    range_pop(state, sizes[OPCODE_DATA_TYPE(opcode, OP_JUMP_IF)]);
+  else if (opcode == OP_CALL)
+    *state = range_start();
+}
+
+/* Narrow the registers of state knowing condition is truth, returning
+   false if it can't be. */
+static bool range_narrow(struct RangeState *state,
+                         const struct RangeValue *condition, bool truth)
+{
+  opcode_t opcode          = condition->compare;
+  struct RangeOperand left = condition->left, right = condition->right;
+  if (opcode == OP_NOOP || (opcode == OP_EQ_WORD && !truth))
+    return true;
+  else if (!truth)
+    opcode = opcode == OP_LT_WORD    ? OP_GTE_WORD
+             : opcode == OP_LTE_WORD ? OP_GT_WORD
+             : opcode == OP_GT_WORD  ? OP_LTE_WORD
+                                     : OP_LT_WORD;
+  // a > b is b < a
+  if (opcode == OP_GT_WORD || opcode == OP_GTE_WORD)
+  {
+    const struct RangeOperand tmp = left;
+    left                          = right;
+    right                         = tmp;
+    opcode = opcode == OP_GT_WORD ? OP_LT_WORD : OP_LTE_WORD;
+  }
+
+  size_t below = RANGE_NONE;
+  if (opcode == OP_EQ_WORD)
+  {
+    left.lo = right.lo = MAX(left.lo, right.lo);
+    left.hi = right.hi = MIN(left.hi, right.hi);
+  }
+  else if (opcode == OP_LTE_WORD)
+  {
+    left.hi  = MIN(left.hi, right.hi);
+    right.lo = MAX(right.lo, left.lo);
+  }
+  else
+  {
+    if (right.hi == 0 || left.lo == WORD_MAX)
+      return false;
+    left.hi  = MIN(left.hi, right.hi - 1);
+    right.lo = MAX(right.lo, left.lo + 1);
+    below    = right.size_of;
+  }
+  if (left.lo > left.hi || right.lo > right.hi)
+    return false;
+
+  if (left.reg != RANGE_NONE)
+  {
+    struct RangeValue *value = state->registers + left.reg;
+    value->lo                = MAX(value->lo, left.lo);
+    value->hi                = MIN(value->hi, left.hi);
+    if (below != RANGE_NONE)
+      value->below = below;
+  }
+  if (right.reg != RANGE_NONE)
+  {
+    struct RangeValue *value = state->registers + right.reg;
+    value->lo                = MAX(value->lo, right.lo);
+    value->hi                = MIN(value->hi, right.hi);
+  }
+  return true;
+}
+
+static bool range_same_operand(const struct RangeOperand *a,
+                               const struct RangeOperand *b)
+{
+  return a->lo == b->lo && a->hi == b->hi && a->reg == b->reg &&
+         a->size_of == b->size_of;
+}
+
+static bool range_same_compare(const struct RangeValue *a,
+                               const struct RangeValue *b)
+{
+  return a->compare == b->compare &&
+         (a->compare == OP_NOOP || (range_same_operand(&a->left, &b->left) &&
+                                    range_same_operand(&a->right, &b->right)));
+}
+
+static bool range_same(const struct RangeValue *a, const struct RangeValue *b)
+{
+  return a->lo == b->lo && a->hi == b->hi && a->page == b->page &&
+         a->origin == b->origin && a->size_of == b->size_of &&
+         a->below == b->below && range_same_compare(a, b);
+}
+
+/* Join value into into, widening any range still changing if widen,
+   returning whether into changed. */
+static bool range_join_value(struct RangeValue *into,
+                             const struct RangeValue *value, word_t size,
+                             bool widen)
+{
+  struct RangeValue joined = *into;
+  joined.lo                = MIN(into->lo, value->lo);
+  joined.hi                = MAX(into->hi, value->hi);
+  joined.page              = MIN(into->page, value->page);
+  if (into->origin != value->origin)
+    joined.origin = RANGE_NONE;
+  if (into->size_of != value->size_of)
+    joined.size_of = RANGE_NONE;
+  if (into->below != value->below)
+    joined.below = RANGE_NONE;
+  if (!range_same_compare(into, value))
+    joined.compare = OP_NOOP;
+  if (widen)
+  {
+    if (joined.lo < into->lo)
+      joined.lo = 0;
+    if (joined.hi > into->hi)
+      joined.hi = range_max(size);
+    if (joined.page < into->page)
+      joined.page = 0;
+  }
+  const bool changed = !range_same(into, &joined);
+  *into              = joined;
+  return changed;
+}
+
+/* Join state into the state at the start of a block, returning
+   whether it changed.  Entries are matched from the top of the stack,
+   and any which don't match are forgotten.
+
+   Every loop has an edge going back to an earlier address, so ranges
+   are only widened along those. */
+static bool range_join(struct RangeState *into, const struct RangeState *state,
+                       bool backward)
+{
+  if (!into->reached)
+  {
+    *into         = *state;
+    into->changes = 0;
+    return true;
+  }
+  const bool widen = backward && into->changes >= RANGE_WIDEN;
+  bool changed     = false;
+  size_t kept      = 0;
+  for (; kept < MIN(into->depth, state->depth); ++kept)
+  {
+    struct RangeEntry *a       = into->stack + into->depth - 1 - kept;
+    const struct RangeEntry *b = state->stack + state->depth - 1 - kept;
+    if (a->size != b->size)
+      break;
+    changed = range_join_value(&a->value, &b->value, a->size, widen) || changed;
+  }
+  if (kept < into->depth)
+  {
+    memmove(into->stack, into->stack + into->depth - kept,
+            kept * sizeof(*into->stack));
+    into->depth = kept;
+    changed     = true;
+  }
+  for (size_t i = 0; i < RANGE_REGISTERS; ++i)
+    changed = range_join_value(into->registers + i, state->registers + i,
+                               WORD_SIZE, widen) ||
+              changed;
+  if (changed)
+    ++into->changes;
+  return changed;
+}
+
+/* Run the block at index through its state, joining it into its
+   successors and adding those which changed to work. */
+static void range_block(struct Range *r, const cfg_t *cfg, size_t index,
+                        struct RangeState *states, size_t *work,
+                        size_t *work_size, bool *queued)
+{
+  const cfg_block_t *block = cfg->blocks + index;
+  struct RangeState state  = states[index], next[2];
+  for (word_t i = block->start; i + 1 < block->end; ++i)
+    range_step(r, &state, i);
+
+  const inst_t last = r->program.instructions[block->end - 1];
+  if (UNSIGNED_OPCODE_IS_TYPE(last.opcode, OP_JUMP_IF))
+  {
+    const struct RangeValue condition =
+        range_pop(&state, sizes[OPCODE_DATA_TYPE(last.opcode, OP_JUMP_IF)]);
+    next[CFG_FALLTHROUGH] = next[CFG_TARGET] = state;
+    // Without a target of its own both ways go to the fallthrough
+    if (block->successors[CFG_TARGET] != CFG_NONE)
+    {
+      next[CFG_FALLTHROUGH].reached =
+          range_narrow(next + CFG_FALLTHROUGH, &condition, false);
+      next[CFG_TARGET].reached =
+          range_narrow(next + CFG_TARGET, &condition, true);
+    }
+  }
+  else
+  {
+    range_step(r, &state, block->end - 1);
+    next[CFG_FALLTHROUGH] = next[CFG_TARGET] = state;
+  }
+
+  for (size_t i = 0; i < ARR_SIZE(block->successors); ++i)
+  {
+    const size_t successor = block->successors[i];
+    // Callees are analysed from their own entry
+    if (successor == CFG_NONE || !next[i].reached ||
+        (last.opcode == OP_CALL && i == CFG_TARGET))
+      continue;
+    const bool backward = cfg->blocks[successor].start <= block->start;
+    if (range_join(states + successor, next + i, backward) &&
+        !queued[successor])
+    {
+      queued[successor]     = true;
+      work[(*work_size)++] = successor;
+    }
+  }
+}
+
+bool range_analyse(prog_t program, bool *in_bounds)
+{
+  cfg_t cfg = {0};
+  if (!cfg_build(program, &cfg))
+    return false;
+  struct RangeState *states = calloc(MAX(cfg.count, 1), sizeof(*states));
+  size_t *work              = malloc(MAX(cfg.count, 1) * sizeof(*work));
+  bool *queued              = calloc(MAX(cfg.count, 1), sizeof(*queued));
+  if (!states || !work || !queued)
+  {
+    cfg_free(&cfg);
+    free(states);
+    free(work);
+    free(queued);
+    return false;
+  }
+
+  struct Range r   = {program, NULL};
+  size_t work_size = 0;
+  for (size_t i = 0; i < cfg.count; ++i)
+  {
+    const inst_t last = program.instructions[cfg.blocks[i].end - 1];
+    const size_t entry =
+        i == 0 ? cfg.entry
+        : last.opcode == OP_CALL ? cfg.blocks[i].successors[CFG_TARGET]
+                                 : CFG_NONE;
+    if (entry != CFG_NONE && !states[entry].reached)
+    {
+      states[entry]     = range_start();
+      queued[entry]     = true;
+      work[work_size++] = entry;
+    }
+  }
+  while (work_size > 0)
+  {
+    const size_t index = work[--work_size];
+    queued[index]      = false;
+    range_block(&r, &cfg, index, states, work, &work_size, queued);
+  }
+
+  memset(in_bounds, 0, program.count * sizeof(*in_bounds));
+  r.in_bounds = in_bounds;
+  for (size_t i = 0; i < cfg.count; ++i)
+    if (states[i].reached)
+    {
+      struct RangeState state = states[i];
+      for (word_t j = cfg.blocks[i].start; j < cfg.blocks[i].end; ++j)
+        range_step(&r, &state, j);
+    }
+
+  cfg_free(&cfg);
+  free(states);
+  free(work);
+  free(queued);
+  return true;
+}
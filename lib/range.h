@@ -0,0 +1,56 @@
+/* Copyright (C) 2026 Aryadev Chavali
+
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License Version 2 for
+ * more details.
+
+ * You should have received a copy of the GNU General Public License Version 2
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+ * Created: 2026-10-16
+ * Author: Aryadev Chavali
+ * Description: Range analysis of indices into heap pages
+ */
+
+#ifndef RANGE_H
+#define RANGE_H
+
+#include <stdbool.h>
+
+#include <lib/inst.h>
+
+/* Entries at the top of the stack, and word registers from the first,
+   tracked by range_analyse.  Anything else could hold any value. */
+#define RANGE_DEPTH     16
+#define RANGE_REGISTERS 16
+
+/* Changes to the state at the start of a loop before range_analyse
+   widens the ranges still changing to everything. */
+#define RANGE_WIDEN 2
+
+/**
+   @brief Find the MGETs and MSETs whose index is always in bounds of
+   their page.
+
+   @details Each datum is given the range of values it may have, and
+   the least size of the page it may point to if it's from a MALLOC
+   with a nonzero count.  Ranges are narrowed on either side of a
+   JUMP_IF on the comparison of two words, so in a loop over a page
+   the index is bounded by the condition of the loop even though the
+   analysis widens it to everything once it's been through the loop a
+   few times.
+
+   An index is in bounds if it's below the least size of the page in
+   elements, or for MGET_BYTE and MSET_BYTE if it's below an MSIZE of
+   the page, compared while both were in registers that haven't been
+   written to since.
+
+   @param[program] Program to analyse
+   @param[in_bounds] Set for each MGET and MSET as above, by address
+   @return False if memory for the analysis couldn't be allocated, in
+   which case nothing is set
+ */
+bool range_analyse(prog_t program, bool *in_bounds);
+
+#endif
@@ -0,0 +1,229 @@
+/* Copyright (C) 2026 Aryadev Chavali
+
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License Version 2 for
+ * more details.
+
+ * You should have received a copy of the GNU General Public License Version 2
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+ * Created: 2026-10-16
+ * Author: Aryadev Chavali
+ * Description: Analysis of the resources a program needs
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include <lib/heap.h>
+#include <lib/resource.h>
+
+/* Analysis
+
+   Much like verify_program, but looking for bounds rather than
+   proving the program can't fail: an instruction which would fail
+   just ends its path.  Each subroutine is summarised by the most
+   depth it reaches relative to its entry, the change in depth on
+   return, how deep it nests calls, the registers it uses and what it
+   allocates.  A summary still being computed when it's needed means
+   recursion, so the program isn't bounded.
+*/
+
+#define RESOURCE_UNKNOWN LONG_MIN
+
+static const word_t sizes[] = {BYTE_SIZE, SHORT_SIZE, HWORD_SIZE, WORD_SIZE};
+
+struct ResourceSummary
+{
+  enum
+  {
+    RESOURCE_NONE = 0,
+    RESOURCE_PENDING,
+    RESOURCE_DONE,
+  } state;
+  bool returns;
+  sword_t delta, extent;
+  word_t calls, registers, heap;
+};
+
+struct Resource
+{
+  prog_t program;
+  struct ResourceSummary *summaries;
+  size_t nesting;
+};
+
+/* Bytes of the registers an instruction uses from the first, or 0 if
+   it uses none or the register can't possibly exist. */
+static word_t resource_registers(inst_t inst)
+{
+  word_t size = 0, reg = inst.operand.as_word;
+  if (UNSIGNED_OPCODE_IS_TYPE(inst.opcode, OP_PUSH_REGISTER))
+    size = sizes[OPCODE_DATA_TYPE(inst.opcode, OP_PUSH_REGISTER)];
+  else if (UNSIGNED_OPCODE_IS_TYPE(inst.opcode, OP_MOV))
+    size = sizes[OPCODE_DATA_TYPE(inst.opcode, OP_MOV)];
+  else if (UNSIGNED_OPCODE_IS_TYPE(inst.opcode, OP_POP))
+  {
+    size = sizes[OPCODE_DATA_TYPE(inst.opcode, OP_POP)];
+    reg  = 0;
+  }
+  return size && reg < WORD_MAX / size - 1 ? (reg + 1) * size : 0;
+}
+
+/* Bytes allocated by the MALLOC at address. */
+static word_t resource_heap(prog_t program, word_t address)
+{
+  const opcode_t opcode = program.instructions[address].opcode;
+  const word_t size     = sizes[OPCODE_DATA_TYPE(opcode, OP_MALLOC)];
+  if (address == 0 || program.instructions[address - 1].opcode != OP_PUSH_WORD)
+    return PAGE_DEFAULT_SIZE;
+  const word_t n = program.instructions[address - 1].operand.as_word;
+  if (n == 0)
+    return PAGE_DEFAULT_SIZE;
+  return n <= WORD_MAX / size ? n * size : 0;
+}
+
+static bool resource_procedure(struct Resource *r, word_t entry,
+                               bool is_called);
+
+static const struct ResourceSummary *resource_call(struct Resource *r,
+                                                   word_t target)
+{
+  struct ResourceSummary *summary = r->summaries + target;
+  if (summary->state == RESOURCE_NONE &&
+      (r->nesting >= RESOURCE_MAX_NESTING ||
+       !resource_procedure(r, target, true)))
+    return NULL;
+  return summary->state == RESOURCE_DONE ? summary : NULL;
+}
+
+/* Walk every path of the procedure at entry, filling its summary. */
+static bool resource_procedure(struct Resource *r, word_t entry,
+                               bool is_called)
+{
+  const prog_t program            = r->program;
+  struct ResourceSummary *summary = r->summaries + entry;
+  struct ResourceSummary result   = {.state = RESOURCE_DONE};
+  sword_t *depths = malloc(program.count * sizeof(*depths));
+  word_t *work    = malloc(program.count * sizeof(*work));
+  size_t work_size = 0;
+  bool bounded     = depths && work;
+  for (word_t i = 0; bounded && i < program.count; ++i)
+    depths[i] = RESOURCE_UNKNOWN;
+
+  summary->state = RESOURCE_PENDING;
+  ++r->nesting;
+  if (bounded)
+  {
+    depths[entry]     = 0;
+    work[work_size++] = entry;
+  }
+
+#define RESOURCE_SUCCESSOR(ADDRESS, DEPTH)                 \
+  do                                                       \
+  {                                                        \
+    if ((ADDRESS) >= program.count)                        \
+      break;                                               \
+    else if (depths[(ADDRESS)] == RESOURCE_UNKNOWN)        \
+    {                                                      \
+      depths[(ADDRESS)] = (DEPTH);                         \
+      work[work_size++] = (ADDRESS);                       \
+    }                                                      \
+    else if (depths[(ADDRESS)] != (DEPTH))                 \
+      bounded = false;                                     \
+  } while (0)
+
+  while (bounded && work_size > 0)
+  {
+    const word_t address = work[--work_size];
+    const inst_t inst    = program.instructions[address];
+    const opcode_t op    = inst.opcode;
+    const sword_t depth  = depths[address];
+    const word_t operand = inst.operand.as_word;
+    if ((word_t)op >= NUMBER_OF_OPCODES)
+      continue;
+
+    const sword_t next =
+        depth - (sword_t)opcode_info[op].pop + (sword_t)opcode_info[op].push;
+    result.extent      = MAX(result.extent, next);
+    result.registers   = MAX(result.registers, resource_registers(inst));
+    if (UNSIGNED_OPCODE_IS_TYPE(op, OP_MALLOC))
+      result.heap += resource_heap(program, address);
+
+    if (op == OP_HALT)
+      continue;
+    else if (op == OP_JUMP_ABS)
+    {
+      RESOURCE_SUCCESSOR(operand, next);
+      continue;
+    }
+    else if (UNSIGNED_OPCODE_IS_TYPE(op, OP_JUMP_IF))
+      RESOURCE_SUCCESSOR(operand, next);
+    else if (op == OP_CALL)
+    {
+      if (operand >= program.count)
+        continue;
+      const struct ResourceSummary *callee = resource_call(r, operand);
+      if (!callee)
+      {
+        bounded = false;
+        continue;
+      }
+      result.extent    = MAX(result.extent, depth + callee->extent);
+      result.calls     = MAX(result.calls, callee->calls + 1);
+      result.registers = MAX(result.registers, callee->registers);
+      result.heap     += callee->heap;
+      if (callee->returns)
+        RESOURCE_SUCCESSOR(address + 1, depth + callee->delta);
+      continue;
+    }
+    else if (op == OP_RET)
+    {
+      // Returning from the start address underflows the call stack
+      if (is_called && result.returns && result.delta != depth)
+        bounded = false;
+      result.returns = is_called;
+      result.delta   = depth;
+      continue;
+    }
+
+    RESOURCE_SUCCESSOR(address + 1, next);
+  }
+
+#undef RESOURCE_SUCCESSOR
+
+  --r->nesting;
+  *summary = bounded ? result : (struct ResourceSummary){0};
+  free(depths);
+  free(work);
+  return bounded;
+}
+
+bool resource_analyse(prog_t program, prog_resources_t *resources)
+{
+  *resources = (prog_resources_t){0};
+  if (program.start_address >= program.count)
+  {
+    resources->present = true;
+    return true;
+  }
+
+  struct Resource r = {
+      .program   = program,
+      .summaries = calloc(program.count, sizeof(struct ResourceSummary)),
+  };
+  if (r.summaries && resource_procedure(&r, program.start_address, false))
+  {
+    const struct ResourceSummary *summary = r.summaries + program.start_address;
+    *resources = (prog_resources_t){
+        .present   = true,
+        .stack     = summary->extent,
+        .calls     = summary->calls,
+        .registers = summary->registers,
+        .heap      = summary->heap,
+    };
+  }
+  free(r.summaries);
+  return resources->present;
+}
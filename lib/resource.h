@@ -0,0 +1,52 @@
+/* Copyright (C) 2026 Aryadev Chavali
+
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License Version 2 for
+ * more details.
+
+ * You should have received a copy of the GNU General Public License Version 2
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+ * Created: 2026-10-16
+ * Author: Aryadev Chavali
+ * Description: Analysis of the resources a program needs
+ */
+
+#ifndef RESOURCE_H
+#define RESOURCE_H
+
+#include <stdbool.h>
+
+#include <lib/inst.h>
+
+/* Deepest nesting of calls followed by resource_analyse.  Programs
+   nesting calls any deeper aren't bounded. */
+#define RESOURCE_MAX_NESTING 256
+
+/**
+   @brief Bound the resources a program needs when run from its start
+   address with empty stacks.
+
+   @details Every subroutine is walked over every path from its entry
+   with the depth of the stack relative to its call, which must be the
+   same on every path reaching an instruction, and calls take on the
+   summary of their target.  So a program pushing on every iteration
+   of a loop, recursing or returning at different depths from one
+   subroutine isn't bounded.  Paths end wherever the program would
+   fail or halt, so a bounded program never needs more than the bounds
+   before it stops.
+
+   The heap is estimated as each MALLOC running once for every call of
+   its subroutine and never being deleted, with its count from the
+   PUSH before it if there is one or a page of PAGE_DEFAULT_SIZE if
+   not.
+
+   @param[program] Program to analyse
+   @param[resources] Set to the resources of program, present if it's
+   bounded
+   @return Whether program is bounded
+ */
+bool resource_analyse(prog_t program, prog_resources_t *resources);
+
+#endif
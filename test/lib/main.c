@@ -15,11 +15,27 @@
 
 #include "test-base.h"
 
+#include "test-cfg.h"
 #include "test-darr.h"
+#include "test-escape.h"
+#include "test-heap.h"
+#include "test-inst.h"
+#include "test-opt.h"
+#include "test-pure.h"
+#include "test-range.h"
+#include "test-resource.h"
 
 int main(void)
 {
   RUN_TEST_SUITE(test_lib_base);
   RUN_TEST_SUITE(test_lib_darr);
+  RUN_TEST_SUITE(test_lib_inst);
+  RUN_TEST_SUITE(test_lib_heap);
+  RUN_TEST_SUITE(test_lib_opt);
+  RUN_TEST_SUITE(test_lib_cfg);
+  RUN_TEST_SUITE(test_lib_escape);
+  RUN_TEST_SUITE(test_lib_range);
+  RUN_TEST_SUITE(test_lib_pure);
+  RUN_TEST_SUITE(test_lib_resource);
   return 0;
 }
@@ -0,0 +1,150 @@
+/* Copyright (C) 2026 Aryadev Chavali
+
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License Version 2 for
+ * more details.
+
+ * You should have received a copy of the GNU General Public License Version 2
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+ * Created: 2026-10-16
+ * Author: Aryadev Chavali
+ * Description: Tests for cfg.h
+ */
+
+#ifndef TEST_CFG_H
+#define TEST_CFG_H
+
+#include <lib/cfg.h>
+#include <lib/inst-macro.h>
+
+#include "../testing.h"
+
+#define TEST_CFG_MAX 8
+
+struct TestCfg
+{
+  word_t start, count;
+  inst_t input[TEST_CFG_MAX];
+  size_t blocks, entry;
+  // Start, successors and dominator of each block
+  struct
+  {
+    word_t start;
+    size_t fallthrough, target, dominator;
+  } expected[TEST_CFG_MAX];
+};
+
+void test_lib_cfg_build(void)
+{
+  const struct TestCfg tests[] = {
+      // Straight line code is one block
+      {0,
+       3,
+       {INST_PUSH(BYTE, 1), INST_PRINT(BYTE), INST_HALT},
+       1,
+       0,
+       {{0, CFG_NONE, CFG_NONE, CFG_NONE}}},
+      // A loop: the body and exit are both dominated by the test
+      {0,
+       5,
+       {INST_PUSH(BYTE, 1), INST_JUMP_IF(BYTE, 3), INST_HALT,
+        INST_PUSH(BYTE, 0), INST_JUMP_ABS(0)},
+       3,
+       0,
+       {{0, 1, 2, CFG_NONE}, {2, CFG_NONE, CFG_NONE, 0}, {3, CFG_NONE, 0, 0}}},
+      // A diamond joins at a block dominated by neither arm
+      {0,
+       6,
+       {INST_PUSH(BYTE, 1), INST_JUMP_IF(BYTE, 4), INST_PUSH(BYTE, 2),
+        INST_JUMP_ABS(5), INST_PUSH(BYTE, 3), INST_HALT},
+       4,
+       0,
+       {{0, 1, 2, CFG_NONE},
+        {2, CFG_NONE, 3, 0},
+        {4, 3, CFG_NONE, 0},
+        {5, CFG_NONE, CFG_NONE, 0}}},
+      // Calls fall through to their return site and RETs go nowhere
+      {1,
+       4,
+       {INST_RET, INST_CALL(0), INST_CALL(0), INST_HALT},
+       4,
+       1,
+       {{0, CFG_NONE, CFG_NONE, 1},
+        {1, 2, 0, CFG_NONE},
+        {2, 3, 0, 1},
+        {3, CFG_NONE, CFG_NONE, 2}}},
+      // Unreachable blocks have no dominator
+      {0,
+       3,
+       {INST_JUMP_ABS(2), INST_PUSH(BYTE, 1), INST_HALT},
+       3,
+       0,
+       {{0, CFG_NONE, 2, CFG_NONE},
+        {1, 2, CFG_NONE, CFG_NONE},
+        {2, CFG_NONE, CFG_NONE, 0}}},
+  };
+  for (size_t i = 0; i < ARR_SIZE(tests); ++i)
+  {
+    const struct TestCfg *test = tests + i;
+    prog_t program = {test->start, test->count, (inst_t *)test->input, {0}};
+    cfg_t cfg      = {0};
+    bool same      = cfg_build(program, &cfg) && cfg.count == test->blocks &&
+                cfg.entry == test->entry;
+    for (size_t j = 0; same && j < cfg.count; ++j)
+      same = cfg.blocks[j].start == test->expected[j].start &&
+             cfg.blocks[j].successors[CFG_FALLTHROUGH] ==
+                 test->expected[j].fallthrough &&
+             cfg.blocks[j].successors[CFG_TARGET] == test->expected[j].target &&
+             cfg.blocks[j].dominator == test->expected[j].dominator;
+    // Every edge is recorded at both ends
+    for (size_t j = 0; same && j < cfg.count; ++j)
+      for (size_t k = 0; k < cfg.blocks[j].predecessor_count; ++k)
+      {
+        const cfg_block_t *from = cfg.blocks + cfg.blocks[j].predecessors[k];
+        same = same && (from->successors[CFG_FALLTHROUGH] == j ||
+                        from->successors[CFG_TARGET] == j);
+      }
+    if (!same)
+    {
+      FAIL(__func__, "[%lu] -> Expected %lu blocks\n", i, test->blocks);
+      cfg_print(&cfg, stderr);
+      assert(false);
+    }
+    cfg_free(&cfg);
+  }
+}
+
+void test_lib_cfg_dominates(void)
+{
+  // Diamond from test_lib_cfg_build
+  inst_t instructions[] = {INST_PUSH(BYTE, 1), INST_JUMP_IF(BYTE, 4),
+                           INST_PUSH(BYTE, 2), INST_JUMP_ABS(5),
+                           INST_PUSH(BYTE, 3), INST_HALT};
+  prog_t program        = {0, ARR_SIZE(instructions), instructions, {0}};
+  cfg_t cfg             = {0};
+  assert(cfg_build(program, &cfg));
+  const struct
+  {
+    size_t dominator, block;
+    bool expected;
+  } tests[] = {
+      {0, 3, true}, {1, 1, true}, {1, 3, false}, {2, 3, false}, {3, 0, false},
+  };
+  for (size_t i = 0; i < ARR_SIZE(tests); ++i)
+    if (cfg_dominates(&cfg, tests[i].dominator, tests[i].block) !=
+        tests[i].expected)
+    {
+      FAIL(__func__, "[%lu] -> Expected %lu %s %lu\n", i, tests[i].dominator,
+           tests[i].expected ? "to dominate" : "not to dominate",
+           tests[i].block);
+      assert(false);
+    }
+  cfg_free(&cfg);
+}
+
+TEST_SUITE(test_lib_cfg, CREATE_TEST(test_lib_cfg_build),
+           CREATE_TEST(test_lib_cfg_dominates), );
+
+#endif
@@ -0,0 +1,101 @@
+/* Copyright (C) 2026 Aryadev Chavali
+
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License Version 2 for
+ * more details.
+
+ * You should have received a copy of the GNU General Public License Version 2
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+ * Created: 2026-10-16
+ * Author: Aryadev Chavali
+ * Description: Tests for escape.h
+ */
+
+#ifndef TEST_ESCAPE_H
+#define TEST_ESCAPE_H
+
+#include <lib/escape.h>
+#include <lib/inst-macro.h>
+
+#include "../testing.h"
+
+#define TEST_ESCAPE_MAX 12
+
+struct TestEscape
+{
+  word_t start, count;
+  inst_t input[TEST_ESCAPE_MAX];
+  bool expected[TEST_ESCAPE_MAX];
+};
+
+void test_lib_escape_analyse(void)
+{
+  const struct TestEscape tests[] = {
+      // Used as a page then deleted
+      {0,
+       8,
+       {INST_PUSH(WORD, 4), INST_MALLOC(BYTE, 0), INST_DUP(WORD, 0),
+        INST_PUSH(BYTE, 1), INST_PUSH(WORD, 0), INST_MSET(BYTE, 0),
+        INST_MDELETE, INST_HALT},
+       {[1] = true, [6] = true}},
+      // Live at HALT
+      {0, 3, {INST_PUSH(WORD, 4), INST_MALLOC(BYTE, 0), INST_HALT}, {0}},
+      // The first page is stored in the second
+      {0,
+       11,
+       {INST_PUSH(WORD, 1), INST_MALLOC(WORD, 0), INST_PUSH(WORD, 1),
+        INST_MALLOC(WORD, 0), INST_DUP(WORD, 0), INST_DUP(WORD, 2),
+        INST_PUSH(WORD, 0), INST_MSET(WORD, 0), INST_MDELETE, INST_MDELETE,
+        INST_HALT},
+       {[3] = true, [8] = true}},
+      // Allocated and deleted by a subroutine called twice
+      {0,
+       10,
+       {INST_CALL(3), INST_CALL(3), INST_HALT, INST_PUSH(WORD, 8),
+        INST_MALLOC(BYTE, 0), INST_DUP(WORD, 0), INST_MSIZE, INST_PRINT(WORD),
+        INST_MDELETE, INST_RET},
+       {[4] = true, [8] = true}},
+      // Only deleted on one path
+      {0,
+       8,
+       {INST_PUSH(WORD, 1), INST_MALLOC(BYTE, 0), INST_MOV(WORD, 1),
+        INST_PUSH(BYTE, 1), INST_JUMP_IF(BYTE, 7), INST_PUSH_REG(WORD, 1),
+        INST_MDELETE, INST_HALT},
+       {0}},
+      // Kept in a tracked register
+      {0,
+       6,
+       {INST_PUSH(WORD, 1), INST_MALLOC(BYTE, 0), INST_MOV(WORD, 1),
+        INST_PUSH_REG(WORD, 1), INST_MDELETE, INST_HALT},
+       {[1] = true, [4] = true}},
+      // Kept in an untracked register
+      {0,
+       6,
+       {INST_PUSH(WORD, 1), INST_MALLOC(BYTE, 0), INST_MOV(WORD, 9),
+        INST_PUSH_REG(WORD, 9), INST_MDELETE, INST_HALT},
+       {0}},
+  };
+  for (size_t i = 0; i < ARR_SIZE(tests); ++i)
+  {
+    const struct TestEscape *test = tests + i;
+    prog_t program = {test->start, test->count, (inst_t *)test->input, {0}};
+    bool scoped[TEST_ESCAPE_MAX] = {0};
+    bool same = escape_analyse(program, scoped) &&
+                memcmp(scoped, test->expected, sizeof(scoped)) == 0;
+    if (!same)
+    {
+      FAIL(__func__, "[%lu] -> Scoped addresses differ\n", i);
+      for (word_t j = 0; j < test->count; ++j)
+        fprintf(stderr, "\t%lu: %s, expected %s\n", j,
+                scoped[j] ? "scoped" : "escapes",
+                test->expected[j] ? "scoped" : "escapes");
+      assert(false);
+    }
+  }
+}
+
+TEST_SUITE(test_lib_escape, CREATE_TEST(test_lib_escape_analyse), );
+
+#endif
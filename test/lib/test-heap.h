@@ -0,0 +1,77 @@
+/* Copyright (C) 2026 Aryadev Chavali
+
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License Version 2 for
+ * more details.
+
+ * You should have received a copy of the GNU General Public License Version 2
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+ * Created: 2026-10-17
+ * Author: Aryadev Chavali
+ * Description: Tests for heap.h
+ */
+
+#ifndef TEST_HEAP_H
+#define TEST_HEAP_H
+
+#include <lib/heap.h>
+
+#include <stdint.h>
+
+#include "../testing.h"
+
+void test_lib_heap_scratch_allocate(void)
+{
+  heap_t heap = {0};
+  heap_create(&heap);
+
+  // Reused once freed, zeroed
+  page_t *page = heap_scratch_allocate(&heap, 10);
+  if (!page || page->available < 10)
+  {
+    FAIL(__func__, "10 -> Expected a page of at least 10 bytes%s\n", "");
+    assert(false);
+  }
+  page->data[0] = 1;
+  heap_scratch_free(&heap, page);
+  page_t *reused = heap_scratch_allocate(&heap, 10);
+  if (reused != page || reused->data[0] != 0)
+  {
+    FAIL(__func__, "10 -> Expected the freed page back, zeroed%s\n", "");
+    assert(false);
+  }
+  heap_scratch_free(&heap, reused);
+
+  // Sizes with no capacity to round up to
+  const size_t sizes[] = {(SIZE_MAX / 2) + 1, SIZE_MAX};
+  for (size_t i = 0; i < ARR_SIZE(sizes); ++i)
+  {
+    if (heap_scratch_allocate(&heap, sizes[i]))
+    {
+      FAIL(__func__, "[%lu] -> Allocated a scratch page of %lu bytes\n", i,
+           sizes[i]);
+      assert(false);
+    }
+  }
+
+  // Sizes which overflow with the page itself
+  if (heap_allocate(&heap, SIZE_MAX))
+  {
+    FAIL(__func__, "Allocated a page of %lu bytes\n", SIZE_MAX);
+    assert(false);
+  }
+  if (heap.page_vec.used != 0)
+  {
+    FAIL(__func__, "Expected no pages on the heap, got %lu\n",
+         heap.page_vec.used / sizeof(page_t *));
+    assert(false);
+  }
+
+  heap_stop(&heap);
+}
+
+TEST_SUITE(test_lib_heap, CREATE_TEST(test_lib_heap_scratch_allocate), );
+
+#endif
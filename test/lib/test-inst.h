@@ -0,0 +1,185 @@
+/* Copyright (C) 2026 Aryadev Chavali
+
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License Version 2 for
+ * more details.
+
+ * You should have received a copy of the GNU General Public License Version 2
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+ * Created: 2026-10-16
+ * Author: Aryadev Chavali
+ * Description: Tests for the bytecode of inst.h
+ */
+
+#ifndef TEST_INST_H
+#define TEST_INST_H
+
+#include <lib/inst-macro.h>
+#include <lib/inst.h>
+
+#include "../testing.h"
+
+/* Every opcode with an operand whose bytes differ, as it'd be after
+   being read back from bytecode. */
+static inst_t test_lib_inst_every(opcode_t opcode)
+{
+  const opcode_info_t info = opcode_info[opcode];
+  const size_t width       = info.size - 1;
+  word_t operand           = 0x0807060504030201;
+  if (width < WORD_SIZE)
+    operand &= (1UL << (width * 8)) - 1;
+  return (inst_t){opcode, DWORD(operand)};
+}
+
+void test_lib_inst_info(void)
+{
+  for (opcode_t opcode = 0; opcode < NUMBER_OF_OPCODES; ++opcode)
+  {
+    const opcode_info_t info = opcode_info[opcode];
+    const inst_t inst        = test_lib_inst_every(opcode);
+    byte_t bytes[INST_MAX_BYTECODE_SIZE] = {0};
+    inst_t read                          = {0};
+    const size_t written = inst_write_bytecode(inst, bytes);
+    const int bytes_read = inst_read_bytecode(&read, bytes, written);
+    if (!info.name || info.size == 0 || info.size > INST_MAX_BYTECODE_SIZE ||
+        (info.type == DATA_TYPE_NIL) != (info.operand == OPERAND_NONE) ||
+        written != info.size || bytes_read != (int)info.size ||
+        read.opcode != opcode || read.operand.as_word != inst.operand.as_word)
+    {
+      FAIL(__func__, "[%d] -> %s doesn't round trip\n", opcode,
+           info.name ? info.name : "(null)");
+      assert(false);
+    }
+    else if (written > 1 &&
+             inst_read_bytecode(&read, bytes, written - 1) !=
+                 READ_ERR_OPERAND_NO_FIT)
+    {
+      FAIL(__func__, "[%d] -> %s read without its operand\n", opcode,
+           info.name);
+      assert(false);
+    }
+  }
+}
+
+void test_lib_inst_effect(void)
+{
+  const struct
+  {
+    opcode_t opcode;
+    byte_t pop, push;
+  } tests[] = {
+      {OP_NOOP, 0, 0},
+      {OP_PUSH_SHORT, 0, SHORT_SIZE},
+      {OP_POP_HWORD, HWORD_SIZE, 0},
+      {OP_PUSH_REGISTER_WORD, 0, WORD_SIZE},
+      {OP_MOV_BYTE, BYTE_SIZE, 0},
+      {OP_DUP_SHORT, 0, SHORT_SIZE},
+      {OP_MALLOC_HWORD, WORD_SIZE, WORD_SIZE},
+      {OP_MSET_SHORT, 2 * WORD_SIZE + SHORT_SIZE, 0},
+      {OP_MGET_BYTE, 2 * WORD_SIZE, BYTE_SIZE},
+      {OP_MDELETE, WORD_SIZE, 0},
+      {OP_MSIZE, WORD_SIZE, WORD_SIZE},
+      {OP_NOT_WORD, WORD_SIZE, WORD_SIZE},
+      {OP_EQ_HWORD, 2 * HWORD_SIZE, BYTE_SIZE},
+      {OP_MULT_SHORT, 2 * SHORT_SIZE, SHORT_SIZE},
+      {OP_LT_SSHORT, 2 * SHORT_SIZE, BYTE_SIZE},
+      {OP_GTE_SWORD, 2 * WORD_SIZE, BYTE_SIZE},
+      {OP_PRINT_SHWORD, HWORD_SIZE, 0},
+      {OP_JUMP_IF_WORD, WORD_SIZE, 0},
+      {OP_CALL, 0, 0},
+      {OP_RET, 0, 0},
+  };
+
+  for (size_t i = 0; i < ARR_SIZE(tests); ++i)
+  {
+    const opcode_info_t info = opcode_info[tests[i].opcode];
+    if (info.pop != tests[i].pop || info.push != tests[i].push)
+    {
+      FAIL(__func__, "[%lu] -> %s pops %u and pushes %u, expected %u and %u\n",
+           i, info.name, info.pop, info.push, tests[i].pop, tests[i].push);
+      assert(false);
+    }
+  }
+}
+
+void test_lib_inst_read_bytecode_n(void)
+{
+  // Every opcode in turn, so reads cross from the fast to the checked
+  // loop at every alignment
+  inst_t insts[NUMBER_OF_OPCODES], read[NUMBER_OF_OPCODES];
+  byte_t bytes[NUMBER_OF_OPCODES * INST_MAX_BYTECODE_SIZE];
+  size_t size = 0;
+  for (opcode_t opcode = 0; opcode < NUMBER_OF_OPCODES; ++opcode)
+  {
+    insts[opcode] = test_lib_inst_every(opcode);
+    size += inst_write_bytecode(insts[opcode], bytes + size);
+  }
+
+  size_t size_read    = 0;
+  read_err_prog_t err = inst_read_bytecode_n(read, NUMBER_OF_OPCODES,
+                                             &size_read, bytes, size);
+  bool same = err.type == 0 && size_read == size;
+  for (size_t i = 0; same && i < NUMBER_OF_OPCODES; ++i)
+    same = read[i].opcode == insts[i].opcode &&
+           read[i].operand.as_word == insts[i].operand.as_word;
+  if (!same)
+  {
+    FAIL(__func__, "Every opcode -> read back %lu of %lu bytes (%d)\n",
+         size_read, size, err.type);
+    assert(false);
+  }
+
+  const struct
+  {
+    inst_t input[3];
+    size_t count, truncate;
+    read_err_prog_t expected;
+  } tests[] = {
+      // Operand cut short at the end
+      {{INST_PUSH(WORD, 1), INST_CALL(2), INST_HALT},
+       3,
+       2,
+       {READ_ERR_OPERAND_NO_FIT, INST_MAX_BYTECODE_SIZE}},
+      // Fewer instructions than expected
+      {{INST_PUSH(BYTE, 1), INST_HALT, INST_HALT},
+       4,
+       0,
+       {READ_ERR_EXPECTED_MORE, 0}},
+  };
+  for (size_t i = 0; i < ARR_SIZE(tests); ++i)
+  {
+    size_t test_size = 0;
+    for (size_t j = 0; j < ARR_SIZE(tests[i].input); ++j)
+      test_size += inst_write_bytecode(tests[i].input[j], bytes + test_size);
+    err = inst_read_bytecode_n(read, tests[i].count, &size_read, bytes,
+                               test_size - tests[i].truncate);
+    if (err.type != tests[i].expected.type ||
+        err.index != tests[i].expected.index)
+    {
+      FAIL(__func__, "[%lu] -> Expected %d at %lu, got %d at %lu\n", i,
+           tests[i].expected.type, tests[i].expected.index, err.type,
+           err.index);
+      assert(false);
+    }
+  }
+
+  // An invalid opcode is found by the fast loop
+  size = 0;
+  for (size_t i = 0; i < 4; ++i)
+    size += inst_write_bytecode(INST_PUSH(WORD, i), bytes + size);
+  bytes[WORD_SIZE + 1] = NUMBER_OF_OPCODES;
+  err = inst_read_bytecode_n(read, 4, &size_read, bytes, size);
+  if (err.type != READ_ERR_INVALID_OPCODE || err.index != WORD_SIZE + 1)
+  {
+    FAIL(__func__, "Invalid opcode -> got %d at %lu\n", err.type, err.index);
+    assert(false);
+  }
+}
+
+TEST_SUITE(test_lib_inst, CREATE_TEST(test_lib_inst_info),
+           CREATE_TEST(test_lib_inst_effect),
+           CREATE_TEST(test_lib_inst_read_bytecode_n), );
+
+#endif
@@ -0,0 +1,316 @@
+/* Copyright (C) 2026 Aryadev Chavali
+
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License Version 2 for
+ * more details.
+
+ * You should have received a copy of the GNU General Public License Version 2
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+ * Created: 2026-10-16
+ * Author: Aryadev Chavali
+ * Description: Tests for opt.h
+ */
+
+#ifndef TEST_OPT_H
+#define TEST_OPT_H
+
+#include <lib/inst-macro.h>
+#include <lib/opt.h>
+
+#include "../testing.h"
+
+#define TEST_OPT_MAX 8
+
+struct TestOpt
+{
+  unsigned passes;
+  word_t start, count;
+  inst_t input[TEST_OPT_MAX];
+  word_t expected_start, expected_count;
+  inst_t expected[TEST_OPT_MAX];
+};
+
+static void test_lib_opt_run(const char *name, const struct TestOpt *tests,
+                             size_t size)
+{
+  for (size_t i = 0; i < size; ++i)
+  {
+    // Inlining replaces the instructions, so they're on the heap
+    inst_t *instructions = malloc(sizeof(tests[i].input));
+    memcpy(instructions, tests[i].input, sizeof(tests[i].input));
+    prog_t program = {tests[i].start, tests[i].count, instructions, {0}};
+    bool same      = opt_program(&program, tests[i].passes, NULL) &&
+                program.start_address == tests[i].expected_start &&
+                program.count == tests[i].expected_count;
+    instructions = program.instructions;
+    for (size_t j = 0; same && j < program.count; ++j)
+      same = instructions[j].opcode == tests[i].expected[j].opcode &&
+             instructions[j].operand.as_word ==
+                 tests[i].expected[j].operand.as_word;
+    if (!same)
+    {
+      FAIL(name,
+           "[%lu] -> Expected %lu instructions from %lu, got %lu from %lu\n", i,
+           tests[i].expected_count, tests[i].expected_start, program.count,
+           program.start_address);
+      for (size_t j = 0; j < program.count; ++j)
+      {
+        inst_print(instructions[j], stderr);
+        fprintf(stderr, "\n");
+      }
+      assert(false);
+    }
+    free(instructions);
+  }
+}
+
+void test_lib_opt_fold(void)
+{
+  const struct TestOpt tests[] = {
+      {OPT_FOLD | OPT_STRIP,
+       0,
+       4,
+       {INST_PUSH(WORD, 2), INST_PUSH(WORD, 3), INST_SUB(WORD),
+        INST_PRINT(WORD)},
+       0,
+       2,
+       {INST_PUSH(WORD, 1), INST_PRINT(WORD)}},
+      // Folds chain, and results are truncated to their type
+      {OPT_FOLD | OPT_STRIP,
+       0,
+       6,
+       {INST_PUSH(BYTE, 200), INST_PUSH(BYTE, 100), INST_PLUS(BYTE),
+        INST_PUSH(BYTE, 212), INST_PLUS(BYTE), INST_PRINT(BYTE)},
+       0,
+       2,
+       {INST_PUSH(BYTE, 0), INST_PRINT(BYTE)}},
+      // Comparisons push a byte, signed or not
+      {OPT_FOLD | OPT_STRIP,
+       0,
+       4,
+       {INST_PUSH(SHORT, 0xFFFF), INST_PUSH(SHORT, 1), INST_LT(SSHORT),
+        INST_PRINT(BYTE)},
+       0,
+       2,
+       {INST_PUSH(BYTE, 1), INST_PRINT(BYTE)}},
+      // Jumps into a sequence stop it being folded
+      {OPT_FOLD | OPT_STRIP,
+       0,
+       4,
+       {INST_PUSH(WORD, 2), INST_PUSH(WORD, 3), INST_PLUS(WORD),
+        INST_JUMP_ABS(1)},
+       0,
+       4,
+       {INST_PUSH(WORD, 2), INST_PUSH(WORD, 3), INST_PLUS(WORD),
+        INST_JUMP_ABS(1)}},
+      // Constant branches
+      {OPT_FOLD | OPT_STRIP,
+       0,
+       5,
+       {INST_PUSH(BYTE, 0), INST_JUMP_IF(BYTE, 4), INST_PUSH(BYTE, 1),
+        INST_JUMP_IF(BYTE, 0), INST_HALT},
+       0,
+       2,
+       {INST_JUMP_ABS(0), INST_HALT}},
+  };
+  test_lib_opt_run(__func__, tests, ARR_SIZE(tests));
+}
+
+void test_lib_opt_thread(void)
+{
+  const struct TestOpt tests[] = {
+      {OPT_THREAD,
+       0,
+       5,
+       {INST_JUMP_IF(BYTE, 2), INST_HALT, INST_JUMP_ABS(3), INST_JUMP_ABS(4),
+        INST_HALT},
+       0,
+       5,
+       {INST_JUMP_IF(BYTE, 4), INST_HALT, INST_NOOP, INST_NOOP, INST_HALT}},
+      // Loops of jumps are left alone
+      {OPT_THREAD,
+       0,
+       3,
+       {INST_JUMP_ABS(2), INST_HALT, INST_JUMP_ABS(0)},
+       0,
+       3,
+       {INST_JUMP_ABS(2), INST_HALT, INST_JUMP_ABS(0)}},
+  };
+  test_lib_opt_run(__func__, tests, ARR_SIZE(tests));
+}
+
+void test_lib_opt_registers(void)
+{
+  const struct TestOpt tests[] = {
+      {OPT_REGISTERS | OPT_STRIP,
+       0,
+       6,
+       {INST_PUSH_REG(WORD, 1), INST_MOV(WORD, 1), INST_PUSH_REG(BYTE, 0),
+        INST_POP(BYTE), INST_PUSH_REG(SHORT, 1), INST_MOV(SHORT, 2)},
+       0,
+       2,
+       {INST_PUSH_REG(SHORT, 1), INST_MOV(SHORT, 2)}},
+  };
+  test_lib_opt_run(__func__, tests, ARR_SIZE(tests));
+}
+
+void test_lib_opt_unreachable(void)
+{
+  const struct TestOpt tests[] = {
+      {OPT_UNREACHABLE | OPT_STRIP,
+       1,
+       7,
+       {INST_PRINT(BYTE), INST_CALL(4), INST_HALT, INST_PRINT(WORD),
+        INST_PUSH(BYTE, 1), INST_RET, INST_PRINT(SHORT)},
+       0,
+       4,
+       {INST_CALL(2), INST_HALT, INST_PUSH(BYTE, 1), INST_RET}},
+  };
+  test_lib_opt_run(__func__, tests, ARR_SIZE(tests));
+}
+
+void test_lib_opt_strip(void)
+{
+  const struct TestOpt tests[] = {
+      {OPT_STRIP,
+       1,
+       6,
+       {INST_NOOP, INST_JUMP_ABS(3), INST_NOOP, INST_PRINT(BYTE),
+        INST_JUMP_IF(BYTE, 7), INST_JUMP_ABS(0)},
+       0,
+       4,
+       {INST_JUMP_ABS(1), INST_PRINT(BYTE), INST_JUMP_IF(BYTE, 4),
+        INST_JUMP_ABS(0)}},
+      // Jumping or returning to the end gets a HALT
+      {OPT_STRIP,
+       0,
+       4,
+       {INST_JUMP_IF(BYTE, 3), INST_CALL(2), INST_RET, INST_NOOP},
+       0,
+       4,
+       {INST_JUMP_IF(BYTE, 3), INST_CALL(2), INST_RET, INST_HALT}},
+  };
+  test_lib_opt_run(__func__, tests, ARR_SIZE(tests));
+}
+
+void test_lib_opt_tail(void)
+{
+  const struct TestOpt tests[] = {
+      {OPT_TAIL,
+       0,
+       5,
+       {INST_CALL(3), INST_NOOP, INST_RET, INST_PUSH(BYTE, 1), INST_RET},
+       0,
+       5,
+       {INST_JUMP_ABS(3), INST_NOOP, INST_RET, INST_PUSH(BYTE, 1),
+        INST_RET}},
+  };
+  test_lib_opt_run(__func__, tests, ARR_SIZE(tests));
+}
+
+void test_lib_opt_inline(void)
+{
+  const struct TestOpt tests[] = {
+      {OPT_INLINE,
+       0,
+       5,
+       {INST_CALL(3), INST_CALL(3), INST_HALT, INST_PUSH(BYTE, 1), INST_RET},
+       0,
+       7,
+       {INST_PUSH(BYTE, 1), INST_JUMP_ABS(2), INST_PUSH(BYTE, 1),
+        INST_JUMP_ABS(4), INST_HALT, INST_PUSH(BYTE, 1), INST_RET}},
+      {OPT_ALL,
+       0,
+       5,
+       {INST_CALL(3), INST_CALL(3), INST_HALT, INST_PUSH(BYTE, 1), INST_RET},
+       0,
+       3,
+       {INST_PUSH(BYTE, 1), INST_PUSH(BYTE, 1), INST_HALT}},
+      // Subroutines which call aren't inlined
+      {OPT_INLINE,
+       0,
+       4,
+       {INST_CALL(2), INST_HALT, INST_CALL(2), INST_RET},
+       0,
+       4,
+       {INST_CALL(2), INST_HALT, INST_CALL(2), INST_RET}},
+  };
+  test_lib_opt_run(__func__, tests, ARR_SIZE(tests));
+}
+
+void test_lib_opt_layout(void)
+{
+  const struct
+  {
+    word_t count;
+    inst_t input[TEST_OPT_MAX];
+    word_t counts[TEST_OPT_MAX];
+    word_t expected_count;
+    inst_t expected[TEST_OPT_MAX];
+  } tests[] = {
+      // The hot target of a branch follows it and the cold fallthrough
+      // is jumped to
+      {6,
+       {INST_PUSH(BYTE, 1), INST_JUMP_IF(BYTE, 4), INST_PUSH(BYTE, 2),
+        INST_HALT, INST_PUSH(BYTE, 3), INST_JUMP_ABS(0)},
+       {10, 0, 10},
+       7,
+       {INST_PUSH(BYTE, 1), INST_JUMP_IF(BYTE, 3), INST_JUMP_ABS(5),
+        INST_PUSH(BYTE, 3), INST_JUMP_ABS(0), INST_PUSH(BYTE, 2), INST_HALT}},
+      // Jumps to the block laid out next are removed
+      {4,
+       {INST_JUMP_ABS(2), INST_PRINT(BYTE), INST_PUSH(BYTE, 1),
+        INST_JUMP_ABS(1)},
+       {1, 1, 1},
+       3,
+       {INST_PUSH(BYTE, 1), INST_PRINT(BYTE), INST_JUMP_ABS(0)}},
+      // Code running off the end gets a HALT once moved
+      {4,
+       {INST_PUSH(BYTE, 1), INST_JUMP_IF(BYTE, 3), INST_HALT,
+        INST_PRINT(BYTE)},
+       {1, 0, 1},
+       6,
+       {INST_PUSH(BYTE, 1), INST_JUMP_IF(BYTE, 3), INST_JUMP_ABS(5),
+        INST_PRINT(BYTE), INST_HALT, INST_HALT}},
+  };
+  for (size_t i = 0; i < ARR_SIZE(tests); ++i)
+  {
+    inst_t *instructions = malloc(sizeof(tests[i].input));
+    memcpy(instructions, tests[i].input, sizeof(tests[i].input));
+    prog_t program = {0, tests[i].count, instructions, {0}};
+    cfg_t cfg      = {0};
+    bool same      = cfg_build(program, &cfg) &&
+                opt_layout(&program, &cfg, tests[i].counts) &&
+                program.start_address == 0 &&
+                program.count == tests[i].expected_count;
+    for (size_t j = 0; same && j < program.count; ++j)
+      same = program.instructions[j].opcode == tests[i].expected[j].opcode &&
+             program.instructions[j].operand.as_word ==
+                 tests[i].expected[j].operand.as_word;
+    if (!same)
+    {
+      FAIL(__func__, "[%lu] -> Expected %lu instructions, got %lu\n", i,
+           tests[i].expected_count, program.count);
+      for (size_t j = 0; j < program.count; ++j)
+      {
+        inst_print(program.instructions[j], stderr);
+        fprintf(stderr, "\n");
+      }
+      assert(false);
+    }
+    cfg_free(&cfg);
+    free(program.instructions);
+  }
+}
+
+TEST_SUITE(test_lib_opt, CREATE_TEST(test_lib_opt_fold),
+           CREATE_TEST(test_lib_opt_thread),
+           CREATE_TEST(test_lib_opt_registers),
+           CREATE_TEST(test_lib_opt_unreachable),
+           CREATE_TEST(test_lib_opt_strip), CREATE_TEST(test_lib_opt_tail),
+           CREATE_TEST(test_lib_opt_inline),
+           CREATE_TEST(test_lib_opt_layout), );
+
+#endif
@@ -0,0 +1,110 @@
+/* Copyright (C) 2026 Aryadev Chavali
+
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License Version 2 for
+ * more details.
+
+ * You should have received a copy of the GNU General Public License Version 2
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+ * Created: 2026-10-16
+ * Author: Aryadev Chavali
+ * Description: Tests for pure.h
+ */
+
+#ifndef TEST_PURE_H
+#define TEST_PURE_H
+
+#include <lib/inst-macro.h>
+#include <lib/pure.h>
+
+#include "../testing.h"
+
+#define TEST_PURE_MAX 25
+
+struct TestPure
+{
+  word_t start, count;
+  inst_t input[TEST_PURE_MAX];
+  pure_t expected[TEST_PURE_MAX];
+};
+
+void test_lib_pure_analyse(void)
+{
+  const struct TestPure tests[] = {
+      // Recursive fib, dropping through registers 0 and 1
+      {0,
+       25,
+       {INST_PUSH(WORD, 30),   INST_CALL(4),          INST_PRINT(WORD),
+        INST_HALT,             INST_DUP(WORD, 0),     INST_PUSH(WORD, 2),
+        INST_LT(WORD),         INST_JUMP_IF(BYTE, 20), INST_PUSH(WORD, 1),
+        INST_DUP(WORD, 1),     INST_SUB(WORD),        INST_CALL(4),
+        INST_PUSH(WORD, 2),    INST_DUP(WORD, 2),     INST_SUB(WORD),
+        INST_CALL(4),          INST_PLUS(WORD),       INST_MOV(WORD, 0),
+        INST_MOV(WORD, 1),     INST_JUMP_ABS(23),     INST_DUP(WORD, 0),
+        INST_MOV(WORD, 0),     INST_MOV(WORD, 1),     INST_PUSH_REG(WORD, 0),
+        INST_RET},
+       {[4] = {true, WORD_SIZE, WORD_SIZE, 0, 0xFFFF}, [24] = {true}}},
+      // Reads a register
+      {0,
+       6,
+       {INST_PUSH(WORD, 1), INST_CALL(3), INST_HALT, INST_PUSH_REG(WORD, 2),
+        INST_PLUS(WORD), INST_RET},
+       {[3] = {true, WORD_SIZE, WORD_SIZE, 0xFFUL << 16, 0},
+        [5] = {true}}},
+      // Writes a register on one path, so may leave it as it was
+      {0,
+       7,
+       {INST_PUSH(BYTE, 1), INST_CALL(3), INST_HALT, INST_JUMP_IF(BYTE, 6),
+        INST_PUSH(WORD, 0), INST_MOV(WORD, 0), INST_RET},
+       {[3] = {true, BYTE_SIZE, 0, 0xFF, 0xFF}, [6] = {true}}},
+      // Returns at two depths
+      {0,
+       6,
+       {INST_PUSH(BYTE, 1), INST_CALL(3), INST_HALT, INST_JUMP_IF(BYTE, 5),
+        INST_PUSH(BYTE, 1), INST_RET},
+       {{0}}},
+      // Prints
+      {0,
+       5,
+       {INST_PUSH(BYTE, 1), INST_CALL(3), INST_HALT, INST_PRINT(BYTE),
+        INST_RET},
+       {{0}}},
+      // Calls a subroutine using the heap
+      {0,
+       9,
+       {INST_CALL(2), INST_HALT, INST_CALL(4), INST_RET, INST_PUSH(WORD, 1),
+        INST_MALLOC(BYTE, 0), INST_MDELETE, INST_RET},
+       {{0}}},
+  };
+  for (size_t i = 0; i < ARR_SIZE(tests); ++i)
+  {
+    const struct TestPure *test = tests + i;
+    prog_t program = {test->start, test->count, (inst_t *)test->input, {0}};
+    pure_t pure[TEST_PURE_MAX] = {0};
+    bool same                  = pure_analyse(program, pure);
+    for (word_t j = 0; same && j < test->count; ++j)
+      same = pure[j].pure == test->expected[j].pure &&
+             pure[j].args == test->expected[j].args &&
+             pure[j].results == test->expected[j].results &&
+             pure[j].registers == test->expected[j].registers &&
+             pure[j].writes == test->expected[j].writes;
+    if (!same)
+    {
+      FAIL(__func__, "[%lu] -> Summaries differ\n", i);
+      for (word_t j = 0; j < test->count; ++j)
+        fprintf(stderr,
+                "\t%lu: %d %lu %lu %lx %lx, expected %d %lu %lu %lx %lx\n", j,
+                pure[j].pure, pure[j].args, pure[j].results,
+                pure[j].registers, pure[j].writes, test->expected[j].pure,
+                test->expected[j].args, test->expected[j].results,
+                test->expected[j].registers, test->expected[j].writes);
+      assert(false);
+    }
+  }
+}
+
+TEST_SUITE(test_lib_pure, CREATE_TEST(test_lib_pure_analyse), );
+
+#endif
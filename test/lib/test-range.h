@@ -0,0 +1,123 @@
+/* Copyright (C) 2026 Aryadev Chavali
+
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License Version 2 for
+ * more details.
+
+ * You should have received a copy of the GNU General Public License Version 2
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+ * Created: 2026-10-16
+ * Author: Aryadev Chavali
+ * Description: Tests for range.h
+ */
+
+#ifndef TEST_RANGE_H
+#define TEST_RANGE_H
+
+#include <lib/inst-macro.h>
+#include <lib/range.h>
+
+#include "../testing.h"
+
+#define TEST_RANGE_MAX 25
+
+struct TestRange
+{
+  word_t start, count;
+  inst_t input[TEST_RANGE_MAX];
+  bool expected[TEST_RANGE_MAX];
+};
+
+/* Store i into a page of 10 words for i from 0 while i < BOUND */
+#define TEST_RANGE_LOOP(BOUND)                                               \
+  {0,                                                                        \
+   21,                                                                       \
+   {INST_PUSH(WORD, 10), INST_MALLOC(WORD, 0), INST_MOV(WORD, 1),            \
+    INST_PUSH(WORD, 0), INST_MOV(WORD, 0), INST_PUSH_REG(WORD, 0),           \
+    INST_PUSH(WORD, BOUND), INST_GTE(WORD), INST_JUMP_IF(BYTE, 18),          \
+    INST_PUSH_REG(WORD, 1), INST_PUSH_REG(WORD, 0), INST_PUSH_REG(WORD, 0),  \
+    INST_MSET(WORD, 0), INST_PUSH(WORD, 1), INST_PUSH_REG(WORD, 0),          \
+    INST_PLUS(WORD), INST_MOV(WORD, 0), INST_JUMP_ABS(5),                    \
+    INST_PUSH_REG(WORD, 1), INST_MDELETE, INST_HALT},                        \
+   {[12] = (BOUND) <= 10}}
+
+/* Print each TYPE of a page of any size while below its MSIZE */
+#define TEST_RANGE_MSIZE(TYPE, IN_BOUNDS)                                    \
+  {0,                                                                        \
+   25,                                                                       \
+   {INST_PUSH_REG(WORD, 5), INST_MALLOC(BYTE, 0), INST_MOV(WORD, 1),         \
+    INST_PUSH_REG(WORD, 1), INST_MSIZE, INST_MOV(WORD, 2),                   \
+    INST_PUSH(WORD, 0), INST_MOV(WORD, 0), INST_PUSH_REG(WORD, 0),           \
+    INST_PUSH_REG(WORD, 2), INST_LT(WORD), INST_JUMP_IF(BYTE, 13),           \
+    INST_JUMP_ABS(22), INST_PUSH_REG(WORD, 1), INST_PUSH_REG(WORD, 0),       \
+    INST_MGET(TYPE, 0), INST_PRINT(TYPE), INST_PUSH(WORD, 1),                \
+    INST_PUSH_REG(WORD, 0), INST_PLUS(WORD), INST_MOV(WORD, 0),              \
+    INST_JUMP_ABS(8), INST_PUSH_REG(WORD, 1), INST_MDELETE, INST_HALT},      \
+   {[15] = (IN_BOUNDS)}}
+
+void test_lib_range_analyse(void)
+{
+  const struct TestRange tests[] = {
+      // Constant index into a page of constant size
+      {0,
+       8,
+       {INST_PUSH(WORD, 4), INST_MALLOC(BYTE, 0), INST_DUP(WORD, 0),
+        INST_PUSH(WORD, 3), INST_MGET(BYTE, 0), INST_PRINT(BYTE),
+        INST_MDELETE, INST_HALT},
+       {[4] = true}},
+      // Just past the end
+      {0,
+       8,
+       {INST_PUSH(WORD, 4), INST_MALLOC(BYTE, 0), INST_DUP(WORD, 0),
+        INST_PUSH(WORD, 4), INST_MGET(BYTE, 0), INST_PRINT(BYTE),
+        INST_MDELETE, INST_HALT},
+       {0}},
+      // Loops bounded by the condition of the loop
+      TEST_RANGE_LOOP(10),
+      TEST_RANGE_LOOP(11),
+      // Bytes are bounded by MSIZE, but words aren't
+      TEST_RANGE_MSIZE(BYTE, true),
+      TEST_RANGE_MSIZE(WORD, false),
+      // A word popped off a byte entry is below the byte
+      {0,
+       9,
+       {INST_PUSH(BYTE, 0xFF), INST_PUSH(WORD, 3), INST_MOV(WORD, 1),
+        INST_PUSH(WORD, 4), INST_MALLOC(BYTE, 0), INST_PUSH_REG(WORD, 1),
+        INST_MGET(BYTE, 0), INST_PRINT(BYTE), INST_HALT},
+       {[6] = true}},
+      // A word popped off a word and a byte could be anything, so a
+      // signed comparison doesn't bound it
+      {0,
+       16,
+       {INST_PUSH(WORD, 0), INST_PUSH(BYTE, 0xFF), INST_MOV(WORD, 1),
+        INST_PUSH(WORD, 4), INST_MALLOC(BYTE, 0), INST_MOV(WORD, 2),
+        INST_PUSH_REG(WORD, 1), INST_PUSH(WORD, 4), INST_LT(SWORD),
+        INST_JUMP_IF(BYTE, 11), INST_HALT, INST_PUSH_REG(WORD, 2),
+        INST_PUSH_REG(WORD, 1), INST_MGET(BYTE, 0), INST_PRINT(BYTE),
+        INST_HALT},
+       {0}},
+  };
+  for (size_t i = 0; i < ARR_SIZE(tests); ++i)
+  {
+    const struct TestRange *test = tests + i;
+    prog_t program = {test->start, test->count, (inst_t *)test->input, {0}};
+    bool in_bounds[TEST_RANGE_MAX] = {0};
+    bool same = range_analyse(program, in_bounds) &&
+                memcmp(in_bounds, test->expected, sizeof(in_bounds)) == 0;
+    if (!same)
+    {
+      FAIL(__func__, "[%lu] -> Accesses in bounds differ\n", i);
+      for (word_t j = 0; j < test->count; ++j)
+        fprintf(stderr, "\t%lu: %s, expected %s\n", j,
+                in_bounds[j] ? "in bounds" : "checked",
+                test->expected[j] ? "in bounds" : "checked");
+      assert(false);
+    }
+  }
+}
+
+TEST_SUITE(test_lib_range, CREATE_TEST(test_lib_range_analyse), );
+
+#endif
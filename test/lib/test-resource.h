@@ -0,0 +1,150 @@
+/* Copyright (C) 2026 Aryadev Chavali
+
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License Version 2 for
+ * more details.
+
+ * You should have received a copy of the GNU General Public License Version 2
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+ * Created: 2026-10-16
+ * Author: Aryadev Chavali
+ * Description: Tests for resource.h and the resource section of bytecode
+ */
+
+#ifndef TEST_RESOURCE_H
+#define TEST_RESOURCE_H
+
+#include <lib/inst-macro.h>
+#include <lib/resource.h>
+
+#include "../testing.h"
+
+#define TEST_RESOURCE_MAX 10
+
+struct TestResource
+{
+  word_t start, count;
+  inst_t input[TEST_RESOURCE_MAX];
+  prog_resources_t expected;
+};
+
+void test_lib_resource_analyse(void)
+{
+  const struct TestResource tests[] = {
+      // Straight line, using register 1
+      {0,
+       5,
+       {INST_PUSH(WORD, 1), INST_PUSH(WORD, 2), INST_PLUS(WORD),
+        INST_MOV(WORD, 1), INST_HALT},
+       {true, 2 * WORD_SIZE, 0, 2 * WORD_SIZE, 0}},
+      // A call pushing on top of its argument
+      {0,
+       6,
+       {INST_PUSH(WORD, 1), INST_CALL(3), INST_HALT, INST_PUSH(WORD, 2),
+        INST_PLUS(WORD), INST_RET},
+       {true, 2 * WORD_SIZE, 1, 0, 0}},
+      // A call nested in another, allocating 4 words
+      {0,
+       7,
+       {INST_CALL(2), INST_HALT, INST_CALL(4), INST_RET, INST_PUSH(WORD, 4),
+        INST_MALLOC(WORD, 0), INST_RET},
+       {true, WORD_SIZE, 2, 0, 4 * WORD_SIZE}},
+      // Pops into register 0 on only one path
+      {0,
+       5,
+       {INST_PUSH(BYTE, 1), INST_JUMP_IF(BYTE, 4), INST_PUSH(SHORT, 2),
+        INST_POP(SHORT), INST_HALT},
+       {true, SHORT_SIZE, 0, SHORT_SIZE, 0}},
+      // Recursion
+      {0, 4, {INST_CALL(2), INST_HALT, INST_CALL(2), INST_RET}, {0}},
+      // Pushes on every iteration of a loop
+      {0, 2, {INST_PUSH(BYTE, 1), INST_JUMP_ABS(0)}, {0}},
+      // Returns at two depths
+      {0,
+       6,
+       {INST_PUSH(BYTE, 1), INST_CALL(3), INST_HALT, INST_JUMP_IF(BYTE, 5),
+        INST_PUSH(BYTE, 1), INST_RET},
+       {0}},
+  };
+  for (size_t i = 0; i < ARR_SIZE(tests); ++i)
+  {
+    const struct TestResource *test = tests + i;
+    prog_t program = {test->start, test->count, (inst_t *)test->input, {0}};
+    prog_resources_t resources = {0};
+    const prog_resources_t expected = test->expected;
+    const bool bounded = resource_analyse(program, &resources);
+    if (bounded != expected.present || resources.present != expected.present ||
+        resources.stack != expected.stack ||
+        resources.calls != expected.calls ||
+        resources.registers != expected.registers ||
+        resources.heap != expected.heap)
+    {
+      FAIL(__func__,
+           "[%lu] -> Expected %d %lu %lu %lu %lu, got %d %lu %lu %lu %lu\n", i,
+           expected.present, expected.stack, expected.calls,
+           expected.registers, expected.heap, resources.present,
+           resources.stack, resources.calls, resources.registers,
+           resources.heap);
+      assert(false);
+    }
+  }
+}
+
+void test_lib_resource_bytecode(void)
+{
+  inst_t instructions[] = {INST_PUSH(WORD, 1), INST_PUSH(WORD, 2),
+                           INST_PLUS(WORD), INST_HALT};
+  const prog_resources_t sections[] = {{0}, {true, 16, 1, 8, 4096}};
+  for (size_t i = 0; i < ARR_SIZE(sections); ++i)
+  {
+    const prog_t program = {0, ARR_SIZE(instructions), instructions,
+                            sections[i]};
+    byte_t bytes[128]    = {0};
+    const size_t size    = prog_bytecode_size(program);
+    const size_t written = prog_write_bytecode(program, bytes, sizeof(bytes));
+
+    prog_t read         = {0};
+    const size_t header = prog_read_header(&read, bytes, size);
+    inst_t read_instructions[ARR_SIZE(instructions)];
+    read.instructions    = read_instructions;
+    size_t read_size     = 0;
+    read_err_prog_t err  = prog_read_instructions(
+        &read, &read_size, bytes + header, size - header);
+
+    const prog_resources_t expected = sections[i], got = read.resources;
+    if (written != size || header == 0 || err.type != 0 ||
+        header + read_size != size || read.count != program.count ||
+        got.present != expected.present || got.stack != expected.stack ||
+        got.calls != expected.calls || got.registers != expected.registers ||
+        got.heap != expected.heap)
+    {
+      FAIL(__func__, "[%lu] -> Section not read back as written\n", i);
+      assert(false);
+    }
+  }
+
+  // Counts which clash with the flag for the section can't be written
+  byte_t bytes[PROG_HEADER_SIZE] = {0};
+  const prog_t clash = {0, PROG_RESOURCES, instructions, {0}};
+  if (prog_write_bytecode(clash, bytes, sizeof(bytes)) != 0)
+  {
+    FAIL(__func__, "Wrote a count of %lu\n", clash.count);
+    assert(false);
+  }
+
+  // A header flagging a section too short to be there is rejected
+  convert_word_to_bytes(PROG_RESOURCES | 1, bytes + WORD_SIZE);
+  prog_t read = {0};
+  if (prog_read_header(&read, bytes, sizeof(bytes)) != 0)
+  {
+    FAIL(__func__, "Read a header without its section%s\n", "");
+    assert(false);
+  }
+}
+
+TEST_SUITE(test_lib_resource, CREATE_TEST(test_lib_resource_analyse),
+           CREATE_TEST(test_lib_resource_bytecode), );
+
+#endif
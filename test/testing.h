@@ -55,12 +55,12 @@ struct Test
   SUCCESS("<" #SUITE ">", "%s", "Test suite passed!\n")
 #endif
 
-static size_t size_byte_array_to_string(const size_t n)
+static inline size_t size_byte_array_to_string(const size_t n)
 {
   return 3 + (4 * n) + (2 * (n - 1));
 }
 
-static void byte_array_to_string(const byte_t *bytes, size_t size_bytes,
+static inline void byte_array_to_string(const byte_t *bytes, size_t size_bytes,
                                  char *str)
 {
   str[0]   = '{';
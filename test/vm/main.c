@@ -0,0 +1,40 @@
+/* Copyright (C) 2026 Aryadev Chavali
+
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License Version 2 for
+ * more details.
+
+ * You should have received a copy of the GNU General Public License Version 2
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+ * Created: 2026-10-17
+ * Author: Aryadev Chavali
+ * Description:
+ */
+
+#include <vm/guard.h>
+
+#include "test-batch.h"
+#include "test-engines.h"
+#include "test-memo.h"
+#include "test-struct.h"
+#include "test-verify.h"
+
+int main(void)
+{
+#if VM_GUARD
+  // Overflows are only caught by the guard pages with the handler
+  if (!guard_install())
+  {
+    FAIL("test/vm", "Could not install the guard page handler\n%s", "");
+    return 1;
+  }
+#endif
+  RUN_TEST_SUITE(test_vm_struct);
+  RUN_TEST_SUITE(test_vm_batch);
+  RUN_TEST_SUITE(test_vm_engines);
+  RUN_TEST_SUITE(test_vm_memo);
+  RUN_TEST_SUITE(test_vm_verify);
+  return 0;
+}
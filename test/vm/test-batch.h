@@ -0,0 +1,149 @@
+/* Copyright (C) 2026 Aryadev Chavali
+
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License Version 2 for
+ * more details.
+
+ * You should have received a copy of the GNU General Public License Version 2
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+ * Created: 2026-10-17
+ * Author: Aryadev Chavali
+ * Description: Tests for batch.h
+ */
+
+#ifndef TEST_BATCH_H
+#define TEST_BATCH_H
+
+#include <lib/inst-macro.h>
+#include <vm/batch.h>
+
+#include "../testing.h"
+
+#define TEST_BATCH_LANES 3
+
+/* Store register 0 in a page and read it back into register 2 with a
+   word left below, then delete the page.  Lane n starts with n + 1 in
+   register 0 and, if below is set, n words on its stack. */
+static void test_vm_batch_run(bool below)
+{
+  inst_t instructions[] = {
+      INST_PUSH(WORD, 4),     INST_MALLOC(WORD, 0),   INST_MOV(WORD, 1),
+      INST_PUSH_REG(WORD, 1), INST_PUSH_REG(WORD, 0), INST_PUSH(WORD, 2),
+      INST_MSET(WORD, 0),     INST_PUSH(WORD, 7),     INST_PUSH_REG(WORD, 1),
+      INST_PUSH(WORD, 2),     INST_MGET(WORD, 0),     INST_MOV(WORD, 2),
+      INST_PUSH_REG(WORD, 1), INST_MDELETE,           INST_HALT,
+  };
+  const prog_t program = {0, ARR_SIZE(instructions), instructions, {0}};
+  const vm_config_t config = {256, 8 * WORD_SIZE, 16};
+  batch_t *batch           = batch_create(config, program, TEST_BATCH_LANES);
+  vm_t *vm                 = vm_create(config, program);
+  assert(batch && vm);
+
+  for (size_t lane = 0; lane < TEST_BATCH_LANES; ++lane)
+  {
+    VM_NTH_REGISTER(vm->registers, 0) = lane + 1;
+    vm->stack.ptr                     = below ? lane * WORD_SIZE : 0;
+    memset(vm->stack.data, 0, vm->stack.ptr);
+    batch_load(batch, lane, vm);
+  }
+
+  const size_t failed = batch_execute(batch);
+  for (size_t lane = 0; lane < TEST_BATCH_LANES; ++lane)
+  {
+    batch_store(batch, lane, vm);
+    const size_t sp = (below ? lane * WORD_SIZE : 0) + WORD_SIZE;
+    if (failed || batch->err[lane] != ERR_OK || vm->stack.ptr != sp ||
+        convert_bytes_to_word(vm->stack.data + sp - WORD_SIZE) != 7 ||
+        VM_NTH_REGISTER(vm->registers, 2) != lane + 1)
+    {
+      FAIL(__func__, "[%lu] -> err=%d sp=%lu reg2=%lu, expected sp=%lu\n",
+           lane, batch->err[lane], vm->stack.ptr,
+           VM_NTH_REGISTER(vm->registers, 2), sp);
+      assert(false);
+    }
+  }
+
+  vm_destroy(vm);
+  batch_destroy(batch);
+}
+
+void test_vm_batch_heap_uniform(void)
+{
+  test_vm_batch_run(false);
+}
+
+void test_vm_batch_heap_divergent(void)
+{
+  test_vm_batch_run(true);
+}
+
+/* Programs running off the end of a stack of a size no page or word is
+   a multiple of, which fail at the same point with and without
+   VM_GUARD, and in every lane just as in a vm from vm_create. */
+void test_vm_batch_overflow(void)
+{
+  const struct
+  {
+    inst_t input[2];
+    err_t err;
+    size_t sp, csp;
+  } tests[] = {
+      {{INST_PUSH(WORD, 1), INST_JUMP_ABS(0)},
+       ERR_STACK_OVERFLOW,
+       96,
+       0},
+      {{INST_PUSH(BYTE, 1), INST_JUMP_ABS(0)},
+       ERR_STACK_OVERFLOW,
+       VM_STACK_SLOTS ? 96 : 100,
+       0},
+      {{INST_PUSH(SHORT, 1), INST_JUMP_ABS(0)},
+       ERR_STACK_OVERFLOW,
+       VM_STACK_SLOTS ? 96 : 98,
+       0},
+      {{INST_CALL(0), INST_HALT}, ERR_CALL_STACK_OVERFLOW, 0, 10},
+  };
+  const vm_config_t config = {100, 8 * WORD_SIZE, 10};
+  for (size_t i = 0; i < ARR_SIZE(tests); ++i)
+  {
+    const prog_t program = {0, ARR_SIZE(tests[i].input),
+                            (inst_t *)tests[i].input, {0}};
+    vm_t *vm             = vm_create(config, program);
+    batch_t *batch       = batch_create(config, program, TEST_BATCH_LANES);
+    assert(vm && batch);
+
+    const err_t err = vm_execute_loop(vm);
+    if (err != tests[i].err || vm->stack.ptr != tests[i].sp ||
+        vm->call_stack.ptr != tests[i].csp)
+    {
+      FAIL(__func__, "[%lu] -> Expected %d sp=%lu csp=%lu, got %d %lu %lu\n",
+           i, tests[i].err, tests[i].sp, tests[i].csp, err, vm->stack.ptr,
+           vm->call_stack.ptr);
+      assert(false);
+    }
+
+    const word_t pc = vm->program.ptr;
+    batch_execute(batch);
+    for (size_t lane = 0; lane < TEST_BATCH_LANES; ++lane)
+    {
+      batch_store(batch, lane, vm);
+      if (batch->err[lane] != err || vm->stack.ptr != tests[i].sp ||
+          vm->call_stack.ptr != tests[i].csp || vm->program.ptr != pc)
+      {
+        FAIL(__func__, "[%lu] Lane %lu -> Got %d sp=%lu csp=%lu\n", i, lane,
+             batch->err[lane], vm->stack.ptr, vm->call_stack.ptr);
+        assert(false);
+      }
+    }
+
+    batch_destroy(batch);
+    vm_destroy(vm);
+  }
+}
+
+TEST_SUITE(test_vm_batch, CREATE_TEST(test_vm_batch_heap_uniform),
+           CREATE_TEST(test_vm_batch_heap_divergent),
+           CREATE_TEST(test_vm_batch_overflow), );
+
+#endif
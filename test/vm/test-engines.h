@@ -0,0 +1,384 @@
+/* Copyright (C) 2026 Aryadev Chavali
+
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License Version 2 for
+ * more details.
+
+ * You should have received a copy of the GNU General Public License Version 2
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+ * Created: 2026-10-17
+ * Author: Aryadev Chavali
+ * Description: Tests of every engine against vm_execute_loop
+ */
+
+#ifndef TEST_ENGINES_H
+#define TEST_ENGINES_H
+
+#include <lib/inst-macro.h>
+#include <vm/batch.h>
+#include <vm/ir.h>
+#include <vm/jit.h>
+#include <vm/runtime.h>
+#include <vm/verify.h>
+
+#include "../testing.h"
+
+/* Every engine promises the same result and the same state of the vm
+   as vm_execute_loop, on success or error.  So each program below is
+   run by vm_execute_loop and by the engine under test on vms from
+   vm_create, then the two vms compared.  No page address is left on
+   the stack or in a register, as those differ between vms. */
+
+#define TEST_ENGINES_MAX 24
+
+struct TestEnginesProgram
+{
+  const char *name;
+  inst_t input[TEST_ENGINES_MAX];
+  size_t count;
+};
+
+#define TEST_ENGINES_PROGRAM(NAME, ...) \
+  {NAME, {__VA_ARGS__}, ARR_SIZE(((inst_t[]){__VA_ARGS__}))}
+
+
+/* Stack and call stacks sizes no page or word is a multiple of, see
+   test_vm_batch_overflow. */
+static const vm_config_t test_engines_config = {100, 8 * WORD_SIZE, 10};
+
+#define TEST_ENGINES_PAGES 8
+
+/* Pages of heap not yet deleted, up to TEST_ENGINES_PAGES of them.
+   Pages whose last copy is dropped may be scratch pages, see escape.h,
+   so those in use count as well. */
+static size_t test_engines_pages(const heap_t *heap, const page_t **pages)
+{
+  size_t count = 0;
+  for (size_t i = 0; i < HEAP_SIZE(*heap); ++i)
+  {
+    const page_t *page = DARR_AT(page_t *, heap->page_vec.data, i);
+    if (page && count < TEST_ENGINES_PAGES)
+      pages[count++] = page;
+  }
+  for (size_t i = heap->scratch_free;
+       i < heap->scratch.used / sizeof(page_t *) && count < TEST_ENGINES_PAGES;
+       ++i)
+    pages[count++] = DARR_AT(page_t *, heap->scratch.data, i);
+  return count;
+}
+
+/* Whether both heaps have the same pages, in any order. */
+static bool test_engines_same_heap(const heap_t *a, const heap_t *b)
+{
+  const page_t *x[TEST_ENGINES_PAGES], *y[TEST_ENGINES_PAGES];
+  const size_t count = test_engines_pages(a, x);
+  if (test_engines_pages(b, y) != count)
+    return false;
+  for (size_t i = 0; i < count; ++i)
+  {
+    size_t j = 0;
+    while (j < count &&
+           (!y[j] || y[j]->available != x[i]->available ||
+            memcmp(y[j]->data, x[i]->data, x[i]->available) != 0))
+      ++j;
+    if (j == count)
+      return false;
+    y[j] = NULL;
+  }
+  return true;
+}
+
+static bool test_engines_same(const vm_t *a, const vm_t *b)
+{
+  return a->program.ptr == b->program.ptr && a->stack.ptr == b->stack.ptr &&
+         memcmp(a->stack.data, b->stack.data, a->stack.ptr) == 0 &&
+         memcmp(a->registers.bytes, b->registers.bytes, a->registers.size) ==
+             0 &&
+         a->call_stack.ptr == b->call_stack.ptr &&
+         memcmp(a->call_stack.address_pointers, b->call_stack.address_pointers,
+                a->call_stack.ptr * sizeof(word_t)) == 0 &&
+         test_engines_same_heap(&a->heap, &b->heap);
+}
+
+typedef err_t (*test_engine_f)(vm_t *);
+
+/* Run every program with engine, failing test if it disagrees with
+   vm_execute_loop. */
+static void test_engines_run(const char *test, test_engine_f engine)
+{
+  const struct TestEnginesProgram programs[] = {
+      TEST_ENGINES_PROGRAM(
+          "alu", INST_PUSH(BYTE, 200), INST_PUSH(BYTE, 100), INST_PLUS(BYTE),
+          INST_PUSH(SHORT, 0x1234), INST_PUSH(SHORT, 0x0F0F), INST_AND(SHORT),
+          INST_PUSH(HWORD, 0xFFFF0000), INST_NOT(HWORD), INST_PUSH(WORD, 3),
+          INST_PUSH(WORD, 5), INST_SUB(WORD), INST_PUSH(WORD, 7),
+          INST_PUSH(WORD, 6), INST_MULT(WORD), INST_XOR(WORD),
+          INST_PUSH(BYTE, 0xFF), INST_PUSH(BYTE, 1), INST_LT(SBYTE),
+          INST_PUSH(HWORD, 0x80000000), INST_PUSH(HWORD, 1), INST_GT(SHWORD),
+          INST_EQ(BYTE), INST_OR(BYTE), INST_HALT),
+      TEST_ENGINES_PROGRAM(
+          "registers", INST_PUSH(WORD, 0x0102030405060708), INST_MOV(WORD, 3),
+          INST_PUSH_REG(BYTE, 25), INST_PUSH_REG(SHORT, 13),
+          INST_PUSH_REG(HWORD, 6), INST_DUP(BYTE, 2), INST_MOV(SHORT, 2),
+          INST_POP(HWORD), INST_PUSH_REG(WORD, 3), INST_DUP(WORD, 0),
+          INST_MOV(WORD, 7), INST_HALT),
+      // Sum 10 down to 1 into register 1, through the fused sequences
+      TEST_ENGINES_PROGRAM(
+          "loop", INST_PUSH(WORD, 10), INST_MOV(WORD, 0), INST_PUSH(WORD, 0),
+          INST_MOV(WORD, 1), INST_PUSH_REG(WORD, 1), INST_PUSH_REG(WORD, 0),
+          INST_PLUS(WORD), INST_MOV(WORD, 1), INST_PUSH(WORD, 1),
+          INST_PUSH_REG(WORD, 0), INST_SUB(WORD), INST_MOV(WORD, 0),
+          INST_PUSH(WORD, 0), INST_PUSH_REG(WORD, 0), INST_LT(WORD),
+          INST_JUMP_IF(BYTE, 4), INST_PUSH_REG(WORD, 1), INST_PUSH(WORD, 3),
+          INST_MULT(WORD), INST_MOV(WORD, 2), INST_HALT),
+      TEST_ENGINES_PROGRAM("forward", INST_PUSH(SHORT, 0), INST_JUMP_IF(SHORT, 4),
+                           INST_PUSH(SHORT, 1), INST_JUMP_IF(SHORT, 5),
+                           INST_PUSH(BYTE, 1), INST_JUMP_ABS(7),
+                           INST_PUSH(BYTE, 2), INST_HALT),
+      TEST_ENGINES_PROGRAM("calls", INST_PUSH(WORD, 3), INST_CALL(6),
+                           INST_PUSH(WORD, 4), INST_CALL(6), INST_PLUS(WORD),
+                           INST_HALT, INST_DUP(WORD, 0), INST_MULT(WORD),
+                           INST_RET),
+      // Factorial of 5, recursively
+      TEST_ENGINES_PROGRAM(
+          "recursion", INST_PUSH(WORD, 5), INST_CALL(3), INST_HALT,
+          INST_DUP(WORD, 0), INST_JUMP_IF(WORD, 8), INST_POP(WORD),
+          INST_PUSH(WORD, 1), INST_RET, INST_PUSH(WORD, 1), INST_DUP(WORD, 1),
+          INST_SUB(WORD), INST_CALL(3), INST_MULT(WORD), INST_RET),
+      TEST_ENGINES_PROGRAM("halt in call", INST_CALL(2), INST_HALT,
+                           INST_PUSH(BYTE, 1), INST_HALT),
+      TEST_ENGINES_PROGRAM("end of program", INST_PUSH(WORD, 1),
+                           INST_PUSH(WORD, 2)),
+      // Leaves one page holding 0xAB, with its size in register 0
+      TEST_ENGINES_PROGRAM(
+          "heap", INST_PUSH(WORD, 4), INST_MALLOC(WORD, 0), INST_MOV(WORD, 1),
+          INST_PUSH_REG(WORD, 1), INST_PUSH(WORD, 9), INST_PUSH(WORD, 2),
+          INST_MSET(WORD, 0), INST_PUSH_REG(WORD, 1), INST_PUSH(WORD, 2),
+          INST_MGET(WORD, 0), INST_PUSH_REG(WORD, 1), INST_MDELETE,
+          INST_PUSH(WORD, 0), INST_MOV(WORD, 1), INST_PUSH(WORD, 3),
+          INST_MALLOC(BYTE, 0), INST_DUP(WORD, 0), INST_PUSH(BYTE, 0xAB),
+          INST_PUSH(WORD, 1), INST_MSET(BYTE, 0), INST_MSIZE, INST_POP(WORD),
+          INST_HALT),
+      TEST_ENGINES_PROGRAM("stack underflow", INST_PUSH(BYTE, 1),
+                           INST_PLUS(WORD)),
+      TEST_ENGINES_PROGRAM("dup underflow", INST_PUSH(WORD, 1), INST_DUP(WORD, 1)),
+      TEST_ENGINES_PROGRAM("stack overflow", INST_PUSH(WORD, 1),
+                           INST_JUMP_ABS(0)),
+      TEST_ENGINES_PROGRAM("byte overflow", INST_PUSH(BYTE, 1), INST_JUMP_ABS(0)),
+      TEST_ENGINES_PROGRAM("register overflow", INST_PUSH_REG(SHORT, 0),
+                           INST_JUMP_ABS(0)),
+      TEST_ENGINES_PROGRAM("call stack overflow", INST_CALL(0)),
+      TEST_ENGINES_PROGRAM("call stack underflow", INST_RET),
+      TEST_ENGINES_PROGRAM("invalid register", INST_PUSH(WORD, 1),
+                           INST_PUSH_REG(WORD, 100)),
+      // Fails in the last instruction of a fused sequence
+      TEST_ENGINES_PROGRAM("invalid fused register", INST_PUSH_REG(WORD, 0),
+                           INST_PUSH(WORD, 1), INST_PLUS(WORD),
+                           INST_MOV(WORD, 100)),
+      TEST_ENGINES_PROGRAM("invalid jump", INST_PUSH(BYTE, 1),
+                           INST_JUMP_IF(BYTE, 100)),
+      TEST_ENGINES_PROGRAM("invalid call", INST_PUSH(BYTE, 1), INST_CALL(100)),
+      TEST_ENGINES_PROGRAM("invalid page", INST_PUSH(WORD, 8), INST_MDELETE),
+      TEST_ENGINES_PROGRAM("out of bounds", INST_PUSH(WORD, 1),
+                           INST_MALLOC(BYTE, 0), INST_PUSH(WORD, 5),
+                           INST_MGET(BYTE, 0)),
+      TEST_ENGINES_PROGRAM("invalid opcode", INST_PUSH(BYTE, 1),
+                           ((inst_t){.opcode = NUMBER_OF_OPCODES})),
+  };
+
+  for (size_t i = 0; i < ARR_SIZE(programs); ++i)
+  {
+    const struct TestEnginesProgram *p = programs + i;
+    const prog_t program = {0, p->count, (inst_t *)p->input, {0}};
+    vm_t *expected       = vm_create(test_engines_config, program);
+    vm_t *got            = vm_create(test_engines_config, program);
+    assert(expected && got);
+
+    const err_t want = vm_execute_loop(expected);
+    const err_t err  = engine(got);
+    if (err != want || !test_engines_same(expected, got))
+    {
+      FAIL(test,
+           "[%s] -> Got %s pc=%lu sp=%lu csp=%lu, expected %s pc=%lu "
+           "sp=%lu csp=%lu\n",
+           p->name, err_as_cstr(err), got->program.ptr, got->stack.ptr,
+           got->call_stack.ptr, err_as_cstr(want), expected->program.ptr,
+           expected->stack.ptr, expected->call_stack.ptr);
+      assert(false);
+    }
+
+    vm_destroy(got);
+    vm_destroy(expected);
+  }
+}
+
+void test_vm_engines_all(void)
+{
+  test_engines_run(__func__, vm_execute_all);
+}
+
+#if VM_THREADED
+/* Decoded once at load time rather than on each run, as avm does. */
+static err_t test_engines_decoded(vm_t *vm)
+{
+  decoded_inst_t *decoded =
+      calloc(VM_DECODED_SIZE(vm->program.data), sizeof(*decoded));
+  assert(decoded);
+  vm_decode_program(vm, decoded);
+  const err_t err     = vm_execute_threaded(vm);
+  vm->program.decoded = NULL;
+  free(decoded);
+  return err;
+}
+#endif
+
+/* The threaded engine, with its fused sequences and cached top of
+   stack where the build has them. */
+void test_vm_engines_threaded(void)
+{
+#if VM_THREADED
+  test_engines_run(__func__, vm_execute_threaded);
+  test_engines_run(__func__, test_engines_decoded);
+#endif
+}
+
+static err_t test_engines_ir(vm_t *vm)
+{
+  ir_prog_t ir = {0};
+  ir_translate(vm->program.data, &ir);
+  const err_t err = vm_execute_ir(vm, &ir);
+  ir_free(&ir);
+  return err;
+}
+
+void test_vm_engines_ir(void)
+{
+  test_engines_run(__func__, test_engines_ir);
+}
+
+#if VM_JIT
+static err_t test_engines_jit(vm_t *vm)
+{
+  jit_t jit = {0};
+  assert(jit_compile(vm->program.data, &jit));
+  const err_t err = vm_execute_jit(vm, &jit);
+  jit_free(&jit);
+  return err;
+}
+#endif
+
+/* As avm --jit-diff does for one program, on every build with the
+   JIT. */
+void test_vm_engines_jit(void)
+{
+#if VM_JIT
+  test_engines_run(__func__, test_engines_jit);
+#endif
+}
+
+static err_t test_engines_verified(vm_t *vm)
+{
+  verify_t verify = {0};
+  verify_program(vm->program.data, &verify);
+  return vm_execute_verified(vm, &verify);
+}
+
+/* Unchecked for the programs which verify, otherwise checked as in
+   vm_execute_all. */
+void test_vm_engines_verified(void)
+{
+  test_engines_run(__func__, test_engines_verified);
+}
+
+static err_t test_engines_traced(vm_t *vm)
+{
+  FILE *fp = tmpfile();
+  assert(fp);
+  const err_t err = vm_execute_traced(vm, fp);
+  fclose(fp);
+  return err;
+}
+
+void test_vm_engines_traced(void)
+{
+  test_engines_run(__func__, test_engines_traced);
+}
+
+/* Runs of vm_execute_n, resumed until they halt or fail.  A run must
+   get somewhere before pausing or stopping, so there's a bound on how
+   many are needed. */
+static err_t test_engines_n(vm_t *vm, word_t budget, const atomic_bool *stop)
+{
+  run_t run = {0};
+  err_t err = ERR_OK;
+  for (size_t runs = 0; runs < 1000; ++runs)
+  {
+    run = (run_t){budget, stop, RUN_HALTED};
+    err = vm_execute_n(vm, &run);
+    if (run.status != RUN_PAUSED && run.status != RUN_STOPPED)
+      return err;
+  }
+  FAIL(__func__, "Still %s after 1000 runs\n",
+       run.status == RUN_PAUSED ? "paused" : "stopped");
+  assert(false);
+  return err;
+}
+
+static err_t test_engines_n_all(vm_t *vm)
+{
+  return test_engines_n(vm, WORD_MAX, NULL);
+}
+
+static err_t test_engines_n_one(vm_t *vm)
+{
+  return test_engines_n(vm, 1, NULL);
+}
+
+static err_t test_engines_n_stopped(vm_t *vm)
+{
+  static const atomic_bool stop = true;
+  return test_engines_n(vm, WORD_MAX, &stop);
+}
+
+void test_vm_engines_n(void)
+{
+  test_engines_run(__func__, test_engines_n_all);
+  test_engines_run(__func__, test_engines_n_one);
+  test_engines_run(__func__, test_engines_n_stopped);
+}
+
+/* Two lanes running in lockstep, the second stored back into vm along
+   with its heap. */
+static err_t test_engines_batch(vm_t *vm)
+{
+  batch_t *batch = batch_create(test_engines_config, vm->program.data, 2);
+  assert(batch);
+  batch_load(batch, 0, vm);
+  batch_load(batch, 1, vm);
+  batch_execute(batch);
+  batch_store(batch, 1, vm);
+  heap_stop(&vm->heap);
+  vm->heap        = batch->heaps[1];
+  batch->heaps[1] = (heap_t){0};
+  const err_t err = batch->err[1];
+  batch_destroy(batch);
+  return err;
+}
+
+void test_vm_engines_batch(void)
+{
+  test_engines_run(__func__, test_engines_batch);
+}
+
+TEST_SUITE(test_vm_engines, CREATE_TEST(test_vm_engines_all),
+           CREATE_TEST(test_vm_engines_threaded),
+           CREATE_TEST(test_vm_engines_ir),
+           CREATE_TEST(test_vm_engines_jit),
+           CREATE_TEST(test_vm_engines_verified),
+           CREATE_TEST(test_vm_engines_traced),
+           CREATE_TEST(test_vm_engines_n),
+           CREATE_TEST(test_vm_engines_batch), );
+
+#endif
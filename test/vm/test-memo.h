@@ -0,0 +1,64 @@
+/* Copyright (C) 2026 Aryadev Chavali
+
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License Version 2 for
+ * more details.
+
+ * You should have received a copy of the GNU General Public License Version 2
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+ * Created: 2026-10-17
+ * Author: Aryadev Chavali
+ * Description: Tests for memo.h
+ */
+
+#ifndef TEST_MEMO_H
+#define TEST_MEMO_H
+
+#include <lib/inst-macro.h>
+#include <vm/memo.h>
+
+#include "../testing.h"
+
+/* A result remembered by a vm with room to run the call is used by
+   one whose stack it exactly fills.  Only the threaded engine without
+   VM_STACK_SLOTS memoises calls, see vm_decode_program, so it's run
+   directly rather than through vm_execute_all, which traces when
+   VERBOSE >= 2. */
+void test_vm_memo_full_stack(void)
+{
+#if VM_THREADED && !VM_STACK_SLOTS
+  inst_t instructions[] = {
+      INST_PUSH(BYTE, 2), INST_CALL(3),    INST_HALT,
+      INST_PUSH(BYTE, 1), INST_PLUS(BYTE), INST_RET,
+  };
+  const prog_t program = {0, ARR_SIZE(instructions), instructions, {0}};
+  memo_t memo          = {0};
+  assert(memo_create(&memo, program, 16, MEMO_LRU));
+
+  const size_t stack_sizes[] = {16, 1};
+  for (size_t i = 0; i < ARR_SIZE(stack_sizes); ++i)
+  {
+    vm_t *vm = vm_create((vm_config_t){stack_sizes[i], 8 * WORD_SIZE, 16},
+                         program);
+    assert(vm);
+    vm->memo        = &memo;
+    const err_t err = vm_execute_threaded(vm);
+    if (err != ERR_OK || vm->stack.ptr != 1 || vm->stack.data[0] != 3 ||
+        memo.hits != i || memo.misses != 1)
+    {
+      FAIL(__func__, "[%lu] -> Got %d sp=%lu, %lu hits %lu misses\n", i, err,
+           vm->stack.ptr, memo.hits, memo.misses);
+      assert(false);
+    }
+    vm_destroy(vm);
+  }
+
+  memo_free(&memo);
+#endif
+}
+
+TEST_SUITE(test_vm_memo, CREATE_TEST(test_vm_memo_full_stack), );
+
+#endif
@@ -0,0 +1,57 @@
+/* Copyright (C) 2026 Aryadev Chavali
+
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License Version 2 for
+ * more details.
+
+ * You should have received a copy of the GNU General Public License Version 2
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+ * Created: 2026-10-17
+ * Author: Aryadev Chavali
+ * Description: Tests for struct.h
+ */
+
+#ifndef TEST_STRUCT_H
+#define TEST_STRUCT_H
+
+#include <stdint.h>
+
+#include <lib/inst-macro.h>
+#include <vm/struct.h>
+
+#include "../testing.h"
+
+void test_vm_struct_create(void)
+{
+  inst_t instructions[] = {INST_HALT};
+  const prog_t program  = {0, ARR_SIZE(instructions), instructions, {0}};
+  vm_t *vm = vm_create((vm_config_t){100, 3 * WORD_SIZE, 10}, program);
+  if (!vm || vm->stack.max != 100 || vm->registers.size != 3 * WORD_SIZE ||
+      vm->call_stack.max != 10 || (uintptr_t)vm % VM_CACHE_LINE != 0 ||
+      VM_NTH_REGISTER(vm->registers, 2) != 0)
+  {
+    FAIL(__func__, "Expected a vm of the sizes asked for%s\n", "");
+    assert(false);
+  }
+  vm_destroy(vm);
+
+  // Sizes which wrap when rounded up to cache lines, or added up
+  const vm_config_t configs[] = {
+      {SIZE_MAX, WORD_SIZE, 1},
+      {WORD_SIZE, SIZE_MAX - 1, 1},
+      {WORD_SIZE, WORD_SIZE, SIZE_MAX / WORD_SIZE},
+      {SIZE_MAX / 2, WORD_SIZE, SIZE_MAX / (2 * WORD_SIZE)},
+  };
+  for (size_t i = 0; i < ARR_SIZE(configs); ++i)
+    if (vm_create(configs[i], program))
+    {
+      FAIL(__func__, "[%lu] -> Expected no vm\n", i);
+      assert(false);
+    }
+}
+
+TEST_SUITE(test_vm_struct, CREATE_TEST(test_vm_struct_create), );
+
+#endif
@@ -0,0 +1,60 @@
+/* Copyright (C) 2026 Aryadev Chavali
+
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License Version 2 for
+ * more details.
+
+ * You should have received a copy of the GNU General Public License Version 2
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+ * Created: 2026-10-17
+ * Author: Aryadev Chavali
+ * Description: Tests for verify.h
+ */
+
+#ifndef TEST_VERIFY_H
+#define TEST_VERIFY_H
+
+#include <lib/inst-macro.h>
+#include <vm/verify.h>
+
+#include "../testing.h"
+
+/* A routine failing leaves the vm as the checked engine would, with
+   the operands it popped gone. */
+void test_vm_verify_routine_error(void)
+{
+  inst_t instructions[] = {
+      INST_PUSH(WORD, 1),
+      INST_PUSH(WORD, 5),
+      INST_MDELETE,
+      INST_HALT,
+  };
+  const prog_t program = {0, ARR_SIZE(instructions), instructions, {0}};
+  const vm_config_t config = {256, 8 * WORD_SIZE, 16};
+  verify_t verify          = {0};
+  vm_t *checked            = vm_create(config, program);
+  vm_t *vm                 = vm_create(config, program);
+  assert(checked && vm);
+
+  const err_t expected = vm_execute_all(checked);
+  const bool valid     = verify_program(program, &verify);
+  const err_t err      = vm_execute_verified(vm, &verify);
+  if (!valid || expected != ERR_INVALID_PAGE_ADDRESS || err != expected ||
+      vm->stack.ptr != checked->stack.ptr ||
+      vm->program.ptr != checked->program.ptr)
+  {
+    FAIL(__func__, "Expected err=%d sp=%lu pc=%lu, got err=%d sp=%lu pc=%lu\n",
+         expected, checked->stack.ptr, checked->program.ptr, err,
+         vm->stack.ptr, vm->program.ptr);
+    assert(false);
+  }
+
+  vm_destroy(vm);
+  vm_destroy(checked);
+}
+
+TEST_SUITE(test_vm_verify, CREATE_TEST(test_vm_verify_routine_error), );
+
+#endif
@@ -0,0 +1,212 @@
+/* Copyright (C) 2026 Aryadev Chavali
+
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License Version 2 for
+ * more details.
+
+ * You should have received a copy of the GNU General Public License Version 2
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+ * Created: 2026-10-16
+ * Author: Aryadev Chavali
+ * Description: Optimiser rewriting bytecode files
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <lib/base.h>
+#include <lib/cfg.h>
+#include <lib/darr.h>
+#include <lib/inst.h>
+#include <lib/opt.h>
+#include <lib/resource.h>
+
+static const struct
+{
+  const char *option;
+  opt_pass_t pass;
+} passes[] = {
+    {"--no-fold", OPT_FOLD},
+    {"--no-thread", OPT_THREAD},
+    {"--no-registers", OPT_REGISTERS},
+    {"--no-unreachable", OPT_UNREACHABLE},
+    {"--no-strip", OPT_STRIP},
+    {"--no-tail", OPT_TAIL},
+    {"--no-inline", OPT_INLINE},
+};
+
+void usage(const char *program_name, FILE *out)
+{
+  fprintf(out,
+          "Usage: %s [OPTIONS] FILE\n"
+          "\t FILE: Bytecode file to optimise\n"
+          "\tOptions:\n"
+          "\t\t --output OUT: Write the optimised bytecode to OUT rather than "
+          "back to FILE\n"
+          "\t\t --profile PROFILE: Lay out blocks by PROFILE, from avm "
+          "--profile-output, before optimising\n"
+          "\t\t --no-fold: Don't fold constants\n"
+          "\t\t --no-thread: Don't thread jumps\n"
+          "\t\t --no-registers: Don't remove PUSH_REGISTER, MOV pairs\n"
+          "\t\t --no-unreachable: Don't remove unreachable instructions\n"
+          "\t\t --no-strip: Don't remove NOOPs\n"
+          "\t\t --no-tail: Don't make tail calls jumps\n"
+          "\t\t --no-inline: Don't inline small subroutines\n"
+          "\t\t --no-resources: Don't write the resources the program "
+          "needs into its header\n",
+          program_name);
+}
+
+/* Lay out the blocks of program by the profile in the file path. */
+bool layout(prog_t *program, const char *path)
+{
+  FILE *fp = fopen(path, "r");
+  if (!fp)
+  {
+    FAIL("ERROR", "Could not open `%s`\n", path);
+    return false;
+  }
+  cfg_t cfg      = {0};
+  word_t *counts = NULL;
+  bool ok        = cfg_build(*program, &cfg) &&
+            (counts = calloc(MAX(cfg.count, 1), sizeof(*counts)));
+  if (!ok)
+    FAIL("ERROR", "Could not build the control flow graph%s\n", "");
+  else if (!(ok = cfg_read_profile(&cfg, counts, fp)))
+    FAIL("ERROR", "`%s` isn't a profile of this program\n", path);
+  else if (!(ok = opt_layout(program, &cfg, counts)))
+    FAIL("ERROR", "Could not lay out the program%s\n", "");
+  fclose(fp);
+  free(counts);
+  cfg_free(&cfg);
+  return ok;
+}
+
+int main(int argc, char *argv[])
+{
+  const char *filename = NULL, *output = NULL, *profile = NULL;
+  unsigned enabled     = OPT_ALL;
+  bool resources       = true;
+  for (int i = 1; i < argc; ++i)
+  {
+    size_t pass = 0;
+    for (; pass < ARR_SIZE(passes); ++pass)
+      if (strcmp(argv[i], passes[pass].option) == 0)
+        break;
+    if (pass < ARR_SIZE(passes))
+      enabled &= ~passes[pass].pass;
+    else if (strcmp(argv[i], "--no-resources") == 0)
+      resources = false;
+    else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc)
+      output = argv[++i];
+    else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc)
+      profile = argv[++i];
+    else if (argv[i][0] != '-' && !filename)
+      filename = argv[i];
+    else
+    {
+      usage(argv[0], stderr);
+      return 1;
+    }
+  }
+  if (!filename)
+  {
+    usage(argv[0], stderr);
+    return 1;
+  }
+  if (!output)
+    output = filename;
+
+  FILE *fp = fopen(filename, "rb");
+  if (!fp)
+  {
+    FAIL("ERROR", "Could not open `%s`\n", filename);
+    return 1;
+  }
+  darr_t fp_bytes = darr_read_file(fp);
+  fclose(fp);
+
+  prog_t program = {0};
+  size_t header_read =
+      prog_read_header(&program, fp_bytes.data, fp_bytes.available);
+  if (!header_read)
+  {
+    FAIL("ERROR", "Could not deserialise program header in `%s`\n", filename);
+    return 1;
+  }
+
+  program.instructions = calloc(program.count, sizeof(*program.instructions));
+  size_t bytes_read    = 0;
+  read_err_prog_t read_err =
+      prog_read_instructions(&program, &bytes_read, fp_bytes.data + header_read,
+                             fp_bytes.available - header_read);
+  if (bytes_read == 0)
+  {
+    FAIL("ERROR", "%s [%lu]: Could not deserialise instructions\n", filename,
+         read_err.index);
+    return 1;
+  }
+  free(fp_bytes.data);
+
+#if VERBOSE >= 1
+  const word_t count = program.count;
+#endif
+  // The profile is of the program as it was run, so layout comes first
+  if (profile && !layout(&program, profile))
+    return 1;
+
+  opt_stats_t stats = {0};
+  if (!opt_program(&program, enabled, &stats))
+  {
+    FAIL("ERROR", "Could not optimise `%s`\n", filename);
+    return 1;
+  }
+
+#if VERBOSE >= 1
+  SUCCESS("OPT", "%lu instructions to %lu in %lu rounds\n", count,
+          program.count, stats.rounds);
+  INFO("OPT",
+       "folded=%lu threaded=%lu registers=%lu tails=%lu inlined=%lu "
+       "unreachable=%lu stripped=%lu\n",
+       stats.folded, stats.threaded, stats.registers, stats.tails,
+       stats.inlined, stats.unreachable, stats.stripped);
+#endif
+
+  // Any section read in is out of date now
+  program.resources = (prog_resources_t){0};
+  if (resources)
+    resource_analyse(program, &program.resources);
+
+#if VERBOSE >= 1
+  if (program.resources.present)
+    INFO("OPT", "stack=%lu calls=%lu registers=%lu heap=%lu\n",
+         program.resources.stack, program.resources.calls,
+         program.resources.registers, program.resources.heap);
+  else if (resources)
+    INFO("OPT", "Resources aren't bounded, so aren't written%s\n", "");
+#endif
+
+  darr_t bytes = {0};
+  darr_init(&bytes, prog_bytecode_size(program));
+  bytes.used = prog_write_bytecode(program, bytes.data, bytes.available);
+  free(program.instructions);
+  if (bytes.used == 0)
+  {
+    FAIL("ERROR", "Could not serialise the optimised `%s`\n", filename);
+    return 1;
+  }
+
+  fp = fopen(output, "wb");
+  if (!fp)
+  {
+    FAIL("ERROR", "Could not open `%s`\n", output);
+    return 1;
+  }
+  darr_write_file(&bytes, fp);
+  fclose(fp);
+  free(bytes.data);
+  return 0;
+}
@@ -0,0 +1,499 @@
+/* Copyright (C) 2026 Aryadev Chavali
+
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License Version 2 for
+ * more details.
+
+ * You should have received a copy of the GNU General Public License Version 2
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+ * Created: 2026-10-16
+ * Author: Aryadev Chavali
+ * Description: Ahead of time translator from bytecode to C
+ */
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <lib/base.h>
+#include <lib/darr.h>
+#include <lib/inst.h>
+
+/* Translation
+
+   A program is translated into one function, err_t NAME(vm_t *), which
+   loads the program into the vm then executes it like vm_execute_all.
+   Every instruction has a label, jumps and calls are gotos, and RET
+   goes through a switch over every address of the program.
+
+   The stack pointer is kept in a local while running.  Heap, print
+   and DUP instructions are left to the runtime: the vm is synchronised
+   and vm_execute runs the instruction (see call_runtime).  Any other
+   instruction which would fail traps the same way, so errors and the
+   state of the vm on error are the same as under the interpreter.
+
+   The generated code only depends on vm/runtime.h, so it can be
+   compiled into an executable linked with the runtime or into a
+   shared object loaded by some host.
+*/
+
+static const size_t sizes[]              = {BYTE_SIZE, SHORT_SIZE, HWORD_SIZE,
+                                            WORD_SIZE};
+static const char *const members[]       = {"as_byte", "as_short", "as_hword",
+                                            "as_word"};
+static const char *const signed_types[]  = {"sbyte_t", "sshort_t", "shword_t",
+                                            "sword_t"};
+static const char *const prelude =
+    "#include <string.h>\n\n"
+    "#include <vm/runtime.h>\n"
+    "\n"
+    "#if VM_STACK_SLOTS\n"
+    "#error \"avm2c: Translated for the byte exact stack\"\n"
+    "#endif\n"
+    "\n"
+    "static inline word_t avm2c_read(const byte_t *bytes, size_t size)\n"
+    "{\n"
+    "  word_t datum = 0;\n"
+    "  for (size_t i = 0; i < size; ++i)\n"
+    "    datum |= ((word_t)bytes[i]) << (i * 8);\n"
+    "  return datum;\n"
+    "}\n"
+    "\n"
+    "static inline void avm2c_write(byte_t *bytes, word_t datum, size_t size)\n"
+    "{\n"
+    "  for (size_t i = 0; i < size; ++i)\n"
+    "    bytes[i] = (datum >> (i * 8)) & 0xFF;\n"
+    "}\n"
+    "\n"
+    "#define AVM2C_TRAP(PTR)    \\\n"
+    "  do                        \\\n"
+    "  {                         \\\n"
+    "    vm->stack.ptr   = sp;   \\\n"
+    "    vm->program.ptr = PTR;  \\\n"
+    "    goto trap;              \\\n"
+    "  } while (0)\n";
+
+struct Translation
+{
+  FILE *out;
+  prog_t program;
+  bool traps;
+};
+
+#define EMIT(T, ...) fprintf((T)->out, __VA_ARGS__)
+
+static void trap_if(struct Translation *t, word_t i, const char *condition)
+{
+  t->traps = true;
+  EMIT(t, "  if (%s)\n    AVM2C_TRAP(%" PRIu64 ");\n", condition, i);
+}
+
+static void check_register(struct Translation *t, word_t i, word_t reg,
+                           size_t size)
+{
+  char condition[64];
+  snprintf(condition, sizeof(condition),
+           "%" PRIu64 "ULL >= registers_size / %lu", reg, size);
+  trap_if(t, i, condition);
+}
+
+static void check_underflow(struct Translation *t, word_t i, size_t size)
+{
+  char condition[64];
+  snprintf(condition, sizeof(condition), "sp < %lu", size);
+  trap_if(t, i, condition);
+}
+
+// As done by the vm_push routines, where a byte has no margin
+static void check_overflow(struct Translation *t, word_t i, size_t margin)
+{
+  char condition[64];
+  if (margin == 0)
+    snprintf(condition, sizeof(condition), "sp >= max");
+  else
+    snprintf(condition, sizeof(condition), "sp + %lu >= max", margin);
+  trap_if(t, i, condition);
+}
+
+/* Execute instruction i through vm_execute, for opcodes left to the
+   runtime.  Its routines aren't called directly as they raise a trap
+   rather than returning an error in a VM_TRAP build. */
+static void call_runtime(struct Translation *t, word_t i)
+{
+  EMIT(t,
+       "  vm->stack.ptr   = sp;\n"
+       "  vm->program.ptr = %" PRIu64 ";\n"
+       "  err             = vm_execute(vm);\n"
+       "  if (err)\n"
+       "    return err;\n"
+       "  sp = vm->stack.ptr;\n",
+       i);
+}
+
+static void translate_inst(struct Translation *t, word_t i)
+{
+  static_assert(NUMBER_OF_OPCODES == 115, "translate_inst: Out of date");
+  const inst_t inst     = t->program.instructions[i];
+  const opcode_t opcode = inst.opcode;
+  const word_t operand  = inst.operand.as_word;
+  const bool valid      = operand < t->program.count;
+  EMIT(t, "inst_%" PRIu64 ": // %s\n", i, opcode_as_cstr(opcode));
+
+  if (opcode == OP_NOOP)
+    EMIT(t, "  ;\n");
+  else if (opcode == OP_HALT)
+    EMIT(t,
+         "  vm->stack.ptr   = sp;\n"
+         "  vm->program.ptr = %" PRIu64 ";\n"
+         "  return ERR_OK;\n",
+         i);
+  else if (UNSIGNED_OPCODE_IS_TYPE(opcode, OP_PUSH))
+  {
+    const size_t type = OPCODE_DATA_TYPE(opcode, OP_PUSH);
+    word_t datum      = inst.operand.as_word;
+    if (type == DATA_TYPE_BYTE)
+      datum = inst.operand.as_byte;
+    else if (type == DATA_TYPE_SHORT)
+      datum = inst.operand.as_short;
+    else if (type == DATA_TYPE_HWORD)
+      datum = inst.operand.as_hword;
+    check_overflow(t, i, type == DATA_TYPE_BYTE ? 0 : sizes[type]);
+    EMIT(t,
+         "  avm2c_write(stack + sp, 0x%" PRIX64 "ULL, %lu);\n"
+         "  sp += %lu;\n",
+         datum, sizes[type], sizes[type]);
+  }
+  else if (UNSIGNED_OPCODE_IS_TYPE(opcode, OP_PUSH_REGISTER))
+  {
+    const size_t size = sizes[OPCODE_DATA_TYPE(opcode, OP_PUSH_REGISTER)];
+    check_register(t, i, operand, size);
+    check_overflow(t, i, size);
+    EMIT(t,
+         "  memcpy(stack + sp, registers + %" PRIu64 "ULL * %lu, %lu);\n"
+         "  sp += %lu;\n",
+         operand, size, size, size);
+  }
+  else if (UNSIGNED_OPCODE_IS_TYPE(opcode, OP_MOV) ||
+           UNSIGNED_OPCODE_IS_TYPE(opcode, OP_POP))
+  {
+    // POP is a MOV into register 0, as in vm_execute
+    const bool pop    = UNSIGNED_OPCODE_IS_TYPE(opcode, OP_POP);
+    const word_t reg  = pop ? 0 : operand;
+    const size_t size = sizes[pop ? OPCODE_DATA_TYPE(opcode, OP_POP)
+                                  : OPCODE_DATA_TYPE(opcode, OP_MOV)];
+    check_register(t, i, reg, size);
+    check_underflow(t, i, size);
+    EMIT(t,
+         "  sp -= %lu;\n"
+         "  memcpy(registers + %" PRIu64 "ULL * %lu, stack + sp, %lu);\n",
+         size, reg, size, size);
+  }
+  else if (UNSIGNED_OPCODE_IS_TYPE(opcode, OP_NOT))
+  {
+    const size_t size = sizes[OPCODE_DATA_TYPE(opcode, OP_NOT)];
+    check_underflow(t, i, size);
+    // Pushing the result checks (sp - size) + size >= max
+    if (size != BYTE_SIZE)
+      check_overflow(t, i, 0);
+    EMIT(t,
+         "  avm2c_write(stack + sp - %lu, !avm2c_read(stack + sp - %lu, %lu), "
+         "%lu);\n",
+         size, size, size, size);
+  }
+  else if (opcode >= OP_OR_BYTE && opcode <= OP_MULT_WORD &&
+           !UNSIGNED_OPCODE_IS_TYPE(opcode, OP_EQ))
+  {
+    static const char *const operators[] = {"|", "&", "^", "", "+", "-", "*"};
+    const size_t size = sizes[(opcode - OP_OR_BYTE) % 4];
+    check_underflow(t, i, 2 * size);
+    // a is the top of the stack, b the datum below it
+    EMIT(t,
+         "  {\n"
+         "    const word_t a = avm2c_read(stack + sp - %lu, %lu);\n"
+         "    const word_t b = avm2c_read(stack + sp - %lu, %lu);\n"
+         "    sp -= %lu;\n"
+         "    avm2c_write(stack + sp - %lu, a %s b, %lu);\n"
+         "  }\n",
+         size, size, 2 * size, size, size, size,
+         operators[(opcode - OP_OR_BYTE) / 4], size);
+  }
+  else if (UNSIGNED_OPCODE_IS_TYPE(opcode, OP_EQ) ||
+           (opcode >= OP_LT_BYTE && opcode <= OP_GTE_SWORD))
+  {
+    static const char *const comparators[] = {"<", "<=", ">", ">="};
+    const char *comparator = "==";
+    const char *cast       = "word_t";
+    size_t type            = OPCODE_DATA_TYPE(opcode, OP_EQ);
+    if (!UNSIGNED_OPCODE_IS_TYPE(opcode, OP_EQ))
+    {
+      const size_t index = opcode - OP_LT_BYTE;
+      comparator         = comparators[index / 8];
+      type               = (index % 8) / 2;
+      if (index % 2)
+        cast = signed_types[type];
+    }
+    const size_t size = sizes[type];
+    check_underflow(t, i, 2 * size);
+    // Comparators push b COMP a, where a is the top of the stack
+    EMIT(t,
+         "  {\n"
+         "    const word_t a = avm2c_read(stack + sp - %lu, %lu);\n"
+         "    const word_t b = avm2c_read(stack + sp - %lu, %lu);\n"
+         "    sp -= %lu;\n"
+         "    stack[sp++] = (%s)b %s (%s)a;\n"
+         "  }\n",
+         size, size, 2 * size, size, 2 * size, cast, comparator, cast);
+  }
+  // Invalid targets always fail through vm_execute
+  else if (opcode == OP_JUMP_ABS && valid)
+    EMIT(t, "  goto inst_%" PRIu64 ";\n", operand);
+  else if (UNSIGNED_OPCODE_IS_TYPE(opcode, OP_JUMP_IF) && valid)
+  {
+    const size_t size = sizes[OPCODE_DATA_TYPE(opcode, OP_JUMP_IF)];
+    check_underflow(t, i, size);
+    EMIT(t,
+         "  sp -= %lu;\n"
+         "  if (avm2c_read(stack + sp, %lu))\n"
+         "    goto inst_%" PRIu64 ";\n",
+         size, size, operand);
+  }
+  else if (opcode == OP_CALL && valid)
+  {
+    trap_if(t, i, "vm->call_stack.ptr >= vm->call_stack.max");
+    EMIT(t,
+         "  vm->call_stack.address_pointers[vm->call_stack.ptr++] = %" PRIu64
+         ";\n"
+         "  goto inst_%" PRIu64 ";\n",
+         i + 1, operand);
+  }
+  else if (opcode == OP_RET)
+  {
+    char condition[128];
+    snprintf(condition, sizeof(condition),
+             "vm->call_stack.ptr == 0 ||\n"
+             "      vm->call_stack.address_pointers[vm->call_stack.ptr - 1] "
+             ">= %" PRIu64,
+             t->program.count);
+    trap_if(t, i, condition);
+    EMIT(t, "  vm->program.ptr =\n"
+            "      vm->call_stack.address_pointers[--vm->call_stack.ptr];\n"
+            "  goto dispatch;\n");
+  }
+  else if (UNSIGNED_OPCODE_IS_TYPE(opcode, OP_DUP) ||
+           UNSIGNED_OPCODE_IS_TYPE(opcode, OP_MALLOC) ||
+           UNSIGNED_OPCODE_IS_TYPE(opcode, OP_MSET) ||
+           UNSIGNED_OPCODE_IS_TYPE(opcode, OP_MGET) ||
+           SIGNED_OPCODE_IS_TYPE(opcode, OP_PRINT) || opcode == OP_MDELETE ||
+           opcode == OP_MSIZE)
+    call_runtime(t, i);
+  else
+    trap_if(t, i, "true");
+}
+
+static void translate_program(struct Translation *t, const char *name)
+{
+  const prog_t program = t->program;
+  EMIT(t, "static inst_t %s_instructions[] = {\n", name);
+  for (word_t i = 0; i < program.count; ++i)
+  {
+    const inst_t inst = program.instructions[i];
+    const char *member = "as_word";
+    if (UNSIGNED_OPCODE_IS_TYPE(inst.opcode, OP_PUSH))
+      member = members[OPCODE_DATA_TYPE(inst.opcode, OP_PUSH)];
+    EMIT(t, "    {OP_%s, {.%s = 0x%" PRIX64 "ULL}},\n",
+         opcode_as_cstr(inst.opcode), member, inst.operand.as_word);
+  }
+  EMIT(t, "};\n\n");
+
+  bool registers = false;
+  for (word_t i = 0; i < program.count; ++i)
+  {
+    const opcode_t opcode = program.instructions[i].opcode;
+    registers |= UNSIGNED_OPCODE_IS_TYPE(opcode, OP_PUSH_REGISTER) ||
+                 UNSIGNED_OPCODE_IS_TYPE(opcode, OP_MOV) ||
+                 UNSIGNED_OPCODE_IS_TYPE(opcode, OP_POP);
+  }
+
+  EMIT(t,
+       "err_t %s(vm_t *vm)\n"
+       "{\n"
+       "  vm_load_program(vm, (prog_t){.start_address = %" PRIu64
+       ",\n"
+       "                               .count         = %" PRIu64 ",\n"
+       "                               .instructions  = %s_instructions});\n"
+       "  byte_t *stack    = vm->stack.data;\n"
+       "  const size_t max = vm->stack.max;\n"
+       "  size_t sp        = vm->stack.ptr;\n"
+       "  err_t err        = ERR_OK;\n",
+       name, program.start_address, program.count, name);
+  if (registers)
+    EMIT(t, "  byte_t *registers           = vm->registers.bytes;\n"
+            "  const size_t registers_size = vm->registers.size;\n");
+  EMIT(t,
+       "  (void)max;\n"
+       "  (void)err;\n"
+       "  vm->program.ptr = %" PRIu64 ";\n"
+       "  goto dispatch;\n\n",
+       program.start_address);
+
+  for (word_t i = 0; i < program.count; ++i)
+    translate_inst(t, i);
+  EMIT(t,
+       "  vm->program.ptr = %" PRIu64 ";\n"
+       "  goto done;\n\n",
+       program.count);
+
+  if (t->traps)
+    EMIT(t, "trap:\n"
+            "  err = vm_execute(vm);\n"
+            "  if (err)\n"
+            "    return err;\n"
+            "  sp = vm->stack.ptr;\n");
+  EMIT(t, "dispatch:\n"
+          "  switch (vm->program.ptr)\n"
+          "  {\n");
+  for (word_t i = 0; i < program.count; ++i)
+    EMIT(t, "  case %" PRIu64 ":\n    goto inst_%" PRIu64 ";\n", i, i);
+  EMIT(t, "  default:\n"
+          "    goto done;\n"
+          "  }\n"
+          "done:\n"
+          "  vm->stack.ptr = sp;\n"
+          "  return ERR_OK;\n"
+          "}\n");
+}
+
+/* Sizes of the parts of the vm in the generated main, when the program
+   doesn't say what it needs. */
+#define AVM2C_STACK_SIZE     256
+#define AVM2C_CALL_DEPTH     256
+#define AVM2C_REGISTERS_SIZE (8 * WORD_SIZE)
+
+static void translate_main(struct Translation *t, const char *name)
+{
+  // Sized exactly for programs saying what they need, as avm does
+  const prog_resources_t resources = t->program.resources;
+  size_t stack_size = AVM2C_STACK_SIZE, call_depth = AVM2C_CALL_DEPTH,
+         registers_size = AVM2C_REGISTERS_SIZE;
+  if (resources.present)
+  {
+    // A push fails if it'd reach the end of the stack, hence the byte
+    stack_size = resources.stack + 1;
+    call_depth = MAX(resources.calls, 1);
+    registers_size =
+        MAX((resources.registers + WORD_SIZE - 1) / WORD_SIZE, 1) * WORD_SIZE;
+  }
+
+  EMIT(t,
+       "\n"
+       "int main(void)\n"
+       "{\n"
+       "  // Words, so the stack is aligned for vm_load_stack\n"
+       "  static word_t stack[%lu], call_stack[%lu];\n"
+       "  static byte_t registers[%lu];\n"
+       "  heap_t heap = {0};\n"
+       "  heap_create(&heap);\n"
+       "\n"
+       "  vm_t vm = {0};\n"
+       "  vm_load_stack(&vm, (byte_t *)stack, %lu);\n"
+       "  vm_load_registers(&vm, registers, sizeof(registers));\n"
+       "  vm_load_heap(&vm, heap);\n"
+       "  vm_load_call_stack(&vm, call_stack, %lu);\n"
+       "\n"
+       "  err_t err = %s(&vm);\n"
+       "  int ret   = 0;\n"
+       "  if (err)\n"
+       "  {\n"
+       "    FAIL(\"ERROR\", \"%%s\\n\", err_as_cstr(err));\n"
+       "    vm_print_all(&vm, stderr);\n"
+       "    ret = 255 - err;\n"
+       "  }\n"
+       "  vm_stop(&vm);\n"
+       "  return ret;\n"
+       "}\n",
+       (stack_size + WORD_SIZE - 1) / WORD_SIZE, call_depth, registers_size,
+       stack_size, call_depth, name);
+}
+
+void usage(const char *program_name, FILE *out)
+{
+  fprintf(out,
+          "Usage: %s [OPTIONS] FILE\n"
+          "\t FILE: Bytecode file to translate into C on stdout\n"
+          "\tOptions:\n"
+          "\t\t --name NAME: Name of the generated function (avm_program)\n"
+          "\t\t --main: Generate a main which executes the program, sized by\n"
+          "\t\t   its resource section if it has one\n",
+          program_name);
+}
+
+int main(int argc, char *argv[])
+{
+  const char *filename = NULL, *name = "avm_program";
+  bool with_main       = false;
+  for (int i = 1; i < argc; ++i)
+  {
+    if (strcmp(argv[i], "--main") == 0)
+      with_main = true;
+    else if (strcmp(argv[i], "--name") == 0 && i + 1 < argc)
+      name = argv[++i];
+    else if (argv[i][0] != '-' && !filename)
+      filename = argv[i];
+    else
+    {
+      usage(argv[0], stderr);
+      return 1;
+    }
+  }
+  if (!filename)
+  {
+    usage(argv[0], stderr);
+    return 1;
+  }
+
+  FILE *fp = fopen(filename, "rb");
+  if (!fp)
+  {
+    FAIL("ERROR", "Could not open `%s`\n", filename);
+    return 1;
+  }
+  darr_t fp_bytes = darr_read_file(fp);
+  fclose(fp);
+
+  prog_t program = {0};
+  size_t header_read =
+      prog_read_header(&program, fp_bytes.data, fp_bytes.available);
+  if (!header_read)
+  {
+    FAIL("ERROR", "Could not deserialise program header in `%s`\n", filename);
+    return 1;
+  }
+
+  program.instructions = calloc(program.count, sizeof(*program.instructions));
+  size_t bytes_read    = 0;
+  read_err_prog_t read_err =
+      prog_read_instructions(&program, &bytes_read, fp_bytes.data + header_read,
+                             fp_bytes.available - header_read);
+  if (program.count > 0 && bytes_read == 0)
+  {
+    FAIL("ERROR", "%s [%lu]: Could not deserialise instructions\n", filename,
+         read_err.index);
+    return 1;
+  }
+
+  struct Translation t = {.out = stdout, .program = program};
+  EMIT(&t, "/* Translated by avm2c from `%s` */\n\n", filename);
+  EMIT(&t, "%s\n", prelude);
+  translate_program(&t, name);
+  if (with_main)
+    translate_main(&t, name);
+
+  free(program.instructions);
+  free(fp_bytes.data);
+  return 0;
+}
@@ -0,0 +1,920 @@
+/* Copyright (C) 2026 Aryadev Chavali
+
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License Version 2 for
+ * more details.
+
+ * You should have received a copy of the GNU General Public License Version 2
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+ * Created: 2026-10-16
+ * Author: Aryadev Chavali
+ * Description: Lockstep execution of one program over many lanes
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vm/batch.h>
+
+/* Batches
+
+   Running one program over many inputs with a vm each pays for the
+   decode and dispatch of every instruction once per vm.  A batch runs
+   them as lanes in lockstep instead, SIMT style: each instruction is
+   decoded and dispatched once for every lane at it, and its work done
+   for all of them in one loop.
+
+   With the stacks interleaved a word at a time (see batch_t), the same
+   stack pointer means the same offset into every lane's words.  So
+   while all the lanes at an instruction have the same stack pointer,
+   which is called uniform, an operation on words is a loop over
+   contiguous memory the compiler vectorises, and its checks are done
+   once for the lot.  Where lanes have different stack pointers each
+   is checked and worked on by itself, which is still correct, just
+   slower.
+
+   Lanes are independent of each other, so they may be run in any
+   interleaving and each still ends as it would on a vm of its own. */
+
+/* Byte p of the rows of a lane, given rows offset to the lane. */
+static inline byte_t *batch_at(const word_t *rows, size_t lanes, size_t p)
+{
+  return (byte_t *)(rows + (p / WORD_SIZE) * lanes) + p % WORD_SIZE;
+}
+
+/* Little endian read and write of size bytes at byte p of the rows of
+   a lane.  Unless the datum crosses a word it's a single load or store
+   on little endian hosts.  Aligned is a constant saying p is a
+   multiple of size, so the datum can't cross a word: the compiler
+   doesn't work that out from the stack pointer by itself, and won't
+   vectorise a loop with the bytewise fallback left in. */
+static inline word_t batch_read(const word_t *rows, size_t lanes, size_t p,
+                                size_t size, bool aligned)
+{
+  word_t datum = 0;
+  if (HOST_LITTLE_ENDIAN && (aligned || p % WORD_SIZE + size <= WORD_SIZE))
+    memcpy(&datum, batch_at(rows, lanes, p), size);
+  else
+    for (size_t i = 0; i < size; ++i)
+      datum |= ((word_t)*batch_at(rows, lanes, p + i)) << (i * 8);
+  return datum;
+}
+
+static inline void batch_write(word_t *rows, size_t lanes, size_t p,
+                               word_t datum, size_t size, bool aligned)
+{
+  if (HOST_LITTLE_ENDIAN && (aligned || p % WORD_SIZE + size <= WORD_SIZE))
+    memcpy(batch_at(rows, lanes, p), &datum, size);
+  else
+    for (size_t i = 0; i < size; ++i)
+      *batch_at(rows, lanes, p + i) = (datum >> (i * 8)) & 0xFF;
+}
+
+// Copy size bytes between a buffer and byte p of the rows of a lane
+static void batch_copy_in(word_t *rows, size_t lanes, size_t p,
+                          const byte_t *bytes, size_t size)
+{
+  for (size_t i = 0; i < size; ++i)
+    *batch_at(rows, lanes, p + i) = bytes[i];
+}
+
+static void batch_copy_out(const word_t *rows, size_t lanes, size_t p,
+                           byte_t *bytes, size_t size)
+{
+  for (size_t i = 0; i < size; ++i)
+    bytes[i] = *batch_at(rows, lanes, p + i);
+}
+
+/* Lay out a batch in block, which is NULL to just get the size
+   needed.  The layout is the same as vm_create's, every part starting
+   on a cache line of its own:
+
+   | batch_t | per lane arrays | registers | stack | call stack | */
+static size_t batch_layout(batch_t *batch, byte_t *block)
+{
+  const size_t lanes = batch->lanes;
+  size_t size        = VM_LINES(sizeof(*batch));
+#define BATCH_PART(MEMBER, COUNT)                       \
+  do                                                    \
+  {                                                     \
+    if (block)                                          \
+      batch->MEMBER = (void *)(block + size);           \
+    size += VM_LINES((COUNT) * sizeof(*batch->MEMBER)); \
+  } while (0)
+  BATCH_PART(pc, lanes);
+  BATCH_PART(sp, lanes);
+  BATCH_PART(csp, lanes);
+  BATCH_PART(err, lanes);
+  BATCH_PART(heaps, lanes);
+  BATCH_PART(running, lanes);
+  BATCH_PART(active, lanes);
+  BATCH_PART(registers,
+             lanes * ((batch->config.registers_size + WORD_SIZE - 1) /
+                      WORD_SIZE));
+  BATCH_PART(stack,
+             lanes * ((batch->config.stack_size + WORD_SIZE - 1) / WORD_SIZE));
+  BATCH_PART(call_stack, lanes * batch->config.call_stack_size);
+#undef BATCH_PART
+  return size;
+}
+
+batch_t *batch_create(vm_config_t config, prog_t program, size_t lanes)
+{
+  // Keep every part, and so the sum of them, well clear of SIZE_MAX
+  const size_t limit = lanes ? SIZE_MAX / 16 / WORD_SIZE / lanes : 0;
+  if (config.stack_size / WORD_SIZE >= limit ||
+      config.registers_size / WORD_SIZE >= limit ||
+      config.call_stack_size >= limit)
+    return NULL;
+
+  batch_t layout = {.lanes = lanes, .config = config};
+  const size_t size = batch_layout(&layout, NULL);
+  byte_t *block     = aligned_alloc(VM_CACHE_LINE, size);
+  if (!block)
+    return NULL;
+  batch_t *batch = (batch_t *)block;
+  *batch         = layout;
+  batch_layout(batch, block);
+  batch->program = program;
+
+  memset(batch->registers, 0,
+         lanes * ((config.registers_size + WORD_SIZE - 1) / WORD_SIZE) *
+             sizeof(word_t));
+  for (size_t lane = 0; lane < lanes; ++lane)
+  {
+    batch->pc[lane]  = program.start_address;
+    batch->sp[lane]  = 0;
+    batch->csp[lane] = 0;
+    batch->err[lane] = ERR_OK;
+    heap_create(batch->heaps + lane);
+  }
+  return batch;
+}
+
+void batch_destroy(batch_t *batch)
+{
+  if (!batch)
+    return;
+  for (size_t lane = 0; lane < batch->lanes; ++lane)
+    heap_stop(batch->heaps + lane);
+  free(batch);
+}
+
+void batch_load(batch_t *batch, size_t lane, const vm_t *vm)
+{
+  const size_t lanes = batch->lanes;
+  assert(lane < lanes && "batch_load: No such lane");
+  assert(vm->registers.size <= batch->config.registers_size &&
+         vm->stack.ptr <= batch->config.stack_size &&
+         vm->call_stack.ptr <= batch->config.call_stack_size &&
+         "batch_load: vm doesn't fit in the lane");
+  batch_copy_in(batch->registers + lane, lanes, 0, vm->registers.bytes,
+                vm->registers.size);
+  batch_copy_in(batch->stack + lane, lanes, 0, vm->stack.data, vm->stack.ptr);
+  for (size_t i = 0; i < vm->call_stack.ptr; ++i)
+    batch->call_stack[i * lanes + lane] = vm->call_stack.address_pointers[i];
+  batch->sp[lane]  = vm->stack.ptr;
+  batch->csp[lane] = vm->call_stack.ptr;
+}
+
+void batch_store(const batch_t *batch, size_t lane, vm_t *vm)
+{
+  const size_t lanes = batch->lanes;
+  assert(lane < lanes && "batch_store: No such lane");
+  assert(vm->registers.size >= batch->config.registers_size &&
+         vm->stack.max >= batch->sp[lane] &&
+         vm->call_stack.max >= batch->csp[lane] &&
+         "batch_store: Lane doesn't fit in the vm");
+  batch_copy_out(batch->registers + lane, lanes, 0, vm->registers.bytes,
+                 batch->config.registers_size);
+  batch_copy_out(batch->stack + lane, lanes, 0, vm->stack.data,
+                 batch->sp[lane]);
+  for (size_t i = 0; i < batch->csp[lane]; ++i)
+    vm->call_stack.address_pointers[i] = batch->call_stack[i * lanes + lane];
+  vm->stack.ptr       = batch->sp[lane];
+  vm->call_stack.ptr  = batch->csp[lane];
+  vm->program.ptr     = batch->pc[lane];
+}
+
+#if VM_STACK_SLOTS
+/* Word slots are in host order and a datum of any type takes one, so
+   none of the work on bytes below applies.  Each lane just runs on a
+   vm of its own. */
+size_t batch_execute(batch_t *batch)
+{
+  vm_t *vm = vm_create(batch->config, batch->program);
+  if (!vm)
+    return batch->lanes;
+  heap_t heap   = vm->heap;
+  size_t failed = 0;
+  for (size_t lane = 0; lane < batch->lanes; ++lane)
+  {
+    batch_store(batch, lane, vm);
+    vm->heap          = batch->heaps[lane];
+    batch->err[lane]  = vm_execute_loop(vm);
+    batch->heaps[lane] = vm->heap;
+    batch_load(batch, lane, vm);
+    batch->pc[lane] = vm->program.ptr;
+    failed += batch->err[lane] != ERR_OK;
+  }
+  vm->heap = heap;
+  vm_destroy(vm);
+  return failed;
+}
+#else
+/* Lockstep
+
+   Every running lane waits at its program pointer, and the lanes at
+   the least of them form the group which executes next.  When a
+   JUMP_IF or RET sends lanes of a group different ways, only those
+   going to the lesser address stay in it.  Lanes behind the others
+   run first, so after a conditional the lanes which took either side
+   meet again where the sides join, and lanes leaving a loop early wait
+   for the rest to finish it.
+
+   A group keeps executing without the lanes being searched again
+   until it reaches the pointer of some lane outside it (its limit),
+   halts, or loses lanes.  So lanes which never diverge are searched
+   once.  While a lane is in the group its program pointer is the
+   group's, as is its stack pointer if the group is uniform, and
+   batch->pc and batch->sp are only written when it leaves. */
+typedef struct
+{
+  word_t pc, limit;
+  size_t sp, count;
+  bool uniform, split;
+} batch_group_t;
+
+static inline bool batch_halted(const prog_t *program, word_t pc)
+{
+  return pc >= program->count ||
+         program->instructions[pc].opcode == OP_HALT;
+}
+
+// Retire halted lanes and make the group of the lanes left
+static bool batch_group(batch_t *batch, batch_group_t *group)
+{
+  const size_t lanes = batch->lanes;
+  word_t least = WORD_MAX, next = WORD_MAX;
+  for (size_t lane = 0; lane < lanes; ++lane)
+  {
+    if (!batch->running[lane])
+      continue;
+    const word_t pc = batch->pc[lane];
+    if (batch_halted(&batch->program, pc))
+      batch->running[lane] = 0;
+    else if (pc < least)
+    {
+      next  = least;
+      least = pc;
+    }
+    else if (pc > least && pc < next)
+      next = pc;
+  }
+  if (least == WORD_MAX)
+    return false;
+
+  *group = (batch_group_t){.pc = least, .limit = next, .uniform = true};
+  for (size_t lane = 0; lane < lanes; ++lane)
+  {
+    batch->active[lane] = batch->running[lane] && batch->pc[lane] == least;
+    if (!batch->active[lane])
+      continue;
+    if (group->count == 0)
+      group->sp = batch->sp[lane];
+    else if (group->sp != batch->sp[lane])
+      group->uniform = false;
+    ++group->count;
+  }
+  return true;
+}
+
+// Write the state of the lanes still in the group
+static void batch_flush(batch_t *batch, const batch_group_t *group)
+{
+  for (size_t lane = 0; lane < batch->lanes; ++lane)
+    if (batch->active[lane])
+    {
+      batch->pc[lane] = group->pc;
+      if (group->uniform)
+        batch->sp[lane] = group->sp;
+    }
+}
+
+static inline size_t batch_sp(const batch_t *batch,
+                              const batch_group_t *group, size_t lane)
+{
+  return group->uniform ? group->sp : batch->sp[lane];
+}
+
+static void batch_remove(batch_t *batch, batch_group_t *group, size_t lane,
+                         word_t pc, size_t sp)
+{
+  batch->pc[lane]     = pc;
+  batch->sp[lane]     = sp;
+  batch->active[lane] = 0;
+  if (--group->count == 0)
+    group->split = true;
+}
+
+// Take a lane out of the group, going to pc with stack pointer sp
+static void batch_leave(batch_t *batch, batch_group_t *group, size_t lane,
+                        word_t pc, size_t sp)
+{
+  batch_remove(batch, group, lane, pc, sp);
+  group->limit = MIN(group->limit, pc);
+}
+
+// Stop a lane in the group with an error, at the group's instruction
+static void batch_fail(batch_t *batch, batch_group_t *group, size_t lane,
+                       err_t err, size_t sp)
+{
+  batch_remove(batch, group, lane, group->pc, sp);
+  batch->running[lane] = 0;
+  batch->err[lane]     = err;
+}
+
+static void batch_fail_all(batch_t *batch, batch_group_t *group, err_t err)
+{
+  for (size_t lane = 0; lane < batch->lanes; ++lane)
+    if (batch->active[lane])
+      batch_fail(batch, group, lane, err, batch_sp(batch, group, lane));
+}
+
+/* Checks done by the routines of vm_execute on the stack.  A push
+   fails if the stack pointer plus extent reaches the end, extent
+   being 0 for vm_push_byte and the size of the datum otherwise. */
+static inline err_t batch_pop(size_t *sp, size_t size)
+{
+  if (*sp < size)
+    return ERR_STACK_UNDERFLOW;
+  *sp -= size;
+  return ERR_OK;
+}
+
+static inline err_t batch_push(size_t sp, size_t max, size_t extent)
+{
+  return sp + extent >= max ? ERR_STACK_OVERFLOW : ERR_OK;
+}
+
+static inline err_t batch_register(const batch_t *batch, word_t reg,
+                                   size_t type)
+{
+  if (reg >= batch->config.registers_size / (1 << type))
+    return ERR_INVALID_REGISTER_BYTE + type;
+  return ERR_OK;
+}
+
+/* The error an instruction of the stack families would fail with
+   given the stack pointer, setting sp to the pointer it'd leave.
+   These only depend on the stack pointer and operand, so are the same
+   for every lane of a uniform group.  They're made in the same order
+   as the routines of vm_execute make them. */
+static err_t batch_effect(const batch_t *batch, inst_t inst, size_t *sp)
+{
+  const opcode_t opcode = inst.opcode;
+  const word_t operand  = inst.operand.as_word;
+  const size_t max      = batch->config.stack_size;
+  err_t err             = ERR_OK;
+  if (UNSIGNED_OPCODE_IS_TYPE(opcode, OP_PUSH))
+  {
+    const size_t size = 1 << (opcode - OP_PUSH_BYTE);
+    return batch_push(*sp, max, size == BYTE_SIZE ? 0 : size);
+  }
+  else if (UNSIGNED_OPCODE_IS_TYPE(opcode, OP_POP))
+  {
+    if ((err = batch_register(batch, 0, opcode - OP_POP_BYTE)))
+      return err;
+    return batch_pop(sp, 1 << (opcode - OP_POP_BYTE));
+  }
+  else if (UNSIGNED_OPCODE_IS_TYPE(opcode, OP_PUSH_REGISTER))
+  {
+    const size_t type = opcode - OP_PUSH_REGISTER_BYTE;
+    if ((err = batch_register(batch, operand, type)))
+      return err;
+    return batch_push(*sp, max, 1 << type);
+  }
+  else if (UNSIGNED_OPCODE_IS_TYPE(opcode, OP_MOV))
+  {
+    if ((err = batch_register(batch, operand, opcode - OP_MOV_BYTE)))
+      return err;
+    return batch_pop(sp, 1 << (opcode - OP_MOV_BYTE));
+  }
+  else if (UNSIGNED_OPCODE_IS_TYPE(opcode, OP_DUP))
+  {
+    const size_t size = 1 << (opcode - OP_DUP_BYTE);
+    if (*sp < size * (operand + 1))
+      return ERR_STACK_UNDERFLOW;
+    return batch_push(*sp, max, size == BYTE_SIZE ? 0 : size);
+  }
+  else if (UNSIGNED_OPCODE_IS_TYPE(opcode, OP_NOT))
+  {
+    const size_t size = 1 << (opcode - OP_NOT_BYTE);
+    if ((err = batch_pop(sp, size)))
+      return err;
+    return batch_push(*sp, max, size == BYTE_SIZE ? 0 : size);
+  }
+  else if (UNSIGNED_OPCODE_IS_TYPE(opcode, OP_OR) ||
+           UNSIGNED_OPCODE_IS_TYPE(opcode, OP_AND) ||
+           UNSIGNED_OPCODE_IS_TYPE(opcode, OP_XOR) ||
+           UNSIGNED_OPCODE_IS_TYPE(opcode, OP_PLUS) ||
+           UNSIGNED_OPCODE_IS_TYPE(opcode, OP_SUB) ||
+           UNSIGNED_OPCODE_IS_TYPE(opcode, OP_MULT))
+  {
+    // Every one of these families is in order of type
+    const size_t size = 1 << ((opcode - OP_OR_BYTE) % 4);
+    if ((err = batch_pop(sp, size)) || (err = batch_pop(sp, size)))
+      return err;
+    return batch_push(*sp, max, size == BYTE_SIZE ? 0 : size);
+  }
+  else if (UNSIGNED_OPCODE_IS_TYPE(opcode, OP_EQ) ||
+           SIGNED_OPCODE_IS_TYPE(opcode, OP_LT) ||
+           SIGNED_OPCODE_IS_TYPE(opcode, OP_LTE) ||
+           SIGNED_OPCODE_IS_TYPE(opcode, OP_GT) ||
+           SIGNED_OPCODE_IS_TYPE(opcode, OP_GTE))
+  {
+    const size_t size = UNSIGNED_OPCODE_IS_TYPE(opcode, OP_EQ)
+                            ? 1 << (opcode - OP_EQ_BYTE)
+                            : 1 << (((opcode - OP_LT_BYTE) % 8) / 2);
+    if ((err = batch_pop(sp, size)) || (err = batch_pop(sp, size)))
+      return err;
+    return batch_push(*sp, max, 0);
+  }
+  else if (UNSIGNED_OPCODE_IS_TYPE(opcode, OP_JUMP_IF))
+    return batch_pop(sp, 1 << (opcode - OP_JUMP_IF_BYTE));
+  return ERR_OK;
+}
+
+/* Fail every lane of the group an instruction fails the checks of,
+   returning whether any are left. */
+static bool batch_check(batch_t *batch, batch_group_t *group, inst_t inst)
+{
+  if (group->uniform)
+  {
+    size_t sp = group->sp;
+    err_t err = batch_effect(batch, inst, &sp);
+    if (!err)
+      return true;
+    group->sp = sp;
+    batch_fail_all(batch, group, err);
+    return false;
+  }
+  for (size_t lane = 0; lane < batch->lanes; ++lane)
+    if (batch->active[lane])
+    {
+      size_t sp = batch->sp[lane];
+      err_t err = batch_effect(batch, inst, &sp);
+      if (err)
+        batch_fail(batch, group, lane, err, sp);
+    }
+  return group->count > 0;
+}
+
+/* Bytes of the stack the heap and print opcodes may pop, see
+   batch_routine */
+#define BATCH_WINDOW (3 * WORD_SIZE)
+
+#if VM_GUARD
+/* Bytes the heap opcodes push, which a VM_GUARD build doesn't check */
+static size_t batch_pushed(opcode_t opcode)
+{
+  if (UNSIGNED_OPCODE_IS_TYPE(opcode, OP_MGET))
+    return 1 << (opcode - OP_MGET_BYTE);
+  else if (UNSIGNED_OPCODE_IS_TYPE(opcode, OP_MALLOC) || opcode == OP_MSIZE)
+    return WORD_SIZE;
+  return 0;
+}
+#endif
+
+/* Heap and print opcodes run one lane at a time through vm_execute on
+   a vm made for the purpose.  None of them pop more than BATCH_WINDOW
+   bytes or push more than a word, so that vm only gets the top
+   BATCH_WINDOW bytes of the stack, rebased, with its max moved down
+   to match: checks on the window fail exactly when they would on the
+   whole stack.  Returns the stack pointer left. */
+static size_t batch_routine(batch_t *batch, batch_group_t *group,
+                            size_t lane, size_t sp)
+{
+  const size_t base = sp - MIN(sp, BATCH_WINDOW);
+  // Another word for pushes, and one more for those unchecked by VM_GUARD
+  word_t window[BATCH_WINDOW / WORD_SIZE + 2];
+  batch_copy_out(batch->stack + lane, batch->lanes, base, (byte_t *)window,
+                 sp - base);
+
+  vm_t vm = {0};
+  vm_load_stack(&vm, (byte_t *)window, batch->config.stack_size - base);
+  vm_load_program(&vm, batch->program);
+  vm.stack.ptr   = sp - base;
+  vm.program.ptr = group->pc;
+  vm.heap        = batch->heaps[lane];
+  err_t err      = vm_execute(&vm);
+  batch->heaps[lane] = vm.heap;
+
+#if VM_GUARD
+  const opcode_t opcode = batch->program.instructions[group->pc].opcode;
+  if (!err && vm.stack.ptr >= vm.stack.max && batch_pushed(opcode))
+  {
+    err = ERR_STACK_OVERFLOW;
+    vm.stack.ptr -= batch_pushed(opcode);
+  }
+#endif
+  batch_copy_in(batch->stack + lane, batch->lanes, base, (byte_t *)window,
+                vm.stack.ptr);
+  if (err)
+    batch_fail(batch, group, lane, err, base + vm.stack.ptr);
+  return base + vm.stack.ptr;
+}
+
+/* Run the statement after the macro for every lane of the group, with
+   lane its index and sp its stack pointer, then take pop bytes off
+   and put push bytes on its stack.  A full uniform group with sp word
+   aligned gets a loop with nothing but the statement, which
+   vectorises: every datum the kernels access is then at a multiple of
+   its size, so aligned is set. */
+#define BATCH_LANES(POP, PUSH, ...)                          \
+  do                                                         \
+  {                                                          \
+    if (group->uniform)                                      \
+    {                                                        \
+      const size_t uniform = group->sp;                      \
+      if (group->count == lanes && uniform % WORD_SIZE == 0) \
+        for (size_t lane = 0; lane < lanes; ++lane)          \
+        {                                                    \
+          const size_t sp    = uniform;                      \
+          const bool aligned = true;                         \
+          __VA_ARGS__;                                       \
+        }                                                    \
+      else                                                   \
+        for (size_t lane = 0; lane < lanes; ++lane)          \
+          if (active[lane])                                  \
+          {                                                  \
+            const size_t sp    = uniform;                    \
+            const bool aligned = false;                      \
+            __VA_ARGS__;                                     \
+          }                                                  \
+      group->sp = uniform - (POP) + (PUSH);                  \
+    }                                                        \
+    else                                                     \
+      for (size_t lane = 0; lane < lanes; ++lane)            \
+        if (active[lane])                                    \
+        {                                                    \
+          const size_t sp    = batch->sp[lane];              \
+          const bool aligned = false;                        \
+          __VA_ARGS__;                                       \
+          batch->sp[lane] = sp - (POP) + (PUSH);             \
+        }                                                    \
+  } while (0)
+
+/* Reads and writes at byte P of the stack or registers of the lane,
+   for kernels */
+#define BATCH_READ(ROWS, P, SIZE) \
+  batch_read((ROWS) + lane, lanes, P, SIZE, aligned)
+#define BATCH_WRITE(ROWS, P, DATUM, SIZE) \
+  batch_write((ROWS) + lane, lanes, P, DATUM, SIZE, aligned)
+
+static inline word_t batch_operand(data_t operand, size_t size)
+{
+  switch (size)
+  {
+  case BYTE_SIZE:
+    return operand.as_byte;
+  case SHORT_SIZE:
+    return operand.as_short;
+  case HWORD_SIZE:
+    return operand.as_hword;
+  default:
+    return operand.as_word;
+  }
+}
+
+// Sign extend a datum of size bytes
+static inline sword_t batch_signed(word_t datum, size_t size)
+{
+  switch (size)
+  {
+  case BYTE_SIZE:
+    return (sbyte_t)datum;
+  case SHORT_SIZE:
+    return (sshort_t)datum;
+  case HWORD_SIZE:
+    return (shword_t)datum;
+  default:
+    return (sword_t)datum;
+  }
+}
+
+/* Kernels for each family, given the size of the type.  They do what
+   the vm_* routine does once the checks have passed. */
+#define BATCH_PUSH(SIZE, _) \
+  BATCH_LANES(0, SIZE,      \
+              BATCH_WRITE(stack, sp, batch_operand(inst.operand, SIZE), SIZE))
+
+#define BATCH_PUSH_REGISTER(SIZE, _)                                       \
+  BATCH_LANES(0, SIZE,                                                     \
+              BATCH_WRITE(stack, sp,                                       \
+                          BATCH_READ(registers,                            \
+                                     inst.operand.as_word * (SIZE), SIZE), \
+                          SIZE))
+
+#define BATCH_MOV_TO(SIZE, REG)                      \
+  BATCH_LANES(SIZE, 0,                               \
+              BATCH_WRITE(registers, (REG) * (SIZE), \
+                          BATCH_READ(stack, sp - (SIZE), SIZE), SIZE))
+#define BATCH_MOV(SIZE, _) BATCH_MOV_TO(SIZE, inst.operand.as_word)
+#define BATCH_POP(SIZE, _) BATCH_MOV_TO(SIZE, 0)
+
+#define BATCH_DUP(SIZE, _)                                                    \
+  BATCH_LANES(                                                                \
+      0, SIZE,                                                                \
+      BATCH_WRITE(stack, sp,                                                  \
+                  BATCH_READ(stack, sp - (SIZE) * (inst.operand.as_word + 1), \
+                             SIZE),                                           \
+                  SIZE))
+
+#define BATCH_NOT(SIZE, _)                    \
+  BATCH_LANES(0, 0,                           \
+              BATCH_WRITE(stack, sp - (SIZE), \
+                          !BATCH_READ(stack, sp - (SIZE), SIZE), SIZE))
+
+// a is popped first, so is the top of the stack
+#define BATCH_BINARY(SIZE, OP)                                           \
+  BATCH_LANES(2 * (SIZE), SIZE,                                          \
+              const word_t a = BATCH_READ(stack, sp - (SIZE), SIZE);     \
+              const word_t b = BATCH_READ(stack, sp - 2 * (SIZE), SIZE); \
+              BATCH_WRITE(stack, sp - 2 * (SIZE), a OP b, SIZE))
+
+/* The result is a byte, but when it's word aligned the whole word is
+   written, zero extended: bytes above the top of the stack are never
+   read, and one store per lane vectorises where storing a byte every
+   word doesn't. */
+#define BATCH_COMPARE(SIZE, SIGNED, COMP)                                \
+  BATCH_LANES(2 * (SIZE), BYTE_SIZE,                                     \
+              const word_t a = BATCH_READ(stack, sp - (SIZE), SIZE);     \
+              const word_t b = BATCH_READ(stack, sp - 2 * (SIZE), SIZE); \
+              BATCH_WRITE(stack, sp - 2 * (SIZE),                        \
+                          (SIGNED) ? batch_signed(b, SIZE)               \
+                                         COMP batch_signed(a, SIZE)      \
+                                   : b COMP a,                           \
+                          aligned && (2 * (SIZE)) % WORD_SIZE == 0       \
+                              ? WORD_SIZE                                \
+                              : BYTE_SIZE))
+
+#define BATCH_EQ(SIZE, _) BATCH_COMPARE(SIZE, false, ==)
+
+/* Cases of a family given its kernel, which is passed the size of
+   each type and ARG */
+#define BATCH_CASES_UNSIGNED(OP, KERNEL, ARG) \
+  case OP##_BYTE:                             \
+    KERNEL(BYTE_SIZE, ARG);                   \
+    break;                                    \
+  case OP##_SHORT:                            \
+    KERNEL(SHORT_SIZE, ARG);                  \
+    break;                                    \
+  case OP##_HWORD:                            \
+    KERNEL(HWORD_SIZE, ARG);                  \
+    break;                                    \
+  case OP##_WORD:                             \
+    KERNEL(WORD_SIZE, ARG);                   \
+    break;
+
+#define BATCH_CASES_SIGNED(OP, COMP)        \
+  case OP##_BYTE:                           \
+    BATCH_COMPARE(BYTE_SIZE, false, COMP);  \
+    break;                                  \
+  case OP##_SBYTE:                          \
+    BATCH_COMPARE(BYTE_SIZE, true, COMP);   \
+    break;                                  \
+  case OP##_SHORT:                          \
+    BATCH_COMPARE(SHORT_SIZE, false, COMP); \
+    break;                                  \
+  case OP##_SSHORT:                         \
+    BATCH_COMPARE(SHORT_SIZE, true, COMP);  \
+    break;                                  \
+  case OP##_HWORD:                          \
+    BATCH_COMPARE(HWORD_SIZE, false, COMP); \
+    break;                                  \
+  case OP##_SHWORD:                         \
+    BATCH_COMPARE(HWORD_SIZE, true, COMP);  \
+    break;                                  \
+  case OP##_WORD:                           \
+    BATCH_COMPARE(WORD_SIZE, false, COMP);  \
+    break;                                  \
+  case OP##_SWORD:                          \
+    BATCH_COMPARE(WORD_SIZE, true, COMP);   \
+    break;
+
+/* JUMP_IF: lanes going to the lesser of the target and the next
+   instruction stay in the group, the others leave it. */
+#define BATCH_JUMP_IF(SIZE)                                                   \
+  do                                                                          \
+  {                                                                           \
+    const word_t next = group->pc + 1, target = inst.operand.as_word;         \
+    const bool valid = target < batch->program.count;                         \
+    const bool back  = valid && target < next;                                \
+    BATCH_LANES(SIZE, 0,                                                      \
+                const bool taken = BATCH_READ(stack, sp - (SIZE), SIZE) != 0; \
+                if (taken && !valid)                                          \
+                  batch_fail(batch, group, lane, ERR_INVALID_PROGRAM_ADDRESS, \
+                             sp - (SIZE));                                    \
+                else if (taken != back && target != next)                     \
+                  batch_leave(batch, group, lane, back ? next : target,       \
+                              sp - (SIZE)));                                  \
+    group->pc = back ? target : next;                                         \
+  } while (0)
+
+/* Lets the loops over lanes use AVX2 where the host has it, without
+   building everything for it. */
+#if defined(__GNUC__) && defined(__x86_64__) && defined(__linux__)
+#define BATCH_CLONES __attribute__((target_clones("avx2", "default")))
+#else
+#define BATCH_CLONES
+#endif
+
+static_assert(NUMBER_OF_OPCODES == 115, "batch_cycle: Out of date");
+
+// Execute the instruction of the group for every lane in it
+BATCH_CLONES __attribute__((flatten)) static void batch_cycle(
+    batch_t *batch, batch_group_t *group)
+{
+  const size_t lanes   = batch->lanes;
+  const byte_t *active = batch->active;
+  word_t *const stack = batch->stack, *const registers = batch->registers;
+  const inst_t inst    = batch->program.instructions[group->pc];
+  if (!batch_check(batch, group, inst))
+    return;
+
+  switch (inst.opcode)
+  {
+    BATCH_CASES_UNSIGNED(OP_PUSH, BATCH_PUSH, )
+    BATCH_CASES_UNSIGNED(OP_POP, BATCH_POP, )
+    BATCH_CASES_UNSIGNED(OP_PUSH_REGISTER, BATCH_PUSH_REGISTER, )
+    BATCH_CASES_UNSIGNED(OP_MOV, BATCH_MOV, )
+    BATCH_CASES_UNSIGNED(OP_DUP, BATCH_DUP, )
+    BATCH_CASES_UNSIGNED(OP_NOT, BATCH_NOT, )
+    BATCH_CASES_UNSIGNED(OP_OR, BATCH_BINARY, |)
+    BATCH_CASES_UNSIGNED(OP_AND, BATCH_BINARY, &)
+    BATCH_CASES_UNSIGNED(OP_XOR, BATCH_BINARY, ^)
+    BATCH_CASES_UNSIGNED(OP_PLUS, BATCH_BINARY, +)
+    BATCH_CASES_UNSIGNED(OP_SUB, BATCH_BINARY, -)
+    BATCH_CASES_UNSIGNED(OP_MULT, BATCH_BINARY, *)
+    BATCH_CASES_UNSIGNED(OP_EQ, BATCH_EQ, )
+    BATCH_CASES_SIGNED(OP_LT, <)
+    BATCH_CASES_SIGNED(OP_LTE, <=)
+    BATCH_CASES_SIGNED(OP_GT, >)
+    BATCH_CASES_SIGNED(OP_GTE, >=)
+  case OP_MALLOC_BYTE:
+  case OP_MALLOC_SHORT:
+  case OP_MALLOC_HWORD:
+  case OP_MALLOC_WORD:
+  case OP_MSET_BYTE:
+  case OP_MSET_SHORT:
+  case OP_MSET_HWORD:
+  case OP_MSET_WORD:
+  case OP_MGET_BYTE:
+  case OP_MGET_SHORT:
+  case OP_MGET_HWORD:
+  case OP_MGET_WORD:
+  case OP_MDELETE:
+  case OP_MSIZE:
+  case OP_PRINT_BYTE:
+  case OP_PRINT_SBYTE:
+  case OP_PRINT_SHORT:
+  case OP_PRINT_SSHORT:
+  case OP_PRINT_HWORD:
+  case OP_PRINT_SHWORD:
+  case OP_PRINT_WORD:
+  case OP_PRINT_SWORD:
+  {
+    // Every lane left in a uniform group ends with the same pointer,
+    // which is only moved once they've all run from where it was
+    const size_t sp = group->sp;
+    size_t left     = sp;
+    for (size_t lane = 0; lane < lanes; ++lane)
+    {
+      if (!active[lane])
+        continue;
+      const size_t next = batch_routine(batch, group, lane,
+                                        group->uniform ? sp : batch->sp[lane]);
+      if (!group->uniform)
+        batch->sp[lane] = next;
+      else if (active[lane])
+        left = next;
+    }
+    if (group->uniform)
+      group->sp = left;
+    break;
+  }
+  case OP_NOOP:
+    break;
+  case OP_JUMP_ABS:
+    if (inst.operand.as_word >= batch->program.count)
+      batch_fail_all(batch, group, ERR_INVALID_PROGRAM_ADDRESS);
+    else
+      group->pc = inst.operand.as_word;
+    return;
+  case OP_JUMP_IF_BYTE:
+    BATCH_JUMP_IF(BYTE_SIZE);
+    return;
+  case OP_JUMP_IF_SHORT:
+    BATCH_JUMP_IF(SHORT_SIZE);
+    return;
+  case OP_JUMP_IF_HWORD:
+    BATCH_JUMP_IF(HWORD_SIZE);
+    return;
+  case OP_JUMP_IF_WORD:
+    BATCH_JUMP_IF(WORD_SIZE);
+    return;
+  case OP_CALL:
+    for (size_t lane = 0; lane < lanes; ++lane)
+    {
+      if (!active[lane])
+        continue;
+      const size_t csp = batch->csp[lane];
+      if (csp >= batch->config.call_stack_size)
+      {
+        batch_fail(batch, group, lane, ERR_CALL_STACK_OVERFLOW,
+                   batch_sp(batch, group, lane));
+        continue;
+      }
+      batch->call_stack[csp * lanes + lane] = group->pc + 1;
+      batch->csp[lane]                      = csp + 1;
+      if (inst.operand.as_word >= batch->program.count)
+        batch_fail(batch, group, lane, ERR_INVALID_PROGRAM_ADDRESS,
+                   batch_sp(batch, group, lane));
+    }
+    group->pc = inst.operand.as_word;
+    return;
+  case OP_RET:
+  {
+    // Lanes returning to the least address stay in the group
+    word_t least = WORD_MAX;
+    for (size_t lane = 0; lane < lanes; ++lane)
+    {
+      if (!active[lane])
+        continue;
+      const size_t csp = batch->csp[lane];
+      if (csp == 0)
+      {
+        batch_fail(batch, group, lane, ERR_CALL_STACK_UNDERFLOW,
+                   batch_sp(batch, group, lane));
+        continue;
+      }
+      const word_t address = batch->call_stack[(csp - 1) * lanes + lane];
+      if (address >= batch->program.count)
+        batch_fail(batch, group, lane, ERR_INVALID_PROGRAM_ADDRESS,
+                   batch_sp(batch, group, lane));
+      else
+        least = MIN(least, address);
+    }
+    for (size_t lane = 0; lane < lanes; ++lane)
+    {
+      if (!active[lane])
+        continue;
+      const size_t csp     = --batch->csp[lane];
+      const word_t address = batch->call_stack[csp * lanes + lane];
+      if (address != least)
+        batch_leave(batch, group, lane, address,
+                    batch_sp(batch, group, lane));
+    }
+    group->pc = least;
+    return;
+  }
+  case OP_HALT:
+    // Halted lanes never get here
+    return;
+  case NUMBER_OF_OPCODES:
+  default:
+    batch_fail_all(batch, group, ERR_INVALID_OPCODE);
+    return;
+  }
+  ++group->pc;
+}
+
+size_t batch_execute(batch_t *batch)
+{
+  for (size_t lane = 0; lane < batch->lanes; ++lane)
+  {
+    batch->pc[lane]      = batch->program.start_address;
+    batch->err[lane]     = ERR_OK;
+    batch->running[lane] = 1;
+  }
+
+  batch_group_t group;
+  while (batch_group(batch, &group))
+  {
+    do
+      batch_cycle(batch, &group);
+    while (!group.split && group.pc < group.limit &&
+           !batch_halted(&batch->program, group.pc));
+    batch_flush(batch, &group);
+  }
+
+  size_t failed = 0;
+  for (size_t lane = 0; lane < batch->lanes; ++lane)
+    failed += batch->err[lane] != ERR_OK;
+  return failed;
+}
+#endif
@@ -0,0 +1,111 @@
+/* Copyright (C) 2026 Aryadev Chavali
+
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License Version 2 for
+ * more details.
+
+ * You should have received a copy of the GNU General Public License Version 2
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+ * Created: 2026-10-16
+ * Author: Aryadev Chavali
+ * Description: Lockstep execution of one program over many lanes
+ */
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <vm/runtime.h>
+
+/**
+   @brief Many vms running the same program in lockstep.
+
+   @details Each lane is a vm of its own, but their state is kept as
+   structure of arrays.  Stacks, registers and call stacks are
+   interleaved a word at a time: word n of the stack of lane l is
+   stack[n * lanes + l], so the same word of every lane is contiguous.
+   Bytes within a word are in the same order as in a vm.  Use
+   batch_load and batch_store to move state between a lane and a vm.
+
+   @prop[program] Program every lane runs
+   @prop[lanes] Number of lanes
+   @prop[config] Sizes of each lane, as for vm_create
+   @prop[pc] Program pointer of each lane
+   @prop[sp] Stack pointer of each lane in bytes
+   @prop[csp] Call stack pointer of each lane
+   @prop[err] Error each lane stopped with
+   @prop[stack] Interleaved stacks
+   @prop[registers] Interleaved registers
+   @prop[call_stack] Interleaved call stacks
+   @prop[heaps] Heap of each lane
+   @prop[running] Whether each lane is still running, for batch_execute
+   @prop[active] Whether each lane is in the current group, for
+   batch_execute
+ */
+typedef struct
+{
+  prog_t program;
+  size_t lanes;
+  vm_config_t config;
+
+  word_t *pc;
+  size_t *sp, *csp;
+  err_t *err;
+
+  word_t *stack, *registers, *call_stack;
+  heap_t *heaps;
+
+  byte_t *running, *active;
+} batch_t;
+
+/**
+   @brief Create a batch of lanes for a program in one allocation.
+
+   @details Every lane starts as a vm from vm_create would: zeroed
+   registers, empty stacks and an empty heap.  The program is
+   borrowed, not copied.
+
+   @param[config] Sizes of each lane
+   @param[program] Program to run
+   @param[lanes] Number of lanes
+   @return The batch, or NULL if it couldn't be allocated
+ */
+batch_t *batch_create(vm_config_t config, prog_t program, size_t lanes);
+
+/* Free a batch made by batch_create along with the heaps of its
+   lanes. */
+void batch_destroy(batch_t *);
+
+/**
+   @brief Copy the registers, stack and call stack of a vm into a
+   lane.
+
+   @details The parts of the vm must fit in the lane.  The heap isn't
+   copied, so pages of the vm mustn't be referred to by the lane.
+ */
+void batch_load(batch_t *batch, size_t lane, const vm_t *vm);
+
+/**
+   @brief Copy the registers, stack, call stack and program pointer of
+   a lane into a vm.
+
+   @details The parts of the vm must be at least as large as those of
+   the lane, as for a vm from vm_create with the config of the batch.
+   The heap of the lane stays in batch->heaps.
+ */
+void batch_store(const batch_t *batch, size_t lane, vm_t *vm);
+
+/**
+   @brief Execute the program on every lane, from its start address.
+
+   @details Each lane ends in the same state vm_execute_loop would
+   leave a vm in, with its error in batch->err.  Lanes at the same
+   instruction share its dispatch and execute it together, see
+   batch.c.  Stack overflow is always checked, even with VM_GUARD.
+
+   @return Number of lanes which failed
+ */
+size_t batch_execute(batch_t *batch);
+
+#endif
@@ -0,0 +1,146 @@
+/* Copyright (C) 2026 Aryadev Chavali
+
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License Version 2 for
+ * more details.
+
+ * You should have received a copy of the GNU General Public License Version 2
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+ * Created: 2026-10-16
+ * Author: Aryadev Chavali
+ * Description: Stacks reserved on demand behind guard pages
+ */
+
+// For MAP_ANONYMOUS, MAP_NORESERVE and sigaction
+#define _DEFAULT_SOURCE
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <vm/guard.h>
+
+#if VM_GUARD_PAGES
+#include <signal.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/* Guard pages
+
+   guard_map reserves the memory asked for plus one page in a single
+   anonymous mapping, then takes every permission away from that last
+   page.  Mappings come in whole pages, so the memory is placed at the
+   end of what's left for it and the guard page starts exactly where
+   the memory ends.  The mapping is MAP_NORESERVE so the kernel only
+   finds physical pages for it as they're touched: a stack of megabytes
+   costs a page or two for a program which never goes deep.
+
+   Running off the end of the memory hits the guard page and faults.
+   With VM_GUARD the routines rely on that rather than checking for
+   overflow.  A push writes its datum before moving the stack pointer,
+   as CALL does with the return address, so the fault leaves the vm
+   just as a failed check would have.  Pushes which fail their check
+   on reaching the end, rather than passing it, touch the byte past
+   their datum first (see VM_OVERFLOW_REACHES in runtime.c), so they
+   fault on exactly the same pushes.  The handler then raises the
+   error as a trap, which returns from the engine with that error.
+*/
+
+static size_t guard_page;
+
+static size_t guard_page_size(void)
+{
+  if (!guard_page)
+    guard_page = sysconf(_SC_PAGESIZE);
+  return guard_page;
+}
+
+// Bytes in front of memory of size bytes, up to the start of its mapping
+static size_t guard_slack(size_t size)
+{
+  const size_t page = guard_page_size();
+  return (page - (size % page)) % page;
+}
+
+void *guard_map(size_t size)
+{
+  const size_t page = guard_page_size(), slack = guard_slack(size);
+  if (size > SIZE_MAX - slack - page)
+    return NULL;
+  byte_t *bytes = mmap(NULL, slack + size + page, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (bytes == MAP_FAILED)
+    return NULL;
+  else if (mprotect(bytes + slack + size, page, PROT_NONE) != 0)
+  {
+    munmap(bytes, slack + size + page);
+    return NULL;
+  }
+  return bytes + slack;
+}
+
+void guard_unmap(void *bytes, size_t size)
+{
+  const size_t slack = guard_slack(size);
+  if (bytes)
+    munmap((byte_t *)bytes - slack, slack + size + guard_page_size());
+}
+
+#if VM_TRAP
+// Whether address is on the guard page starting at end
+static bool guard_hit(const void *address, const void *end)
+{
+  return (const byte_t *)address >= (const byte_t *)end &&
+         (const byte_t *)address < (const byte_t *)end + guard_page;
+}
+
+static void guard_fault(int signal, siginfo_t *info, void *context)
+{
+  (void)context;
+  const vm_t *vm = vm_trapping();
+  if (vm && guard_hit(info->si_addr,
+                     vm->stack.data + GUARD_STACK_SIZE(vm->stack.max)))
+    vm_raise(ERR_STACK_OVERFLOW);
+  else if (vm && guard_hit(info->si_addr, vm->call_stack.address_pointers +
+                                              vm->call_stack.max))
+    vm_raise(ERR_CALL_STACK_OVERFLOW);
+
+  // Not a guard page, so returning faults again with the default action
+  struct sigaction action = {.sa_handler = SIG_DFL};
+  sigemptyset(&action.sa_mask);
+  sigaction(signal, &action, NULL);
+}
+
+bool guard_install(void)
+{
+  guard_page_size();
+  struct sigaction action = {.sa_sigaction = guard_fault};
+  // The handler leaves through longjmp, so SIGSEGV mustn't stay blocked
+  action.sa_flags = SA_SIGINFO | SA_NODEFER;
+  sigemptyset(&action.sa_mask);
+  return sigaction(SIGSEGV, &action, NULL) == 0;
+}
+#else
+bool guard_install(void)
+{
+  return false;
+}
+#endif
+#else
+void *guard_map(size_t size)
+{
+  return calloc(size, 1);
+}
+
+void guard_unmap(void *bytes, size_t size)
+{
+  (void)size;
+  free(bytes);
+}
+
+bool guard_install(void)
+{
+  return false;
+}
+#endif
@@ -0,0 +1,77 @@
+/* Copyright (C) 2026 Aryadev Chavali
+
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License Version 2 for
+ * more details.
+
+ * You should have received a copy of the GNU General Public License Version 2
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+ * Created: 2026-10-16
+ * Author: Aryadev Chavali
+ * Description: Stacks reserved on demand behind guard pages
+ */
+
+#ifndef GUARD_H
+#define GUARD_H
+
+#include <stdbool.h>
+
+#include <vm/runtime.h>
+
+/* Guard pages need mmap, so are only available on Linux.  Elsewhere
+   guard_map just allocates. */
+#ifndef VM_GUARD_PAGES
+#if defined(__linux__)
+#define VM_GUARD_PAGES 1
+#else
+#define VM_GUARD_PAGES 0
+#endif
+#endif
+#if VM_GUARD && !VM_GUARD_PAGES
+#error "VM_GUARD needs guard pages"
+#endif
+
+/**
+   @brief Reserve zeroed memory followed by a guard page.
+
+   @details The mapping is rounded up to whole pages, with what that
+   adds put in front of the memory so the guard page starts right
+   after its last byte.  The memory is only as aligned as size is.
+   Memory is reserved rather than committed, so a large reservation
+   only costs physical memory for the pages actually touched.  Any
+   access to the page past the end faults.
+
+   @param[size] Bytes wanted
+   @return The memory, or NULL if it couldn't be reserved
+ */
+void *guard_map(size_t size);
+
+/* Release memory from guard_map, given the size asked for. */
+void guard_unmap(void *bytes, size_t size);
+
+/* Bytes guard_map is asked for by a stack of SIZE bytes.  With
+   VM_STACK_SLOTS a push writes a whole word, so the stack is cut to
+   whole words to keep them aligned: a slot which only fits in the
+   bytes cut off would fail its check anyway. */
+#if VM_STACK_SLOTS
+#define GUARD_STACK_SIZE(SIZE) ((SIZE) - ((SIZE) % WORD_SIZE))
+#else
+#define GUARD_STACK_SIZE(SIZE) (SIZE)
+#endif
+
+/**
+   @brief Install the handler turning faults on guard pages into
+   errors.
+
+   @details A fault on the guard page of the stack or call stack of
+   vm_trapping is raised as ERR_STACK_OVERFLOW or
+   ERR_CALL_STACK_OVERFLOW.  Any other fault gets the default action.
+   Only available with VM_TRAP, and needed with VM_GUARD.
+
+   @return Whether the handler was installed
+ */
+bool guard_install(void);
+
+#endif
@@ -0,0 +1,707 @@
+/* Copyright (C) 2026 Aryadev Chavali
+
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License Version 2 for
+ * more details.
+
+ * You should have received a copy of the GNU General Public License Version 2
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+ * Created: 2026-10-16
+ * Author: Aryadev Chavali
+ * Description: Register IR translated from stack bytecode
+ */
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vm/ir.h>
+
+/* Translation
+
+   Programs are split into basic blocks, each starting at a leader: the
+   start address, the target of any jump or call, the instruction after
+   any jump or call, and any instruction which has no translation.  So
+   every block is either a run of instructions which can be translated,
+   ending at most with a jump, or a single instruction which can't.
+
+   A block is translated by running through it with a symbolic stack.
+   Each slot of the stack is virtual register of the same index, but
+   pushing a constant or a register doesn't emit anything: the operand
+   is just put on the symbolic stack and used directly by whatever pops
+   it.  Popping past the bottom of the symbolic stack gives an operand
+   on the real stack.  So a chain like PUSH_REGISTER; PUSH; PLUS; MOV
+   becomes a single instruction operating on registers.
+
+   Values left on the symbolic stack are only written to the real stack
+   when the block ends, or when something pops them with a different
+   size to what they were pushed as.
+
+   Every check the instructions of a block would make, i.e. stack
+   underflow and overflow and the validity of registers, only depends
+   on the stack pointer and size of the register file at the start of
+   the block.  So they're folded into one guard for the whole block,
+   and when it doesn't hold the block is executed by vm_execute instead
+   which then fails at the right instruction.
+*/
+
+struct Translation
+{
+  ir_prog_t *ir;
+  ir_block_t *block;
+  ir_operand_t stack[IR_MAX_DEPTH];
+  size_t depth;
+  // Offset of the top of the stack from the start of the block
+  sword_t offset;
+  // IR instruction producing the top of the symbolic stack, if it was
+  // the last one emitted
+  size_t result;
+};
+
+static const byte_t ir_sizes[] = {BYTE_SIZE, SHORT_SIZE, HWORD_SIZE, WORD_SIZE};
+
+static word_t ir_datum(data_t datum, size_t size)
+{
+  switch (size)
+  {
+  case BYTE_SIZE:
+    return datum.as_byte;
+  case SHORT_SIZE:
+    return datum.as_short;
+  case HWORD_SIZE:
+    return datum.as_hword;
+  default:
+    return datum.as_word;
+  }
+}
+
+static ir_operand_t ir_constant(word_t value, byte_t size)
+{
+  return (ir_operand_t){
+      .type = IR_OPERAND_CONSTANT, .size = size, .value = value};
+}
+
+static ir_operand_t ir_virtual(size_t index, byte_t size)
+{
+  return (ir_operand_t){
+      .type = IR_OPERAND_VIRTUAL, .size = size, .value = index};
+}
+
+static ir_operand_t ir_register(word_t reg, byte_t size)
+{
+  return (ir_operand_t){
+      .type = IR_OPERAND_REGISTER, .size = size, .value = reg * size};
+}
+
+static ir_operand_t ir_stack(sword_t offset, byte_t size)
+{
+  return (ir_operand_t){
+      .type = IR_OPERAND_STACK, .size = size, .offset = offset};
+}
+
+static size_t ir_emit(struct Translation *t, ir_inst_t inst)
+{
+  darr_append_bytes(&t->ir->insts, (byte_t *)&inst, sizeof(inst));
+  ++t->block->inst_count;
+  t->result = IR_NOT_LEADER;
+  return (t->ir->insts.used / sizeof(inst)) - 1;
+}
+
+static void ir_materialise(struct Translation *t)
+{
+  sword_t offset = t->offset;
+  for (size_t i = 0; i < t->depth; ++i)
+    offset -= t->stack[i].size;
+  for (size_t i = 0; i < t->depth; ++i)
+  {
+    ir_emit(t, (ir_inst_t){.opcode = IR_MOVE,
+                           .dst    = ir_stack(offset, t->stack[i].size),
+                           .a      = t->stack[i]});
+    offset += t->stack[i].size;
+  }
+  t->depth = 0;
+}
+
+static void ir_require_registers(struct Translation *t, word_t reg, byte_t size)
+{
+  const word_t bytes = (reg + 1) * size;
+  if (bytes > t->block->registers_min)
+    t->block->registers_min = bytes;
+}
+
+/* Margin for pushing a datum of size bytes: vm_push_byte only checks
+   ptr >= max, unlike the other pushes. */
+static sword_t ir_margin(byte_t size)
+{
+  return size == BYTE_SIZE ? 0 : size;
+}
+
+/* Push an operand, where the instruction would overflow the stack if
+   the stack pointer + margin >= max. */
+static void ir_push(struct Translation *t, ir_operand_t operand, sword_t margin)
+{
+  if (t->offset + margin > t->block->stack_extent)
+    t->block->stack_extent = t->offset + margin;
+  if (t->depth == IR_MAX_DEPTH)
+    ir_materialise(t);
+  t->stack[t->depth++] = operand;
+  t->offset += operand.size;
+}
+
+static ir_operand_t ir_pop(struct Translation *t, byte_t size)
+{
+  if (t->depth > 0 && t->stack[t->depth - 1].size != size)
+    ir_materialise(t);
+
+  if (t->depth == 0)
+  {
+    // From the real stack, so the stack pointer must be big enough
+    if (size - t->offset > (sword_t)t->block->stack_min)
+      t->block->stack_min = size - t->offset;
+    t->offset -= size;
+    return ir_stack(t->offset, size);
+  }
+
+  t->offset -= size;
+  return t->stack[--t->depth];
+}
+
+/* Registers pushed onto the symbolic stack are read when popped, so
+   they must be copied out before the register is written to. */
+static void ir_write_register(struct Translation *t, ir_operand_t reg)
+{
+  for (size_t i = 0; i < t->depth; ++i)
+  {
+    const ir_operand_t operand = t->stack[i];
+    if (operand.type != IR_OPERAND_REGISTER ||
+        operand.value + operand.size <= reg.value ||
+        reg.value + reg.size <= operand.value)
+      continue;
+    t->stack[i] = ir_virtual(i, operand.size);
+    ir_emit(t, (ir_inst_t){
+                   .opcode = IR_MOVE, .dst = t->stack[i], .a = operand});
+  }
+}
+
+static void ir_mov(struct Translation *t, word_t reg, byte_t size)
+{
+  ir_require_registers(t, reg, size);
+  const size_t result     = t->result;
+  const ir_operand_t a    = ir_pop(t, size);
+  const ir_operand_t dst  = ir_register(reg, size);
+  const size_t insts_used = t->ir->insts.used;
+  ir_write_register(t, dst);
+
+  // Write the result of the last instruction straight into the register
+  if (result != IR_NOT_LEADER && insts_used == t->ir->insts.used &&
+      a.type == IR_OPERAND_VIRTUAL)
+    DARR_AT(ir_inst_t, t->ir->insts.data, result).dst = dst;
+  else
+    ir_emit(t, (ir_inst_t){.opcode = IR_MOVE, .dst = dst, .a = a});
+  t->result = IR_NOT_LEADER;
+}
+
+static void ir_operation(struct Translation *t, ir_opcode_t opcode,
+                         byte_t size, byte_t result_size, bool is_signed)
+{
+  ir_inst_t inst = {.opcode = opcode, .is_signed = is_signed};
+  if (opcode == IR_NOT)
+    inst.a = ir_pop(t, size);
+  else if (opcode >= IR_EQ)
+  {
+    // Comparisons are second COMP top
+    inst.b = ir_pop(t, size);
+    inst.a = ir_pop(t, size);
+  }
+  else
+  {
+    inst.a = ir_pop(t, size);
+    inst.b = ir_pop(t, size);
+  }
+  if (t->depth == IR_MAX_DEPTH)
+    ir_materialise(t);
+  inst.dst           = ir_virtual(t->depth, result_size);
+  const size_t index = ir_emit(t, inst);
+  ir_push(t, inst.dst, ir_margin(result_size));
+  t->result = index;
+}
+
+static bool ir_can_translate(prog_t program, inst_t inst)
+{
+  const opcode_t opcode = inst.opcode;
+  // Blocks are translated for the byte exact stack
+  if (VM_STACK_SLOTS)
+    return false;
+  else if (UNSIGNED_OPCODE_IS_TYPE(opcode, OP_PUSH_REGISTER) ||
+      UNSIGNED_OPCODE_IS_TYPE(opcode, OP_MOV))
+    // Such that the bytes of the register don't overflow a word
+    return inst.operand.as_word < (WORD_MAX / WORD_SIZE) - 1;
+  else if (opcode == OP_JUMP_ABS || UNSIGNED_OPCODE_IS_TYPE(opcode, OP_JUMP_IF))
+    return inst.operand.as_word < program.count;
+  return opcode == OP_NOOP || UNSIGNED_OPCODE_IS_TYPE(opcode, OP_PUSH) ||
+         UNSIGNED_OPCODE_IS_TYPE(opcode, OP_POP) ||
+         (opcode >= OP_NOT_BYTE && opcode <= OP_GTE_SWORD);
+}
+
+static void ir_translate_inst(struct Translation *t, inst_t inst)
+{
+  static_assert(NUMBER_OF_OPCODES == 115, "ir_translate_inst: Out of date");
+  const opcode_t opcode = inst.opcode;
+  if (opcode == OP_NOOP)
+    return;
+  else if (UNSIGNED_OPCODE_IS_TYPE(opcode, OP_PUSH))
+  {
+    const byte_t size = ir_sizes[OPCODE_DATA_TYPE(opcode, OP_PUSH)];
+    ir_push(t, ir_constant(ir_datum(inst.operand, size), size),
+            ir_margin(size));
+  }
+  else if (UNSIGNED_OPCODE_IS_TYPE(opcode, OP_PUSH_REGISTER))
+  {
+    const byte_t size = ir_sizes[OPCODE_DATA_TYPE(opcode, OP_PUSH_REGISTER)];
+    ir_require_registers(t, inst.operand.as_word, size);
+    ir_push(t, ir_register(inst.operand.as_word, size), size);
+  }
+  else if (UNSIGNED_OPCODE_IS_TYPE(opcode, OP_MOV))
+    ir_mov(t, inst.operand.as_word, ir_sizes[OPCODE_DATA_TYPE(opcode, OP_MOV)]);
+  else if (UNSIGNED_OPCODE_IS_TYPE(opcode, OP_POP))
+    // POP is a MOV into register 0, as in vm_execute
+    ir_mov(t, 0, ir_sizes[OPCODE_DATA_TYPE(opcode, OP_POP)]);
+  else if (opcode >= OP_NOT_BYTE && opcode <= OP_MULT_WORD)
+  {
+    // Families of unsigned opcodes from NOT to MULT, in order
+    static const ir_opcode_t families[] = {IR_NOT, IR_OR,   IR_AND, IR_XOR,
+                                           IR_EQ,  IR_PLUS, IR_SUB, IR_MULT};
+    const size_t index     = opcode - OP_NOT_BYTE;
+    const byte_t size      = ir_sizes[index % 4];
+    const ir_opcode_t irop = families[index / 4];
+    ir_operation(t, irop, size, irop == IR_EQ ? BYTE_SIZE : size, false);
+  }
+  else if (opcode >= OP_LT_BYTE && opcode <= OP_GTE_SWORD)
+  {
+    static const ir_opcode_t families[] = {IR_LT, IR_LTE, IR_GT, IR_GTE};
+    const size_t index = opcode - OP_LT_BYTE;
+    ir_operation(t, families[index / 8], ir_sizes[(index % 8) / 2], BYTE_SIZE,
+                 index % 2);
+  }
+  else if (UNSIGNED_OPCODE_IS_TYPE(opcode, OP_JUMP_IF))
+  {
+    const ir_operand_t a =
+        ir_pop(t, ir_sizes[OPCODE_DATA_TYPE(opcode, OP_JUMP_IF)]);
+    ir_materialise(t);
+    ir_emit(t, (ir_inst_t){.opcode = IR_JUMP_IF,
+                           .a      = a,
+                           .target = inst.operand.as_word});
+  }
+  else if (opcode == OP_JUMP_ABS)
+  {
+    ir_materialise(t);
+    ir_emit(t, (ir_inst_t){.opcode = IR_JUMP, .target = inst.operand.as_word});
+  }
+}
+
+static void ir_translate_block(ir_prog_t *ir, prog_t program, ir_block_t *block)
+{
+  struct Translation t = {.ir = ir, .block = block, .result = IR_NOT_LEADER};
+  block->stack_extent  = LONG_MIN;
+  block->inst_start    = ir->insts.used / sizeof(ir_inst_t);
+  for (word_t i = block->start; i < block->end; ++i)
+    ir_translate_inst(&t, program.instructions[i]);
+  ir_materialise(&t);
+  block->stack_delta = t.offset;
+}
+
+void ir_translate(prog_t program, ir_prog_t *ir)
+{
+  darr_init(&ir->blocks, sizeof(ir_block_t));
+  darr_init(&ir->insts, sizeof(ir_inst_t));
+  ir->count   = program.count;
+  ir->leaders = malloc(sizeof(*ir->leaders) * (program.count + 1));
+
+  // Use leaders to mark the leaders first, then to map them to blocks
+  bool *translatable = calloc(program.count + 1, sizeof(*translatable));
+  for (word_t i = 0; i <= program.count; ++i)
+    ir->leaders[i] = IR_NOT_LEADER;
+  ir->leaders[0] = 0;
+  if (program.start_address < program.count)
+    ir->leaders[program.start_address] = 0;
+
+  for (word_t i = 0; i < program.count; ++i)
+  {
+    const inst_t inst = program.instructions[i];
+    translatable[i]   = ir_can_translate(program, inst);
+    if (!translatable[i])
+    {
+      ir->leaders[i]     = 0;
+      ir->leaders[i + 1] = 0;
+    }
+    if (inst.opcode == OP_JUMP_ABS || inst.opcode == OP_CALL ||
+        UNSIGNED_OPCODE_IS_TYPE(inst.opcode, OP_JUMP_IF))
+    {
+      if (inst.operand.as_word < program.count)
+        ir->leaders[inst.operand.as_word] = 0;
+      ir->leaders[i + 1] = 0;
+    }
+  }
+
+  for (word_t i = 0; i < program.count;)
+  {
+    ir_block_t block = {.start = i, .translated = translatable[i]};
+    for (++i; i < program.count && ir->leaders[i] == IR_NOT_LEADER; ++i)
+      continue;
+    block.end = i;
+
+    ir->leaders[block.start] = ir->blocks.used / sizeof(block);
+    darr_append_bytes(&ir->blocks, (byte_t *)&block, sizeof(block));
+  }
+  ir->leaders[program.count] = IR_NOT_LEADER;
+
+  // Blocks can only be translated once the array of them is stable
+  for (size_t i = 0; i < ir->blocks.used / sizeof(ir_block_t); ++i)
+  {
+    ir_block_t *block = &DARR_AT(ir_block_t, ir->blocks.data, i);
+    if (block->translated)
+      ir_translate_block(ir, program, block);
+  }
+
+  free(translatable);
+}
+
+void ir_free(ir_prog_t *ir)
+{
+  free(ir->blocks.data);
+  free(ir->insts.data);
+  free(ir->leaders);
+  *ir = (ir_prog_t){0};
+}
+
+static const char *ir_opcode_as_cstr(ir_opcode_t opcode)
+{
+  switch (opcode)
+  {
+  case IR_MOVE:
+    return "MOVE";
+  case IR_NOT:
+    return "NOT";
+  case IR_OR:
+    return "OR";
+  case IR_AND:
+    return "AND";
+  case IR_XOR:
+    return "XOR";
+  case IR_PLUS:
+    return "PLUS";
+  case IR_SUB:
+    return "SUB";
+  case IR_MULT:
+    return "MULT";
+  case IR_EQ:
+    return "EQ";
+  case IR_LT:
+    return "LT";
+  case IR_LTE:
+    return "LTE";
+  case IR_GT:
+    return "GT";
+  case IR_GTE:
+    return "GTE";
+  case IR_JUMP:
+    return "JUMP";
+  case IR_JUMP_IF:
+    return "JUMP_IF";
+  case NUMBER_OF_IR_OPCODES:
+  default:
+    return "";
+  }
+}
+
+static void ir_print_operand(ir_operand_t operand, FILE *fp)
+{
+  switch (operand.type)
+  {
+  case IR_OPERAND_CONSTANT:
+    fprintf(fp, "%" PRIu64, operand.value);
+    break;
+  case IR_OPERAND_VIRTUAL:
+    fprintf(fp, "v%" PRIu64, operand.value);
+    break;
+  case IR_OPERAND_REGISTER:
+    fprintf(fp, "reg[%" PRIu64 "]", operand.value);
+    break;
+  case IR_OPERAND_STACK:
+    fprintf(fp, "stack[%" PRId64 "]", operand.offset);
+    break;
+  }
+  fprintf(fp, ":%u", operand.size);
+}
+
+void ir_print(const ir_prog_t *ir, FILE *fp)
+{
+  const size_t blocks = ir->blocks.used / sizeof(ir_block_t);
+  for (size_t i = 0; i < blocks; ++i)
+  {
+    const ir_block_t block = DARR_AT(ir_block_t, ir->blocks.data, i);
+    fprintf(fp, "Block %lu [%" PRIu64 ", %" PRIu64 ")", i, block.start,
+            block.end);
+    if (!block.translated)
+    {
+      fprintf(fp, ": Not translated\n");
+      continue;
+    }
+    fprintf(fp, ": stack >= %" PRIu64 ", registers >= %" PRIu64 "\n",
+            block.stack_min, block.registers_min);
+    for (size_t j = 0; j < block.inst_count; ++j)
+    {
+      const ir_inst_t inst =
+          DARR_AT(ir_inst_t, ir->insts.data, block.inst_start + j);
+      fprintf(fp, "\t%s%s", inst.is_signed ? "S" : "",
+              ir_opcode_as_cstr(inst.opcode));
+      if (inst.opcode == IR_JUMP || inst.opcode == IR_JUMP_IF)
+        fprintf(fp, "(%" PRIu64 ")", inst.target);
+      else
+      {
+        fprintf(fp, " ");
+        ir_print_operand(inst.dst, fp);
+      }
+      if (inst.opcode != IR_JUMP)
+      {
+        fprintf(fp, " ");
+        ir_print_operand(inst.a, fp);
+      }
+      if (inst.opcode >= IR_OR && inst.opcode <= IR_GTE)
+      {
+        fprintf(fp, " ");
+        ir_print_operand(inst.b, fp);
+      }
+      fprintf(fp, "\n");
+    }
+  }
+}
+
+/* Execution */
+
+/* Little endian loads and stores of size bytes. */
+static inline word_t ir_load(const byte_t *bytes, byte_t size)
+{
+  word_t datum = 0;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  switch (size)
+  {
+  case BYTE_SIZE:
+    return *bytes;
+  case SHORT_SIZE:
+    memcpy(&datum, bytes, SHORT_SIZE);
+    break;
+  case HWORD_SIZE:
+    memcpy(&datum, bytes, HWORD_SIZE);
+    break;
+  default:
+    memcpy(&datum, bytes, WORD_SIZE);
+    break;
+  }
+#else
+  for (size_t i = 0; i < size; ++i)
+    datum |= ((word_t)bytes[i]) << (i * 8);
+#endif
+  return datum;
+}
+
+static inline void ir_store(byte_t *bytes, word_t datum, byte_t size)
+{
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  switch (size)
+  {
+  case BYTE_SIZE:
+    *bytes = datum;
+    break;
+  case SHORT_SIZE:
+    memcpy(bytes, &datum, SHORT_SIZE);
+    break;
+  case HWORD_SIZE:
+    memcpy(bytes, &datum, HWORD_SIZE);
+    break;
+  default:
+    memcpy(bytes, &datum, WORD_SIZE);
+    break;
+  }
+#else
+  for (size_t i = 0; i < size; ++i)
+    bytes[i] = (datum >> (i * 8)) & 0xFF;
+#endif
+}
+
+static inline word_t ir_truncate(word_t datum, byte_t size)
+{
+  return size == WORD_SIZE ? datum : datum & ((((word_t)1) << (size * 8)) - 1);
+}
+
+static inline sword_t ir_signed(word_t datum, byte_t size)
+{
+  switch (size)
+  {
+  case BYTE_SIZE:
+    return (sbyte_t)datum;
+  case SHORT_SIZE:
+    return (sshort_t)datum;
+  case HWORD_SIZE:
+    return (shword_t)datum;
+  default:
+    return (sword_t)datum;
+  }
+}
+
+static inline word_t ir_read(vm_t *vm, const word_t *virtuals,
+                             const byte_t *base, ir_operand_t operand)
+{
+  switch (operand.type)
+  {
+  case IR_OPERAND_CONSTANT:
+    return operand.value;
+  case IR_OPERAND_VIRTUAL:
+    return virtuals[operand.value];
+  case IR_OPERAND_REGISTER:
+    return ir_load(vm->registers.bytes + operand.value, operand.size);
+  case IR_OPERAND_STACK:
+    return ir_load(base + operand.offset, operand.size);
+  }
+  return 0;
+}
+
+static inline void ir_write(vm_t *vm, word_t *virtuals, byte_t *base,
+                            ir_operand_t operand, word_t datum)
+{
+  switch (operand.type)
+  {
+  case IR_OPERAND_VIRTUAL:
+    virtuals[operand.value] = ir_truncate(datum, operand.size);
+    break;
+  case IR_OPERAND_REGISTER:
+    ir_store(vm->registers.bytes + operand.value, datum, operand.size);
+    break;
+  case IR_OPERAND_STACK:
+    ir_store(base + operand.offset, datum, operand.size);
+    break;
+  case IR_OPERAND_CONSTANT:
+    break;
+  }
+}
+
+static inline bool ir_guard(const vm_t *vm, const ir_block_t *block)
+{
+  return vm->stack.ptr >= block->stack_min &&
+         (sword_t)vm->stack.ptr + block->stack_extent <
+             (sword_t)vm->stack.max &&
+         vm->registers.size >= block->registers_min;
+}
+
+/* Execute a translated block which passed its guard, returning the
+   address of the next instruction. */
+static word_t ir_run_block(vm_t *vm, const ir_prog_t *ir,
+                           const ir_block_t *block)
+{
+  word_t virtuals[IR_MAX_DEPTH];
+  byte_t *base        = vm->stack.data + vm->stack.ptr;
+  word_t next         = block->end;
+  const ir_inst_t *pc = &DARR_AT(ir_inst_t, ir->insts.data, block->inst_start);
+  for (const ir_inst_t *end = pc + block->inst_count; pc < end; ++pc)
+  {
+    const word_t a = ir_read(vm, virtuals, base, pc->a);
+    word_t result  = 0;
+    switch (pc->opcode)
+    {
+    case IR_MOVE:
+      result = a;
+      break;
+    case IR_NOT:
+      result = !a;
+      break;
+    case IR_OR:
+      result = a | ir_read(vm, virtuals, base, pc->b);
+      break;
+    case IR_AND:
+      result = a & ir_read(vm, virtuals, base, pc->b);
+      break;
+    case IR_XOR:
+      result = a ^ ir_read(vm, virtuals, base, pc->b);
+      break;
+    case IR_PLUS:
+      result = a + ir_read(vm, virtuals, base, pc->b);
+      break;
+    case IR_SUB:
+      result = a - ir_read(vm, virtuals, base, pc->b);
+      break;
+    case IR_MULT:
+      result = a * ir_read(vm, virtuals, base, pc->b);
+      break;
+    case IR_EQ:
+      result = a == ir_read(vm, virtuals, base, pc->b);
+      break;
+#define IR_COMPARE(COMP)                                               \
+  {                                                                    \
+    const word_t b = ir_read(vm, virtuals, base, pc->b);               \
+    if (pc->is_signed)                                                 \
+      result = ir_signed(a, pc->a.size) COMP ir_signed(b, pc->b.size); \
+    else                                                               \
+      result = a COMP b;                                               \
+  }
+    case IR_LT:
+      IR_COMPARE(<);
+      break;
+    case IR_LTE:
+      IR_COMPARE(<=);
+      break;
+    case IR_GT:
+      IR_COMPARE(>);
+      break;
+    case IR_GTE:
+      IR_COMPARE(>=);
+      break;
+#undef IR_COMPARE
+    case IR_JUMP:
+      next = pc->target;
+      continue;
+    case IR_JUMP_IF:
+      if (a != 0)
+        next = pc->target;
+      continue;
+    case NUMBER_OF_IR_OPCODES:
+    default:
+      continue;
+    }
+    ir_write(vm, virtuals, base, pc->dst, result);
+  }
+  vm->stack.ptr += block->stack_delta;
+  return next;
+}
+
+err_t vm_execute_ir(vm_t *vm, const ir_prog_t *ir)
+{
+  struct Program *program = &vm->program;
+  const word_t count      = program->data.count;
+  program->ptr            = program->data.start_address;
+  while (program->ptr < count &&
+         program->data.instructions[program->ptr].opcode != OP_HALT)
+  {
+    const size_t index = ir->leaders[program->ptr];
+    const ir_block_t *block =
+        index == IR_NOT_LEADER ? NULL
+                               : &DARR_AT(ir_block_t, ir->blocks.data, index);
+    if (block && block->translated && ir_guard(vm, block))
+    {
+      program->ptr = ir_run_block(vm, ir, block);
+      continue;
+    }
+
+    // Drop back to vm_execute until the next block
+    do
+    {
+      err_t err = vm_execute(vm);
+      if (err)
+        return err;
+    } while (program->ptr < count &&
+             ir->leaders[program->ptr] == IR_NOT_LEADER);
+  }
+  return ERR_OK;
+}
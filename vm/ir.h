@@ -0,0 +1,173 @@
+/* Copyright (C) 2026 Aryadev Chavali
+
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License Version 2 for
+ * more details.
+
+ * You should have received a copy of the GNU General Public License Version 2
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+ * Created: 2026-10-16
+ * Author: Aryadev Chavali
+ * Description: Register IR translated from stack bytecode
+ */
+
+#ifndef IR_H
+#define IR_H
+
+#include <stdbool.h>
+
+#include <lib/darr.h>
+#include <vm/runtime.h>
+
+/* Maximum depth of the stack tracked within a block, which is also
+   the number of virtual registers a block may use. */
+#define IR_MAX_DEPTH 64
+
+/* Entry of ir_prog_t.leaders for instructions which don't start a
+   block. */
+#define IR_NOT_LEADER ((size_t)-1)
+
+typedef enum
+{
+  IR_OPERAND_CONSTANT,
+  IR_OPERAND_VIRTUAL,
+  IR_OPERAND_REGISTER,
+  IR_OPERAND_STACK,
+} ir_operand_type_t;
+
+/**
+   @brief Operand of an IR instruction.
+
+   @details Every operand is an unsigned datum of size bytes.
+   Registers are given as the offset of their first byte in the
+   register file, and stack operands as an offset from the stack
+   pointer when the block was entered, so they may be negative.
+
+   @prop[type] What the operand refers to
+   @prop[size] Size of the datum in bytes
+   @prop[value] Constant, virtual register or register offset
+   @prop[offset] Offset into the stack
+ */
+typedef struct
+{
+  ir_operand_type_t type;
+  byte_t size;
+  union
+  {
+    word_t value;
+    sword_t offset;
+  };
+} ir_operand_t;
+
+typedef enum
+{
+  IR_MOVE = 0,
+  IR_NOT,
+  IR_OR,
+  IR_AND,
+  IR_XOR,
+  IR_PLUS,
+  IR_SUB,
+  IR_MULT,
+  IR_EQ,
+  IR_LT,
+  IR_LTE,
+  IR_GT,
+  IR_GTE,
+  IR_JUMP,
+  IR_JUMP_IF,
+
+  NUMBER_OF_IR_OPCODES,
+} ir_opcode_t;
+
+/**
+   @brief Three address instruction: dst = a OP b.
+
+   @details Comparisons produce a byte and compare as signed integers
+   of their operand size if is_signed.  Jumps set the address
+   execution continues at once the block is done, JUMP_IF only if a is
+   non zero.
+ */
+typedef struct
+{
+  ir_opcode_t opcode;
+  bool is_signed;
+  ir_operand_t dst, a, b;
+  word_t target;
+} ir_inst_t;
+
+/**
+   @brief Basic block of a program.
+
+   @details A block either has a translation into IR or is executed by
+   vm_execute.  The translation is only valid if, on entry, the stack
+   pointer and register file satisfy the guard: then no instruction in
+   the block can fail.  Otherwise the block is executed by vm_execute
+   as well, which gets errors exactly right.
+
+   @prop[start] Address of the first instruction in the block
+   @prop[end] Address after the last instruction in the block
+   @prop[translated] Whether the block has a translation
+   @prop[stack_min] Guard: minimum stack pointer
+   @prop[stack_extent] Guard: stack pointer + stack_extent < max
+   @prop[registers_min] Guard: minimum size of the register file
+   @prop[stack_delta] Change to the stack pointer by the block
+   @prop[inst_start] Index of the block's first IR instruction
+   @prop[inst_count] Number of IR instructions in the block
+ */
+typedef struct
+{
+  word_t start, end;
+  bool translated;
+  word_t stack_min;
+  sword_t stack_extent;
+  word_t registers_min;
+  sword_t stack_delta;
+  size_t inst_start, inst_count;
+} ir_block_t;
+
+/**
+   @brief Translation of a program into IR.
+
+   @prop[blocks] Dynamic array of ir_block_t's
+   @prop[insts] Dynamic array of ir_inst_t's
+   @prop[leaders] For each instruction in the program, index of the
+   block it starts or IR_NOT_LEADER
+   @prop[count] Number of instructions in the program
+ */
+typedef struct
+{
+  darr_t blocks, insts;
+  size_t *leaders;
+  word_t count;
+} ir_prog_t;
+
+/**
+   @brief Translate a program into IR.
+
+   @details Stack slots within a block are renamed to virtual
+   registers so that values only go through the real stack at the
+   boundaries of a block.  Free with ir_free.
+
+   @param[program] Program to translate
+   @param[ir] Translation to initialise
+ */
+void ir_translate(prog_t program, ir_prog_t *ir);
+void ir_free(ir_prog_t *ir);
+void ir_print(const ir_prog_t *ir, FILE *fp);
+
+/**
+   @brief Execute the program loaded in vm using its translation.
+
+   @details Exactly like vm_execute_loop, but executing translated
+   blocks at once.  Between blocks, and on any error, the state of vm
+   is the same as it would be under vm_execute_loop.
+
+   @param[vm] Virtual machine with a program loaded
+   @param[ir] Translation of the loaded program
+ */
+err_t vm_execute_ir(vm_t *vm, const ir_prog_t *ir);
+
+#endif
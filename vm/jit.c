@@ -0,0 +1,722 @@
+/* Copyright (C) 2026 Aryadev Chavali
+
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License Version 2 for
+ * more details.
+
+ * You should have received a copy of the GNU General Public License Version 2
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+ * Created: 2026-10-16
+ * Author: Aryadev Chavali
+ * Description: Template JIT compiling programs to x86-64
+ */
+
+// For MAP_ANONYMOUS
+#define _DEFAULT_SOURCE
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <lib/darr.h>
+#include <vm/jit.h>
+
+#if VM_JIT
+#include <sys/mman.h>
+
+/* Code generation
+
+   The native code for a program is one function:
+
+     int code(vm_t *vm, const void *start, const void **table)
+
+   which jumps to start, the native address of some instruction, and
+   executes until the program halts, ends or an instruction fails.
+   The state of the vm lives in fixed host registers while running:
+   JIT_VM, JIT_STACK_DATA, JIT_STACK_PTR, JIT_STACK_MAX and
+   JIT_REGISTERS.  Only the stack pointer changes, so it's written
+   back to the vm whenever the native code leaves.
+
+   Each instruction checks everything vm_execute would check before
+   it changes anything.  If one of those checks fails, the program
+   pointer is set to the instruction and the code returns JIT_BAIL.
+   vm_execute_jit then runs the instruction through vm_execute, which
+   fails with the right error.  Heap and print instructions are always
+   passed to vm_execute in the same way but without leaving the native
+   code.
+*/
+
+#define JIT_BAIL (-1)
+
+enum JitRegister
+{
+  JIT_RAX = 0,
+  JIT_RCX,
+  JIT_RDX,
+  JIT_RBX,
+  JIT_RSP,
+  JIT_RBP,
+  JIT_RSI,
+  JIT_RDI,
+  JIT_R8,
+  JIT_R9,
+  JIT_R10,
+  JIT_R11,
+  JIT_R12,
+  JIT_R13,
+  JIT_R14,
+  JIT_R15,
+};
+
+// Callee saved registers holding the state of the vm
+#define JIT_VM         JIT_RBX
+#define JIT_TABLE      JIT_RBP
+#define JIT_STACK_DATA JIT_R12
+#define JIT_STACK_PTR  JIT_R13
+#define JIT_REGISTERS  JIT_R14
+#define JIT_STACK_MAX  JIT_R15
+
+// Index of a memory operand without an index register
+#define JIT_NO_INDEX JIT_RSP
+
+// Condition codes, as the second byte of a near Jcc
+enum JitCondition
+{
+  JIT_ALWAYS = 0,
+  JIT_B      = 0x82,
+  JIT_AE     = 0x83,
+  JIT_E      = 0x84,
+  JIT_NE     = 0x85,
+  JIT_BE     = 0x86,
+  JIT_A      = 0x87,
+  JIT_L      = 0x8C,
+  JIT_GE     = 0x8D,
+  JIT_LE     = 0x8E,
+  JIT_G      = 0x8F,
+};
+
+// Second byte of SETcc for a condition
+#define JIT_SET(COND) ((COND) + 0x10)
+
+// Opcodes of ALU operations on r/m64, r64 and their /digit for imm32
+enum JitAlu
+{
+  JIT_ADD  = 0x01,
+  JIT_OR   = 0x09,
+  JIT_AND  = 0x21,
+  JIT_SUB  = 0x29,
+  JIT_XOR  = 0x31,
+  JIT_CMP  = 0x39,
+  JIT_TEST = 0x85,
+  JIT_MOV  = 0x89,
+};
+
+#define JIT_ALU_DIGIT(ALU) ((ALU) >> 3)
+
+enum JitLabel
+{
+  JIT_LABEL_INST,
+  JIT_LABEL_BAIL,
+  JIT_LABEL_EXIT,
+};
+
+struct JitMem
+{
+  enum JitRegister base, index;
+  byte_t scale;
+  int32_t disp;
+};
+
+#define JIT_FIELD(FIELD) \
+  ((struct JitMem){JIT_VM, JIT_NO_INDEX, 0, offsetof(vm_t, FIELD)})
+#define JIT_STACK(DISP) \
+  ((struct JitMem){JIT_STACK_DATA, JIT_STACK_PTR, 0, (DISP)})
+#define JIT_REGISTER(OFFSET) \
+  ((struct JitMem){JIT_REGISTERS, JIT_NO_INDEX, 0, (OFFSET)})
+
+struct JitFixup
+{
+  size_t at;
+  enum JitLabel label;
+  word_t index;
+};
+
+struct Jit
+{
+  darr_t code, fixups;
+  prog_t program;
+  // Native offset of each instruction and its bail stub
+  size_t *offsets, *bails;
+  size_t exit;
+};
+
+#define JIT_NO_LABEL ((size_t)-1)
+
+#define JIT_EMIT(JIT, ...)                                 \
+  darr_append_bytes(&(JIT)->code, (byte_t[]){__VA_ARGS__}, \
+                    sizeof((byte_t[]){__VA_ARGS__}))
+
+static void jit_imm(struct Jit *jit, word_t imm, size_t size)
+{
+  for (size_t i = 0; i < size; ++i)
+    darr_append_byte(&jit->code, (imm >> (i * 8)) & 0xFF);
+}
+
+static bool jit_fits_imm32(word_t imm)
+{
+  return (sword_t)imm >= INT32_MIN && (sword_t)imm <= INT32_MAX;
+}
+
+static void jit_rex(struct Jit *jit, bool w, int reg, int index, int base)
+{
+  const byte_t rex = 0x40 | (w << 3) | ((reg >> 3) << 2) |
+                     ((index >> 3) << 1) | (base >> 3);
+  if (rex != 0x40)
+    darr_append_byte(&jit->code, rex);
+}
+
+/* Emit an instruction with a memory operand, opcode being one or two
+   bytes, where reg is the register or /digit of the instruction. */
+static void jit_mem(struct Jit *jit, bool w, word_t opcode, int reg,
+                    struct JitMem mem)
+{
+  jit_rex(jit, w, reg, mem.index, mem.base);
+  if (opcode > 0xFF)
+    darr_append_byte(&jit->code, opcode >> 8);
+  darr_append_byte(&jit->code, opcode & 0xFF);
+  // Always [base + index * scale + disp32] through a SIB byte
+  JIT_EMIT(jit, 0x84 | ((reg & 7) << 3),
+           (mem.scale << 6) | ((mem.index & 7) << 3) | (mem.base & 7));
+  jit_imm(jit, (uint32_t)mem.disp, 4);
+}
+
+/* Emit an instruction with two register operands, rm and reg. */
+static void jit_reg(struct Jit *jit, bool w, word_t opcode, int reg, int rm)
+{
+  jit_rex(jit, w, reg, 0, rm);
+  if (opcode > 0xFF)
+    darr_append_byte(&jit->code, opcode >> 8);
+  JIT_EMIT(jit, opcode & 0xFF, 0xC0 | ((reg & 7) << 3) | (rm & 7));
+}
+
+static void jit_alu(struct Jit *jit, enum JitAlu alu, int dst, int src)
+{
+  jit_reg(jit, true, alu, src, dst);
+}
+
+static void jit_alu_imm(struct Jit *jit, enum JitAlu alu, int dst, int32_t imm)
+{
+  jit_reg(jit, true, 0x81, JIT_ALU_DIGIT(alu), dst);
+  jit_imm(jit, (uint32_t)imm, 4);
+}
+
+/* Load size bytes into reg, zero or sign extended to a word. */
+static void jit_load(struct Jit *jit, int reg, size_t size, bool is_signed,
+                     struct JitMem mem)
+{
+  switch (size)
+  {
+  case BYTE_SIZE:
+    jit_mem(jit, is_signed, is_signed ? 0x0FBE : 0x0FB6, reg, mem);
+    break;
+  case SHORT_SIZE:
+    jit_mem(jit, is_signed, is_signed ? 0x0FBF : 0x0FB7, reg, mem);
+    break;
+  case HWORD_SIZE:
+    jit_mem(jit, is_signed, is_signed ? 0x63 : 0x8B, reg, mem);
+    break;
+  default:
+    jit_mem(jit, true, 0x8B, reg, mem);
+    break;
+  }
+}
+
+static void jit_store(struct Jit *jit, int reg, size_t size, struct JitMem mem)
+{
+  if (size == SHORT_SIZE)
+    JIT_EMIT(jit, 0x66);
+  jit_mem(jit, size == WORD_SIZE, size == BYTE_SIZE ? 0x88 : 0x89, reg, mem);
+}
+
+static void jit_load_word(struct Jit *jit, int reg, struct JitMem mem)
+{
+  jit_load(jit, reg, WORD_SIZE, false, mem);
+}
+
+static void jit_store_word(struct Jit *jit, int reg, struct JitMem mem)
+{
+  jit_store(jit, reg, WORD_SIZE, mem);
+}
+
+static void jit_store_imm(struct Jit *jit, word_t imm, size_t size,
+                          struct JitMem mem)
+{
+  if (size == WORD_SIZE && !jit_fits_imm32(imm))
+  {
+    // mov rax, imm64
+    JIT_EMIT(jit, 0x48, 0xB8);
+    jit_imm(jit, imm, WORD_SIZE);
+    jit_store(jit, JIT_RAX, WORD_SIZE, mem);
+    return;
+  }
+  if (size == SHORT_SIZE)
+    JIT_EMIT(jit, 0x66);
+  jit_mem(jit, size == WORD_SIZE, size == BYTE_SIZE ? 0xC6 : 0xC7, 0, mem);
+  jit_imm(jit, imm, size == WORD_SIZE ? HWORD_SIZE : size);
+}
+
+static void jit_fixup(struct Jit *jit, enum JitLabel label, word_t index)
+{
+  struct JitFixup fixup = {jit->code.used, label, index};
+  darr_append_bytes(&jit->fixups, (byte_t *)&fixup, sizeof(fixup));
+  jit_imm(jit, 0, 4);
+}
+
+static void jit_jump(struct Jit *jit, enum JitCondition cond,
+                     enum JitLabel label, word_t index)
+{
+  if (cond == JIT_ALWAYS)
+    JIT_EMIT(jit, 0xE9);
+  else
+    JIT_EMIT(jit, 0x0F, cond);
+  jit_fixup(jit, label, index);
+}
+
+static void jit_set_ptr(struct Jit *jit, word_t ptr)
+{
+  jit_store_imm(jit, ptr, WORD_SIZE, JIT_FIELD(program.ptr));
+}
+
+/* Checks which leave the native code if an instruction would fail. */
+
+// The stack pointer + margin >= max, as done by the vm_push routines
+static void jit_check_overflow(struct Jit *jit, word_t i, size_t margin)
+{
+  if (margin == 0)
+    jit_alu(jit, JIT_CMP, JIT_STACK_PTR, JIT_STACK_MAX);
+  else
+  {
+    // lea rax, [stack ptr + margin]
+    jit_mem(jit, true, 0x8D, JIT_RAX,
+            (struct JitMem){JIT_STACK_PTR, JIT_NO_INDEX, 0, margin});
+    jit_alu(jit, JIT_CMP, JIT_RAX, JIT_STACK_MAX);
+  }
+  jit_jump(jit, JIT_AE, JIT_LABEL_BAIL, i);
+}
+
+static void jit_check_underflow(struct Jit *jit, word_t i, size_t size)
+{
+  jit_alu_imm(jit, JIT_CMP, JIT_STACK_PTR, size);
+  jit_jump(jit, JIT_B, JIT_LABEL_BAIL, i);
+}
+
+// Returns false if the register can never be valid
+static bool jit_check_register(struct Jit *jit, word_t i, word_t reg,
+                               size_t size)
+{
+  if (reg >= INT32_MAX / size)
+  {
+    jit_jump(jit, JIT_ALWAYS, JIT_LABEL_BAIL, i);
+    return false;
+  }
+  jit_mem(jit, true, 0x81, JIT_ALU_DIGIT(JIT_CMP), JIT_FIELD(registers.size));
+  jit_imm(jit, (reg + 1) * size, 4);
+  jit_jump(jit, JIT_B, JIT_LABEL_BAIL, i);
+  return true;
+}
+
+/* Templates */
+
+static const size_t jit_sizes[] = {BYTE_SIZE, SHORT_SIZE, HWORD_SIZE,
+                                   WORD_SIZE};
+
+static word_t jit_datum(data_t datum, size_t size)
+{
+  switch (size)
+  {
+  case BYTE_SIZE:
+    return datum.as_byte;
+  case SHORT_SIZE:
+    return datum.as_short;
+  case HWORD_SIZE:
+    return datum.as_hword;
+  default:
+    return datum.as_word;
+  }
+}
+
+static void jit_push(struct Jit *jit, word_t i, data_t datum, size_t size)
+{
+  // vm_push_byte only checks ptr >= max, unlike the other pushes
+  jit_check_overflow(jit, i, size == BYTE_SIZE ? 0 : size);
+  jit_store_imm(jit, jit_datum(datum, size), size, JIT_STACK(0));
+  jit_alu_imm(jit, JIT_ADD, JIT_STACK_PTR, size);
+}
+
+static void jit_push_register(struct Jit *jit, word_t i, word_t reg,
+                              size_t size)
+{
+  if (!jit_check_register(jit, i, reg, size))
+    return;
+  jit_check_overflow(jit, i, size);
+  jit_load(jit, JIT_RAX, size, false, JIT_REGISTER(reg * size));
+  jit_store(jit, JIT_RAX, size, JIT_STACK(0));
+  jit_alu_imm(jit, JIT_ADD, JIT_STACK_PTR, size);
+}
+
+static void jit_mov(struct Jit *jit, word_t i, word_t reg, size_t size)
+{
+  if (!jit_check_register(jit, i, reg, size))
+    return;
+  jit_check_underflow(jit, i, size);
+  jit_load(jit, JIT_RAX, size, false, JIT_STACK(-(int32_t)size));
+  jit_store(jit, JIT_RAX, size, JIT_REGISTER(reg * size));
+  jit_alu_imm(jit, JIT_SUB, JIT_STACK_PTR, size);
+}
+
+static void jit_not(struct Jit *jit, word_t i, size_t size)
+{
+  jit_check_underflow(jit, i, size);
+  // Pushing the result checks (ptr - size) + size >= max
+  if (size != BYTE_SIZE)
+    jit_check_overflow(jit, i, 0);
+  jit_load(jit, JIT_RAX, size, false, JIT_STACK(-(int32_t)size));
+  jit_alu(jit, JIT_TEST, JIT_RAX, JIT_RAX);
+  // sete al; movzx eax, al
+  JIT_EMIT(jit, 0x0F, JIT_SET(JIT_E), 0xC0, 0x0F, 0xB6, 0xC0);
+  jit_store(jit, JIT_RAX, size, JIT_STACK(-(int32_t)size));
+}
+
+static void jit_same_type(struct Jit *jit, word_t i, opcode_t opcode,
+                          size_t size)
+{
+  jit_check_underflow(jit, i, 2 * size);
+  // a is the top of the stack, b the datum below it
+  jit_load(jit, JIT_RAX, size, false, JIT_STACK(-(int32_t)size));
+  jit_load(jit, JIT_RCX, size, false, JIT_STACK(-2 * (int32_t)size));
+  if (UNSIGNED_OPCODE_IS_TYPE(opcode, OP_MULT))
+    // imul rax, rcx
+    jit_reg(jit, true, 0x0FAF, JIT_RAX, JIT_RCX);
+  else
+  {
+    enum JitAlu alu = JIT_ADD;
+    if (UNSIGNED_OPCODE_IS_TYPE(opcode, OP_OR))
+      alu = JIT_OR;
+    else if (UNSIGNED_OPCODE_IS_TYPE(opcode, OP_AND))
+      alu = JIT_AND;
+    else if (UNSIGNED_OPCODE_IS_TYPE(opcode, OP_XOR))
+      alu = JIT_XOR;
+    else if (UNSIGNED_OPCODE_IS_TYPE(opcode, OP_SUB))
+      alu = JIT_SUB;
+    jit_alu(jit, alu, JIT_RAX, JIT_RCX);
+  }
+  jit_store(jit, JIT_RAX, size, JIT_STACK(-2 * (int32_t)size));
+  jit_alu_imm(jit, JIT_SUB, JIT_STACK_PTR, size);
+}
+
+static void jit_comparator(struct Jit *jit, word_t i, enum JitCondition cond,
+                           size_t size, bool is_signed)
+{
+  jit_check_underflow(jit, i, 2 * size);
+  // Comparators push b COMP a, where a is the top of the stack
+  jit_load(jit, JIT_RAX, size, is_signed, JIT_STACK(-2 * (int32_t)size));
+  jit_load(jit, JIT_RCX, size, is_signed, JIT_STACK(-(int32_t)size));
+  jit_alu(jit, JIT_CMP, JIT_RAX, JIT_RCX);
+  JIT_EMIT(jit, 0x0F, JIT_SET(cond), 0xC0);
+  jit_store(jit, JIT_RAX, BYTE_SIZE, JIT_STACK(-2 * (int32_t)size));
+  jit_alu_imm(jit, JIT_SUB, JIT_STACK_PTR, 2 * size - 1);
+}
+
+static void jit_jump_if(struct Jit *jit, word_t i, word_t target, size_t size)
+{
+  jit_check_underflow(jit, i, size);
+  jit_load(jit, JIT_RAX, size, false, JIT_STACK(-(int32_t)size));
+  jit_alu_imm(jit, JIT_SUB, JIT_STACK_PTR, size);
+  jit_alu(jit, JIT_TEST, JIT_RAX, JIT_RAX);
+  jit_jump(jit, JIT_NE, JIT_LABEL_INST, target);
+}
+
+static void jit_call(struct Jit *jit, word_t i, word_t target)
+{
+  jit_load_word(jit, JIT_RAX, JIT_FIELD(call_stack.ptr));
+  // cmp rax, [call stack max]
+  jit_mem(jit, true, 0x3B, JIT_RAX, JIT_FIELD(call_stack.max));
+  jit_jump(jit, JIT_AE, JIT_LABEL_BAIL, i);
+  jit_load_word(jit, JIT_RCX, JIT_FIELD(call_stack.address_pointers));
+  jit_store_imm(jit, i + 1, WORD_SIZE,
+                (struct JitMem){JIT_RCX, JIT_RAX, 3, 0});
+  jit_alu_imm(jit, JIT_ADD, JIT_RAX, 1);
+  jit_store_word(jit, JIT_RAX, JIT_FIELD(call_stack.ptr));
+  jit_jump(jit, JIT_ALWAYS, JIT_LABEL_INST, target);
+}
+
+static void jit_ret(struct Jit *jit, word_t i)
+{
+  jit_load_word(jit, JIT_RAX, JIT_FIELD(call_stack.ptr));
+  jit_alu(jit, JIT_TEST, JIT_RAX, JIT_RAX);
+  jit_jump(jit, JIT_E, JIT_LABEL_BAIL, i);
+  jit_load_word(jit, JIT_RCX, JIT_FIELD(call_stack.address_pointers));
+  jit_load(jit, JIT_RCX, WORD_SIZE, false,
+           (struct JitMem){JIT_RCX, JIT_RAX, 3, -(int32_t)WORD_SIZE});
+  // cmp rcx, [program count]
+  jit_mem(jit, true, 0x3B, JIT_RCX, JIT_FIELD(program.data.count));
+  jit_jump(jit, JIT_AE, JIT_LABEL_BAIL, i);
+  jit_alu_imm(jit, JIT_SUB, JIT_RAX, 1);
+  jit_store_word(jit, JIT_RAX, JIT_FIELD(call_stack.ptr));
+  // jmp [table + rcx * 8]
+  jit_mem(jit, false, 0xFF, 4, (struct JitMem){JIT_TABLE, JIT_RCX, 3, 0});
+}
+
+static void jit_leave(struct Jit *jit, word_t ptr)
+{
+  jit_set_ptr(jit, ptr);
+  // xor eax, eax
+  JIT_EMIT(jit, 0x31, 0xC0);
+  jit_jump(jit, JIT_ALWAYS, JIT_LABEL_EXIT, 0);
+}
+
+/* Execute the instruction through vm_execute, continuing at the
+   program pointer it leaves if dispatch. */
+static void jit_call_out(struct Jit *jit, word_t i, bool dispatch)
+{
+  err_t (*execute)(vm_t *) = vm_execute;
+  word_t address           = 0;
+  memcpy(&address, &execute, sizeof(execute));
+
+  jit_store_word(jit, JIT_STACK_PTR, JIT_FIELD(stack.ptr));
+  jit_set_ptr(jit, i);
+  // mov rdi, vm; mov rax, vm_execute; call rax
+  jit_alu(jit, JIT_MOV, JIT_RDI, JIT_VM);
+  JIT_EMIT(jit, 0x48, 0xB8);
+  jit_imm(jit, address, WORD_SIZE);
+  JIT_EMIT(jit, 0xFF, 0xD0);
+  jit_load_word(jit, JIT_STACK_PTR, JIT_FIELD(stack.ptr));
+  // test eax, eax
+  JIT_EMIT(jit, 0x85, 0xC0);
+  jit_jump(jit, JIT_NE, JIT_LABEL_EXIT, 0);
+  if (dispatch)
+  {
+    // jmp [table + program ptr * 8]
+    jit_load_word(jit, JIT_RCX, JIT_FIELD(program.ptr));
+    jit_mem(jit, false, 0xFF, 4, (struct JitMem){JIT_TABLE, JIT_RCX, 3, 0});
+  }
+}
+
+static void jit_compile_inst(struct Jit *jit, word_t i)
+{
+  static_assert(NUMBER_OF_OPCODES == 115, "jit_compile_inst: Out of date");
+  const inst_t inst     = jit->program.instructions[i];
+  const opcode_t opcode = inst.opcode;
+  const word_t operand  = inst.operand.as_word;
+  if (opcode == OP_NOOP)
+    return;
+  else if (opcode == OP_HALT)
+    jit_leave(jit, i);
+  else if (UNSIGNED_OPCODE_IS_TYPE(opcode, OP_PUSH))
+    jit_push(jit, i, inst.operand,
+             jit_sizes[OPCODE_DATA_TYPE(opcode, OP_PUSH)]);
+  else if (UNSIGNED_OPCODE_IS_TYPE(opcode, OP_PUSH_REGISTER))
+    jit_push_register(jit, i, operand,
+                      jit_sizes[OPCODE_DATA_TYPE(opcode, OP_PUSH_REGISTER)]);
+  else if (UNSIGNED_OPCODE_IS_TYPE(opcode, OP_MOV))
+    jit_mov(jit, i, operand, jit_sizes[OPCODE_DATA_TYPE(opcode, OP_MOV)]);
+  else if (UNSIGNED_OPCODE_IS_TYPE(opcode, OP_POP))
+    // POP is a MOV into register 0, as in vm_execute
+    jit_mov(jit, i, 0, jit_sizes[OPCODE_DATA_TYPE(opcode, OP_POP)]);
+  else if (UNSIGNED_OPCODE_IS_TYPE(opcode, OP_NOT))
+    jit_not(jit, i, jit_sizes[OPCODE_DATA_TYPE(opcode, OP_NOT)]);
+  else if (UNSIGNED_OPCODE_IS_TYPE(opcode, OP_EQ))
+    jit_comparator(jit, i, JIT_E, jit_sizes[OPCODE_DATA_TYPE(opcode, OP_EQ)],
+                   false);
+  else if (opcode >= OP_OR_BYTE && opcode <= OP_MULT_WORD)
+    jit_same_type(jit, i, opcode, jit_sizes[(opcode - OP_OR_BYTE) % 4]);
+  else if (opcode >= OP_LT_BYTE && opcode <= OP_GTE_SWORD)
+  {
+    // Families of signed opcodes from LT to GTE, in order
+    static const enum JitCondition conditions[][2] = {
+        {JIT_B, JIT_L}, {JIT_BE, JIT_LE}, {JIT_A, JIT_G}, {JIT_AE, JIT_GE}};
+    const size_t index = opcode - OP_LT_BYTE;
+    const bool is_signed = index % 2;
+    jit_comparator(jit, i, conditions[index / 8][is_signed],
+                   jit_sizes[(index % 8) / 2], is_signed);
+  }
+  // Invalid targets always fail through vm_execute
+  else if (opcode == OP_JUMP_ABS && operand < jit->program.count)
+    jit_jump(jit, JIT_ALWAYS, JIT_LABEL_INST, operand);
+  else if (UNSIGNED_OPCODE_IS_TYPE(opcode, OP_JUMP_IF) &&
+           operand < jit->program.count)
+    jit_jump_if(jit, i, operand,
+                jit_sizes[OPCODE_DATA_TYPE(opcode, OP_JUMP_IF)]);
+  else if (opcode == OP_CALL && operand < jit->program.count &&
+           i < INT32_MAX)
+    jit_call(jit, i, operand);
+  else if (opcode == OP_RET)
+    jit_ret(jit, i);
+  else
+    jit_call_out(jit, i,
+                 opcode == OP_JUMP_ABS || opcode == OP_CALL ||
+                     UNSIGNED_OPCODE_IS_TYPE(opcode, OP_JUMP_IF));
+}
+
+static void jit_prologue(struct Jit *jit)
+{
+  // push rbx, rbp, r12, r13, r14, r15; keeping the stack aligned
+  JIT_EMIT(jit, 0x53, 0x55, 0x41, 0x54, 0x41, 0x55, 0x41, 0x56, 0x41, 0x57);
+  jit_alu_imm(jit, JIT_SUB, JIT_RSP, 8);
+  jit_alu(jit, JIT_MOV, JIT_VM, JIT_RDI);
+  jit_alu(jit, JIT_MOV, JIT_TABLE, JIT_RDX);
+  jit_load_word(jit, JIT_STACK_DATA, JIT_FIELD(stack.data));
+  jit_load_word(jit, JIT_STACK_PTR, JIT_FIELD(stack.ptr));
+  jit_load_word(jit, JIT_STACK_MAX, JIT_FIELD(stack.max));
+  jit_load_word(jit, JIT_REGISTERS, JIT_FIELD(registers.bytes));
+  // jmp rsi
+  JIT_EMIT(jit, 0xFF, 0xE6);
+}
+
+static void jit_epilogue(struct Jit *jit)
+{
+  jit->exit = jit->code.used;
+  jit_store_word(jit, JIT_STACK_PTR, JIT_FIELD(stack.ptr));
+  jit_alu_imm(jit, JIT_ADD, JIT_RSP, 8);
+  // pop r15, r14, r13, r12, rbp, rbx; ret
+  JIT_EMIT(jit, 0x41, 0x5F, 0x41, 0x5E, 0x41, 0x5D, 0x41, 0x5C, 0x5D, 0x5B,
+           0xC3);
+}
+
+static void jit_resolve(struct Jit *jit)
+{
+  for (size_t i = 0; i < jit->fixups.used / sizeof(struct JitFixup); ++i)
+  {
+    const struct JitFixup fixup =
+        DARR_AT(struct JitFixup, jit->fixups.data, i);
+    size_t target = jit->exit;
+    if (fixup.label == JIT_LABEL_INST)
+      target = jit->offsets[fixup.index];
+    else if (fixup.label == JIT_LABEL_BAIL)
+    {
+      if (jit->bails[fixup.index] == JIT_NO_LABEL)
+      {
+        // Stubs are made on demand, which may make more fixups
+        jit->bails[fixup.index] = jit->code.used;
+        jit_set_ptr(jit, fixup.index);
+        // mov eax, JIT_BAIL
+        JIT_EMIT(jit, 0xB8);
+        jit_imm(jit, (uint32_t)JIT_BAIL, 4);
+        jit_jump(jit, JIT_ALWAYS, JIT_LABEL_EXIT, 0);
+      }
+      target = jit->bails[fixup.index];
+    }
+    const int32_t rel = (sword_t)target - (sword_t)(fixup.at + 4);
+    memcpy(jit->code.data + fixup.at, &rel, sizeof(rel));
+  }
+}
+
+bool jit_compile(prog_t program, jit_t *jit)
+{
+  struct Jit state = {.program = program};
+  darr_init(&state.code, 0);
+  darr_init(&state.fixups, 0);
+  state.offsets = malloc(sizeof(*state.offsets) * (program.count + 1));
+  state.bails   = malloc(sizeof(*state.bails) * MAX(program.count, 1));
+  *jit          = (jit_t){0};
+  if (!state.offsets || !state.bails)
+  {
+    free(state.code.data);
+    free(state.fixups.data);
+    free(state.offsets);
+    free(state.bails);
+    return false;
+  }
+  for (word_t i = 0; i < program.count; ++i)
+    state.bails[i] = JIT_NO_LABEL;
+
+  jit_prologue(&state);
+  for (word_t i = 0; i < program.count; ++i)
+  {
+    state.offsets[i] = state.code.used;
+    jit_compile_inst(&state, i);
+  }
+  state.offsets[program.count] = state.code.used;
+  jit_leave(&state, program.count);
+  jit_epilogue(&state);
+  jit_resolve(&state);
+
+  jit->size = state.code.used;
+  jit->code = mmap(NULL, jit->size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  bool success = jit->code != MAP_FAILED;
+  if (success)
+  {
+    memcpy(jit->code, state.code.data, jit->size);
+    success = mprotect(jit->code, jit->size, PROT_READ | PROT_EXEC) == 0;
+    jit->table = malloc(sizeof(*jit->table) * (program.count + 1));
+    success    = success && jit->table;
+    for (word_t i = 0; success && i <= program.count; ++i)
+      jit->table[i] = jit->code + state.offsets[i];
+  }
+  else
+    jit->code = NULL;
+
+  free(state.code.data);
+  free(state.fixups.data);
+  free(state.offsets);
+  free(state.bails);
+  if (!success)
+    jit_free(jit);
+  return success;
+}
+
+void jit_free(jit_t *jit)
+{
+  if (jit->code)
+    munmap(jit->code, jit->size);
+  free(jit->table);
+  *jit = (jit_t){0};
+}
+
+err_t vm_execute_jit(vm_t *vm, const jit_t *jit)
+{
+  int (*code)(vm_t *, const void *, const void **) = NULL;
+  memcpy(&code, &jit->code, sizeof(code));
+
+  struct Program *program = &vm->program;
+  const word_t count      = program->data.count;
+  program->ptr            = program->data.start_address;
+  while (program->ptr < count &&
+         program->data.instructions[program->ptr].opcode != OP_HALT)
+  {
+    int ret = code(vm, jit->table[program->ptr], jit->table);
+    if (ret == JIT_BAIL)
+    {
+      err_t err = vm_execute(vm);
+      if (err)
+        return err;
+    }
+    else if (ret)
+      return ret;
+  }
+  return ERR_OK;
+}
+#else
+bool jit_compile(prog_t program, jit_t *jit)
+{
+  (void)program;
+  *jit = (jit_t){0};
+  return false;
+}
+
+void jit_free(jit_t *jit)
+{
+  *jit = (jit_t){0};
+}
+
+err_t vm_execute_jit(vm_t *vm, const jit_t *jit)
+{
+  (void)jit;
+  return vm_execute_loop(vm);
+}
+#endif
@@ -0,0 +1,78 @@
+/* Copyright (C) 2026 Aryadev Chavali
+
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License Version 2 for
+ * more details.
+
+ * You should have received a copy of the GNU General Public License Version 2
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+ * Created: 2026-10-16
+ * Author: Aryadev Chavali
+ * Description: Template JIT compiling programs to x86-64
+ */
+
+#ifndef JIT_H
+#define JIT_H
+
+#include <stdbool.h>
+
+#include <vm/runtime.h>
+
+/* The JIT is only available on x86-64 Linux, for the byte exact stack.
+   Elsewhere jit_compile always fails, so callers can fall back to the
+   interpreter. */
+#ifndef VM_JIT
+#if defined(__x86_64__) && defined(__linux__) && !VM_STACK_SLOTS
+#define VM_JIT 1
+#else
+#define VM_JIT 0
+#endif
+#endif
+
+/**
+   @brief Native code compiled from a program.
+
+   @details Compiled once per program, and may be executed on any vm
+   with that program loaded.
+
+   @prop[code] Executable mapping holding the native code
+   @prop[size] Size of the mapping in bytes
+   @prop[table] Native address of each instruction of the program
+ */
+typedef struct
+{
+  byte_t *code;
+  size_t size;
+  const void **table;
+} jit_t;
+
+/**
+   @brief Compile a program into native code.
+
+   @details Every opcode has a machine code template, with jumps and
+   calls compiled into direct branches.  Heap and print opcodes call
+   into vm_execute.
+
+   @param[program] Program to compile
+   @param[jit] Compiled code to initialise
+   @return true if the program could be compiled
+ */
+bool jit_compile(prog_t program, jit_t *jit);
+void jit_free(jit_t *jit);
+
+/**
+   @brief Execute the program loaded in vm using its native code.
+
+   @details Whenever an instruction would fail, the native code exits
+   before it makes any changes and vm_execute runs the instruction
+   instead.  So errors, and the state of vm on error, are exactly the
+   same as under vm_execute_loop.
+
+   @param[vm] Virtual machine with a program loaded
+   @param[jit] Native code of the loaded program
+ */
+err_t vm_execute_jit(vm_t *vm, const jit_t *jit);
+
+#endif
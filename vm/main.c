@@ -16,9 +16,20 @@
 #include "lib/base.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
+#include <vm/guard.h>
+#include <vm/jit.h>
+#include <vm/memo.h>
 #include <vm/runtime.h>
 #include <vm/struct.h>
+#include <vm/verify.h>
+
+/* Defaults for the size of the stack and call stack, for programs
+   without a resource section.  They're only reserved, so a program
+   pays for the pages it touches. */
+#define DEFAULT_STACK_SIZE (8UL << 20)
+#define DEFAULT_CALL_DEPTH (1UL << 20)
 
 void usage(const char *program_name, FILE *out)
 {
@@ -26,18 +37,151 @@ void usage(const char *program_name, FILE *out)
           "Usage: %s [OPTIONS] FILE\n"
           "\t FILE: Bytecode file to execute\n"
           "\tOptions:\n"
-          "\t\t To be developed...\n",
-          program_name);
+          "\t\t --jit: Compile FILE to native code before executing it\n"
+          "\t\t --jit-diff: Execute FILE with both the JIT and the "
+          "interpreter, then compare the final states\n"
+          "\t\t --unchecked: Verify FILE, executing it without runtime "
+          "checks if it passes\n"
+          "\t\t --trace: Print a trace of every cycle to stderr\n"
+          "\t\t --profile: Count entries into each basic block, printing "
+          "the hottest to stderr\n"
+          "\t\t --profile-output OUT: Profile as --profile, also writing "
+          "the counts to OUT for avm-opt --profile\n"
+          "\t\t --stack-size BYTES: Limit the stack to BYTES (default "
+          "%lu, or what FILE needs if it says)\n"
+          "\t\t --call-depth N: Limit the call stack to N calls (default "
+          "%lu, or what FILE needs if it says)\n"
+          "\t\t --memo N: Remember the results of up to N calls of pure "
+          "subroutines, skipping calls with the same arguments (not "
+          "with --jit, --unchecked, --trace or --profile)\n"
+          "\t\t --memo-policy lru|fifo|keep: Which result --memo "
+          "replaces when full (default lru)\n",
+          program_name, DEFAULT_STACK_SIZE, DEFAULT_CALL_DEPTH);
+}
+
+typedef enum
+{
+  ENGINE_INTERPRETER,
+  ENGINE_JIT,
+  ENGINE_JIT_DIFF,
+  ENGINE_UNCHECKED,
+  ENGINE_TRACE,
+  ENGINE_PROFILE,
+} engine_t;
+
+/* Compare the final states of a program executed by the interpreter
+   and the JIT.  Heap addresses differ between the two, so programs
+   keeping them on the stack or in registers will differ. */
+bool jit_diff(vm_t *interpreter, err_t interpreter_err, vm_t *jit,
+              err_t jit_err)
+{
+  bool same = interpreter_err == jit_err &&
+              interpreter->program.ptr == jit->program.ptr &&
+              interpreter->stack.ptr == jit->stack.ptr &&
+              interpreter->call_stack.ptr == jit->call_stack.ptr &&
+              memcmp(interpreter->stack.data, jit->stack.data,
+                     jit->stack.ptr) == 0 &&
+              memcmp(interpreter->registers.bytes, jit->registers.bytes,
+                     jit->registers.size) == 0 &&
+              memcmp(interpreter->call_stack.address_pointers,
+                     jit->call_stack.address_pointers,
+                     jit->call_stack.ptr * sizeof(word_t)) == 0;
+  if (same)
+    return true;
+  FAIL("JIT", "Interpreter and JIT differ\n%s", "");
+  fprintf(stderr, "Interpreter: %s\n", err_as_cstr(interpreter_err));
+  vm_print_all(interpreter, stderr);
+  fprintf(stderr, "JIT: %s\n", err_as_cstr(jit_err));
+  vm_print_all(jit, stderr);
+  return false;
 }
 
 int main(int argc, char *argv[])
 {
-  if (argc == 1)
+  const char *filename = NULL, *profile = NULL;
+  engine_t engine      = ENGINE_INTERPRETER;
+  size_t memo_entries  = 0;
+  memo_policy_t policy = MEMO_LRU;
+  bool sized           = false;
+  vm_config_t config   = {.stack_size      = DEFAULT_STACK_SIZE,
+                          .registers_size  = 8 * WORD_SIZE,
+                          .call_stack_size = DEFAULT_CALL_DEPTH};
+  for (int i = 1; i < argc; ++i)
+  {
+    if (strcmp(argv[i], "--jit") == 0)
+      engine = ENGINE_JIT;
+    else if (strcmp(argv[i], "--jit-diff") == 0)
+      engine = ENGINE_JIT_DIFF;
+    else if (strcmp(argv[i], "--unchecked") == 0)
+      engine = ENGINE_UNCHECKED;
+    else if (strcmp(argv[i], "--trace") == 0)
+      engine = ENGINE_TRACE;
+    else if (strcmp(argv[i], "--profile") == 0)
+      engine = ENGINE_PROFILE;
+    else if (strcmp(argv[i], "--profile-output") == 0 && i + 1 < argc)
+    {
+      engine  = ENGINE_PROFILE;
+      profile = argv[++i];
+    }
+    else if (strcmp(argv[i], "--memo-policy") == 0 && i + 1 < argc)
+    {
+      const char *name = argv[++i];
+      if (strcmp(name, "lru") == 0)
+        policy = MEMO_LRU;
+      else if (strcmp(name, "fifo") == 0)
+        policy = MEMO_FIFO;
+      else if (strcmp(name, "keep") == 0)
+        policy = MEMO_KEEP;
+      else
+      {
+        usage(argv[0], stderr);
+        return 1;
+      }
+    }
+    else if ((strcmp(argv[i], "--stack-size") == 0 ||
+              strcmp(argv[i], "--call-depth") == 0 ||
+              strcmp(argv[i], "--memo") == 0) &&
+             i + 1 < argc)
+    {
+      char *end    = NULL;
+      size_t limit = strtoull(argv[i + 1], &end, 10);
+      if (*end || limit == 0)
+      {
+        usage(argv[0], stderr);
+        return 1;
+      }
+      if (strcmp(argv[i], "--stack-size") == 0)
+        config.stack_size = limit;
+      else if (strcmp(argv[i], "--call-depth") == 0)
+        config.call_stack_size = limit;
+      else
+        memo_entries = limit;
+      sized = sized || strcmp(argv[i], "--memo") != 0;
+      ++i;
+    }
+    else if (argv[i][0] != '-' && !filename)
+      filename = argv[i];
+    else
+    {
+      usage(argv[0], stderr);
+      return 1;
+    }
+  }
+  if (!filename)
   {
     usage(argv[0], stderr);
     return 1;
   }
-  const char *filename = argv[1];
+
+  // Only the threaded interpreter looks calls up in the memo, and
+  // not with VM_STACK_SLOTS, see vm_decode_program
+  if (memo_entries > 0 &&
+      (!VM_THREADED || VM_STACK_SLOTS ||
+       (engine != ENGINE_INTERPRETER && engine != ENGINE_JIT_DIFF)))
+  {
+    FAIL("ERROR", "--memo only works with the threaded interpreter\n%s", "");
+    return 1;
+  }
 
 #if VERBOSE >= 1
   INFO("INTERPRETER", "`%s`\n", filename);
@@ -94,38 +238,163 @@ int main(int argc, char *argv[])
   SUCCESS("SETUP", "Read %lu instructions\n", program.count);
 #endif
 
-  size_t stack_size     = 256;
-  byte_t *stack         = calloc(stack_size, 1);
-  size_t registers_size = 8 * WORD_SIZE;
-  byte_t *registers     = calloc(registers_size, 1);
-  heap_t heap           = {0};
-  heap_create(&heap);
-  size_t call_stack_size = 256;
-  word_t *call_stack     = calloc(call_stack_size, sizeof(call_stack));
-
-  vm_t vm = {0};
-  vm_load_stack(&vm, stack, stack_size);
-  vm_load_program(&vm, program);
-  vm_load_registers(&vm, registers, registers_size);
-  vm_load_heap(&vm, heap);
-  vm_load_call_stack(&vm, call_stack, call_stack_size);
+  // Size the vm exactly for programs saying what they need, unless
+  // told otherwise
+  const prog_resources_t resources = program.resources;
+  if (resources.present && !sized)
+  {
+    // A push fails if it'd reach the end of the stack, hence the byte
+    config.stack_size =
+        (VM_STACK_SLOTS ? resources.stack * WORD_SIZE : resources.stack) + 1;
+    config.call_stack_size = MAX(resources.calls, 1);
+    config.registers_size =
+        MAX((resources.registers + WORD_SIZE - 1) / WORD_SIZE, 1) * WORD_SIZE;
+#if VERBOSE >= 1
+    INFO("SETUP", "Sized for stack=%lu calls=%lu registers=%lu heap=%lu\n",
+         resources.stack, resources.calls, resources.registers,
+         resources.heap);
+#endif
+  }
+
+#if VM_GUARD
+  if (!guard_install())
+  {
+    FAIL("ERROR", "Could not install the guard page handler\n%s", "");
+    return 1;
+  }
+#endif
+
+  vm_t *vm = vm_create(config, program);
+  if (!vm)
+  {
+    FAIL("ERROR", "Could not create the vm\n%s", "");
+    return 1;
+  }
+
+  jit_t jit = {0};
+  if ((engine == ENGINE_JIT || engine == ENGINE_JIT_DIFF) &&
+      !jit_compile(program, &jit))
+  {
+    FAIL("ERROR", "Could not compile `%s` to native code\n", filename);
+    return 1;
+  }
+
+  memo_t memo = {0};
+  if (memo_entries > 0)
+  {
+    if (!memo_create(&memo, program, memo_entries, policy))
+    {
+      FAIL("ERROR", "Could not create the memo\n%s", "");
+      return 1;
+    }
+    vm->memo = &memo;
+  }
+
+#if VM_THREADED
+  // Decode once here rather than on every execution
+  decoded_inst_t *decoded =
+      calloc(VM_DECODED_SIZE(program), sizeof(*decoded));
+  if (!decoded)
+  {
+    FAIL("ERROR", "Could not decode `%s`\n", filename);
+    return 1;
+  }
+  vm_decode_program(vm, decoded);
+#endif
 
 #if VERBOSE >= 1
   SUCCESS("SETUP", "Loaded internals\n%s", "");
   INFO("INTERPRETER", "Beginning execution\n%s", "");
 #endif
-  err_t err = vm_execute_all(&vm);
+  verify_t verify = {0};
+  if (engine == ENGINE_UNCHECKED)
+  {
+    verify_program(program, &verify);
+#if VERBOSE >= 1
+    if (!verify.valid)
+      INFO("VERIFY", "Instruction %lu failed verification\n",
+           verify.failed_at);
+#endif
+  }
+
+  cfg_t cfg      = {0};
+  word_t *counts = NULL;
+  if (engine == ENGINE_PROFILE)
+  {
+    if (!cfg_build(program, &cfg) ||
+        !(counts = calloc(cfg.count, sizeof(*counts))))
+    {
+      FAIL("ERROR", "Could not build the control flow graph of `%s`\n",
+           filename);
+      return 1;
+    }
+  }
+
+  err_t err = ERR_OK;
+  if (engine == ENGINE_JIT)
+    err = vm_execute_jit(vm, &jit);
+  else if (engine == ENGINE_UNCHECKED)
+    err = vm_execute_verified(vm, &verify);
+  else if (engine == ENGINE_TRACE)
+    err = vm_execute_traced(vm, stderr);
+  else if (engine == ENGINE_PROFILE)
+    err = vm_execute_profiled(vm, &cfg, counts);
+  else
+    err = vm_execute_all(vm);
+
+  if (engine == ENGINE_JIT_DIFF)
+  {
+    vm_t *jit_vm = vm_create(config, program);
+    if (!jit_vm)
+    {
+      FAIL("ERROR", "Could not create the vm\n%s", "");
+      return 1;
+    }
+    err_t jit_err = vm_execute_jit(jit_vm, &jit);
+    if (!jit_diff(vm, err, jit_vm, jit_err))
+      return 1;
+    vm_destroy(jit_vm);
+#if VERBOSE >= 1
+    SUCCESS("JIT", "Interpreter and JIT agree\n%s", "");
+#endif
+  }
+  jit_free(&jit);
+
+#if VERBOSE >= 1
+  if (vm->memo)
+    INFO("MEMO", "%lu calls skipped, %lu made\n", memo.hits, memo.misses);
+#endif
+
+  if (engine == ENGINE_PROFILE)
+  {
+    cfg_print_profile(&cfg, counts, 10, stderr);
+    FILE *profile_fp = profile ? fopen(profile, "w") : NULL;
+    if (profile_fp)
+    {
+      cfg_write_profile(&cfg, counts, profile_fp);
+      fclose(profile_fp);
+    }
+    else if (profile)
+      FAIL("ERROR", "Could not open `%s`\n", profile);
+    free(counts);
+    cfg_free(&cfg);
+  }
 
   int ret = 0;
   if (err)
   {
     const char *error_str = err_as_cstr(err);
     FAIL("ERROR", "%s\n", error_str);
-    vm_print_all(&vm, stderr);
+    vm_print_all(vm, stderr);
     ret = 255 - err;
   }
 
-  vm_stop(&vm);
+  vm_report_leaks(vm, stderr);
+  vm_destroy(vm);
+  memo_free(&memo);
+#if VM_THREADED
+  free(decoded);
+#endif
 
 #if VERBOSE >= 1
   SUCCESS("INTEPRETER", "Finished execution\n%s", "");
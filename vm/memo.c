@@ -0,0 +1,179 @@
+/* Copyright (C) 2026 Aryadev Chavali
+
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License Version 2 for
+ * more details.
+
+ * You should have received a copy of the GNU General Public License Version 2
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+ * Created: 2026-10-16
+ * Author: Aryadev Chavali
+ * Description: Memoisation of calls to pure subroutines
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <vm/memo.h>
+
+bool memo_create(memo_t *memo, prog_t program, size_t entries,
+                 memo_policy_t policy)
+{
+  *memo         = (memo_t){0};
+  memo->sets    = MAX((entries + MEMO_WAYS - 1) / MEMO_WAYS, 1);
+  memo->policy  = policy;
+  memo->entries = calloc(memo->sets * MEMO_WAYS, sizeof(*memo->entries));
+  memo->pure    = calloc(MAX(program.count, 1), sizeof(*memo->pure));
+  if (!memo->entries || !memo->pure || !pure_analyse(program, memo->pure))
+  {
+    memo_free(memo);
+    return false;
+  }
+  return true;
+}
+
+void memo_free(memo_t *memo)
+{
+  free(memo->entries);
+  free(memo->pure);
+  *memo = (memo_t){0};
+}
+
+// The set a call hashes to, by FNV-1a of its address and key
+static struct MemoEntry *memo_set(memo_t *memo, word_t address,
+                                  const byte_t *key, size_t size)
+{
+  word_t hash = 0xcbf29ce484222325 ^ address;
+  for (size_t i = 0; i < size; ++i)
+    hash = (hash ^ key[i]) * 0x100000001b3;
+  return memo->entries + (hash % memo->sets) * MEMO_WAYS;
+}
+
+/* Copy the bytes of registers set in bits to or from bytes, returning
+   how many were copied. */
+static size_t memo_registers(byte_t *registers, byte_t *bytes, word_t bits,
+                             bool to_registers)
+{
+  size_t n = 0;
+  for (; bits; bits &= bits - 1, ++n)
+    if (to_registers)
+      registers[__builtin_ctzl(bits)] = bytes[n];
+    else
+      bytes[n] = registers[__builtin_ctzl(bits)];
+  return n;
+}
+
+static bool memo_matches(const struct MemoEntry *entry, word_t address,
+                         const byte_t *key, size_t size)
+{
+  return entry->stamp && entry->address == address &&
+         memcmp(entry->data, key, size) == 0;
+}
+
+static struct MemoPending *memo_innermost(memo_t *memo)
+{
+  return memo->pending +
+         (memo->pending_top + MEMO_PENDING - 1) % MEMO_PENDING;
+}
+
+static void memo_pop(memo_t *memo)
+{
+  memo->pending_top = (memo->pending_top + MEMO_PENDING - 1) % MEMO_PENDING;
+  --memo->pending_size;
+}
+
+bool memo_call(memo_t *memo, vm_t *vm, word_t address)
+{
+  const pure_t pure   = memo->pure[address];
+  struct Stack *stack = &vm->stack;
+  const word_t used   = pure.registers | pure.writes;
+  // Calls which would fail reading their arguments, or using the
+  // registers, fail as usual
+  if (!pure.pure || stack->ptr < pure.args ||
+      (used && (word_t)(64 - __builtin_clzl(used)) > vm->registers.size))
+    return false;
+
+  byte_t key[PURE_MAX_ARGS + PURE_MAX_REGISTERS];
+  const size_t base = stack->ptr - pure.args;
+  memcpy(key, stack->data + base, pure.args);
+  const size_t size =
+      pure.args + memo_registers(vm->registers.bytes, key + pure.args,
+                                 pure.registers, false);
+
+  struct MemoEntry *set = memo_set(memo, address, key, size);
+  for (size_t i = 0; i < MEMO_WAYS; ++i)
+    if (memo_matches(set + i, address, key, size) &&
+        base + pure.results <= stack->max)
+    {
+      byte_t *results = set[i].data + size;
+      memcpy(stack->data + base, results, pure.results);
+      memo_registers(vm->registers.bytes, results + pure.results,
+                     pure.writes, true);
+      stack->ptr = base + pure.results;
+      if (memo->policy == MEMO_LRU)
+        set[i].stamp = ++memo->clock;
+      ++memo->hits;
+      return true;
+    }
+
+  ++memo->misses;
+  struct MemoPending *call = memo->pending + memo->pending_top;
+  call->address            = address;
+  call->depth              = vm->call_stack.ptr;
+  call->ptr                = stack->ptr;
+  call->size               = size;
+  memcpy(call->key, key, size);
+  memo->pending_top  = (memo->pending_top + 1) % MEMO_PENDING;
+  memo->pending_size = MIN(memo->pending_size + 1, MEMO_PENDING);
+  return false;
+}
+
+void memo_return(memo_t *memo, vm_t *vm)
+{
+  const size_t depth       = vm->call_stack.ptr;
+  struct MemoPending *call = NULL;
+  // Calls made deeper than this one can't be returned from any more
+  while (memo->pending_size > 0)
+  {
+    call = memo_innermost(memo);
+    if (call->depth < depth)
+      break;
+    memo_pop(memo);
+  }
+  if (memo->pending_size == 0 || call->depth + 1 != depth)
+    return;
+  memo_pop(memo);
+
+  const pure_t pure = memo->pure[call->address];
+  const size_t size = call->size;
+  const size_t base = call->ptr - pure.args;
+  if (vm->stack.ptr != base + pure.results)
+    return;
+
+  struct MemoEntry *set    = memo_set(memo, call->address, call->key, size);
+  struct MemoEntry *victim = NULL;
+  for (size_t i = 0; i < MEMO_WAYS; ++i)
+  {
+    // Sets are filled in order and never emptied, so any match comes
+    // before the first empty entry
+    if (memo_matches(set + i, call->address, call->key, size) ||
+        !set[i].stamp)
+    {
+      victim = set + i;
+      break;
+    }
+    else if (memo->policy != MEMO_KEEP &&
+             (!victim || set[i].stamp < victim->stamp))
+      victim = set + i;
+  }
+  if (!victim)
+    return;
+  victim->address = call->address;
+  victim->stamp   = ++memo->clock;
+  memcpy(victim->data, call->key, size);
+  memcpy(victim->data + size, vm->stack.data + base, pure.results);
+  memo_registers(vm->registers.bytes, victim->data + size + pure.results,
+                 pure.writes, false);
+}
@@ -0,0 +1,132 @@
+/* Copyright (C) 2026 Aryadev Chavali
+
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License Version 2 for
+ * more details.
+
+ * You should have received a copy of the GNU General Public License Version 2
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+ * Created: 2026-10-16
+ * Author: Aryadev Chavali
+ * Description: Memoisation of calls to pure subroutines
+ */
+
+#ifndef MEMO_H
+#define MEMO_H
+
+#include <lib/pure.h>
+#include <vm/struct.h>
+
+/* Entries in each set of the table; a call only ever looks in one. */
+#define MEMO_WAYS 4
+
+/* Calls awaiting their results at once.  A call made while there are
+   this many takes the place of the outermost. */
+#define MEMO_PENDING 64
+
+/**
+   @brief Which entry of a full set a new result replaces.
+
+   @prop[MEMO_LRU] The one least recently inserted or hit
+   @prop[MEMO_FIFO] The one least recently inserted
+   @prop[MEMO_KEEP] None, so the first results kept are never replaced
+ */
+typedef enum
+{
+  MEMO_LRU = 0,
+  MEMO_FIFO,
+  MEMO_KEEP,
+} memo_policy_t;
+
+/* A result: the arguments and registers read by the call, then what
+   it left on the stack and in the registers it wrote to.  stamp is 0
+   if the entry is empty. */
+struct MemoEntry
+{
+  word_t address, stamp;
+  byte_t data[PURE_MAX_ARGS + PURE_MAX_RESULTS + 2 * PURE_MAX_REGISTERS];
+};
+
+/* A call to a pure subroutine yet to return, made with the call stack
+   at depth and the stack at ptr.  Its key is size bytes. */
+struct MemoPending
+{
+  word_t address;
+  size_t depth, ptr, size;
+  byte_t key[PURE_MAX_ARGS + PURE_MAX_REGISTERS];
+};
+
+/**
+   @brief Table of results of calls to pure subroutines of a program.
+
+   @details Results are kept in sets of MEMO_WAYS entries, a call
+   looking in the set its address and arguments hash to, so the table
+   takes sets * sizeof(struct MemoEntry) bytes however many calls are
+   made.  Set the memo of a vm to one before vm_decode_program and the
+   threaded engine looks up every call of a pure subroutine in it,
+   skipping the call if its result is there or remembering the result
+   when it returns if not.
+
+   A call skipped this way can't fail, even if running it would have
+   overflowed the stack or call stack.
+
+   @prop[pure] Result of pure_analyse on the program
+   @prop[entries] Entries of the table, in sets
+   @prop[sets] Number of sets
+   @prop[policy] What's replaced in a full set
+   @prop[clock] Stamp of the last entry inserted or hit
+   @prop[pending] Calls awaiting their results, as a ring
+   @prop[pending_top] Index of pending after the innermost call
+   @prop[pending_size] Number of calls awaiting their results
+   @prop[hits] Calls skipped
+   @prop[misses] Calls run
+ */
+typedef struct Memo
+{
+  pure_t *pure;
+  struct MemoEntry *entries;
+  size_t sets;
+  memo_policy_t policy;
+  word_t clock;
+  struct MemoPending pending[MEMO_PENDING];
+  size_t pending_top, pending_size;
+  size_t hits, misses;
+} memo_t;
+
+/**
+   @brief Make a table for a program holding at least some number of
+   results.
+
+   @param[memo] Table to make
+   @param[program] Program whose calls are looked up in it
+   @param[entries] Least number of results held, rounded up to whole
+   sets
+   @param[policy] What's replaced in a full set
+   @return False if memory couldn't be allocated, in which case memo
+   is left empty
+ */
+bool memo_create(memo_t *memo, prog_t program, size_t entries,
+                 memo_policy_t policy);
+
+void memo_free(memo_t *memo);
+
+/**
+   @brief Look up a call from vm to the pure subroutine at address.
+
+   @details On a hit the arguments on the stack are replaced with the
+   results and the registers are written to, as if the call had been
+   made and returned.  On a miss the call is remembered so memo_return
+   can insert its results.
+
+   @return Whether the results were found, in which case the call
+   mustn't be made
+ */
+bool memo_call(memo_t *memo, vm_t *vm, word_t address);
+
+/* Insert the results of the call vm is about to return from, if it's
+   one memo_call remembered.  Call before the RET is run. */
+void memo_return(memo_t *memo, vm_t *vm);
+
+#endif
@@ -16,12 +16,16 @@
 #include <assert.h>
 #include <inttypes.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
-#if VERBOSE >= 2
-#include <string.h>
+#if VM_TRAP
+#include <setjmp.h>
 #endif
 
+#include <lib/escape.h>
+#include <lib/range.h>
+#include <vm/memo.h>
 #include <vm/runtime.h>
 
 const char *err_as_cstr(err_t err)
@@ -61,35 +65,118 @@ const char *err_as_cstr(err_t err)
   }
 }
 
+#if VM_TRAP
+/* Trap model
+
+   Routines fail through VM_FAIL and propagate the failures of the
+   routines they call through VM_TRY.  Normally those are just returns
+   so every call on the hot path tests an err_t on success as well.
+
+   With VM_TRAP set, VM_FAIL raises a trap instead: the error is stored
+   and control goes straight back to the innermost vm_catch through
+   longjmp.  So on the success path a routine returns ERR_OK which no
+   one looks at, and VM_TRY is just the call.  vm_catch is set once per
+   call to vm_execute or an engine, never per instruction, and returns
+   the err_t raised.  As every routine checks before changing the vm,
+   the state left for vm_print_all is the same in both models.
+
+   A routine called outside of vm_catch would raise with nowhere to go,
+   so other translation units call vm_execute instead. */
+static _Thread_local jmp_buf *vm_trap;
+static _Thread_local err_t vm_trap_err;
+static _Thread_local const vm_t *vm_trap_vm;
+
+const vm_t *vm_trapping(void)
+{
+  return vm_trap_vm;
+}
+
+_Noreturn void vm_raise(err_t err)
+{
+  assert(vm_trap && "vm_raise: Not under vm_catch");
+  vm_trap_err = err;
+  longjmp(*vm_trap, 1);
+}
+
+#define VM_FAIL(ERR) vm_raise(ERR)
+#define VM_TRY(CALL) (void)(CALL)
+
+static err_t vm_catch(vm_t *vm, err_t (*run)(vm_t *, void *),
+                      void *context)
+{
+  jmp_buf trap, *outer = vm_trap;
+  const vm_t *outer_vm = vm_trap_vm;
+  err_t err;
+  if (setjmp(trap) == 0)
+  {
+    vm_trap    = &trap;
+    vm_trap_vm = vm;
+    err        = run(vm, context);
+  }
+  else
+    err = vm_trap_err;
+  vm_trap    = outer;
+  vm_trap_vm = outer_vm;
+  return err;
+}
+#else
+#define VM_FAIL(ERR) return (ERR)
+#define VM_TRY(CALL)       \
+  do                       \
+  {                        \
+    err_t vm_try = (CALL); \
+    if (vm_try)            \
+      return vm_try;       \
+  } while (0)
+
+static inline err_t vm_catch(vm_t *vm, err_t (*run)(vm_t *, void *),
+                             void *context)
+{
+  return run(vm, context);
+}
+#endif
+
+/* Checks for overflow of the stack and call stack by routines, which a
+   VM_GUARD build leaves to the guard pages: see vm/guard.c.  Pushes
+   of more than a byte fail if they'd reach the end of the stack, so
+   with VM_GUARD they touch the byte at END which faults just when the
+   check would fail. */
+#if VM_GUARD
+#define VM_OVERFLOW_IF(COND, ERR) (void)0
+#define VM_OVERFLOW_REACHES(END) \
+  (void)*(volatile byte_t *)(vm->stack.data + (END))
+#else
+#define VM_OVERFLOW_IF(COND, ERR) \
+  do                              \
+  {                               \
+    if (COND)                     \
+      VM_FAIL(ERR);               \
+  } while (0)
+#define VM_OVERFLOW_REACHES(END) \
+  VM_OVERFLOW_IF((END) >= vm->stack.max, ERR_STACK_OVERFLOW)
+#endif
+
 static_assert(NUMBER_OF_OPCODES == 115, "vm_execute: Out of date");
 
-err_t vm_execute(vm_t *vm)
+static err_t vm_step(vm_t *vm)
 {
   struct Program *prog = &vm->program;
   prog_t program_data  = prog->data;
   if (prog->ptr >= program_data.count)
-    return ERR_END_OF_PROGRAM;
+    VM_FAIL(ERR_END_OF_PROGRAM);
   inst_t instruction = program_data.instructions[prog->ptr];
 
   // Opcodes which defer to another function using lookup table
   if (UNSIGNED_OPCODE_IS_TYPE(instruction.opcode, OP_PUSH))
   {
-    err_t err = PUSH_ROUTINES[instruction.opcode](vm, instruction.operand);
-    if (err)
-      return err;
+    VM_TRY(PUSH_ROUTINES[instruction.opcode](vm, instruction.operand));
     prog->ptr++;
   }
   else if (UNSIGNED_OPCODE_IS_TYPE(instruction.opcode, OP_MOV) ||
            UNSIGNED_OPCODE_IS_TYPE(instruction.opcode, OP_PUSH_REGISTER) ||
-           UNSIGNED_OPCODE_IS_TYPE(instruction.opcode, OP_DUP) ||
-           UNSIGNED_OPCODE_IS_TYPE(instruction.opcode, OP_MALLOC) ||
-           UNSIGNED_OPCODE_IS_TYPE(instruction.opcode, OP_MSET) ||
-           UNSIGNED_OPCODE_IS_TYPE(instruction.opcode, OP_MGET))
+           UNSIGNED_OPCODE_IS_TYPE(instruction.opcode, OP_DUP))
   {
-    err_t err =
-        WORD_ROUTINES[instruction.opcode](vm, instruction.operand.as_word);
-    if (err)
-      return err;
+    VM_TRY(WORD_ROUTINES[instruction.opcode](vm, instruction.operand.as_word));
     prog->ptr++;
   }
   else if (UNSIGNED_OPCODE_IS_TYPE(instruction.opcode, OP_POP))
@@ -105,9 +192,7 @@ err_t vm_execute(vm_t *vm)
     opcode_t mov_opcode =
         OPCODE_DATA_TYPE(instruction.opcode, OP_POP) + OP_MOV_BYTE;
 
-    err_t err = WORD_ROUTINES[mov_opcode](vm, 0);
-    if (err)
-      return err;
+    VM_TRY(WORD_ROUTINES[mov_opcode](vm, 0));
     prog->ptr++;
   }
   else if (UNSIGNED_OPCODE_IS_TYPE(instruction.opcode, OP_NOT) ||
@@ -125,16 +210,15 @@ err_t vm_execute(vm_t *vm)
            UNSIGNED_OPCODE_IS_TYPE(instruction.opcode, OP_MALLOC) ||
            UNSIGNED_OPCODE_IS_TYPE(instruction.opcode, OP_MSET) ||
            UNSIGNED_OPCODE_IS_TYPE(instruction.opcode, OP_MGET) ||
+           SIGNED_OPCODE_IS_TYPE(instruction.opcode, OP_PRINT) ||
            instruction.opcode == OP_MDELETE || instruction.opcode == OP_MSIZE)
   {
-    err_t err = STACK_ROUTINES[instruction.opcode](vm);
-    if (err)
-      return err;
+    VM_TRY(STACK_ROUTINES[instruction.opcode](vm));
     prog->ptr++;
   }
   // Opcodes defined in loop
   else if (instruction.opcode == OP_JUMP_ABS)
-    return vm_jump(vm, instruction.operand.as_word);
+    VM_TRY(vm_jump(vm, instruction.operand.as_word));
   else if (UNSIGNED_OPCODE_IS_TYPE(instruction.opcode, OP_JUMP_IF))
   {
     static_assert(DATA_TYPE_NIL == -1 && DATA_TYPE_WORD == 3,
@@ -147,197 +231,1510 @@ err_t vm_execute(vm_t *vm)
     opcode_t pop_opcode =
         OPCODE_DATA_TYPE(instruction.opcode, OP_JUMP_IF) + OP_POP_BYTE;
 
-    err_t err = POP_ROUTINES[pop_opcode](vm, &datum);
-    if (err)
-      return err;
+    VM_TRY(POP_ROUTINES[pop_opcode](vm, &datum));
 
     // If datum != 0 then jump, else go to the next instruction
     if (datum.as_word != 0)
-      return vm_jump(vm, instruction.operand.as_word);
-    ++prog->ptr;
+      VM_TRY(vm_jump(vm, instruction.operand.as_word));
+    else
+      ++prog->ptr;
   }
   else if (instruction.opcode == OP_CALL)
   {
-    if (vm->call_stack.ptr >= vm->call_stack.max)
-      return ERR_CALL_STACK_OVERFLOW;
-    vm->call_stack.address_pointers[vm->call_stack.ptr++] = vm->program.ptr + 1;
-    return vm_jump(vm, instruction.operand.as_word);
+    VM_OVERFLOW_IF(vm->call_stack.ptr >= vm->call_stack.max,
+                   ERR_CALL_STACK_OVERFLOW);
+    // Store before incrementing, so a fault leaves the call stack as is
+    vm->call_stack.address_pointers[vm->call_stack.ptr] = vm->program.ptr + 1;
+    ++vm->call_stack.ptr;
+    VM_TRY(vm_jump(vm, instruction.operand.as_word));
   }
   else if (instruction.opcode == OP_RET)
   {
     if (vm->call_stack.ptr == 0)
-      return ERR_CALL_STACK_UNDERFLOW;
+      VM_FAIL(ERR_CALL_STACK_UNDERFLOW);
     word_t addr = vm->call_stack.address_pointers[vm->call_stack.ptr - 1];
-    err_t err   = vm_jump(vm, vm->call_stack.address_pointers[addr]);
-    if (err)
-      return err;
+    VM_TRY(vm_jump(vm, addr));
 
     --vm->call_stack.ptr;
   }
-  else if (SIGNED_OPCODE_IS_TYPE(instruction.opcode, OP_PRINT))
+  else if (instruction.opcode == OP_NOOP)
+    prog->ptr++;
+  else if (instruction.opcode == OP_HALT)
   {
-    static_assert(DATA_TYPE_NIL == -1 && DATA_TYPE_WORD == 3,
-                  "Code using OPCODE_DATA_TYPE for quick same type opcode "
-                  "conversion may be out of date.");
-    static_assert(OP_PRINT_SWORD - OP_PRINT_BYTE == 7,
-                  "Implementation of OP_PRINT is out of date");
-    /* 1) Pop
-       2) Format
-       3) Print
-     */
-
-    // 1) figure out what datum type to pop
-
-    // type in [0, 7] representing [byte, sbyte, short, sshort, hword, shword,
-    // word, sword]
-    int type = OPCODE_DATA_TYPE(instruction.opcode, OP_PRINT);
-
-    /* Byte and SByte -> POP_BYTE
-       Short and SShort -> POP_SHORT
-       HWord and SHword -> POP_HWORD
-       Word and SWord -> POP_WORD
-     */
-    opcode_t pop_opcode = OP_POP_BYTE + (type / 2);
+    // Do nothing here.  Should be caught by callers of vm_execute
+  }
+  else
+    VM_FAIL(ERR_INVALID_OPCODE);
+  return ERR_OK;
+}
 
-    data_t datum = {0};
-    err_t err    = POP_ROUTINES[pop_opcode](vm, &datum);
+static err_t step_run(vm_t *vm, void *context)
+{
+  (void)context;
+  return vm_step(vm);
+}
 
-    if (err)
-      return err;
+err_t vm_execute(vm_t *vm)
+{
+  return vm_catch(vm, step_run, NULL);
+}
 
-    // 2) create a format string for each datum type possible
+static err_t loop_run(vm_t *vm, void *context)
+{
+  (void)context;
+  struct Program *program = &vm->program;
+  const size_t count      = program->data.count;
+  // Setup the initial address according to the program
+  program->ptr = program->data.start_address;
+  while (program->ptr < count &&
+         program->data.instructions[program->ptr].opcode != OP_HALT)
+    VM_TRY(vm_step(vm));
+  return ERR_OK;
+}
 
-    // TODO: Figure out a way to ensure the ordering of OP_PRINT_* is exactly
-    // BYTE, SBYTE, SHORT, SSHORT, HWORD, SHWORD, WORD, SWORD via static_assert
+err_t vm_execute_loop(vm_t *vm)
+{
+  return vm_catch(vm, loop_run, NULL);
+}
 
-    // lookup table
-    const char *format_strings[] = {
-      "0x%X",
-      "%c",
-#if PRINT_HEX == 1
-      "0x%X",
-      "0x%X",
-      "0x%X",
-      "0x%X",
-      "0x%lX",
-      "0x%dX",
-#else
-      ("%" PRIu32),
-      ("%" PRId32),
-      ("%" PRIu64),
-      ("%" PRId64),
-#endif
-    };
+/* vm_execute_n without the threaded engine, or when the program
+   couldn't be decoded for it.  Every step is counted exactly, while
+   the stop flag is still only checked when the program pointer doesn't
+   go forward. */
+static err_t loop_run_n(vm_t *vm, void *context)
+{
+  run_t *run              = context;
+  struct Program *program = &vm->program;
+  const size_t count      = program->data.count;
+  while (program->ptr < count &&
+         program->data.instructions[program->ptr].opcode != OP_HALT)
+  {
+    if (!run->budget)
+    {
+      run->status = RUN_PAUSED;
+      break;
+    }
+    const word_t ptr = program->ptr;
+    VM_TRY(vm_step(vm));
+    --run->budget;
+    if (program->ptr <= ptr && run->stop &&
+        atomic_load_explicit(run->stop, memory_order_relaxed))
+    {
+      run->status = RUN_STOPPED;
+      break;
+    }
+  }
+  return ERR_OK;
+}
 
-    // 3) Print datum using the format string given.
-    printf(format_strings[type], datum);
+/* Tracing engine
 
-    prog->ptr++;
-  }
-  else if (instruction.opcode == OP_HALT)
+   The same loop as vm_execute_loop, but before every cycle it prints
+   the program and any part of the vm which changed to fp, and counts
+   the pairs of opcodes executed.  It's always built so that a trace
+   can be had from a release binary, while none of this instrumentation
+   goes anywhere near the other engines.  Every cycle goes through
+   vm_execute, which costs nothing next to the printing. */
+
+/* Print the most executed pairs of opcodes, which are the candidates
+   for superinstructions in the threaded engine.  Clears pairs. */
+static void print_opcode_pairs(
+    word_t pairs[NUMBER_OF_OPCODES][NUMBER_OF_OPCODES], size_t n, FILE *fp)
+{
+  fprintf(fp, "Opcode pairs:\n");
+  for (; n > 0; --n)
   {
-    // Do nothing here.  Should be caught by callers of vm_execute
+    size_t first = 0, second = 0;
+    for (size_t i = 0; i < NUMBER_OF_OPCODES; ++i)
+      for (size_t j = 0; j < NUMBER_OF_OPCODES; ++j)
+        if (pairs[i][j] > pairs[first][second])
+        {
+          first  = i;
+          second = j;
+        }
+    if (pairs[first][second] == 0)
+      break;
+    fprintf(fp, "\t%s; %s: %lu\n", opcode_as_cstr(first),
+            opcode_as_cstr(second), pairs[first][second]);
+    pairs[first][second] = 0;
   }
-  else
-    return ERR_INVALID_OPCODE;
-  return ERR_OK;
 }
 
-err_t vm_execute_all(vm_t *vm)
+#define TRACE_RULE                                                         \
+  "----------------------------------------------------------------------" \
+  "----------\n"
+
+err_t vm_execute_traced(vm_t *vm, FILE *fp)
 {
   struct Program *program = &vm->program;
   const size_t count      = program->data.count;
   err_t err               = ERR_OK;
   // Setup the initial address according to the program
   program->ptr = program->data.start_address;
-#if VERBOSE >= 1
-  size_t cycles = 0;
-#endif
-#if VERBOSE >= 2
+
+  size_t cycles                   = 0;
   struct Registers prev_registers = vm->registers;
   size_t prev_sptr                = 0;
   size_t prev_pages               = 0;
   size_t prev_cptr                = 0;
-#endif
+  opcode_t prev_opcode            = NUMBER_OF_OPCODES;
+  word_t(*pairs)[NUMBER_OF_OPCODES] =
+      calloc(NUMBER_OF_OPCODES, sizeof(*pairs));
   while (program->ptr < count &&
          program->data.instructions[program->ptr].opcode != OP_HALT)
   {
-#if VERBOSE >= 2
-    INFO("vm_execute_all", "Trace(Cycle%lu)\n", cycles);
-    fputs(
-        "----------------------------------------------------------------------"
-        "----------\n",
-        stdout);
-    vm_print_program(vm, stdout);
-    fputs(
-        "----------------------------------------------------------------------"
-        "----------\n",
-        stdout);
+    MESSAGE(fp, TERM_YELLOW, "vm_execute_traced", "Trace(Cycle%lu)\n",
+            cycles);
+    fputs(TRACE_RULE, fp);
+    vm_print_program(vm, fp);
+    fputs(TRACE_RULE, fp);
     if (prev_cptr != vm->call_stack.ptr)
     {
-      vm_print_call_stack(vm, stdout);
+      vm_print_call_stack(vm, fp);
       prev_cptr = vm->call_stack.ptr;
-      fputs("------------------------------------------------------------------"
-            "----"
-            "----------\n",
-            stdout);
+      fputs(TRACE_RULE, fp);
     }
     if (prev_pages != HEAP_SIZE(vm->heap))
     {
-      vm_print_heap(vm, stdout);
+      vm_print_heap(vm, fp);
       prev_pages = HEAP_SIZE(vm->heap);
-      fputs("------------------------------------------------------------------"
-            "----"
-            "----------\n",
-            stdout);
+      fputs(TRACE_RULE, fp);
     }
     if (memcmp(&prev_registers, &vm->registers, sizeof(vm->registers)) != 0)
     {
-      vm_print_registers(vm, stdout);
+      vm_print_registers(vm, fp);
       prev_registers = vm->registers;
-      fputs("------------------------------------------------------------------"
-            "----"
-            "----------\n",
-            stdout);
+      fputs(TRACE_RULE, fp);
     }
     if (prev_sptr != vm->stack.ptr)
     {
-      vm_print_stack(vm, stdout);
+      vm_print_stack(vm, fp);
       prev_sptr = vm->stack.ptr;
-      fputs("------------------------------------------------------------------"
-            "----"
-            "----------\n",
-            stdout);
+      fputs(TRACE_RULE, fp);
     }
-#endif
-#if VERBOSE >= 1
     ++cycles;
-#endif
+
+    const opcode_t opcode = program->data.instructions[program->ptr].opcode;
+    if (prev_opcode < NUMBER_OF_OPCODES && opcode < NUMBER_OF_OPCODES)
+      ++pairs[prev_opcode][opcode];
+    prev_opcode = opcode;
+
     err = vm_execute(vm);
     if (err)
-      return err;
+      break;
+  }
+
+  if (!err)
+  {
+    MESSAGE(fp, TERM_YELLOW, "vm_execute_traced",
+            "Final VM State(Cycle %lu)\n", cycles);
+    vm_print_all(vm, fp);
+    print_opcode_pairs(pairs, 10, fp);
+  }
+  free(pairs);
+  return err;
+}
+
+/* Profiling engine
+
+   Control only enters a block at its first instruction and only
+   leaves from its last, so the block is looked up and its counter
+   bumped once per entry.  Within a block each cycle just checks that
+   the program pointer moved on by one and is still inside it; a jump
+   back to the start of the same block fails the first check.  HALT
+   always ends a block, where vm_step leaves the pointer as is. */
+
+struct ProfileRun
+{
+  const cfg_t *cfg;
+  word_t *counts;
+};
+
+static err_t profile_run(vm_t *vm, void *context)
+{
+  const struct ProfileRun *run = context;
+  struct Program *program      = &vm->program;
+  const size_t count           = program->data.count;
+  // Setup the initial address according to the program
+  program->ptr = program->data.start_address;
+  while (program->ptr < count &&
+         program->data.instructions[program->ptr].opcode != OP_HALT)
+  {
+    const size_t block = run->cfg->block_of[program->ptr];
+    const word_t end   = run->cfg->blocks[block].end;
+    ++run->counts[block];
+    word_t ptr;
+    do
+    {
+      ptr = program->ptr;
+      VM_TRY(vm_step(vm));
+    } while (program->ptr == ptr + 1 && program->ptr < end);
+  }
+  return ERR_OK;
+}
+
+err_t vm_execute_profiled(vm_t *vm, const cfg_t *cfg, word_t *counts)
+{
+  struct ProfileRun run = {cfg, counts};
+  return vm_catch(vm, profile_run, &run);
+}
+
+#if VM_THREADED
+/* Threaded execution engine
+
+   Every opcode gets a label in threaded_run and each handler ends by
+   jumping straight to the handler of the next instruction.  So there
+   is no central loop: dispatch is replicated at the end of every
+   handler and costs a single indirect branch, which also gives the
+   branch predictor one history per opcode rather than one overall.
+
+   The engine doesn't run on inst_t's directly but on a stream of
+   decoded_inst_t's made by vm_decode_program.  Each of those has the
+   address of its handler resolved, so dispatch is just `goto
+   *pc->handler`, and jumps have their target validated and resolved
+   to a pointer in the stream.  A sentinel at the end of the stream
+   catches execution falling off the program, so the program counter
+   is never checked against the count.
+
+   The handlers are the exact same routines vm_execute uses, bar the
+   ones working on a cached top of stack when VM_CACHE_TOS is set.
+   They're defined in this translation unit and the engine is
+   flattened, so they're all inlined into it.  vm_execute_loop is kept
+   around as the reference implementation of the semantics.
+
+   Labels as values are a GNU extension, hence the pedantic warnings
+   are suppressed for this section.
+*/
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+
+/* Superinstructions
+
+   Some sequences of opcodes are so common in compiled programs that
+   vm_decode_program fuses each of them into one handler.  Only the
+   record of the first instruction in a sequence is rewritten, so a
+   jump into the middle of a sequence executes the rest of it as
+   usual.
+
+   A fused handler first checks that none of the instructions in its
+   sequence can fail, in which case it does the work of the whole
+   sequence directly without going through the stack.  Otherwise it
+   falls back to the handler of the first instruction and the sequence
+   is executed one instruction at a time, so errors and the program
+   pointer are exactly what they'd be unfused.
+
+   The sequences are the X macros below and the handlers, labels and
+   rules for vm_decode_program are all generated from them.  To find
+   candidates for new ones, vm_execute_traced reports the hottest
+   pairs of opcodes in a program.
+*/
+
+/* PUSH_REGISTER_WORD a; PUSH_WORD n; <OP>_WORD; MOV_WORD b
+   PUSH_WORD n; PUSH_REGISTER_WORD a; <OP>_WORD; MOV_WORD b
+   PUSH_REGISTER_WORD a; PUSH_REGISTER_WORD b; <OP>_WORD; MOV_WORD c */
+#define THREADED_FUSE_ARITHMETIC(X) X(PLUS, +) X(SUB, -) X(MULT, *)
+
+/* Every comparison, as X(OP, COMP, TYPE_CAP, TYPE, GET) where TYPE is
+   what's popped and GET is what's compared.  Each is fused with a
+   following JUMP_IF_BYTE. */
+#define THREADED_COMPARATORS_UNSIGNED(X, OP, COMP) \
+  X(OP, COMP, BYTE, byte, byte)                    \
+  X(OP, COMP, SHORT, short, short)                 \
+  X(OP, COMP, HWORD, hword, hword)                 \
+  X(OP, COMP, WORD, word, word)
+#define THREADED_COMPARATORS_SIGNED(X, OP, COMP) \
+  THREADED_COMPARATORS_UNSIGNED(X, OP, COMP)     \
+  X(OP, COMP, SBYTE, byte, sbyte)                \
+  X(OP, COMP, SSHORT, short, sshort)             \
+  X(OP, COMP, SHWORD, hword, shword)             \
+  X(OP, COMP, SWORD, word, sword)
+#define THREADED_COMPARATORS(X)            \
+  THREADED_COMPARATORS_UNSIGNED(X, EQ, ==) \
+  THREADED_COMPARATORS_SIGNED(X, LT, <)    \
+  THREADED_COMPARATORS_SIGNED(X, LTE, <=)  \
+  THREADED_COMPARATORS_SIGNED(X, GT, >)    \
+  THREADED_COMPARATORS_SIGNED(X, GTE, >=)
+
+#define THREADED_FUSED_ARITHMETIC_ENUM(OP, COMP) \
+  THREADED_FUSED_REGISTER_CONSTANT_##OP,         \
+      THREADED_FUSED_CONSTANT_REGISTER_##OP,     \
+      THREADED_FUSED_REGISTER_REGISTER_##OP,
+#define THREADED_FUSED_COMPARATOR_ENUM(OP, COMP, TYPE_CAP, TYPE, GET) \
+  THREADED_FUSED_##OP##_##TYPE_CAP##_JUMP_IF,                         \
+      THREADED_FUSED_##OP##_##TYPE_CAP##_BACK_JUMP_IF,
+
+/* Handlers in the engine which aren't opcodes, placed after the
+   opcodes in the label table. */
+enum ThreadedHandler
+{
+  THREADED_INVALID_OPCODE = NUMBER_OF_OPCODES,
+  THREADED_END_OF_PROGRAM,
+  // Jumps with an invalid target
+  THREADED_BAD_JUMP_ABS,
+  THREADED_BAD_JUMP_IF_BYTE,
+  THREADED_BAD_JUMP_IF_SHORT,
+  THREADED_BAD_JUMP_IF_HWORD,
+  THREADED_BAD_JUMP_IF_WORD,
+  THREADED_BAD_CALL,
+  // Jumps to the same or an earlier instruction
+  THREADED_BACK_JUMP_ABS,
+  THREADED_BACK_JUMP_IF_BYTE,
+  THREADED_BACK_JUMP_IF_SHORT,
+  THREADED_BACK_JUMP_IF_HWORD,
+  THREADED_BACK_JUMP_IF_WORD,
+  // Allocations which don't escape, see Scratch allocations
+  THREADED_SCRATCH_MALLOC_BYTE,
+  THREADED_SCRATCH_MALLOC_SHORT,
+  THREADED_SCRATCH_MALLOC_HWORD,
+  THREADED_SCRATCH_MALLOC_WORD,
+  THREADED_SCRATCH_MDELETE,
+  // Accesses which are always in bounds, see Unchecked accesses
+  THREADED_UNCHECKED_MSET_BYTE,
+  THREADED_UNCHECKED_MSET_SHORT,
+  THREADED_UNCHECKED_MSET_HWORD,
+  THREADED_UNCHECKED_MSET_WORD,
+  THREADED_UNCHECKED_MGET_BYTE,
+  THREADED_UNCHECKED_MGET_SHORT,
+  THREADED_UNCHECKED_MGET_HWORD,
+  THREADED_UNCHECKED_MGET_WORD,
+  // Calls of pure subroutines and their returns, see Memoised calls
+  THREADED_MEMO_CALL,
+  THREADED_MEMO_RET,
+  // Superinstructions
+  THREADED_FUSE_ARITHMETIC(THREADED_FUSED_ARITHMETIC_ENUM)
+  THREADED_COMPARATORS(THREADED_FUSED_COMPARATOR_ENUM)
+
+  NUMBER_OF_THREADED_HANDLERS,
+};
+
+#define THREADED_LABEL(OP) [OP] = &&label_##OP
+#define THREADED_LABEL_UNSIGNED(OP)                      \
+  THREADED_LABEL(OP##_BYTE), THREADED_LABEL(OP##_SHORT), \
+      THREADED_LABEL(OP##_HWORD), THREADED_LABEL(OP##_WORD)
+#define THREADED_LABEL_SIGNED(OP)                              \
+  THREADED_LABEL(OP##_BYTE), THREADED_LABEL(OP##_SBYTE),       \
+      THREADED_LABEL(OP##_SHORT), THREADED_LABEL(OP##_SSHORT), \
+      THREADED_LABEL(OP##_HWORD), THREADED_LABEL(OP##_SHWORD), \
+      THREADED_LABEL(OP##_WORD), THREADED_LABEL(OP##_SWORD)
+
+#define THREADED_DISPATCH() goto *pc->handler
+
+#define THREADED_NEXT()  \
+  do                     \
+  {                      \
+    ++pc;                \
+    THREADED_DISPATCH(); \
+  } while (0)
+
+#define THREADED_FAIL(ERR) \
+  do                       \
+  {                        \
+    err = (ERR);           \
+    goto end;              \
+  } while (0)
+
+/* Little endian reads and writes of size bytes.  Unlike the convert_*
+   routines these are inlined, so with a constant size they're a
+   single load or store on little endian hosts. */
+static inline word_t threaded_read(const byte_t *bytes, size_t size)
+{
+  word_t datum = 0;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  memcpy(&datum, bytes, size);
+#else
+  for (size_t i = 0; i < size; ++i)
+    datum |= ((word_t)bytes[i]) << (i * 8);
+#endif
+  return datum;
+}
+
+static inline void threaded_write(byte_t *bytes, word_t datum, size_t size)
+{
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  memcpy(bytes, &datum, size);
+#else
+  for (size_t i = 0; i < size; ++i)
+    bytes[i] = (datum >> (i * 8)) & 0xFF;
+#endif
+}
+
+#if VM_CACHE_TOS
+/* Top of stack caching
+
+   The datum at the top of the stack may be kept in cache rather than
+   in the stack buffer, with cached being its size in bytes (0 when
+   nothing is cached).  So the stack as the program sees it is the
+   buffer up to vm->stack.ptr followed by the cached datum in little
+   endian, the same bytes it would have been pushed as.
+
+   The families of opcodes that push and pop (PUSH, POP, PUSH_REGISTER,
+   MOV, NOT, the arithmetic and the comparisons) and JUMP_IF work on
+   the cache directly, so a binary operation on a cached datum reads
+   one value from the buffer and writes nothing back.  Every other
+   handler needs the real view of the stack so it spills the cache
+   into the buffer first, as does leaving the engine for any reason.
+   Checks for overflow and underflow account for the cached datum, so
+   errors happen exactly where they would without the cache.
+*/
+
+/* Bytes above the top of the stack are never read, so unless the
+   cache is right at the end of the buffer the whole word is written
+   in one go whatever the size of the cached datum. */
+static inline void threaded_spill(vm_t *vm, word_t cache, size_t cached)
+{
+  byte_t *top = vm->stack.data + vm->stack.ptr;
+  if (vm->stack.ptr + WORD_SIZE <= vm->stack.max)
+    threaded_write(top, cache, WORD_SIZE);
+  else
+    threaded_write(top, cache, cached);
+  vm->stack.ptr += cached;
+}
+
+#define THREADED_SPILL()                 \
+  do                                     \
+  {                                      \
+    if (cached)                          \
+    {                                    \
+      threaded_spill(vm, cache, cached); \
+      cached = 0;                        \
+    }                                    \
+  } while (0)
+
+#define THREADED_STACK_PTR() (vm->stack.ptr + cached)
+
+#define THREADED_POP_DATUM(TYPE, DATUM)                                        \
+  do                                                                           \
+  {                                                                            \
+    if (cached == sizeof(TYPE##_t))                                            \
+    {                                                                          \
+      (DATUM) = (data_t){.as_##TYPE = cache};                                  \
+      cached  = 0;                                                             \
+      break;                                                                   \
+    }                                                                          \
+    THREADED_SPILL();                                                          \
+    if (vm->stack.ptr < sizeof(TYPE##_t))                                      \
+      THREADED_FAIL(ERR_STACK_UNDERFLOW);                                      \
+    vm->stack.ptr -= sizeof(TYPE##_t);                                         \
+    (DATUM) = (data_t){.as_##TYPE = threaded_read(                             \
+                           vm->stack.data + vm->stack.ptr, sizeof(TYPE##_t))}; \
+  } while (0)
+
+// NOTE: vm_push_byte only checks ptr >= max, unlike the other pushes
+#define THREADED_PUSH_DATUM(TYPE, DATUM)                              \
+  do                                                                  \
+  {                                                                   \
+    if (THREADED_STACK_PTR() +                                        \
+            (sizeof(TYPE##_t) == BYTE_SIZE ? 0 : sizeof(TYPE##_t)) >= \
+        vm->stack.max)                                                \
+      THREADED_FAIL(ERR_STACK_OVERFLOW);                              \
+    THREADED_SPILL();                                                 \
+    cache  = (DATUM).as_##TYPE;                                       \
+    cached = sizeof(TYPE##_t);                                        \
+  } while (0)
+#elif VM_TRAP
+#define THREADED_SPILL()
+#define THREADED_STACK_PTR() (vm->stack.ptr)
+#define THREADED_POP_DATUM(TYPE, DATUM) \
+  do                                    \
+  {                                     \
+    program->ptr = pc - base;           \
+    vm_pop_##TYPE(vm, &(DATUM));        \
+  } while (0)
+#else
+#define THREADED_SPILL()
+#define THREADED_STACK_PTR() (vm->stack.ptr)
+#define THREADED_POP_DATUM(TYPE, DATUM) \
+  do                                    \
+  {                                     \
+    err = vm_pop_##TYPE(vm, &(DATUM));  \
+    if (err)                            \
+      goto end;                         \
+  } while (0)
+#endif
+
+#if VM_TRAP
+/* A routine which fails raises a trap straight out of the engine,
+   past end, so the program pointer is synced before calling one. */
+#define THREADED_HANDLER(OP, CALL) \
+  label_##OP:                      \
+  THREADED_SPILL();                \
+  program->ptr = pc - base;        \
+  (void)(CALL);                    \
+  THREADED_NEXT();
+#else
+#define THREADED_HANDLER(OP, CALL) \
+  label_##OP:                      \
+  THREADED_SPILL();                \
+  err = (CALL);                    \
+  if (err)                         \
+    goto end;                      \
+  THREADED_NEXT();
+#endif
+
+#define THREADED_HANDLER_UNSIGNED(OP, CALL) \
+  THREADED_HANDLER(OP##_BYTE, CALL(byte))   \
+  THREADED_HANDLER(OP##_SHORT, CALL(short)) \
+  THREADED_HANDLER(OP##_HWORD, CALL(hword)) \
+  THREADED_HANDLER(OP##_WORD, CALL(word))
+
+#define THREADED_HANDLER_SIGNED(OP, CALL)     \
+  THREADED_HANDLER(OP##_BYTE, CALL(byte))     \
+  THREADED_HANDLER(OP##_SBYTE, CALL(sbyte))   \
+  THREADED_HANDLER(OP##_SHORT, CALL(short))   \
+  THREADED_HANDLER(OP##_SSHORT, CALL(sshort)) \
+  THREADED_HANDLER(OP##_HWORD, CALL(hword))   \
+  THREADED_HANDLER(OP##_SHWORD, CALL(shword)) \
+  THREADED_HANDLER(OP##_WORD, CALL(word))     \
+  THREADED_HANDLER(OP##_SWORD, CALL(sword))
+
+/* Calls for each family of opcodes, given the type of the opcode */
+#define THREADED_PUSH(TYPE)          vm_push_##TYPE(vm, pc->operand)
+#define THREADED_POP(TYPE)           vm_mov_##TYPE(vm, 0)
+#define THREADED_PUSH_REGISTER(TYPE) \
+  vm_push_##TYPE##_register(vm, pc->operand.as_word)
+#define THREADED_MOV(TYPE)    vm_mov_##TYPE(vm, pc->operand.as_word)
+#define THREADED_DUP(TYPE)    vm_dup_##TYPE(vm, pc->operand.as_word)
+#define THREADED_MALLOC(TYPE) vm_malloc_##TYPE(vm)
+#define THREADED_MSET(TYPE)   vm_mset_##TYPE(vm)
+#define THREADED_MGET(TYPE)   vm_mget_##TYPE(vm)
+#define THREADED_NOT(TYPE)    vm_not_##TYPE(vm)
+#define THREADED_OR(TYPE)     vm_or_##TYPE(vm)
+#define THREADED_AND(TYPE)    vm_and_##TYPE(vm)
+#define THREADED_XOR(TYPE)    vm_xor_##TYPE(vm)
+#define THREADED_EQ(TYPE)     vm_eq_##TYPE(vm)
+#define THREADED_PLUS(TYPE)   vm_plus_##TYPE(vm)
+#define THREADED_SUB(TYPE)    vm_sub_##TYPE(vm)
+#define THREADED_MULT(TYPE)   vm_mult_##TYPE(vm)
+#define THREADED_LT(TYPE)     vm_lt_##TYPE(vm)
+#define THREADED_LTE(TYPE)    vm_lte_##TYPE(vm)
+#define THREADED_GT(TYPE)     vm_gt_##TYPE(vm)
+#define THREADED_GTE(TYPE)    vm_gte_##TYPE(vm)
+#define THREADED_PRINT(TYPE)  vm_print_##TYPE(vm)
+#define THREADED_SCRATCH_ALLOCATE(TYPE) threaded_scratch_malloc_##TYPE(vm)
+#define THREADED_UNCHECKED_SET(TYPE)    threaded_mset_unchecked_##TYPE(vm)
+#define THREADED_UNCHECKED_GET(TYPE)    threaded_mget_unchecked_##TYPE(vm)
+
+#if VM_CACHE_TOS
+/* Handlers for the families which work on the cache, given the type
+   of the opcode.  They do what the vm_* routine for the opcode does,
+   in the same order so errors leave the stack in the same state. */
+#define THREADED_CACHED_UNSIGNED(OP, HANDLER) \
+  HANDLER(OP, BYTE, byte)                     \
+  HANDLER(OP, SHORT, short)                   \
+  HANDLER(OP, HWORD, hword)                   \
+  HANDLER(OP, WORD, word)
+
+#define THREADED_CACHED_PUSH(OP, TYPE_CAP, TYPE) \
+  label_##OP##_##TYPE_CAP:                       \
+  THREADED_PUSH_DATUM(TYPE, pc->operand);        \
+  THREADED_NEXT();
+
+#define THREADED_CACHED_PUSH_REGISTER(OP, TYPE_CAP, TYPE)             \
+  label_##OP##_##TYPE_CAP:                                            \
+  if (pc->operand.as_word >= (vm->registers.size / TYPE_CAP##_SIZE))  \
+    THREADED_FAIL(ERR_INVALID_REGISTER_##TYPE_CAP);                   \
+  else if (THREADED_STACK_PTR() + TYPE_CAP##_SIZE >= vm->stack.max)   \
+    THREADED_FAIL(ERR_STACK_OVERFLOW);                                \
+  THREADED_SPILL();                                                   \
+  cache  = threaded_read(vm->registers.bytes +                        \
+                             (pc->operand.as_word * TYPE_CAP##_SIZE), \
+                         TYPE_CAP##_SIZE);                            \
+  cached = TYPE_CAP##_SIZE;                                           \
+  THREADED_NEXT();
+
+// POP is a MOV into register 0, as in vm_execute
+#define THREADED_CACHED_MOV_TO(LABEL, TYPE_CAP, TYPE, REG)          \
+  LABEL:                                                            \
+  if ((REG) >= (vm->registers.size / TYPE_CAP##_SIZE))              \
+    THREADED_FAIL(ERR_INVALID_REGISTER_##TYPE_CAP);                 \
+  {                                                                 \
+    data_t datum = {0};                                             \
+    THREADED_POP_DATUM(TYPE, datum);                                \
+    threaded_write(vm->registers.bytes + ((REG) * TYPE_CAP##_SIZE), \
+                   datum.as_##TYPE, TYPE_CAP##_SIZE);               \
+  }                                                                 \
+  THREADED_NEXT();
+#define THREADED_CACHED_MOV(OP, TYPE_CAP, TYPE)                   \
+  THREADED_CACHED_MOV_TO(label_##OP##_##TYPE_CAP, TYPE_CAP, TYPE, \
+                         pc->operand.as_word)
+#define THREADED_CACHED_POP(OP, TYPE_CAP, TYPE) \
+  THREADED_CACHED_MOV_TO(label_##OP##_##TYPE_CAP, TYPE_CAP, TYPE, 0)
+
+#define THREADED_CACHED_NOT(OP, TYPE_CAP, TYPE)           \
+  label_##OP##_##TYPE_CAP:                                \
+  {                                                       \
+    data_t a = {0};                                       \
+    THREADED_POP_DATUM(TYPE, a);                          \
+    THREADED_PUSH_DATUM(TYPE, D##TYPE_CAP(!a.as_##TYPE)); \
+  }                                                       \
+  THREADED_NEXT();
+
+#define THREADED_CACHED_SAME_TYPE(OP, COMP, TYPE_CAP, TYPE)               \
+  label_OP_##OP##_##TYPE_CAP:                                             \
+  {                                                                       \
+    data_t a = {0}, b = {0};                                              \
+    THREADED_POP_DATUM(TYPE, a);                                          \
+    THREADED_POP_DATUM(TYPE, b);                                          \
+    THREADED_PUSH_DATUM(TYPE, D##TYPE_CAP(a.as_##TYPE COMP b.as_##TYPE)); \
+  }                                                                       \
+  THREADED_NEXT();
+#define THREADED_CACHED_SAME(OP, COMP)              \
+  THREADED_CACHED_SAME_TYPE(OP, COMP, BYTE, byte)   \
+  THREADED_CACHED_SAME_TYPE(OP, COMP, SHORT, short) \
+  THREADED_CACHED_SAME_TYPE(OP, COMP, HWORD, hword) \
+  THREADED_CACHED_SAME_TYPE(OP, COMP, WORD, word)
+
+#define THREADED_CACHED_COMPARATOR(OP, COMP, TYPE_CAP, TYPE, GET) \
+  label_OP_##OP##_##TYPE_CAP:                                     \
+  {                                                               \
+    data_t a = {0}, b = {0};                                      \
+    THREADED_POP_DATUM(TYPE, a);                                  \
+    THREADED_POP_DATUM(TYPE, b);                                  \
+    THREADED_PUSH_DATUM(byte, DBYTE(b.as_##GET COMP a.as_##GET)); \
+  }                                                               \
+  THREADED_NEXT();
+#endif
+
+/* Bounded runs
+
+   vm_execute_n runs the engine with a budget and stop flag, which are
+   only checked where execution can go backwards: CALL, RET and jumps
+   to the same or an earlier instruction.  Any loop has to go through
+   one of those, so the engine can't run unchecked forever, while
+   straight line code and forward jumps pay nothing for the checks.
+   vm_decode_program gives backward jumps BACK handlers of their own,
+   fused ones included.
+
+   Between two checks execution only goes forward from segment, the
+   instruction the last check resumed at.  So the instructions executed
+   in between are counted as the distance from segment, which is exact
+   bar any skipped by forward jumps.  The budget is only reduced, never
+   checked, outside of a check.
+
+   When a check fails the checked instruction has been executed and
+   the program pointer is set to where it went, so calling
+   vm_execute_n again carries on from there.  Without a run (run is
+   NULL) a check is a single test. */
+
+/* Charge the run for the instructions from segment up to last and
+   move segment to next, returning whether the run has to end.  Kept
+   out of line so the engine doesn't hold segment in a register. */
+__attribute__((noinline, cold)) static bool threaded_check(
+    run_t *run, const decoded_inst_t **segment, const decoded_inst_t *last,
+    const decoded_inst_t *next)
+{
+  run->budget -= MIN((word_t)(last - *segment) + 1, run->budget);
+  *segment = next;
+  if (!run->budget)
+    run->status = RUN_PAUSED;
+  else if (run->stop && atomic_load_explicit(run->stop, memory_order_relaxed))
+    run->status = RUN_STOPPED;
+  return run->status != RUN_HALTED;
+}
+
+#define THREADED_CHECKPOINT(LAST, NEXT)                       \
+  do                                                          \
+  {                                                           \
+    if (run && threaded_check(run, &segment, (LAST), (NEXT))) \
+    {                                                         \
+      pc = segment;                                           \
+      goto end;                                               \
+    }                                                         \
+  } while (0)
+
+/* Pop a datum of the right size, jumping if it's non zero just like
+   vm_execute.  The BAD variant has an invalid target so it fails
+   instead of jumping, while the BACK variant checks the run first. */
+#define THREADED_JUMP_IF(TYPE_CAP, TYPE)          \
+  label_OP_JUMP_IF_##TYPE_CAP:                    \
+  {                                               \
+    data_t datum = {0};                           \
+    THREADED_POP_DATUM(TYPE, datum);              \
+    if (datum.as_word != 0)                       \
+    {                                             \
+      pc = pc->target;                            \
+      THREADED_DISPATCH();                        \
+    }                                             \
+    THREADED_NEXT();                              \
+  }                                               \
+  label_THREADED_BACK_JUMP_IF_##TYPE_CAP:         \
+  {                                               \
+    data_t datum = {0};                           \
+    THREADED_POP_DATUM(TYPE, datum);              \
+    if (datum.as_word != 0)                       \
+    {                                             \
+      THREADED_CHECKPOINT(pc, pc->target);        \
+      pc = pc->target;                            \
+      THREADED_DISPATCH();                        \
+    }                                             \
+    THREADED_NEXT();                              \
+  }                                               \
+  label_THREADED_BAD_JUMP_IF_##TYPE_CAP:          \
+  {                                               \
+    data_t datum = {0};                           \
+    THREADED_POP_DATUM(TYPE, datum);              \
+    if (datum.as_word != 0)                       \
+      THREADED_FAIL(ERR_INVALID_PROGRAM_ADDRESS); \
+    THREADED_NEXT();                              \
+  }
+
+#define THREADED_REGISTER(N) \
+  threaded_read(vm->registers.bytes + ((N) * WORD_SIZE), WORD_SIZE)
+#define THREADED_SET_REGISTER(N, W) \
+  threaded_write(vm->registers.bytes + ((N) * WORD_SIZE), (W), WORD_SIZE)
+
+#define THREADED_FUSED_ARITHMETIC_LABEL(OP, COMP)            \
+  THREADED_LABEL(THREADED_FUSED_REGISTER_CONSTANT_##OP),     \
+      THREADED_LABEL(THREADED_FUSED_CONSTANT_REGISTER_##OP), \
+      THREADED_LABEL(THREADED_FUSED_REGISTER_REGISTER_##OP),
+#define THREADED_FUSED_COMPARATOR_LABEL(OP, COMP, TYPE_CAP, TYPE, GET) \
+  THREADED_LABEL(THREADED_FUSED_##OP##_##TYPE_CAP##_JUMP_IF),          \
+      THREADED_LABEL(THREADED_FUSED_##OP##_##TYPE_CAP##_BACK_JUMP_IF),
+
+/* As in vm_execute, a is the top of the stack so the register pushed
+   last is the left operand. */
+#define THREADED_FUSED_ARITHMETIC_HANDLER(OP, COMP)                     \
+  label_THREADED_FUSED_REGISTER_CONSTANT_##OP:                          \
+  if (pc[0].operand.as_word >= VM_REGISTERS_AVAILABLE(vm->registers) || \
+      pc[3].operand.as_word >= VM_REGISTERS_AVAILABLE(vm->registers) || \
+      THREADED_STACK_PTR() + (2 * WORD_SIZE) >= vm->stack.max)          \
+    goto label_OP_PUSH_REGISTER_WORD;                                   \
+  THREADED_SET_REGISTER(pc[3].operand.as_word,                          \
+                        pc[1].operand.as_word COMP                      \
+                            THREADED_REGISTER(pc[0].operand.as_word));  \
+  pc += 4;                                                              \
+  THREADED_DISPATCH();                                                  \
+  label_THREADED_FUSED_CONSTANT_REGISTER_##OP:                          \
+  if (pc[1].operand.as_word >= VM_REGISTERS_AVAILABLE(vm->registers) || \
+      pc[3].operand.as_word >= VM_REGISTERS_AVAILABLE(vm->registers) || \
+      THREADED_STACK_PTR() + (2 * WORD_SIZE) >= vm->stack.max)          \
+    goto label_OP_PUSH_WORD;                                            \
+  THREADED_SET_REGISTER(pc[3].operand.as_word,                          \
+                        THREADED_REGISTER(pc[1].operand.as_word) COMP   \
+                            pc[0].operand.as_word);                     \
+  pc += 4;                                                              \
+  THREADED_DISPATCH();                                                  \
+  label_THREADED_FUSED_REGISTER_REGISTER_##OP:                          \
+  if (pc[0].operand.as_word >= VM_REGISTERS_AVAILABLE(vm->registers) || \
+      pc[1].operand.as_word >= VM_REGISTERS_AVAILABLE(vm->registers) || \
+      pc[3].operand.as_word >= VM_REGISTERS_AVAILABLE(vm->registers) || \
+      THREADED_STACK_PTR() + (2 * WORD_SIZE) >= vm->stack.max)          \
+    goto label_OP_PUSH_REGISTER_WORD;                                   \
+  THREADED_SET_REGISTER(pc[3].operand.as_word,                          \
+                        THREADED_REGISTER(pc[1].operand.as_word) COMP   \
+                            THREADED_REGISTER(pc[0].operand.as_word));  \
+  pc += 4;                                                              \
+  THREADED_DISPATCH();
+
+/* The byte pushed by the comparison is popped straight away by the
+   jump, so it never has to touch the stack.  The jump's target is
+   always valid as vm_decode_program doesn't fuse BAD jumps, and the
+   BACK variant is for jumps going backwards. */
+#define THREADED_FUSED_COMPARATOR_HANDLER(OP, COMP, TYPE_CAP, TYPE, GET) \
+  label_THREADED_FUSED_##OP##_##TYPE_CAP##_JUMP_IF:                      \
+  if (THREADED_STACK_PTR() < 2 * sizeof(TYPE##_t))                       \
+    goto label_OP_##OP##_##TYPE_CAP;                                     \
+  {                                                                      \
+    data_t a = {0}, b = {0};                                             \
+    THREADED_POP_DATUM(TYPE, a);                                         \
+    THREADED_POP_DATUM(TYPE, b);                                         \
+    pc = (b.as_##GET COMP a.as_##GET) ? pc[1].target : pc + 2;           \
+    THREADED_DISPATCH();                                                 \
+  }                                                                      \
+  label_THREADED_FUSED_##OP##_##TYPE_CAP##_BACK_JUMP_IF:                 \
+  if (THREADED_STACK_PTR() < 2 * sizeof(TYPE##_t))                       \
+    goto label_OP_##OP##_##TYPE_CAP;                                     \
+  {                                                                      \
+    data_t a = {0}, b = {0};                                             \
+    THREADED_POP_DATUM(TYPE, a);                                         \
+    THREADED_POP_DATUM(TYPE, b);                                         \
+    if (!(b.as_##GET COMP a.as_##GET))                                   \
+      pc += 2;                                                           \
+    else                                                                 \
+    {                                                                    \
+      THREADED_CHECKPOINT(pc + 1, pc[1].target);                         \
+      pc = pc[1].target;                                                 \
+    }                                                                    \
+    THREADED_DISPATCH();                                                 \
   }
 
+/* Scratch allocations
+
+   vm_decode_program gives every MALLOC escape_analyse scopes, and
+   every MDELETE of its pages, a SCRATCH handler.  Those pages are
+   always deleted soon after they're allocated, so they come from the
+   scratch pages of the heap: a subroutine allocating a buffer on each
+   call then only pays for zeroing it, rather than a calloc, a free and
+   a scan of every page on the heap.  A page which couldn't be got
+   from there comes from the heap as usual, hence the fallback when
+   deleting. */
+#define THREADED_SCRATCH_CONSTR(TYPE, TYPE_CAP)                         \
+  static err_t threaded_scratch_malloc_##TYPE(vm_t *vm)                 \
+  {                                                                     \
+    data_t n = {0};                                                     \
+    VM_TRY(vm_pop_word(vm, &n));                                        \
+    const size_t size = n.as_word * TYPE_CAP##_SIZE;                    \
+    page_t *page      = heap_scratch_allocate(&vm->heap, size);         \
+    if (!page)                                                          \
+      page = heap_allocate(&vm->heap, size);                            \
+    return vm_push_word(vm, DWORD((word_t)page));                       \
+  }
+
+THREADED_SCRATCH_CONSTR(byte, BYTE)
+THREADED_SCRATCH_CONSTR(short, SHORT)
+THREADED_SCRATCH_CONSTR(hword, HWORD)
+THREADED_SCRATCH_CONSTR(word, WORD)
+
+static err_t threaded_scratch_mdelete(vm_t *vm)
+{
+  data_t ptr = {0};
+  VM_TRY(vm_pop_word(vm, &ptr));
+  page_t *page = (page_t *)ptr.as_word;
+  if (!heap_scratch_free(&vm->heap, page) && !heap_free(&vm->heap, page))
+    VM_FAIL(ERR_INVALID_PAGE_ADDRESS);
+  return ERR_OK;
+}
+
+/* Unchecked accesses
+
+   vm_decode_program gives every MSET and MGET whose index range_analyse
+   proves is in bounds of its page an UNCHECKED handler, which is the
+   same as vm_mset or vm_mget without the bounds check.  That's most
+   accesses in loops over a page, where the check is made once by the
+   condition of the loop rather than on every access. */
+#define THREADED_UNCHECKED_CONSTR(TYPE)                                      \
+  static err_t threaded_mset_unchecked_##TYPE(vm_t *vm)                      \
+  {                                                                          \
+    data_t n = {0};                                                          \
+    VM_TRY(vm_pop_word(vm, &n));                                             \
+    data_t object = {0};                                                     \
+    VM_TRY(vm_pop_##TYPE(vm, &object));                                      \
+    data_t ptr = {0};                                                        \
+    VM_TRY(vm_pop_word(vm, &ptr));                                           \
+    page_t *page                             = (page_t *)ptr.as_word;        \
+    DARR_AT(TYPE##_t, page->data, n.as_word) = object.as_##TYPE;             \
+    return ERR_OK;                                                           \
+  }                                                                          \
+  static err_t threaded_mget_unchecked_##TYPE(vm_t *vm)                      \
+  {                                                                          \
+    data_t n = {0};                                                          \
+    VM_TRY(vm_pop_word(vm, &n));                                             \
+    data_t ptr = {0};                                                        \
+    VM_TRY(vm_pop_word(vm, &ptr));                                           \
+    page_t *page = (page_t *)ptr.as_word;                                    \
+    return vm_push_##TYPE(                                                   \
+        vm, (data_t){.as_##TYPE = DARR_AT(TYPE##_t, page->data, n.as_word)}); \
+  }
+
+THREADED_UNCHECKED_CONSTR(byte)
+THREADED_UNCHECKED_CONSTR(short)
+THREADED_UNCHECKED_CONSTR(hword)
+THREADED_UNCHECKED_CONSTR(word)
+
+/* Memoised calls
+
+   If the vm has a memo when it's decoded, vm_decode_program gives
+   every CALL of a subroutine pure_analyse finds pure a MEMO_CALL
+   handler, and every RET returning from one a MEMO_RET handler.  A
+   call whose result is in the memo is skipped, otherwise it's made
+   as usual and its result inserted at the RET it returns from.  A
+   call which would overflow the call stack is always made, so it
+   fails as usual. */
+
+/* Run the decoded stream of vm, bounded by run if it isn't NULL.  If
+   labels isn't NULL then the label table is written to it instead,
+   which is how vm_decode_program resolves handlers. */
+__attribute__((flatten)) static err_t threaded_run(
+    vm_t *vm, const void *const **labels_out, run_t *run)
+{
+  static const void *const labels[] = {
+      THREADED_LABEL(OP_NOOP),
+      THREADED_LABEL(OP_HALT),
+      THREADED_LABEL_UNSIGNED(OP_PUSH),
+      THREADED_LABEL_UNSIGNED(OP_POP),
+      THREADED_LABEL_UNSIGNED(OP_PUSH_REGISTER),
+      THREADED_LABEL_UNSIGNED(OP_MOV),
+      THREADED_LABEL_UNSIGNED(OP_DUP),
+      THREADED_LABEL_UNSIGNED(OP_MALLOC),
+      THREADED_LABEL_UNSIGNED(OP_MSET),
+      THREADED_LABEL_UNSIGNED(OP_MGET),
+      THREADED_LABEL(OP_MDELETE),
+      THREADED_LABEL(OP_MSIZE),
+      THREADED_LABEL_UNSIGNED(OP_NOT),
+      THREADED_LABEL_UNSIGNED(OP_OR),
+      THREADED_LABEL_UNSIGNED(OP_AND),
+      THREADED_LABEL_UNSIGNED(OP_XOR),
+      THREADED_LABEL_UNSIGNED(OP_EQ),
+      THREADED_LABEL_UNSIGNED(OP_PLUS),
+      THREADED_LABEL_UNSIGNED(OP_SUB),
+      THREADED_LABEL_UNSIGNED(OP_MULT),
+      THREADED_LABEL_SIGNED(OP_LT),
+      THREADED_LABEL_SIGNED(OP_LTE),
+      THREADED_LABEL_SIGNED(OP_GT),
+      THREADED_LABEL_SIGNED(OP_GTE),
+      THREADED_LABEL_SIGNED(OP_PRINT),
+      THREADED_LABEL(OP_JUMP_ABS),
+      THREADED_LABEL_UNSIGNED(OP_JUMP_IF),
+      THREADED_LABEL(OP_CALL),
+      THREADED_LABEL(OP_RET),
+
+      THREADED_LABEL(THREADED_INVALID_OPCODE),
+      THREADED_LABEL(THREADED_END_OF_PROGRAM),
+      THREADED_LABEL(THREADED_BAD_JUMP_ABS),
+      THREADED_LABEL(THREADED_BAD_JUMP_IF_BYTE),
+      THREADED_LABEL(THREADED_BAD_JUMP_IF_SHORT),
+      THREADED_LABEL(THREADED_BAD_JUMP_IF_HWORD),
+      THREADED_LABEL(THREADED_BAD_JUMP_IF_WORD),
+      THREADED_LABEL(THREADED_BAD_CALL),
+      THREADED_LABEL(THREADED_BACK_JUMP_ABS),
+      THREADED_LABEL(THREADED_BACK_JUMP_IF_BYTE),
+      THREADED_LABEL(THREADED_BACK_JUMP_IF_SHORT),
+      THREADED_LABEL(THREADED_BACK_JUMP_IF_HWORD),
+      THREADED_LABEL(THREADED_BACK_JUMP_IF_WORD),
+      THREADED_LABEL_UNSIGNED(THREADED_SCRATCH_MALLOC),
+      THREADED_LABEL(THREADED_SCRATCH_MDELETE),
+      THREADED_LABEL_UNSIGNED(THREADED_UNCHECKED_MSET),
+      THREADED_LABEL_UNSIGNED(THREADED_UNCHECKED_MGET),
+      THREADED_LABEL(THREADED_MEMO_CALL),
+      THREADED_LABEL(THREADED_MEMO_RET),
+      THREADED_FUSE_ARITHMETIC(THREADED_FUSED_ARITHMETIC_LABEL)
+      THREADED_COMPARATORS(THREADED_FUSED_COMPARATOR_LABEL)
+  };
+  static_assert(ARR_SIZE(labels) == NUMBER_OF_THREADED_HANDLERS,
+                "threaded_run: Out of date");
+
+  if (labels_out)
+  {
+    *labels_out = labels;
+    return ERR_OK;
+  }
+
+  struct Program *program = &vm->program;
+  // A bounded run carries on from where the last one stopped
+  const word_t start = run ? program->ptr : program->data.start_address;
+
+  const decoded_inst_t *base    = program->decoded;
+  const word_t count            = program->data.count;
+  const decoded_inst_t *pc      = base + start;
+  const decoded_inst_t *segment = pc;
+  err_t err                     = ERR_OK;
+#if VM_CACHE_TOS
+  word_t cache  = 0;
+  size_t cached = 0;
+#endif
+
+  if (start >= count)
+  {
+    program->ptr = start;
+    return ERR_OK;
+  }
+  // Calls pending from an earlier run will never return
+  if (!run && vm->memo)
+    vm->memo->pending_size = 0;
+  THREADED_DISPATCH();
+
+label_OP_NOOP:
+  THREADED_NEXT();
+label_OP_HALT:
+label_THREADED_END_OF_PROGRAM:
+  goto end;
+label_THREADED_INVALID_OPCODE:
+  THREADED_FAIL(ERR_INVALID_OPCODE);
+
+#if VM_CACHE_TOS
+  THREADED_CACHED_UNSIGNED(OP_PUSH, THREADED_CACHED_PUSH)
+  THREADED_CACHED_UNSIGNED(OP_POP, THREADED_CACHED_POP)
+  THREADED_CACHED_UNSIGNED(OP_PUSH_REGISTER, THREADED_CACHED_PUSH_REGISTER)
+  THREADED_CACHED_UNSIGNED(OP_MOV, THREADED_CACHED_MOV)
+  THREADED_CACHED_UNSIGNED(OP_NOT, THREADED_CACHED_NOT)
+  THREADED_CACHED_SAME(OR, |)
+  THREADED_CACHED_SAME(AND, &)
+  THREADED_CACHED_SAME(XOR, ^)
+  THREADED_CACHED_SAME(PLUS, +)
+  THREADED_CACHED_SAME(SUB, -)
+  THREADED_CACHED_SAME(MULT, *)
+  THREADED_COMPARATORS(THREADED_CACHED_COMPARATOR)
+#else
+  THREADED_HANDLER_UNSIGNED(OP_PUSH, THREADED_PUSH)
+  THREADED_HANDLER_UNSIGNED(OP_POP, THREADED_POP)
+  THREADED_HANDLER_UNSIGNED(OP_PUSH_REGISTER, THREADED_PUSH_REGISTER)
+  THREADED_HANDLER_UNSIGNED(OP_MOV, THREADED_MOV)
+  THREADED_HANDLER_UNSIGNED(OP_NOT, THREADED_NOT)
+  THREADED_HANDLER_UNSIGNED(OP_OR, THREADED_OR)
+  THREADED_HANDLER_UNSIGNED(OP_AND, THREADED_AND)
+  THREADED_HANDLER_UNSIGNED(OP_XOR, THREADED_XOR)
+  THREADED_HANDLER_UNSIGNED(OP_EQ, THREADED_EQ)
+  THREADED_HANDLER_UNSIGNED(OP_PLUS, THREADED_PLUS)
+  THREADED_HANDLER_UNSIGNED(OP_SUB, THREADED_SUB)
+  THREADED_HANDLER_UNSIGNED(OP_MULT, THREADED_MULT)
+  THREADED_HANDLER_SIGNED(OP_LT, THREADED_LT)
+  THREADED_HANDLER_SIGNED(OP_LTE, THREADED_LTE)
+  THREADED_HANDLER_SIGNED(OP_GT, THREADED_GT)
+  THREADED_HANDLER_SIGNED(OP_GTE, THREADED_GTE)
+#endif
+  THREADED_HANDLER_UNSIGNED(OP_DUP, THREADED_DUP)
+  THREADED_HANDLER_UNSIGNED(OP_MALLOC, THREADED_MALLOC)
+  THREADED_HANDLER_UNSIGNED(OP_MSET, THREADED_MSET)
+  THREADED_HANDLER_UNSIGNED(OP_MGET, THREADED_MGET)
+  THREADED_HANDLER(OP_MDELETE, vm_mdelete(vm))
+  THREADED_HANDLER(OP_MSIZE, vm_msize(vm))
+  THREADED_HANDLER_UNSIGNED(THREADED_SCRATCH_MALLOC, THREADED_SCRATCH_ALLOCATE)
+  THREADED_HANDLER(THREADED_SCRATCH_MDELETE, threaded_scratch_mdelete(vm))
+  THREADED_HANDLER_UNSIGNED(THREADED_UNCHECKED_MSET, THREADED_UNCHECKED_SET)
+  THREADED_HANDLER_UNSIGNED(THREADED_UNCHECKED_MGET, THREADED_UNCHECKED_GET)
+  THREADED_HANDLER_SIGNED(OP_PRINT, THREADED_PRINT)
+
+label_OP_JUMP_ABS:
+  pc = pc->target;
+  THREADED_DISPATCH();
+label_THREADED_BACK_JUMP_ABS:
+  THREADED_CHECKPOINT(pc, pc->target);
+  pc = pc->target;
+  THREADED_DISPATCH();
+label_THREADED_BAD_JUMP_ABS:
+  THREADED_FAIL(ERR_INVALID_PROGRAM_ADDRESS);
+
+  THREADED_JUMP_IF(BYTE, byte)
+  THREADED_JUMP_IF(SHORT, short)
+  THREADED_JUMP_IF(HWORD, hword)
+  THREADED_JUMP_IF(WORD, word)
+
+label_OP_CALL:
+  if (vm->call_stack.ptr >= vm->call_stack.max)
+    THREADED_FAIL(ERR_CALL_STACK_OVERFLOW);
+  vm->call_stack.address_pointers[vm->call_stack.ptr++] = (pc - base) + 1;
+  THREADED_CHECKPOINT(pc, pc->target);
+  pc = pc->target;
+  THREADED_DISPATCH();
+  // NOTE: Like vm_execute, a call to an invalid address still leaves
+  // the return address on the call stack.
+label_THREADED_BAD_CALL:
+  if (vm->call_stack.ptr >= vm->call_stack.max)
+    THREADED_FAIL(ERR_CALL_STACK_OVERFLOW);
+  vm->call_stack.address_pointers[vm->call_stack.ptr++] = (pc - base) + 1;
+  THREADED_FAIL(ERR_INVALID_PROGRAM_ADDRESS);
+
+label_THREADED_MEMO_CALL:
+  THREADED_SPILL();
+  if (vm->call_stack.ptr < vm->call_stack.max &&
+      (word_t)(pc - base) + 1 < count &&
+      memo_call(vm->memo, vm, pc->target - base))
+    THREADED_NEXT();
+  goto label_OP_CALL;
+label_THREADED_MEMO_RET:
+  THREADED_SPILL();
+  memo_return(vm->memo, vm);
+  goto label_OP_RET;
+
+label_OP_RET:
+  if (vm->call_stack.ptr == 0)
+    THREADED_FAIL(ERR_CALL_STACK_UNDERFLOW);
+  else
+  {
+    word_t address = vm->call_stack.address_pointers[vm->call_stack.ptr - 1];
+    if (address >= count)
+      THREADED_FAIL(ERR_INVALID_PROGRAM_ADDRESS);
+    --vm->call_stack.ptr;
+    THREADED_CHECKPOINT(pc, base + address);
+    pc = base + address;
+    THREADED_DISPATCH();
+  }
+
+  THREADED_FUSE_ARITHMETIC(THREADED_FUSED_ARITHMETIC_HANDLER)
+  THREADED_COMPARATORS(THREADED_FUSED_COMPARATOR_HANDLER)
+
+end:
+  THREADED_SPILL();
+  if (run)
+    run->budget -= MIN((word_t)(pc - segment), run->budget);
+  program->ptr = pc - base;
+  return err;
+}
+
+#pragma GCC diagnostic pop
+
+/* A sequence ending in a jump going backwards is fused into
+   back_handler instead, see THREADED_CHECKPOINT. */
+struct ThreadedFusion
+{
+  opcode_t opcodes[4];
+  word_t length;
+  enum ThreadedHandler handler, back_handler;
+};
+
+#define THREADED_FUSED_ARITHMETIC_RULE(OP, COMP)                           \
+  {{OP_PUSH_REGISTER_WORD, OP_PUSH_WORD, OP_##OP##_WORD, OP_MOV_WORD},     \
+   4,                                                                      \
+   THREADED_FUSED_REGISTER_CONSTANT_##OP,                                  \
+   THREADED_FUSED_REGISTER_CONSTANT_##OP},                                 \
+      {{OP_PUSH_WORD, OP_PUSH_REGISTER_WORD, OP_##OP##_WORD, OP_MOV_WORD}, \
+       4,                                                                  \
+       THREADED_FUSED_CONSTANT_REGISTER_##OP,                              \
+       THREADED_FUSED_CONSTANT_REGISTER_##OP},                             \
+      {{OP_PUSH_REGISTER_WORD, OP_PUSH_REGISTER_WORD, OP_##OP##_WORD,      \
+        OP_MOV_WORD},                                                      \
+       4,                                                                  \
+       THREADED_FUSED_REGISTER_REGISTER_##OP,                              \
+       THREADED_FUSED_REGISTER_REGISTER_##OP},
+#define THREADED_FUSED_COMPARATOR_RULE(OP, COMP, TYPE_CAP, TYPE, GET) \
+  {{OP_##OP##_##TYPE_CAP, OP_JUMP_IF_BYTE},                           \
+   2,                                                                 \
+   THREADED_FUSED_##OP##_##TYPE_CAP##_JUMP_IF,                        \
+   THREADED_FUSED_##OP##_##TYPE_CAP##_BACK_JUMP_IF},
+
+static const struct ThreadedFusion fusions[] = {
+    THREADED_FUSE_ARITHMETIC(THREADED_FUSED_ARITHMETIC_RULE)
+        THREADED_COMPARATORS(THREADED_FUSED_COMPARATOR_RULE)};
+
+/* Whether the sequence of fusion starts at index of decoded.  Every
+   instruction in the sequence must have been decoded to its own
+   handler, so sequences with invalid jumps are never fused. */
+static bool threaded_fusion_matches(const struct ThreadedFusion *fusion,
+                                    const void *const *labels,
+                                    const prog_t program,
+                                    const decoded_inst_t *decoded,
+                                    word_t index)
+{
+  if (program.count - index < fusion->length)
+    return false;
+  for (word_t i = 0; i < fusion->length; ++i)
+  {
+    const opcode_t opcode = program.instructions[index + i].opcode;
+    if (opcode != fusion->opcodes[i] ||
+        decoded[index + i].handler != labels[opcode])
+      return false;
+  }
+  return true;
+}
+
+void vm_decode_program(vm_t *vm, decoded_inst_t *decoded)
+{
+  const void *const *labels = NULL;
+  threaded_run(NULL, &labels, NULL);
+
+  const prog_t program = vm->program.data;
+  for (word_t i = 0; i < program.count; ++i)
+  {
+    const inst_t inst = program.instructions[i];
+    decoded_inst_t *d = decoded + i;
+    if ((word_t)inst.opcode >= NUMBER_OF_OPCODES)
+    {
+      d->handler = labels[THREADED_INVALID_OPCODE];
+      continue;
+    }
+
+    d->handler = labels[inst.opcode];
+    d->operand = inst.operand;
+    if (inst.opcode == OP_JUMP_ABS || inst.opcode == OP_CALL ||
+        UNSIGNED_OPCODE_IS_TYPE(inst.opcode, OP_JUMP_IF))
+    {
+      const word_t address = inst.operand.as_word;
+      if (address < program.count)
+        d->target = decoded + address;
+      else if (inst.opcode == OP_JUMP_ABS)
+        d->handler = labels[THREADED_BAD_JUMP_ABS];
+      else if (inst.opcode == OP_CALL)
+        d->handler = labels[THREADED_BAD_CALL];
+      else
+        d->handler = labels[THREADED_BAD_JUMP_IF_BYTE +
+                            OPCODE_DATA_TYPE(inst.opcode, OP_JUMP_IF)];
+    }
+  }
+
+  decoded[program.count] =
+      (decoded_inst_t){.handler = labels[THREADED_END_OF_PROGRAM]};
+
+#if !VM_STACK_SLOTS
+  // The analyses track data by their size on the stack, which
+  // VM_STACK_SLOTS doesn't keep to
+  bool *proven = calloc(MAX(program.count, 1), sizeof(*proven));
+  if (proven && escape_analyse(program, proven))
+    for (word_t i = 0; i < program.count; ++i)
+    {
+      const opcode_t opcode = program.instructions[i].opcode;
+      if (!proven[i] || decoded[i].handler != labels[opcode])
+        continue;
+      else if (opcode == OP_MDELETE)
+        decoded[i].handler = labels[THREADED_SCRATCH_MDELETE];
+      else
+        decoded[i].handler = labels[THREADED_SCRATCH_MALLOC_BYTE +
+                                    OPCODE_DATA_TYPE(opcode, OP_MALLOC)];
+    }
+  if (proven && range_analyse(program, proven))
+    for (word_t i = 0; i < program.count; ++i)
+    {
+      const opcode_t opcode = program.instructions[i].opcode;
+      if (!proven[i] || decoded[i].handler != labels[opcode])
+        continue;
+      else if (UNSIGNED_OPCODE_IS_TYPE(opcode, OP_MSET))
+        decoded[i].handler = labels[THREADED_UNCHECKED_MSET_BYTE +
+                                    OPCODE_DATA_TYPE(opcode, OP_MSET)];
+      else
+        decoded[i].handler = labels[THREADED_UNCHECKED_MGET_BYTE +
+                                    OPCODE_DATA_TYPE(opcode, OP_MGET)];
+    }
+  free(proven);
+
+  for (word_t i = 0; vm->memo && i < program.count; ++i)
+  {
+    const inst_t inst = program.instructions[i];
+    if ((inst.opcode != OP_CALL && inst.opcode != OP_RET) ||
+        decoded[i].handler != labels[inst.opcode])
+      continue;
+    else if (inst.opcode == OP_CALL &&
+             vm->memo->pure[inst.operand.as_word].pure)
+      decoded[i].handler = labels[THREADED_MEMO_CALL];
+    else if (inst.opcode == OP_RET && vm->memo->pure[i].pure)
+      decoded[i].handler = labels[THREADED_MEMO_RET];
+  }
+#endif
+
+  // Only the first record of a sequence is rewritten, so records after
+  // index haven't been fused yet when checking the sequence at index
+  for (word_t i = 0; i < program.count; ++i)
+    for (size_t j = 0; j < ARR_SIZE(fusions); ++j)
+      if (threaded_fusion_matches(fusions + j, labels, program, decoded, i))
+      {
+        const decoded_inst_t *last = decoded + i + fusions[j].length - 1;
+        if (fusions[j].opcodes[fusions[j].length - 1] == OP_JUMP_IF_BYTE &&
+            last->target <= last)
+          decoded[i].handler = labels[fusions[j].back_handler];
+        else
+          decoded[i].handler = labels[fusions[j].handler];
+        break;
+      }
+
+  // Backward jumps are only given their handlers now so that they're
+  // fused like any other jump, see THREADED_CHECKPOINT
+  for (word_t i = 0; i < program.count; ++i)
+  {
+    const opcode_t opcode = program.instructions[i].opcode;
+    decoded_inst_t *d     = decoded + i;
+    if ((opcode != OP_JUMP_ABS &&
+         !UNSIGNED_OPCODE_IS_TYPE(opcode, OP_JUMP_IF)) ||
+        d->handler != labels[opcode] || d->target > d)
+      continue;
+    else if (opcode == OP_JUMP_ABS)
+      d->handler = labels[THREADED_BACK_JUMP_ABS];
+    else
+      d->handler = labels[THREADED_BACK_JUMP_IF_BYTE +
+                          OPCODE_DATA_TYPE(opcode, OP_JUMP_IF)];
+  }
+  vm->program.decoded = decoded;
+}
+
+static err_t threaded_execute(vm_t *vm, void *run)
+{
+  return threaded_run(vm, NULL, run);
+}
+
+static err_t threaded_catch(vm_t *vm, run_t *run)
+{
+  if (vm->program.decoded)
+    return vm_catch(vm, threaded_execute, run);
+
+  // Not decoded at load time so decode just for this run, or run
+  // without decoding if there's no memory to
+  decoded_inst_t *decoded =
+      calloc(VM_DECODED_SIZE(vm->program.data), sizeof(*decoded));
+  if (!decoded)
+    return run ? vm_catch(vm, loop_run_n, run) : vm_execute_loop(vm);
+  vm_decode_program(vm, decoded);
+  err_t err = vm_catch(vm, threaded_execute, run);
+  vm->program.decoded = NULL;
+  free(decoded);
+  return err;
+}
+
+err_t vm_execute_threaded(vm_t *vm)
+{
+  return threaded_catch(vm, NULL);
+}
+#endif
+
+err_t vm_execute_n(vm_t *vm, run_t *run)
+{
+  run->status = RUN_HALTED;
+#if VM_THREADED
+  err_t err = threaded_catch(vm, run);
+#else
+  err_t err = vm_catch(vm, loop_run_n, run);
+#endif
+  if (err)
+    run->status = RUN_FAILED;
+  return err;
+}
+
+err_t vm_execute_all(vm_t *vm)
+{
+#if VERBOSE >= 2
+  return vm_execute_traced(vm, stdout);
+#else
+#if VM_THREADED
+  err_t err = vm_execute_threaded(vm);
+#else
+  err_t err = vm_execute_loop(vm);
+#endif
 #if VERBOSE >= 1
-  INFO("vm_execute_all", "Final VM State(Cycle %lu)\n", cycles);
-  vm_print_all(vm, stdout);
+  if (!err)
+  {
+    INFO("vm_execute_all", "Final VM State\n%s", "");
+    vm_print_all(vm, stdout);
+  }
 #endif
   return err;
+#endif
 }
 
 err_t vm_jump(vm_t *vm, word_t w)
 {
   if (w >= vm->program.data.count)
-    return ERR_INVALID_PROGRAM_ADDRESS;
+    VM_FAIL(ERR_INVALID_PROGRAM_ADDRESS);
   vm->program.ptr = w;
   return ERR_OK;
 }
 
+#if VM_STACK_SLOTS
+/* Word slot stack
+
+   Every datum pushed takes one word of the stack, zero extended and in
+   host order, so pushes and pops are single aligned stores and loads
+   whatever the type.  A pop of any type takes a whole slot and
+   truncates it.  Registers are still little endian so PUSH_REGISTER
+   and MOV convert between the two.
+
+   Unlike on the byte exact stack, a push fails exactly when there
+   isn't room for its slot. */
+
+/* Little endian read and write of a datum of size bytes, where size
+   is a constant. */
+static inline word_t vm_slot_read(const byte_t *bytes, size_t size)
+{
+  switch (size)
+  {
+  case BYTE_SIZE:
+    return *bytes;
+  case SHORT_SIZE:
+    return convert_bytes_to_short(bytes);
+  case HWORD_SIZE:
+    return convert_bytes_to_hword(bytes);
+  default:
+    return convert_bytes_to_word(bytes);
+  }
+}
+
+static inline void vm_slot_write(byte_t *bytes, word_t datum, size_t size)
+{
+  switch (size)
+  {
+  case BYTE_SIZE:
+    *bytes = datum;
+    break;
+  case SHORT_SIZE:
+    convert_short_to_bytes(datum, bytes);
+    break;
+  case HWORD_SIZE:
+    convert_hword_to_bytes(datum, bytes);
+    break;
+  default:
+    convert_word_to_bytes(datum, bytes);
+    break;
+  }
+}
+
+#define VM_PUSH_CONSTR(TYPE, TYPE_CAP)                               \
+  err_t vm_push_##TYPE(vm_t *vm, data_t f)                           \
+  {                                                                  \
+    VM_OVERFLOW_IF(vm->stack.ptr + WORD_SIZE > vm->stack.max,        \
+                   ERR_STACK_OVERFLOW);                              \
+    VM_NTH_SLOT(vm->stack, vm->stack.ptr / WORD_SIZE) = f.as_##TYPE; \
+    vm->stack.ptr += WORD_SIZE;                                      \
+    return ERR_OK;                                                   \
+  }
+
+#define VM_POP_CONSTR(TYPE, TYPE_CAP)                                      \
+  err_t vm_pop_##TYPE(vm_t *vm, data_t *ret)                               \
+  {                                                                        \
+    if (vm->stack.ptr < WORD_SIZE)                                         \
+      VM_FAIL(ERR_STACK_UNDERFLOW);                                        \
+    vm->stack.ptr -= WORD_SIZE;                                            \
+    *ret = D##TYPE_CAP(VM_NTH_SLOT(vm->stack, vm->stack.ptr / WORD_SIZE)); \
+    return ERR_OK;                                                         \
+  }
+
+#define VM_PUSH_REGISTER_CONSTR(TYPE, TYPE_CAP)                          \
+  err_t vm_push_##TYPE##_register(vm_t *vm, word_t reg)                  \
+  {                                                                      \
+    if (reg >= (vm->registers.size / TYPE_CAP##_SIZE))                   \
+      VM_FAIL(ERR_INVALID_REGISTER_##TYPE_CAP);                          \
+    VM_OVERFLOW_IF(vm->stack.ptr + WORD_SIZE > vm->stack.max,            \
+                   ERR_STACK_OVERFLOW);                                  \
+    VM_NTH_SLOT(vm->stack, vm->stack.ptr / WORD_SIZE) = vm_slot_read(    \
+        vm->registers.bytes + (reg * TYPE_CAP##_SIZE), TYPE_CAP##_SIZE); \
+    vm->stack.ptr += WORD_SIZE;                                          \
+    return ERR_OK;                                                       \
+  }
+
+#define VM_MOV_CONSTR(TYPE, TYPE_CAP)                                \
+  err_t vm_mov_##TYPE(vm_t *vm, word_t reg)                          \
+  {                                                                  \
+    if (reg >= (vm->registers.size / TYPE_CAP##_SIZE))               \
+      VM_FAIL(ERR_INVALID_REGISTER_##TYPE_CAP);                      \
+    else if (vm->stack.ptr < WORD_SIZE)                              \
+      VM_FAIL(ERR_STACK_UNDERFLOW);                                  \
+    vm->stack.ptr -= WORD_SIZE;                                      \
+    vm_slot_write(vm->registers.bytes + (reg * TYPE_CAP##_SIZE),     \
+                  VM_NTH_SLOT(vm->stack, vm->stack.ptr / WORD_SIZE), \
+                  TYPE_CAP##_SIZE);                                  \
+    return ERR_OK;                                                   \
+  }
+
+/* The slot duplicated is truncated to the type, as if it had been
+   popped and pushed back. */
+#define VM_DUP_CONSTR(TYPE, TYPE_CAP)                         \
+  err_t vm_dup_##TYPE(vm_t *vm, word_t w)                     \
+  {                                                           \
+    const word_t slot = vm->stack.ptr / WORD_SIZE;            \
+    if (slot < w + 1)                                         \
+      VM_FAIL(ERR_STACK_UNDERFLOW);                           \
+    VM_OVERFLOW_IF(vm->stack.ptr + WORD_SIZE > vm->stack.max, \
+                   ERR_STACK_OVERFLOW);                       \
+    VM_NTH_SLOT(vm->stack, slot) =                            \
+        (TYPE##_t)VM_NTH_SLOT(vm->stack, slot - 1 - w);       \
+    vm->stack.ptr += WORD_SIZE;                               \
+    return ERR_OK;                                            \
+  }
+
+VM_PUSH_CONSTR(byte, BYTE)
+VM_PUSH_CONSTR(short, SHORT)
+VM_PUSH_CONSTR(hword, HWORD)
+VM_PUSH_CONSTR(word, WORD)
+
+VM_POP_CONSTR(byte, BYTE)
+VM_POP_CONSTR(short, SHORT)
+VM_POP_CONSTR(hword, HWORD)
+VM_POP_CONSTR(word, WORD)
+
+VM_PUSH_REGISTER_CONSTR(byte, BYTE)
+VM_PUSH_REGISTER_CONSTR(short, SHORT)
+VM_PUSH_REGISTER_CONSTR(hword, HWORD)
+VM_PUSH_REGISTER_CONSTR(word, WORD)
+
+VM_MOV_CONSTR(byte, BYTE)
+VM_MOV_CONSTR(short, SHORT)
+VM_MOV_CONSTR(hword, HWORD)
+VM_MOV_CONSTR(word, WORD)
+
+VM_DUP_CONSTR(byte, BYTE)
+VM_DUP_CONSTR(short, SHORT)
+VM_DUP_CONSTR(hword, HWORD)
+VM_DUP_CONSTR(word, WORD)
+#else
 err_t vm_push_byte(vm_t *vm, data_t b)
 {
-  if (vm->stack.ptr >= vm->stack.max)
-    return ERR_STACK_OVERFLOW;
-  vm->stack.data[vm->stack.ptr++] = b.as_byte;
+  VM_OVERFLOW_IF(vm->stack.ptr >= vm->stack.max, ERR_STACK_OVERFLOW);
+  vm->stack.data[vm->stack.ptr] = b.as_byte;
+  ++vm->stack.ptr;
   return ERR_OK;
 }
 
@@ -358,8 +1755,7 @@ err_t vm_push_byte(vm_t *vm, data_t b)
 #define VM_PUSH_CONSTR(TYPE, TYPE_CAP)                                      \
   err_t vm_push_##TYPE(vm_t *vm, data_t f)                                  \
   {                                                                         \
-    if (vm->stack.ptr + TYPE_CAP##_SIZE >= vm->stack.max)                   \
-      return ERR_STACK_OVERFLOW;                                            \
+    VM_OVERFLOW_REACHES(vm->stack.ptr + TYPE_CAP##_SIZE);                   \
     convert_##TYPE##_to_bytes(f.as_##TYPE, vm->stack.data + vm->stack.ptr); \
     vm->stack.ptr += TYPE_CAP##_SIZE;                                       \
     return ERR_OK;                                                          \
@@ -372,7 +1768,7 @@ VM_PUSH_CONSTR(word, WORD)
 err_t vm_pop_byte(vm_t *vm, data_t *ret)
 {
   if (vm->stack.ptr == 0)
-    return ERR_STACK_UNDERFLOW;
+    VM_FAIL(ERR_STACK_UNDERFLOW);
   *ret = DBYTE(vm->stack.data[--vm->stack.ptr]);
   return ERR_OK;
 }
@@ -389,19 +1785,19 @@ err_t vm_pop_byte(vm_t *vm, data_t *ret)
    at the stack from bottom up there are the values {0xEF, 0xCD, 0xAB,
    0x89} where 0x89 is at the top of the stack.
 
-   1) Bytes are copied into buffer {0xEF, 0xCD, 0xAB, 0x89}
-   2) Value is converted into host order datum */
-
-#define VM_POP_CONSTR(TYPE, TYPE_CAP)                                 \
-  err_t vm_pop_##TYPE(vm_t *vm, data_t *ret)                          \
-  {                                                                   \
-    if (vm->stack.ptr < TYPE_CAP##_SIZE)                              \
-      return ERR_STACK_UNDERFLOW;                                     \
-    byte_t bytes[TYPE_CAP##_SIZE] = {0};                              \
-    memcpy(bytes, vm->stack.data + (vm->stack.ptr - TYPE_CAP##_SIZE), \
-           TYPE_CAP##_SIZE);                                          \
-    *ret = D##TYPE_CAP(convert_bytes_to_##TYPE(bytes));               \
-    return ERR_OK;                                                    \
+   1) Bytes are read from the stack {0xEF, 0xCD, 0xAB, 0x89}
+   2) Value is converted into host order datum, which is just a load
+      on little endian hosts */
+
+#define VM_POP_CONSTR(TYPE, TYPE_CAP)                                         \
+  err_t vm_pop_##TYPE(vm_t *vm, data_t *ret)                                  \
+  {                                                                           \
+    if (vm->stack.ptr < TYPE_CAP##_SIZE)                                      \
+      VM_FAIL(ERR_STACK_UNDERFLOW);                                           \
+    vm->stack.ptr -= TYPE_CAP##_SIZE;                                         \
+    *ret =                                                                    \
+        D##TYPE_CAP(convert_bytes_to_##TYPE(vm->stack.data + vm->stack.ptr)); \
+    return ERR_OK;                                                            \
   }
 
 VM_POP_CONSTR(short, SHORT)
@@ -424,10 +1820,9 @@ VM_POP_CONSTR(word, WORD)
 #define VM_PUSH_REGISTER_CONSTR(TYPE, TYPE_CAP)                             \
   err_t vm_push_##TYPE##_register(vm_t *vm, word_t reg)                     \
   {                                                                         \
-    if (reg > (vm->registers.size / TYPE_CAP##_SIZE))                       \
-      return ERR_INVALID_REGISTER_##TYPE_CAP;                               \
-    else if (vm->stack.ptr + TYPE_CAP##_SIZE >= vm->stack.max)              \
-      return ERR_STACK_OVERFLOW;                                            \
+    if (reg >= (vm->registers.size / TYPE_CAP##_SIZE))                      \
+      VM_FAIL(ERR_INVALID_REGISTER_##TYPE_CAP);                             \
+    VM_OVERFLOW_REACHES(vm->stack.ptr + TYPE_CAP##_SIZE);                   \
     memcpy(vm->stack.data + vm->stack.ptr,                                  \
            vm->registers.bytes + (reg * TYPE_CAP##_SIZE), TYPE_CAP##_SIZE); \
     vm->stack.ptr += TYPE_CAP##_SIZE;                                       \
@@ -450,9 +1845,9 @@ VM_PUSH_REGISTER_CONSTR(word, WORD)
   err_t vm_mov_##TYPE(vm_t *vm, word_t reg)                    \
   {                                                            \
     if (reg >= (vm->registers.size / TYPE_CAP##_SIZE))         \
-      return ERR_INVALID_REGISTER_##TYPE_CAP;                  \
-    else if (vm->stack.ptr + TYPE_CAP##_SIZE >= vm->stack.max) \
-      return ERR_STACK_OVERFLOW;                               \
+      VM_FAIL(ERR_INVALID_REGISTER_##TYPE_CAP);                \
+    else if (vm->stack.ptr < TYPE_CAP##_SIZE)                  \
+      VM_FAIL(ERR_STACK_UNDERFLOW);                            \
     memcpy(vm->registers.bytes + (reg * TYPE_CAP##_SIZE),      \
            vm->stack.data + vm->stack.ptr - (TYPE_CAP##_SIZE), \
            TYPE_CAP##_SIZE);                                   \
@@ -468,7 +1863,7 @@ VM_MOV_CONSTR(word, WORD)
 err_t vm_dup_byte(vm_t *vm, word_t w)
 {
   if (vm->stack.ptr < w + 1)
-    return ERR_STACK_UNDERFLOW;
+    VM_FAIL(ERR_STACK_UNDERFLOW);
   return vm_push_byte(vm, DBYTE(vm->stack.data[vm->stack.ptr - 1 - w]));
 }
 
@@ -476,9 +1871,8 @@ err_t vm_dup_byte(vm_t *vm, word_t w)
   err_t vm_dup_##TYPE(vm_t *vm, word_t w)                                \
   {                                                                      \
     if (vm->stack.ptr < TYPE_CAP##_SIZE * (w + 1))                       \
-      return ERR_STACK_UNDERFLOW;                                        \
-    else if (vm->stack.ptr + TYPE_CAP##_SIZE >= vm->stack.max)           \
-      return ERR_STACK_OVERFLOW;                                         \
+      VM_FAIL(ERR_STACK_UNDERFLOW);                                      \
+    VM_OVERFLOW_REACHES(vm->stack.ptr + TYPE_CAP##_SIZE);                \
     memcpy(vm->stack.data + vm->stack.ptr,                               \
            vm->stack.data + vm->stack.ptr - (TYPE_CAP##_SIZE * (w + 1)), \
            TYPE_CAP##_SIZE);                                             \
@@ -489,14 +1883,13 @@ err_t vm_dup_byte(vm_t *vm, word_t w)
 VM_DUP_CONSTR(short, SHORT)
 VM_DUP_CONSTR(hword, HWORD)
 VM_DUP_CONSTR(word, WORD)
+#endif
 
 #define VM_MALLOC_CONSTR(TYPE, TYPE_CAP)                                  \
   err_t vm_malloc_##TYPE(vm_t *vm)                                        \
   {                                                                       \
-    data_t n  = {0};                                                      \
-    err_t err = vm_pop_word(vm, &n);                                      \
-    if (err)                                                              \
-      return err;                                                         \
+    data_t n = {0};                                                       \
+    VM_TRY(vm_pop_word(vm, &n));                                          \
     page_t *page = heap_allocate(&vm->heap, n.as_word * TYPE_CAP##_SIZE); \
     return vm_push_word(vm, DWORD((word_t)page));                         \
   }
@@ -509,21 +1902,15 @@ VM_MALLOC_CONSTR(word, WORD)
 #define VM_MSET_CONSTR(TYPE, TYPE_CAP)                           \
   err_t vm_mset_##TYPE(vm_t *vm)                                 \
   {                                                              \
-    data_t n  = {0};                                             \
-    err_t err = vm_pop_word(vm, &n);                             \
-    if (err)                                                     \
-      return err;                                                \
+    data_t n = {0};                                              \
+    VM_TRY(vm_pop_word(vm, &n));                                 \
     data_t object = {0};                                         \
-    err           = vm_pop_##TYPE(vm, &object);                  \
-    if (err)                                                     \
-      return err;                                                \
+    VM_TRY(vm_pop_##TYPE(vm, &object));                          \
     data_t ptr = {0};                                            \
-    err        = vm_pop_word(vm, &ptr);                          \
-    if (err)                                                     \
-      return err;                                                \
+    VM_TRY(vm_pop_word(vm, &ptr));                               \
     page_t *page = (page_t *)ptr.as_word;                        \
     if (n.as_word >= (page->available / TYPE_CAP##_SIZE))        \
-      return ERR_OUT_OF_BOUNDS;                                  \
+      VM_FAIL(ERR_OUT_OF_BOUNDS);                                \
     DARR_AT(TYPE##_t, page->data, n.as_word) = object.as_##TYPE; \
     return ERR_OK;                                               \
   }
@@ -533,27 +1920,42 @@ VM_MSET_CONSTR(short, SHORT)
 VM_MSET_CONSTR(hword, HWORD)
 VM_MSET_CONSTR(word, WORD)
 
+#if VM_STACK_SLOTS
+#define VM_MGET_CONSTR(TYPE, TYPE_CAP)                        \
+  err_t vm_mget_##TYPE(vm_t *vm)                              \
+  {                                                           \
+    data_t n = {0};                                           \
+    VM_TRY(vm_pop_word(vm, &n));                              \
+    data_t ptr = {0};                                         \
+    VM_TRY(vm_pop_word(vm, &ptr));                            \
+    page_t *page = (page_t *)ptr.as_word;                     \
+    if (n.as_word >= (page->available / TYPE_CAP##_SIZE))     \
+      VM_FAIL(ERR_OUT_OF_BOUNDS);                             \
+    VM_OVERFLOW_IF(vm->stack.ptr + WORD_SIZE > vm->stack.max, \
+                   ERR_STACK_OVERFLOW);                       \
+    VM_NTH_SLOT(vm->stack, vm->stack.ptr / WORD_SIZE) =       \
+        DARR_AT(TYPE##_t, page->data, n.as_word);             \
+    vm->stack.ptr += WORD_SIZE;                               \
+    return ERR_OK;                                            \
+  }
+#else
 #define VM_MGET_CONSTR(TYPE, TYPE_CAP)                                     \
   err_t vm_mget_##TYPE(vm_t *vm)                                           \
   {                                                                        \
-    data_t n  = {0};                                                       \
-    err_t err = vm_pop_word(vm, &n);                                       \
-    if (err)                                                               \
-      return (err);                                                        \
+    data_t n = {0};                                                        \
+    VM_TRY(vm_pop_word(vm, &n));                                           \
     data_t ptr = {0};                                                      \
-    err        = vm_pop_word(vm, &ptr);                                    \
-    if (err)                                                               \
-      return err;                                                          \
+    VM_TRY(vm_pop_word(vm, &ptr));                                         \
     page_t *page = (page_t *)ptr.as_word;                                  \
     if (n.as_word >= (page->available / TYPE_CAP##_SIZE))                  \
-      return ERR_OUT_OF_BOUNDS;                                            \
-    else if (vm->stack.ptr + TYPE_CAP##_SIZE >= vm->stack.max)             \
-      return ERR_STACK_OVERFLOW;                                           \
+      VM_FAIL(ERR_OUT_OF_BOUNDS);                                          \
+    VM_OVERFLOW_REACHES(vm->stack.ptr + TYPE_CAP##_SIZE);                  \
     memcpy(vm->stack.data + vm->stack.ptr,                                 \
            page->data + (n.as_word * (TYPE_CAP##_SIZE)), TYPE_CAP##_SIZE); \
     vm->stack.ptr += TYPE_CAP##_SIZE;                                      \
     return ERR_OK;                                                         \
   }
+#endif
 
 VM_MGET_CONSTR(byte, BYTE)
 VM_MGET_CONSTR(short, SHORT)
@@ -563,34 +1965,61 @@ VM_MGET_CONSTR(word, WORD)
 err_t vm_mdelete(vm_t *vm)
 {
   data_t ptr = {0};
-  err_t err  = vm_pop_word(vm, &ptr);
-  if (err)
-    return err;
+  VM_TRY(vm_pop_word(vm, &ptr));
   page_t *page = (page_t *)ptr.as_word;
   bool done    = heap_free(&vm->heap, page);
   if (!done)
-    return ERR_INVALID_PAGE_ADDRESS;
+    VM_FAIL(ERR_INVALID_PAGE_ADDRESS);
   return ERR_OK;
 }
 
 err_t vm_msize(vm_t *vm)
 {
   data_t ptr = {0};
-  err_t err  = vm_pop_word(vm, &ptr);
-  if (err)
-    return err;
+  VM_TRY(vm_pop_word(vm, &ptr));
   page_t *page = (page_t *)ptr.as_word;
   return vm_push_word(vm, DWORD(page->available));
 }
 
+/* Printing a datum popped off the stack.
+
+   PRINT_SBYTE prints the byte as a character whereas PRINT_BYTE
+   prints it in hex.  Every other type is printed as a decimal, unless
+   PRINT_HEX is set, in which case they're printed in hex.
+*/
+#define VM_PRINT_CONSTR(TYPE, POP_TYPE, FORMAT) \
+  err_t vm_print_##TYPE(vm_t *vm)               \
+  {                                             \
+    data_t datum = {0};                         \
+    VM_TRY(vm_pop_##POP_TYPE(vm, &datum));      \
+    printf(FORMAT, datum.as_##TYPE);            \
+    return ERR_OK;                              \
+  }
+
+VM_PRINT_CONSTR(byte, byte, "0x%" PRIX8)
+VM_PRINT_CONSTR(sbyte, byte, "%c")
+#if PRINT_HEX == 1
+VM_PRINT_CONSTR(short, short, "0x%" PRIX16)
+VM_PRINT_CONSTR(sshort, short, "0x%" PRIX16)
+VM_PRINT_CONSTR(hword, hword, "0x%" PRIX32)
+VM_PRINT_CONSTR(shword, hword, "0x%" PRIX32)
+VM_PRINT_CONSTR(word, word, "0x%" PRIX64)
+VM_PRINT_CONSTR(sword, word, "0x%" PRIX64)
+#else
+VM_PRINT_CONSTR(short, short, "%" PRIu16)
+VM_PRINT_CONSTR(sshort, short, "%" PRId16)
+VM_PRINT_CONSTR(hword, hword, "%" PRIu32)
+VM_PRINT_CONSTR(shword, hword, "%" PRId32)
+VM_PRINT_CONSTR(word, word, "%" PRIu64)
+VM_PRINT_CONSTR(sword, word, "%" PRId64)
+#endif
+
 // TODO: rename this to something more appropriate
 #define VM_NOT_TYPE(TYPEL, TYPEU)                        \
   err_t vm_not_##TYPEL(vm_t *vm)                         \
   {                                                      \
-    data_t a  = {0};                                     \
-    err_t err = vm_pop_##TYPEL(vm, &a);                  \
-    if (err)                                             \
-      return err;                                        \
+    data_t a = {0};                                      \
+    VM_TRY(vm_pop_##TYPEL(vm, &a));                      \
     return vm_push_##TYPEL(vm, D##TYPEU(!a.as_##TYPEL)); \
   }
 
@@ -604,12 +2033,8 @@ VM_NOT_TYPE(word, WORD)
   err_t vm_##COMPNAME##_##TYPEL(vm_t *vm)                                 \
   {                                                                       \
     data_t a = {0}, b = {0};                                              \
-    err_t err = vm_pop_##TYPEL(vm, &a);                                   \
-    if (err)                                                              \
-      return err;                                                         \
-    err = vm_pop_##TYPEL(vm, &b);                                         \
-    if (err)                                                              \
-      return err;                                                         \
+    VM_TRY(vm_pop_##TYPEL(vm, &a));                                       \
+    VM_TRY(vm_pop_##TYPEL(vm, &b));                                       \
     return vm_push_##TYPEL(vm, D##TYPEU(a.as_##TYPEL COMP b.as_##TYPEL)); \
   }
 
@@ -618,12 +2043,8 @@ VM_NOT_TYPE(word, WORD)
   err_t vm_##COMPNAME##_##GETL(vm_t *vm)                          \
   {                                                               \
     data_t a = {0}, b = {0};                                      \
-    err_t err = vm_pop_##TYPEL(vm, &a);                           \
-    if (err)                                                      \
-      return err;                                                 \
-    err = vm_pop_##TYPEL(vm, &b);                                 \
-    if (err)                                                      \
-      return err;                                                 \
+    VM_TRY(vm_pop_##TYPEL(vm, &a));                               \
+    VM_TRY(vm_pop_##TYPEL(vm, &b));                               \
     return vm_push_byte(vm, DBYTE(b.as_##GETL COMP a.as_##GETL)); \
   }
 
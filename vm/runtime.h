@@ -16,6 +16,9 @@
 #ifndef RUNTIME_H
 #define RUNTIME_H
 
+#include <stdatomic.h>
+
+#include <lib/cfg.h>
 #include <vm/struct.h>
 
 typedef enum
@@ -38,9 +41,159 @@ typedef enum
 
 const char *err_as_cstr(err_t);
 
+/* Flag for the engine used by vm_execute_all.  The threaded engine
+   relies on labels as values (a GNU extension) so it's only the
+   default on compilers supporting them. */
+#ifndef VM_THREADED
+#if defined(__GNUC__)
+#define VM_THREADED 1
+#else
+#define VM_THREADED 0
+#endif
+#endif
+
+/* Flag for top of stack caching in the threaded engine, see
+   vm/runtime.c.  The cache works on the byte exact stack only, and
+   checks for overflow itself so it's off by default with VM_GUARD. */
+#ifndef VM_CACHE_TOS
+#define VM_CACHE_TOS (VM_THREADED && !VM_STACK_SLOTS && !VM_GUARD)
+#endif
+#if VM_CACHE_TOS && VM_STACK_SLOTS
+#error "VM_CACHE_TOS needs the byte exact stack"
+#endif
+
+/* Flag for the trap model, see vm/runtime.c.  When set, the routines
+   below (vm_push_byte and so on) raise a trap on failure rather than
+   returning the error, so they may only be called by vm_execute and
+   the engines which catch it.  Those still return the err_t. */
+#ifndef VM_TRAP
+#define VM_TRAP 0
+#endif
+
+/* Flag for guard pages, see vm/guard.h.  When set, the routines don't
+   check for overflow of the stack or call stack: running off either
+   faults on a guard page, which the handler from guard_install raises
+   as a trap.  So the stack and call stack must come from guard_map,
+   their guard pages starting at max (see GUARD_STACK_SIZE), for
+   overflows to fail on the same pushes as they would when checked. */
+#ifndef VM_GUARD
+#define VM_GUARD 0
+#endif
+#if VM_GUARD && !VM_TRAP
+#error "VM_GUARD needs VM_TRAP"
+#endif
+
 err_t vm_execute(vm_t *);
+
+#if VM_TRAP
+/* The vm executing under the innermost trap on this thread, or NULL
+   if there isn't one. */
+const vm_t *vm_trapping(void);
+
+/* Raise err as a trap, only while vm_trapping isn't NULL. */
+_Noreturn void vm_raise(err_t err);
+#endif
 err_t vm_execute_all(vm_t *);
 
+/* How a bounded run of a program by vm_execute_n ended */
+typedef enum
+{
+  RUN_HALTED = 0, // Halted or ran off the end of the program
+  RUN_PAUSED,     // Budget ran out
+  RUN_STOPPED,    // Stop flag was set
+  RUN_FAILED,     // Error returned by vm_execute_n
+} run_status_t;
+
+/**
+   @brief Bounds on a run of a program by vm_execute_n.
+
+   @prop[budget] Instructions the run may execute, decreased by the
+   instructions it did
+   @prop[stop] Flag another thread may set to stop the run, or NULL
+   @prop[status] Set to how the run ended
+ */
+typedef struct
+{
+  word_t budget;
+  const atomic_bool *stop;
+  run_status_t status;
+} run_t;
+
+/**
+   @brief Execute the program from where it is until it halts, fails,
+   runs out of budget or is stopped.
+
+   @details Unlike the other engines this carries on from the program
+   pointer rather than the start address (vm_load_program sets it to
+   the start address), so a paused or stopped run resumes just by
+   calling this again.  The budget and stop flag are only checked on
+   backward jumps, CALL and RET: straight line code runs unchecked.
+   Instructions are counted at each check as the distance travelled
+   since the last one, so a run may go over budget by one stretch of
+   straight line code, and instructions skipped by forward jumps are
+   counted as executed.
+
+   @param[vm] Virtual machine with a program loaded
+   @param[run] Bounds of the run, status set on return
+   @return The error if the program failed, otherwise ERR_OK
+ */
+err_t vm_execute_n(vm_t *vm, run_t *run);
+
+/* Reference engine: calls vm_execute until the program halts. */
+err_t vm_execute_loop(vm_t *);
+
+/**
+   @brief Execute the program, tracing every cycle.
+
+   @details Before each cycle the program and whatever parts of the vm
+   changed are printed to fp, then if the program halts the final
+   state and the most executed pairs of opcodes.  vm_execute_all uses
+   this in VERBOSE >= 2 builds, otherwise none of the other engines
+   carry any instrumentation.
+
+   @param[vm] Virtual machine with a program loaded
+   @param[fp] Stream to print the trace to
+ */
+err_t vm_execute_traced(vm_t *, FILE *);
+
+/**
+   @brief Execute the program, counting entries into each basic block.
+
+   @details Unlike vm_execute_traced this only does work when control
+   passes from one block to another, so it's cheap enough to run
+   programs with all the time.  Counts are added to, so profiles of
+   several runs may be accumulated.  Print them with
+   cfg_print_profile.
+
+   @param[vm] Virtual machine with a program loaded
+   @param[cfg] Graph of the program, from cfg_build
+   @param[counts] Entries into each block, by index in cfg
+ */
+err_t vm_execute_profiled(vm_t *vm, const cfg_t *cfg, word_t *counts);
+#if VM_THREADED
+/* Threaded engine: see vm/runtime.c. */
+err_t vm_execute_threaded(vm_t *);
+
+/* Number of decoded_inst_t's needed to decode PROGRAM, including the
+   sentinel for the end of the program. */
+#define VM_DECODED_SIZE(PROGRAM) ((PROGRAM).count + 1)
+
+/**
+   @brief Decode the program loaded in vm for the threaded engine.
+
+   @details Should be called once, after vm_load_program, so that the
+   threaded engine doesn't have to decode the program on every call to
+   vm_execute_threaded.  The buffer is owned by the caller and must
+   outlive any execution of the program.  If the memo of vm is set,
+   which must be made for the same program, calls of pure subroutines
+   are looked up in it from then on, see memo.h.
+
+   @param[vm] Virtual machine with a loaded program
+   @param[decoded] Buffer of at least VM_DECODED_SIZE(program) items
+ */
+void vm_decode_program(vm_t *vm, decoded_inst_t *decoded);
+#endif
+
 err_t vm_jump(vm_t *, word_t);
 
 err_t vm_pop_byte(vm_t *, data_t *);
@@ -202,6 +355,15 @@ err_t vm_mult_short(vm_t *);
 err_t vm_mult_hword(vm_t *);
 err_t vm_mult_word(vm_t *);
 
+err_t vm_print_byte(vm_t *);
+err_t vm_print_sbyte(vm_t *);
+err_t vm_print_short(vm_t *);
+err_t vm_print_sshort(vm_t *);
+err_t vm_print_hword(vm_t *);
+err_t vm_print_shword(vm_t *);
+err_t vm_print_word(vm_t *);
+err_t vm_print_sword(vm_t *);
+
 typedef err_t (*stack_f)(vm_t *);
 static const stack_f STACK_ROUTINES[] = {
     [OP_MALLOC_BYTE] = vm_malloc_byte,   [OP_MALLOC_SHORT] = vm_malloc_short,
@@ -257,6 +419,11 @@ static const stack_f STACK_ROUTINES[] = {
 
     [OP_MULT_BYTE] = vm_mult_byte,       [OP_MULT_SHORT] = vm_mult_short,
     [OP_MULT_HWORD] = vm_mult_hword,     [OP_MULT_WORD] = vm_mult_word,
+
+    [OP_PRINT_BYTE] = vm_print_byte,     [OP_PRINT_SBYTE] = vm_print_sbyte,
+    [OP_PRINT_SHORT] = vm_print_short,   [OP_PRINT_SSHORT] = vm_print_sshort,
+    [OP_PRINT_HWORD] = vm_print_hword,   [OP_PRINT_SHWORD] = vm_print_shword,
+    [OP_PRINT_WORD] = vm_print_word,     [OP_PRINT_SWORD] = vm_print_sword,
 };
 
 #endif
@@ -13,14 +13,121 @@
  * Description: Virtual machine data structures and some helpers
  */
 
+#include <assert.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <lib/darr.h>
+#include <vm/guard.h>
 #include <vm/struct.h>
 
+// Members of vm_t which must be in its first cache line, see vm_t
+#define VM_FIRST_LINE(MEMBER)                                            \
+  _Static_assert(offsetof(vm_t, MEMBER) + sizeof(((vm_t *)0)->MEMBER) <= \
+                     VM_CACHE_LINE,                                      \
+                 "vm_t: " #MEMBER " must be in the first cache line")
+
+VM_FIRST_LINE(stack.data);
+VM_FIRST_LINE(stack.ptr);
+VM_FIRST_LINE(stack.max);
+VM_FIRST_LINE(registers);
+VM_FIRST_LINE(program.ptr);
+VM_FIRST_LINE(program.data.count);
+
+/* Creating vms
+
+   Setting a vm up piece by piece takes an allocation for every part of
+   it, which adds up when making many short lived vms.  vm_create
+   makes one block for everything:
+
+   | vm_t | registers | stack | call stack |
+
+   The vm is at the start of the block, which is aligned to a cache
+   line, so its first line has all the state most instructions touch.
+   Only the vm and registers are zeroed: nothing is read from the stack
+   or call stack before it's written, and leaving them alone means
+   large stacks only cost the pages programs use.
+*/
+
+/* Add size rounded up to whole cache lines to total, unless either
+   would wrap. */
+static bool vm_add_lines(size_t *total, size_t size)
+{
+  if (size > SIZE_MAX - VM_CACHE_LINE || VM_LINES(size) > SIZE_MAX - *total)
+    return false;
+  *total += VM_LINES(size);
+  return true;
+}
+
+vm_t *vm_create(vm_config_t config, prog_t program)
+{
+  if (config.call_stack_size > SIZE_MAX / sizeof(word_t))
+    return NULL;
+  const size_t call_stack_size = config.call_stack_size * sizeof(word_t);
+  const size_t header          = VM_LINES(sizeof(vm_t));
+  size_t total                 = header;
+  bool fits = vm_add_lines(&total, config.registers_size);
+  const size_t registers = total - header;
+#if !VM_GUARD
+  fits = fits && vm_add_lines(&total, config.stack_size) &&
+         vm_add_lines(&total, call_stack_size);
+  const size_t stack = VM_LINES(config.stack_size);
+#endif
+  if (!fits)
+    return NULL;
+
+  byte_t *block = aligned_alloc(VM_CACHE_LINE, total);
+  if (!block)
+    return NULL;
+  vm_t *vm = (vm_t *)block;
+  *vm      = (vm_t){0};
+  memset(block + header, 0, registers);
+  vm_load_registers(vm, block + header, config.registers_size);
+  vm_load_program(vm, program);
+  heap_create(&vm->heap);
+
+#if VM_GUARD
+  const size_t stack_size = GUARD_STACK_SIZE(config.stack_size);
+  byte_t *stack            = guard_map(stack_size);
+  word_t *call_stack       = guard_map(call_stack_size);
+  if (!stack || !call_stack)
+  {
+    guard_unmap(stack, stack_size);
+    guard_unmap(call_stack, call_stack_size);
+    free(block);
+    return NULL;
+  }
+  vm_load_stack(vm, stack, config.stack_size);
+  vm_load_call_stack(vm, call_stack, config.call_stack_size);
+#else
+  vm_load_stack(vm, block + header + registers, config.stack_size);
+  vm_load_call_stack(vm, (word_t *)(block + header + registers + stack),
+                     config.call_stack_size);
+#endif
+  return vm;
+}
+
+void vm_destroy(vm_t *vm)
+{
+  if (!vm)
+    return;
+  heap_stop(&vm->heap);
+#if VM_GUARD
+  guard_unmap(vm->stack.data, GUARD_STACK_SIZE(vm->stack.max));
+  guard_unmap(vm->call_stack.address_pointers,
+              vm->call_stack.max * sizeof(word_t));
+#endif
+  free(vm);
+}
+
 void vm_load_stack(vm_t *vm, byte_t *bytes, size_t size)
 {
+#if VM_STACK_SLOTS
+  assert((uintptr_t)bytes % _Alignof(word_t) == 0 &&
+         "vm_load_stack: Stack must be aligned for word slots");
+#endif
   vm->stack.data = bytes;
   vm->stack.max  = size;
   vm->stack.ptr  = 0;
@@ -28,8 +135,9 @@ void vm_load_stack(vm_t *vm, byte_t *bytes, size_t size)
 
 void vm_load_program(vm_t *vm, prog_t program)
 {
-  vm->program.ptr  = 0;
-  vm->program.data = program;
+  vm->program.ptr     = program.start_address;
+  vm->program.data    = program;
+  vm->program.decoded = NULL;
 }
 
 void vm_load_registers(vm_t *vm, byte_t *buffer, size_t size)
@@ -48,23 +156,23 @@ void vm_load_call_stack(vm_t *vm, word_t *buffer, size_t size)
       (struct CallStack){.address_pointers = buffer, .ptr = 0, .max = size};
 }
 
-void vm_stop(vm_t *vm)
+void vm_report_leaks(vm_t *vm, FILE *fp)
 {
 #if VERBOSE >= 1
   bool leaks = false;
-  INFO("vm_stop", "Checking for leaks...\n%s", "");
+  INFO("vm_report_leaks", "Checking for leaks...\n%s", "");
   if (vm->call_stack.ptr > 0)
   {
     leaks = true;
-    FAIL("vm_stop", "Call stack at %lu\n", vm->call_stack.ptr);
-    FAIL("vm_stop", "Call stack trace:%s", "");
+    FAIL("vm_report_leaks", "Call stack at %lu\n", vm->call_stack.ptr);
+    FAIL("vm_report_leaks", "Call stack trace:%s", "");
     for (size_t i = vm->call_stack.ptr; i > 0; --i)
     {
       word_t w = vm->call_stack.address_pointers[i - 1];
-      printf("\t[%lu]: %lX", vm->call_stack.ptr - i, w);
+      fprintf(fp, "\t[%lu]: %lX", vm->call_stack.ptr - i, w);
       if (i != 1)
-        printf(", ");
-      printf("\n");
+        fprintf(fp, ", ");
+      fputc('\n', fp);
     }
   }
   if (HEAP_SIZE(vm->heap) > 0)
@@ -78,26 +186,34 @@ void vm_stop(vm_t *vm)
       capacities[i] = cur->available;
       total_capacity += capacities[i];
     }
-    FAIL("vm_stop", "Heap: %luB (over %lu %s) not reclaimed\n", total_capacity,
-         size_pages, size_pages == 1 ? "page" : "pages");
+    FAIL("vm_report_leaks", "Heap: %luB (over %lu %s) not reclaimed\n",
+         total_capacity, size_pages, size_pages == 1 ? "page" : "pages");
     for (size_t i = 0; i < size_pages; i++)
-      printf("\t[%lu]: %luB lost\n", i, capacities[i]);
+      fprintf(fp, "\t[%lu]: %luB lost\n", i, capacities[i]);
   }
   if (vm->stack.ptr > 0)
   {
     leaks = true;
-    FAIL("vm_stop", "Stack: %luB not reclaimed\n", vm->stack.ptr);
+    FAIL("vm_report_leaks", "Stack: %luB not reclaimed\n", vm->stack.ptr);
   }
   if (leaks)
-    FAIL("vm_stop", "Leaks found\n%s", "");
+    FAIL("vm_report_leaks", "Leaks found\n%s", "");
   else
-    SUCCESS("vm_stop", "No leaks found\n%s", "");
+    SUCCESS("vm_report_leaks", "No leaks found\n%s", "");
+#else
+  (void)vm;
+  (void)fp;
 #endif
+}
 
+void vm_stop(vm_t *vm)
+{
+  vm_report_leaks(vm, stderr);
   vm->registers = (struct Registers){0};
   vm->program   = (struct Program){0};
   vm->stack     = (struct Stack){0};
-  vm->heap      = (heap_t){0};
+  // Frees any pages left, scratch pages included
+  heap_stop(&vm->heap);
 }
 
 void vm_print_registers(vm_t *vm, FILE *fp)
@@ -125,8 +241,11 @@ void vm_print_stack(vm_t *vm, FILE *fp)
     fprintf(fp, "]\n");
     return;
   }
-  printf("\n");
-  for (size_t i = stack.ptr; i > 0; --i)
+  fputc('\n', fp);
+  size_t end = 0;
+  if (stack.ptr > VM_PRINT_STACK_EXCERPT)
+    end = stack.ptr - VM_PRINT_STACK_EXCERPT;
+  for (size_t i = stack.ptr; i > end; --i)
   {
     byte_t b = stack.data[i - 1];
     fprintf(fp, "\t%lu: %X", stack.ptr - i, b);
@@ -134,6 +253,8 @@ void vm_print_stack(vm_t *vm, FILE *fp)
       fprintf(fp, ", ");
     fprintf(fp, "\n");
   }
+  if (end > 0)
+    fprintf(fp, "\t...\n");
   fprintf(fp, "]\n");
 }
 
@@ -211,8 +332,11 @@ void vm_print_call_stack(vm_t *vm, FILE *fp)
     fprintf(fp, "]\n");
     return;
   }
-  printf("\n");
-  for (size_t i = cs.ptr; i > 0; --i)
+  fputc('\n', fp);
+  size_t end = 0;
+  if (cs.ptr > VM_PRINT_STACK_EXCERPT)
+    end = cs.ptr - VM_PRINT_STACK_EXCERPT;
+  for (size_t i = cs.ptr; i > end; --i)
   {
     word_t w = cs.address_pointers[i - 1];
     fprintf(fp, "\t%lu: %lX", cs.ptr - i, w);
@@ -220,6 +344,8 @@ void vm_print_call_stack(vm_t *vm, FILE *fp)
       fprintf(fp, ", ");
     fprintf(fp, "\n");
   }
+  if (end > 0)
+    fprintf(fp, "\t...\n");
   fprintf(fp, "]\n");
 }
 
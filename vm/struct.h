@@ -26,16 +26,50 @@ struct Registers
   size_t size;
 };
 
+/* Flag for the word slot stack.  Normally the stack is byte exact: a
+   datum takes as many bytes as its type, in little endian, so bytes
+   pushed one way can be popped another.  With VM_STACK_SLOTS set every
+   datum takes a whole word instead, aligned and in host order, which
+   suits programs only using words.  The stack pointer and size stay in
+   bytes and the buffer must be aligned for word_t. */
+#ifndef VM_STACK_SLOTS
+#define VM_STACK_SLOTS 0
+#endif
+
 struct Stack
 {
   byte_t *data;
   size_t ptr, max;
 };
 
+#define VM_NTH_SLOT(STACK, N) (((word_t *)((STACK).data))[N])
+
+/**
+   @brief An instruction decoded for the threaded engine.
+
+   @details Made from an inst_t by vm_decode_program.  Jumps have their
+   address resolved into a pointer to the target, so only one of
+   operand or target is in use.
+
+   @prop[handler] Address of the handler for the instruction
+   @prop[operand] Operand of the instruction
+   @prop[target] Decoded instruction to jump to
+ */
+typedef struct DecodedInst
+{
+  const void *handler;
+  union
+  {
+    data_t operand;
+    const struct DecodedInst *target;
+  };
+} decoded_inst_t;
+
 struct Program
 {
-  prog_t data;
   word_t ptr;
+  prog_t data;
+  decoded_inst_t *decoded;
 };
 
 struct CallStack
@@ -47,16 +81,61 @@ struct CallStack
 #define VM_NTH_REGISTER(REGISTERS, N)     (((word_t *)((REGISTERS).bytes))[N])
 #define VM_REGISTERS_AVAILABLE(REGISTERS) (((REGISTERS).size) / WORD_SIZE)
 
+/* Bytes in a cache line, see vm_create */
+#define VM_CACHE_LINE 64
+
+// Round SIZE up to whole cache lines
+#define VM_LINES(SIZE) \
+  ((((SIZE) + VM_CACHE_LINE - 1) / VM_CACHE_LINE) * VM_CACHE_LINE)
+
+/* The members nearly every instruction uses (stack, registers and the
+   program counter with the bounds of the program) come first, to fit
+   in the first cache line of a vm aligned by vm_create.  The call
+   stack and heap are only used by some instructions so come after.
+   memo is NULL unless calls are memoised, see memo.h. */
 typedef struct
 {
-  struct Registers registers;
   struct Stack stack;
-  heap_t heap;
+  struct Registers registers;
+  struct Program program;
 
   struct CallStack call_stack;
-  struct Program program;
+  heap_t heap;
+  struct Memo *memo;
 } vm_t;
 
+/**
+   @brief Sizes of the parts of a vm made by vm_create.
+
+   @prop[stack_size] Size of the stack in bytes
+   @prop[registers_size] Size of the registers in bytes
+   @prop[call_stack_size] Number of entries in the call stack
+ */
+typedef struct
+{
+  size_t stack_size, registers_size, call_stack_size;
+} vm_config_t;
+
+/**
+   @brief Create a vm for a program in one allocation.
+
+   @details The vm, its registers, stack and call stack are laid out
+   in that order in one block aligned to VM_CACHE_LINE, each part
+   starting on a line of its own.  Only the vm and registers are
+   zeroed.  The program is borrowed, not copied, so many vms may share
+   it.  With VM_GUARD the stack and call stack come from guard_map
+   instead, their guard pages right after the sizes in config.
+
+   @param[config] Sizes of the parts of the vm
+   @param[program] Program to load
+   @return The vm, or NULL if it couldn't be allocated
+ */
+vm_t *vm_create(vm_config_t config, prog_t program);
+
+/* Free a vm made by vm_create along with its heap.  Call this rather
+   than vm_stop on it, which unloads the stack vm_destroy unmaps. */
+void vm_destroy(vm_t *);
+
 // Start and stop
 void vm_load_stack(vm_t *, byte_t *, size_t);
 void vm_load_registers(vm_t *, byte_t *, size_t);
@@ -64,9 +143,13 @@ void vm_load_heap(vm_t *, heap_t);
 void vm_load_program(vm_t *, prog_t);
 void vm_load_call_stack(vm_t *, word_t *, size_t);
 void vm_stop(vm_t *);
+// Report what's left on the stacks and heap if VERBOSE >= 1
+void vm_report_leaks(vm_t *, FILE *);
 
 // Printing the VM
 #define VM_PRINT_PROGRAM_EXCERPT 5
+// Entries from the top of either stack printed
+#define VM_PRINT_STACK_EXCERPT 256
 void vm_print_registers(vm_t *, FILE *);
 void vm_print_stack(vm_t *, FILE *);
 void vm_print_program(vm_t *, FILE *);
@@ -0,0 +1,585 @@
+/* Copyright (C) 2026 Aryadev Chavali
+
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License Version 2 for
+ * more details.
+
+ * You should have received a copy of the GNU General Public License Version 2
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+ * Created: 2026-10-16
+ * Author: Aryadev Chavali
+ * Description: Load time verifier and unchecked execution of programs
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vm/verify.h>
+
+/* Verification
+
+   The program is split into procedures: the one at the start address
+   and one for the target of every CALL.  Each procedure is walked over
+   every path from its entry with the stack depth relative to the entry
+   as the abstract state.  Two paths reaching an instruction with
+   different depths, like a loop pushing on every iteration, fail
+   verification.
+
+   A CALL uses the summary of its target: the least depth it reaches,
+   the most stack it needs, how deep it nests calls and the change in
+   depth on return.  Every RET in a procedure must return with the same
+   depth, and a procedure may not RET if it isn't called.  A summary
+   still being computed when it's needed means recursion, which fails.
+
+   Heap, print and DUP opcodes are only verified for their effect on
+   the stack on success, as they always run through their own checked
+   routines.
+*/
+
+#define VERIFY_UNKNOWN LONG_MIN
+
+static const word_t sizes[] = {BYTE_SIZE, SHORT_SIZE, HWORD_SIZE, WORD_SIZE};
+
+struct Summary
+{
+  enum
+  {
+    SUMMARY_NONE = 0,
+    SUMMARY_PENDING,
+    SUMMARY_DONE,
+  } state;
+  bool returns;
+  sword_t delta, min, extent;
+  word_t registers, calls;
+};
+
+struct Verification
+{
+  prog_t program;
+  struct Summary *summaries;
+  word_t failed_at;
+  size_t nesting;
+};
+
+/* Effect of an instruction on the stack when it succeeds, from
+   opcode_info: bytes popped, then bytes pushed as one datum.  Pushes check ptr + size >=
+   max, except for vm_push_byte which checks ptr >= max, so strict is
+   whether the stack pointer after the push must be < max rather than
+   <= max. */
+struct Effect
+{
+  word_t pop, push;
+  bool strict;
+};
+
+static struct Effect verify_effect(opcode_t opcode)
+{
+  struct Effect effect = {opcode_info[opcode].pop, opcode_info[opcode].push,
+                          false};
+  effect.strict = UNSIGNED_OPCODE_IS_TYPE(opcode, OP_PUSH_REGISTER) ||
+                  UNSIGNED_OPCODE_IS_TYPE(opcode, OP_MGET) ||
+                  effect.push > BYTE_SIZE;
+  return effect;
+}
+
+/* Bytes of the register file an instruction uses, or 0 if it uses
+   none or the register can't possibly exist. */
+static word_t verify_registers(inst_t inst, bool *valid)
+{
+  word_t size = 0, reg = inst.operand.as_word;
+  if (UNSIGNED_OPCODE_IS_TYPE(inst.opcode, OP_PUSH_REGISTER))
+    size = sizes[OPCODE_DATA_TYPE(inst.opcode, OP_PUSH_REGISTER)];
+  else if (UNSIGNED_OPCODE_IS_TYPE(inst.opcode, OP_MOV))
+    size = sizes[OPCODE_DATA_TYPE(inst.opcode, OP_MOV)];
+  else if (UNSIGNED_OPCODE_IS_TYPE(inst.opcode, OP_POP))
+  {
+    size = sizes[OPCODE_DATA_TYPE(inst.opcode, OP_POP)];
+    reg  = 0;
+  }
+  *valid = size == 0 || reg < WORD_MAX / size;
+  return *valid && size ? (reg + 1) * size : 0;
+}
+
+static bool verify_procedure(struct Verification *v, word_t entry,
+                             bool is_called);
+
+static const struct Summary *verify_call(struct Verification *v,
+                                         word_t target)
+{
+  struct Summary *summary = v->summaries + target;
+  if (summary->state == SUMMARY_NONE &&
+      (v->nesting >= VERIFY_MAX_NESTING ||
+       !verify_procedure(v, target, true)))
+    return NULL;
+  return summary->state == SUMMARY_DONE ? summary : NULL;
+}
+
+/* Walk every path of the procedure at entry, filling its summary. */
+static bool verify_procedure(struct Verification *v, word_t entry,
+                             bool is_called)
+{
+  const prog_t program    = v->program;
+  struct Summary *summary = v->summaries + entry;
+  struct Summary result   = {.state = SUMMARY_DONE};
+  sword_t *depths         = malloc(program.count * sizeof(*depths));
+  word_t *work            = malloc(program.count * sizeof(*work));
+  size_t work_size        = 0;
+  bool valid              = depths && work;
+
+  summary->state = SUMMARY_PENDING;
+  ++v->nesting;
+  // Without the memory to walk it the procedure can't be verified
+  if (!valid)
+  {
+    v->failed_at = entry;
+    goto end;
+  }
+  for (word_t i = 0; i < program.count; ++i)
+    depths[i] = VERIFY_UNKNOWN;
+  depths[entry]     = 0;
+  work[work_size++] = entry;
+
+#define VERIFY_FAIL()       \
+  do                        \
+  {                         \
+    v->failed_at = address; \
+    valid        = false;   \
+    goto end;               \
+  } while (0)
+
+#define VERIFY_SUCCESSOR(ADDRESS, DEPTH)     \
+  do                                         \
+  {                                          \
+    if (depths[(ADDRESS)] == VERIFY_UNKNOWN) \
+    {                                        \
+      depths[(ADDRESS)] = (DEPTH);           \
+      work[work_size++] = (ADDRESS);         \
+    }                                        \
+    else if (depths[(ADDRESS)] != (DEPTH))   \
+      VERIFY_FAIL();                         \
+  } while (0)
+
+  while (work_size > 0)
+  {
+    const word_t address = work[--work_size];
+    const inst_t inst    = program.instructions[address];
+    const opcode_t op    = inst.opcode;
+    const sword_t depth  = depths[address];
+    const bool target    = inst.operand.as_word < program.count;
+    if ((word_t)op >= NUMBER_OF_OPCODES)
+      VERIFY_FAIL();
+
+    bool register_valid   = true;
+    const word_t reg_size = verify_registers(inst, &register_valid);
+    if (!register_valid)
+      VERIFY_FAIL();
+    else if (reg_size > result.registers)
+      result.registers = reg_size;
+
+    const struct Effect effect = verify_effect(op);
+    const sword_t popped       = depth - (sword_t)effect.pop;
+    const sword_t next         = popped + (sword_t)effect.push;
+    if (popped < result.min)
+      result.min = popped;
+    if (effect.push && next + effect.strict > result.extent)
+      result.extent = next + effect.strict;
+
+    if (op == OP_HALT)
+      continue;
+    else if (op == OP_JUMP_ABS)
+    {
+      if (!target)
+        VERIFY_FAIL();
+      VERIFY_SUCCESSOR(inst.operand.as_word, next);
+      continue;
+    }
+    else if (UNSIGNED_OPCODE_IS_TYPE(op, OP_JUMP_IF))
+    {
+      if (!target)
+        VERIFY_FAIL();
+      VERIFY_SUCCESSOR(inst.operand.as_word, next);
+    }
+    else if (op == OP_CALL)
+    {
+      const struct Summary *callee = NULL;
+      if (!target || !(callee = verify_call(v, inst.operand.as_word)))
+        VERIFY_FAIL();
+      if (depth + callee->min < result.min)
+        result.min = depth + callee->min;
+      if (depth + callee->extent > result.extent)
+        result.extent = depth + callee->extent;
+      if (callee->calls + 1 > result.calls)
+        result.calls = callee->calls + 1;
+      if (callee->registers > result.registers)
+        result.registers = callee->registers;
+      // Returning to the end of the program is an invalid address
+      if (callee->returns && address + 1 >= program.count)
+        VERIFY_FAIL();
+      else if (callee->returns)
+        VERIFY_SUCCESSOR(address + 1, depth + callee->delta);
+      continue;
+    }
+    else if (op == OP_RET)
+    {
+      if (!is_called || (result.returns && result.delta != depth))
+        VERIFY_FAIL();
+      result.returns = true;
+      result.delta   = depth;
+      continue;
+    }
+
+    // Falling off the end of the program just ends it
+    if (address + 1 < program.count)
+      VERIFY_SUCCESSOR(address + 1, next);
+  }
+
+#undef VERIFY_SUCCESSOR
+#undef VERIFY_FAIL
+
+end:
+  --v->nesting;
+  *summary = valid ? result : (struct Summary){0};
+  free(depths);
+  free(work);
+  return valid;
+}
+
+bool verify_program(prog_t program, verify_t *verify)
+{
+  *verify = (verify_t){0};
+  if (program.start_address >= program.count)
+  {
+    verify->valid = true;
+    return true;
+  }
+
+  struct Verification v = {
+      .program   = program,
+      .summaries = calloc(program.count, sizeof(struct Summary)),
+      .failed_at = program.start_address,
+  };
+  if (v.summaries && verify_procedure(&v, program.start_address, false))
+  {
+    const struct Summary *summary = v.summaries + program.start_address;
+    verify->valid                 = true;
+    verify->stack_min             = -summary->min;
+    verify->stack_extent          = summary->extent;
+    verify->registers_min         = summary->registers;
+    verify->call_depth            = summary->calls;
+  }
+  else
+    verify->failed_at = v.failed_at;
+  free(v.summaries);
+  return verify->valid;
+}
+
+bool verify_holds(const verify_t *verify, const vm_t *vm)
+{
+  // Requirements are in terms of the byte exact stack
+  return !VM_STACK_SLOTS && verify->valid &&
+         vm->stack.ptr >= verify->stack_min &&
+         vm->stack.max >= verify->stack_extent &&
+         vm->stack.ptr <= vm->stack.max - verify->stack_extent &&
+         vm->registers.size >= verify->registers_min &&
+         vm->call_stack.ptr <= vm->call_stack.max &&
+         vm->call_stack.max - vm->call_stack.ptr >= verify->call_depth;
+}
+
+/* Unchecked execution
+
+   Once verify_holds, every check vm_execute would make on the stack,
+   registers, call stack and jumps is known to pass, so the engine
+   below makes none of them.  Each handler is specialised for the size
+   of its datum, so reads and writes of the stack are single loads and
+   stores on little endian hosts.
+
+   Like the threaded engine, handlers dispatch straight to the next
+   handler through a table of labels when labels as values are
+   available, which is the case whenever VM_THREADED is set.  Otherwise
+   they're the cases of a switch.  Jumps, calls and returns only go to
+   verified addresses, so the only check left is for falling off the
+   end of the program.
+*/
+
+static inline word_t verify_read(const byte_t *bytes, size_t size)
+{
+  word_t datum = 0;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  memcpy(&datum, bytes, size);
+#else
+  for (size_t i = 0; i < size; ++i)
+    datum |= ((word_t)bytes[i]) << (i * 8);
+#endif
+  return datum;
+}
+
+static inline void verify_write(byte_t *bytes, word_t datum, size_t size)
+{
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  memcpy(bytes, &datum, size);
+#else
+  for (size_t i = 0; i < size; ++i)
+    bytes[i] = (datum >> (i * 8)) & 0xFF;
+#endif
+}
+
+#if VM_THREADED
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#define VERIFIED_HANDLER(OP) label_##OP:
+#define VERIFIED_DISPATCH()  goto *labels[instructions[pc].opcode]
+#else
+#define VERIFIED_HANDLER(OP) case OP:
+#define VERIFIED_DISPATCH()  continue
+#endif
+
+/* Not wrapped in a do while, as VERIFIED_DISPATCH may be a continue */
+#define VERIFIED_NEXT()  \
+  {                      \
+    if (++pc >= count)   \
+      goto end;          \
+    VERIFIED_DISPATCH(); \
+  }
+
+#define VERIFIED_LABEL(OP) [OP] = &&label_##OP
+#define VERIFIED_LABEL_UNSIGNED(OP)                      \
+  VERIFIED_LABEL(OP##_BYTE), VERIFIED_LABEL(OP##_SHORT), \
+      VERIFIED_LABEL(OP##_HWORD), VERIFIED_LABEL(OP##_WORD)
+#define VERIFIED_LABEL_SIGNED(OP)                              \
+  VERIFIED_LABEL(OP##_BYTE), VERIFIED_LABEL(OP##_SBYTE),       \
+      VERIFIED_LABEL(OP##_SHORT), VERIFIED_LABEL(OP##_SSHORT), \
+      VERIFIED_LABEL(OP##_HWORD), VERIFIED_LABEL(OP##_SHWORD), \
+      VERIFIED_LABEL(OP##_WORD), VERIFIED_LABEL(OP##_SWORD)
+
+#define VERIFIED_UNSIGNED(HANDLER, OP) \
+  HANDLER(OP##_BYTE, BYTE, byte)       \
+  HANDLER(OP##_SHORT, SHORT, short)    \
+  HANDLER(OP##_HWORD, HWORD, hword)    \
+  HANDLER(OP##_WORD, WORD, word)
+
+#define VERIFIED_SIGNED(HANDLER, OP, COMP)  \
+  HANDLER(OP##_BYTE, COMP, BYTE, byte)      \
+  HANDLER(OP##_SBYTE, COMP, BYTE, sbyte)    \
+  HANDLER(OP##_SHORT, COMP, SHORT, short)   \
+  HANDLER(OP##_SSHORT, COMP, SHORT, sshort) \
+  HANDLER(OP##_HWORD, COMP, HWORD, hword)   \
+  HANDLER(OP##_SHWORD, COMP, HWORD, shword) \
+  HANDLER(OP##_WORD, COMP, WORD, word)      \
+  HANDLER(OP##_SWORD, COMP, WORD, sword)
+
+#define VERIFIED_PUSH(OP, TYPE_CAP, TYPE)                      \
+  VERIFIED_HANDLER(OP)                                         \
+  verify_write(stack + sp, instructions[pc].operand.as_##TYPE, \
+               TYPE_CAP##_SIZE);                               \
+  sp += TYPE_CAP##_SIZE;                                       \
+  VERIFIED_NEXT();
+
+// POP is a MOV into register 0, as in vm_execute
+#define VERIFIED_POP(OP, TYPE_CAP, TYPE)          \
+  VERIFIED_HANDLER(OP)                            \
+  sp -= TYPE_CAP##_SIZE;                          \
+  memcpy(registers, stack + sp, TYPE_CAP##_SIZE); \
+  VERIFIED_NEXT();
+
+#define VERIFIED_PUSH_REGISTER(OP, TYPE_CAP, TYPE)                         \
+  VERIFIED_HANDLER(OP)                                                     \
+  memcpy(stack + sp,                                                       \
+         registers + (instructions[pc].operand.as_word * TYPE_CAP##_SIZE), \
+         TYPE_CAP##_SIZE);                                                 \
+  sp += TYPE_CAP##_SIZE;                                                   \
+  VERIFIED_NEXT();
+
+#define VERIFIED_MOV(OP, TYPE_CAP, TYPE)                                   \
+  VERIFIED_HANDLER(OP)                                                     \
+  sp -= TYPE_CAP##_SIZE;                                                   \
+  memcpy(registers + (instructions[pc].operand.as_word * TYPE_CAP##_SIZE), \
+         stack + sp, TYPE_CAP##_SIZE);                                     \
+  VERIFIED_NEXT();
+
+#define VERIFIED_NOT(OP, TYPE_CAP, TYPE)                                    \
+  VERIFIED_HANDLER(OP)                                                      \
+  verify_write(stack + sp - TYPE_CAP##_SIZE,                                \
+               !verify_read(stack + sp - TYPE_CAP##_SIZE, TYPE_CAP##_SIZE), \
+               TYPE_CAP##_SIZE);                                            \
+  VERIFIED_NEXT();
+
+// As in vm_execute, a is the top of the stack
+#define VERIFIED_SAME_TYPE(OP, COMP, TYPE_CAP, TYPE)                       \
+  VERIFIED_HANDLER(OP)                                                     \
+  {                                                                        \
+    const word_t a =                                                       \
+        verify_read(stack + sp - TYPE_CAP##_SIZE, TYPE_CAP##_SIZE);        \
+    const word_t b =                                                       \
+        verify_read(stack + sp - (2 * TYPE_CAP##_SIZE), TYPE_CAP##_SIZE);  \
+    sp -= TYPE_CAP##_SIZE;                                                 \
+    verify_write(stack + sp - TYPE_CAP##_SIZE, a COMP b, TYPE_CAP##_SIZE); \
+  }                                                                        \
+  VERIFIED_NEXT();
+#define VERIFIED_SAME(OP, COMP)                      \
+  VERIFIED_SAME_TYPE(OP##_BYTE, COMP, BYTE, byte)    \
+  VERIFIED_SAME_TYPE(OP##_SHORT, COMP, SHORT, short) \
+  VERIFIED_SAME_TYPE(OP##_HWORD, COMP, HWORD, hword) \
+  VERIFIED_SAME_TYPE(OP##_WORD, COMP, WORD, word)
+
+#define VERIFIED_COMPARATOR(OP, COMP, TYPE_CAP, GET)                      \
+  VERIFIED_HANDLER(OP)                                                    \
+  {                                                                       \
+    const GET##_t a =                                                     \
+        verify_read(stack + sp - TYPE_CAP##_SIZE, TYPE_CAP##_SIZE);       \
+    const GET##_t b =                                                     \
+        verify_read(stack + sp - (2 * TYPE_CAP##_SIZE), TYPE_CAP##_SIZE); \
+    sp -= 2 * TYPE_CAP##_SIZE;                                            \
+    stack[sp++] = b COMP a;                                               \
+  }                                                                       \
+  VERIFIED_NEXT();
+#define VERIFIED_EQ(OP, TYPE_CAP, TYPE) \
+  VERIFIED_COMPARATOR(OP, ==, TYPE_CAP, TYPE)
+
+#define VERIFIED_JUMP_IF(OP, TYPE_CAP, TYPE)    \
+  VERIFIED_HANDLER(OP)                          \
+  sp -= TYPE_CAP##_SIZE;                        \
+  if (verify_read(stack + sp, TYPE_CAP##_SIZE)) \
+  {                                             \
+    pc = instructions[pc].operand.as_word;      \
+    VERIFIED_DISPATCH();                        \
+  }                                             \
+  VERIFIED_NEXT();
+
+/* Opcodes going through vm_execute, which may still fail for reasons
+   the verifier knows nothing about.  Their routines can't be called
+   directly as they raise a trap when VM_TRAP is set. */
+#define VERIFIED_ROUTINE(OP)        \
+  VERIFIED_HANDLER(OP)              \
+  vm->stack.ptr   = sp;             \
+  vm->program.ptr = pc;             \
+  err             = vm_execute(vm); \
+  sp              = vm->stack.ptr;  \
+  if (err)                          \
+    goto end;                       \
+  VERIFIED_NEXT();
+#define VERIFIED_ROUTINE_UNSIGNED(OP) \
+  VERIFIED_ROUTINE(OP##_BYTE)         \
+  VERIFIED_ROUTINE(OP##_SHORT)        \
+  VERIFIED_ROUTINE(OP##_HWORD)        \
+  VERIFIED_ROUTINE(OP##_WORD)
+#define VERIFIED_DUP(OP, TYPE_CAP, TYPE) VERIFIED_ROUTINE(OP)
+#define VERIFIED_PRINT(OP, COMP, TYPE_CAP, TYPE) VERIFIED_ROUTINE(OP)
+
+err_t vm_execute_verified(vm_t *vm, const verify_t *verify)
+{
+  if (!verify_holds(verify, vm))
+    return vm_execute_all(vm);
+
+  const inst_t *instructions = vm->program.data.instructions;
+  const word_t count         = vm->program.data.count;
+  byte_t *stack              = vm->stack.data;
+  byte_t *registers          = vm->registers.bytes;
+  word_t *calls              = vm->call_stack.address_pointers;
+  size_t sp                  = vm->stack.ptr;
+  size_t call_sp             = vm->call_stack.ptr;
+  word_t pc                  = vm->program.data.start_address;
+  err_t err                  = ERR_OK;
+  if (pc >= count)
+    goto end;
+
+  static_assert(NUMBER_OF_OPCODES == 115, "vm_execute_verified: Out of date");
+#if VM_THREADED
+  static const void *const labels[] = {
+      VERIFIED_LABEL(OP_NOOP),
+      VERIFIED_LABEL(OP_HALT),
+      VERIFIED_LABEL_UNSIGNED(OP_PUSH),
+      VERIFIED_LABEL_UNSIGNED(OP_POP),
+      VERIFIED_LABEL_UNSIGNED(OP_PUSH_REGISTER),
+      VERIFIED_LABEL_UNSIGNED(OP_MOV),
+      VERIFIED_LABEL_UNSIGNED(OP_DUP),
+      VERIFIED_LABEL_UNSIGNED(OP_MALLOC),
+      VERIFIED_LABEL_UNSIGNED(OP_MSET),
+      VERIFIED_LABEL_UNSIGNED(OP_MGET),
+      VERIFIED_LABEL(OP_MDELETE),
+      VERIFIED_LABEL(OP_MSIZE),
+      VERIFIED_LABEL_UNSIGNED(OP_NOT),
+      VERIFIED_LABEL_UNSIGNED(OP_OR),
+      VERIFIED_LABEL_UNSIGNED(OP_AND),
+      VERIFIED_LABEL_UNSIGNED(OP_XOR),
+      VERIFIED_LABEL_UNSIGNED(OP_EQ),
+      VERIFIED_LABEL_UNSIGNED(OP_PLUS),
+      VERIFIED_LABEL_UNSIGNED(OP_SUB),
+      VERIFIED_LABEL_UNSIGNED(OP_MULT),
+      VERIFIED_LABEL_SIGNED(OP_LT),
+      VERIFIED_LABEL_SIGNED(OP_LTE),
+      VERIFIED_LABEL_SIGNED(OP_GT),
+      VERIFIED_LABEL_SIGNED(OP_GTE),
+      VERIFIED_LABEL_SIGNED(OP_PRINT),
+      VERIFIED_LABEL(OP_JUMP_ABS),
+      VERIFIED_LABEL_UNSIGNED(OP_JUMP_IF),
+      VERIFIED_LABEL(OP_CALL),
+      VERIFIED_LABEL(OP_RET),
+  };
+  static_assert(ARR_SIZE(labels) == NUMBER_OF_OPCODES,
+                "vm_execute_verified: Out of date");
+  VERIFIED_DISPATCH();
+#else
+  for (;;)
+    switch (instructions[pc].opcode)
+    {
+#endif
+  VERIFIED_HANDLER(OP_NOOP)
+  VERIFIED_NEXT();
+  VERIFIED_HANDLER(OP_HALT)
+  goto end;
+  VERIFIED_UNSIGNED(VERIFIED_PUSH, OP_PUSH)
+  VERIFIED_UNSIGNED(VERIFIED_POP, OP_POP)
+  VERIFIED_UNSIGNED(VERIFIED_PUSH_REGISTER, OP_PUSH_REGISTER)
+  VERIFIED_UNSIGNED(VERIFIED_MOV, OP_MOV)
+  VERIFIED_UNSIGNED(VERIFIED_DUP, OP_DUP)
+  VERIFIED_ROUTINE_UNSIGNED(OP_MALLOC)
+  VERIFIED_ROUTINE_UNSIGNED(OP_MSET)
+  VERIFIED_ROUTINE_UNSIGNED(OP_MGET)
+  VERIFIED_ROUTINE(OP_MDELETE)
+  VERIFIED_ROUTINE(OP_MSIZE)
+  VERIFIED_UNSIGNED(VERIFIED_NOT, OP_NOT)
+  VERIFIED_SAME(OP_OR, |)
+  VERIFIED_SAME(OP_AND, &)
+  VERIFIED_SAME(OP_XOR, ^)
+  VERIFIED_UNSIGNED(VERIFIED_EQ, OP_EQ)
+  VERIFIED_SAME(OP_PLUS, +)
+  VERIFIED_SAME(OP_SUB, -)
+  VERIFIED_SAME(OP_MULT, *)
+  VERIFIED_SIGNED(VERIFIED_COMPARATOR, OP_LT, <)
+  VERIFIED_SIGNED(VERIFIED_COMPARATOR, OP_LTE, <=)
+  VERIFIED_SIGNED(VERIFIED_COMPARATOR, OP_GT, >)
+  VERIFIED_SIGNED(VERIFIED_COMPARATOR, OP_GTE, >=)
+  VERIFIED_SIGNED(VERIFIED_PRINT, OP_PRINT, )
+  VERIFIED_HANDLER(OP_JUMP_ABS)
+  pc = instructions[pc].operand.as_word;
+  VERIFIED_DISPATCH();
+  VERIFIED_UNSIGNED(VERIFIED_JUMP_IF, OP_JUMP_IF)
+  VERIFIED_HANDLER(OP_CALL)
+  calls[call_sp++] = pc + 1;
+  pc               = instructions[pc].operand.as_word;
+  VERIFIED_DISPATCH();
+  VERIFIED_HANDLER(OP_RET)
+  pc = calls[--call_sp];
+  VERIFIED_DISPATCH();
+#if !VM_THREADED
+    case NUMBER_OF_OPCODES:
+    default:
+      // Never valid, so never reached
+      err = ERR_INVALID_OPCODE;
+      goto end;
+    }
+#endif
+
+end:
+  vm->stack.ptr      = sp;
+  vm->call_stack.ptr = call_sp;
+  vm->program.ptr    = pc;
+  return err;
+}
+
+#if VM_THREADED
+#pragma GCC diagnostic pop
+#endif
@@ -0,0 +1,80 @@
+/* Copyright (C) 2026 Aryadev Chavali
+
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License Version 2 for
+ * more details.
+
+ * You should have received a copy of the GNU General Public License Version 2
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+ * Created: 2026-10-16
+ * Author: Aryadev Chavali
+ * Description: Load time verifier and unchecked execution of programs
+ */
+
+#ifndef VERIFY_H
+#define VERIFY_H
+
+#include <stdbool.h>
+
+#include <vm/runtime.h>
+
+/* Maximum depth of nested calls followed by the verifier.  Programs
+   nesting calls any deeper fail verification. */
+#define VERIFY_MAX_NESTING 256
+
+/**
+   @brief Result of verifying a program.
+
+   @details A valid program can't fail a stack, register, call stack
+   or jump check on any vm satisfying its requirements, which are
+   relative to the state of the vm when execution starts.
+
+   @prop[valid] Whether the program passed verification
+   @prop[failed_at] If not valid, the instruction which failed it
+   @prop[stack_min] Minimum stack pointer
+   @prop[stack_extent] Stack pointer + stack_extent <= max
+   @prop[registers_min] Minimum size of the register file in bytes
+   @prop[call_depth] Minimum number of free entries on the call stack
+ */
+typedef struct
+{
+  bool valid;
+  word_t failed_at;
+  word_t stack_min, stack_extent;
+  word_t registers_min;
+  word_t call_depth;
+} verify_t;
+
+/**
+   @brief Verify a program by abstract interpretation.
+
+   @details The stack depth before each instruction is computed
+   relative to the start of its procedure, which must be the same on
+   every path reaching it.  Calls are verified once per target and
+   their effect on the stack used at every call site, so recursive
+   programs are never valid.
+
+   @param[program] Program to verify
+   @param[verify] Result to initialise
+   @return verify->valid
+ */
+bool verify_program(prog_t program, verify_t *verify);
+
+/* Whether the requirements of a valid program hold for vm. */
+bool verify_holds(const verify_t *verify, const vm_t *vm);
+
+/**
+   @brief Execute the program loaded in vm without runtime checks.
+
+   @details Only if the program is valid and its requirements hold for
+   vm, otherwise this is just vm_execute_all.  Heap, print and DUP
+   opcodes still go through their checked routines.
+
+   @param[vm] Virtual machine with a program loaded
+   @param[verify] Verification of the loaded program
+ */
+err_t vm_execute_verified(vm_t *vm, const verify_t *verify);
+
+#endif